@@ -27,6 +27,8 @@
 # define _XOPEN_SOURCE
 #endif
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <vpn.h>
 #include <c-ctype.h>
 #include "plain.h"
@@ -58,20 +60,68 @@ struct plain_ctx_st {
 	unsigned failed; /* non-zero if the username is wrong */
 
 	const struct plain_cfg_st *config;
+	struct plain_vctx_st *vctx;
+};
+
+/* An entry of the password file; the fields point to the file contents
+ * held by the index. */
+struct plain_entry_st {
+	const char *username;
+	char *groups;
+	const char *cpass;
+};
+
+/* The first line of a file written by 'ocpasswd -i' */
+#define INDEX_HEADER "#ocpasswd-index"
+
+/* The entries of the password file, indexed by username. The index is
+ * loaded on the first authentication and is loaded anew once the file
+ * is modified or replaced, so that an authentication doesn't read the
+ * file. A file in the indexed form of ocpasswd has its entries sorted
+ * by username and unique; these are searched in place, and the hash
+ * table is only built for other files. */
+struct plain_db_st {
+	struct htable ht;
+	struct plain_entry_st *entries;
+	unsigned entries_size;
+	unsigned sorted; /* the entries are searched, not hashed */
+	char *data;
+
+	/* the loaded file */
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	time_t ctime;
+};
+
+/* The calls of the module are serialized (see .concurrency), hence the
+ * index is used without locking. */
+struct plain_vctx_st {
+	const struct plain_cfg_st *config;
+	struct plain_db_st *db;
 };
 
 static void plain_vhost_init(void **vctx, void *pool, void *additional)
 {
 	struct plain_cfg_st *config = additional;
+	struct plain_vctx_st *vc;
 
-	/* vctx is plain_cfg_st */
+	/* vctx is plain_vctx_st */
 
 	if (config == NULL) {
 		fprintf(stderr, "plain: no configuration passed!\n");
 		exit(1);
 	}
 
-	*vctx = (void*)config;
+	vc = talloc_zero(pool, struct plain_vctx_st);
+	if (vc == NULL) {
+		fprintf(stderr, "plain: memory error\n");
+		exit(1);
+	}
+	vc->config = config;
+
+	*vctx = vc;
 
 #ifdef HAVE_LIBOATH
 	oath_init();
@@ -139,91 +189,239 @@ break_group_list(void *pool, char *text,
 	while (p != NULL && *elements < MAX_GROUPS);
 }
 
-/* Returns 0 if the user is successfully authenticated, and sets the appropriate group name.
+static size_t entry_rehash(const void *_e, void *unused)
+{
+	const struct plain_entry_st *e = _e;
+	return hash_any(e->username, strlen(e->username), 0);
+}
+
+static bool entry_cmp(const void *_e, void *username)
+{
+	const struct plain_entry_st *e = _e;
+
+	if (strcmp(e->username, username) == 0)
+		return 1;
+	return 0;
+}
+
+static int db_destructor(struct plain_db_st *db)
+{
+	htable_clear(&db->ht);
+	if (db->data != NULL)
+		safe_memset(db->data, 0, talloc_get_size(db->data));
+	return 0;
+}
+
+/* Parses a "username:groupname:encoded-password" line in place. Returns
+ * zero on success. */
+static int parse_entry(char *line, struct plain_entry_st *e)
+{
+	char *p;
+
+	e->username = line;
+	p = strchr(line, ':');
+	if (p == NULL)
+		return -1;
+	*p = 0;
+
+	e->groups = p+1;
+	p = strchr(e->groups, ':');
+	if (p == NULL)
+		return -1;
+	*p = 0;
+
+	/* anything past the password is ignored */
+	e->cpass = p+1;
+	p = strchr(e->cpass, ':');
+	if (p != NULL)
+		*p = 0;
+
+	return 0;
+}
+
+static int entry_search_cmp(const void *username, const void *_e)
+{
+	const struct plain_entry_st *e = _e;
+
+	return strcmp(username, e->username);
+}
+
+/* Loads the password file into a new index. Of the duplicate entries
+ * of a user the first one is used.
  */
-static int read_auth_pass(struct plain_ctx_st *pctx)
+static struct plain_db_st *db_load(void *pool, const char *file)
 {
+	struct plain_db_st *db;
+	struct plain_entry_st *e;
+	struct stat st;
 	FILE *fp;
-	char line[512];
-	ssize_t ll;
-	char *p, *sp;
-	int ret;
+	char *p, *line;
+	size_t ll, len, lines, i;
 
-	if (pctx->config->passwd == NULL) {
-		/* no password file is set */
-		return 0;
+	fp = fopen(file, "r");
+	if (fp == NULL)
+		return NULL;
+
+	/* the index is of what is read, even if the file is modified
+	 * meanwhile */
+	if (fstat(fileno(fp), &st) == -1)
+		goto fail;
+
+	db = talloc_zero(pool, struct plain_db_st);
+	if (db == NULL)
+		goto fail;
+
+	htable_init(&db->ht, entry_rehash, NULL);
+	talloc_set_destructor(db, db_destructor);
+
+	db->dev = st.st_dev;
+	db->ino = st.st_ino;
+	db->size = st.st_size;
+	db->mtime = st.st_mtime;
+	db->ctime = st.st_ctime;
+
+	db->data = talloc_size(db, st.st_size+1);
+	if (db->data == NULL)
+		goto fail_db;
+
+	len = fread(db->data, 1, st.st_size, fp);
+	db->data[len] = 0;
+	fclose(fp);
+	fp = NULL;
+
+	/* the order of the entries is verified below, as the file may
+	 * have been edited by other means */
+	if (strncmp(db->data, INDEX_HEADER"\n", sizeof(INDEX_HEADER)) == 0)
+		db->sorted = 1;
+
+	lines = 1;
+	for (p = db->data; (p = memchr(p, '\n', db->data+len-p)) != NULL; p++)
+		lines++;
+
+	db->entries = talloc_array(db, struct plain_entry_st, lines);
+	if (db->entries == NULL)
+		goto fail_db;
+
+	for (line = db->data; line != NULL && line < db->data+len; line = p) {
+		p = strchr(line, '\n');
+		ll = (p != NULL) ? (size_t)(p-line+1) : strlen(line);
+		if (p != NULL)
+			*p++ = 0;
+
+		/* too short to be an entry */
+		if (ll <= 4)
+			continue;
+
+		ll = strlen(line);
+		if (ll > 0 && line[ll - 1] == '\r')
+			line[ll - 1] = 0;
+
+		e = &db->entries[db->entries_size];
+		if (parse_entry(line, e) < 0)
+			continue;
+
+		if (db->sorted && db->entries_size > 0 &&
+		    strcmp(e[-1].username, e->username) >= 0)
+			db->sorted = 0;
+		db->entries_size++;
 	}
 
-	pctx->failed = 1;
+	if (db->sorted)
+		return db;
 
-	fp = fopen(pctx->config->passwd, "r");
-	if (fp == NULL) {
+	/* the shadowed entries are left in the array, but not counted */
+	lines = db->entries_size;
+	db->entries_size = 0;
+	for (i = 0; i < lines; i++) {
+		e = &db->entries[i];
+		if (htable_get(&db->ht, entry_rehash(e, NULL), entry_cmp, e->username) != NULL)
+			continue;
+
+		if (!htable_add(&db->ht, entry_rehash(e, NULL), e))
+			goto fail_db;
+		db->entries_size++;
+	}
+
+	return db;
+
+ fail_db:
+	talloc_free(db);
+ fail:
+	if (fp != NULL)
+		fclose(fp);
+	return NULL;
+}
+
+/* Returns the index of the password file, loading it again if the
+ * file was modified or replaced since it was last loaded. If that fails,
+ * the previous index is used.
+ */
+static struct plain_db_st *db_get(struct plain_vctx_st *vctx)
+{
+	struct plain_db_st *db = vctx->db;
+	const char *file = vctx->config->passwd;
+	struct stat st;
+
+	if (stat(file, &st) == -1) {
 		syslog(LOG_AUTH,
 		       "error in plain authentication; cannot open: %s",
-		       pctx->config->passwd);
-		return -1;
+		       file);
+		return NULL;
 	}
 
-	line[sizeof(line)-1] = 0;
-	while ((p=fgets(line, sizeof(line)-1, fp)) != NULL) {
-		ll = strlen(p);
+	if (db != NULL && db->dev == st.st_dev && db->ino == st.st_ino &&
+	    db->size == st.st_size && db->mtime == st.st_mtime &&
+	    db->ctime == st.st_ctime)
+		return db;
 
-		if (ll <= 4)
-			continue;
+	db = db_load(vctx, file);
+	if (db == NULL) {
+		syslog(LOG_AUTH,
+		       "error in plain authentication; cannot load: %s%s",
+		       file, vctx->db?" (using the previously loaded entries)":"");
+		return vctx->db;
+	}
 
-		if (line[ll - 1] == '\n') {
-			ll--;
-			line[ll] = 0;
-		}
-		if (line[ll - 1] == '\r') {
-			ll--;
-			line[ll] = 0;
-		}
-#ifdef HAVE_STRSEP
-		sp = line;
-		p = strsep(&sp, ":");
+	syslog(LOG_AUTH, "plain-auth: loaded %u entries from %s%s",
+	       db->entries_size, file, db->sorted?" (indexed)":"");
 
-		if (p != NULL && strcmp(pctx->username, p) == 0) {
-			p = strsep(&sp, ":");
-			if (p != NULL) {
-				break_group_list(pctx, p, pctx->groupnames, &pctx->groupnames_size);
-
-				p = strsep(&sp, ":");
-				if (p != NULL) {
-					strlcpy(pctx->cpass, p, sizeof(pctx->cpass));
-					pctx->failed = 0;
-					ret = 0;
-					goto exit;
-				}
-			}
-		}
+	talloc_free(vctx->db);
+	vctx->db = db;
+	return db;
+}
 
-#else
-		p = strtok_r(line, ":", &sp);
+/* Returns 0 if the user is successfully authenticated, and sets the appropriate group name.
+ */
+static int read_auth_pass(struct plain_ctx_st *pctx)
+{
+	struct plain_db_st *db;
+	struct plain_entry_st *e;
 
-		if (p != NULL && strcmp(pctx->username, p) == 0) {
-			p = strtok_r(NULL, ":", &sp);
-			if (p != NULL) {
-				break_group_list(pctx, p, pctx->groupnames, &pctx->groupnames_size);
-
-				p = strtok_r(NULL, ":", &sp);
-				if (p != NULL) {
-					strlcpy(pctx->cpass, p, sizeof(pctx->cpass));
-					pctx->failed = 0;
-					ret = 0;
-					goto exit;
-				}
-			}
-		}
-#endif
+	if (pctx->config->passwd == NULL) {
+		/* no password file is set */
+		return 0;
+	}
+
+	pctx->failed = 1;
+
+	db = db_get(pctx->vctx);
+	if (db == NULL)
+		return -1;
+
+	if (db->sorted)
+		e = bsearch(pctx->username, db->entries, db->entries_size,
+			    sizeof(db->entries[0]), entry_search_cmp);
+	else
+		e = htable_get(&db->ht, hash_any(pctx->username, strlen(pctx->username), 0),
+			       entry_cmp, pctx->username);
+	if (e != NULL) {
+		break_group_list(pctx, e->groups, pctx->groupnames, &pctx->groupnames_size);
+		strlcpy(pctx->cpass, e->cpass, sizeof(pctx->cpass));
+		pctx->failed = 0;
 	}
 
 	/* always succeed */
-	ret = 0;
- exit:
-	safe_memset(line, 0, sizeof(line));
-	fclose(fp);
-	return ret;
+	return 0;
 }
 
 static int plain_auth_init(void **ctx, void *pool, void *vctx, const common_auth_init_st *info)
@@ -243,7 +441,8 @@ static int plain_auth_init(void **ctx, void *pool, void *vctx, const common_auth
 
 	strlcpy(pctx->username, info->username, sizeof(pctx->username));
 	pctx->pass_msg = NULL; /* use default */
-	pctx->config = vctx;
+	pctx->vctx = vctx;
+	pctx->config = pctx->vctx->config;
 
 	/* this doesn't fail on password mismatch but sets p->failed */
 	ret = read_auth_pass(pctx);
@@ -489,6 +688,7 @@ static void plain_group_list(void *pool, void *additional, char ***groupname, un
 const struct auth_mod_st plain_auth_funcs = {
 	.type = AUTH_TYPE_PLAIN | AUTH_TYPE_USERNAME_PASS,
 	.allows_retries = 1,
+	.concurrency = 1, /* crypt() is not reentrant */
 	.vhost_init = plain_vhost_init,
 	.auth_init = plain_auth_init,
 	.auth_deinit = plain_auth_deinit,
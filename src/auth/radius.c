@@ -61,6 +61,60 @@
 
 #define MAX_CHALLENGES 16
 
+static rc_handle *radius_handle_new(char *config)
+{
+	rc_handle *rh;
+
+	rh = rc_read_config(config);
+	if (rh == NULL)
+		return NULL;
+
+	if (rc_read_dictionary(rh, rc_conf_str(rh, "dictionary")) != 0) {
+		rc_destroy(rh);
+		return NULL;
+	}
+
+	return rh;
+}
+
+/* Takes a free handle of the vhost, or creates one. It may be called
+ * on several threads at once. */
+static struct radius_handle_st *radius_handle_get(struct radius_vhost_ctx *vctx)
+{
+	struct radius_handle_st *h;
+
+	pthread_mutex_lock(&vctx->lock);
+	h = vctx->free_handles;
+	if (h != NULL)
+		vctx->free_handles = h->next;
+	pthread_mutex_unlock(&vctx->lock);
+
+	if (h != NULL)
+		return h;
+
+	/* not allocated under vctx, as talloc is not thread-safe */
+	h = calloc(1, sizeof(*h));
+	if (h == NULL)
+		return NULL;
+
+	h->rh = radius_handle_new(vctx->config);
+	if (h->rh == NULL) {
+		syslog(LOG_ERR, "radius-auth: error reading the configuration %s", vctx->config);
+		free(h);
+		return NULL;
+	}
+
+	return h;
+}
+
+static void radius_handle_put(struct radius_vhost_ctx *vctx, struct radius_handle_st *h)
+{
+	pthread_mutex_lock(&vctx->lock);
+	h->next = vctx->free_handles;
+	vctx->free_handles = h;
+	pthread_mutex_unlock(&vctx->lock);
+}
+
 static void radius_vhost_init(void **_vctx, void *pool, void *additional)
 {
 	radius_cfg_st *config = additional;
@@ -73,10 +127,15 @@ static void radius_vhost_init(void **_vctx, void *pool, void *additional)
 	if (vctx == NULL)
 		goto fail;
 
+	vctx->config = talloc_strdup(vctx, config->config);
+	if (vctx->config == NULL)
+		goto fail;
+
 	vctx->rh = rc_read_config(config->config);
 	if (vctx->rh == NULL) {
 		goto fail;
 	}
+	pthread_mutex_init(&vctx->lock, NULL);
 
 	if (config->nas_identifier) {
 		strlcpy(vctx->nas_identifier, config->nas_identifier, sizeof(vctx->nas_identifier));
@@ -99,6 +158,14 @@ static void radius_vhost_init(void **_vctx, void *pool, void *additional)
 static void radius_vhost_deinit(void *_vctx)
 {
 	struct radius_vhost_ctx *vctx = _vctx;
+	struct radius_handle_st *h;
+
+	while ((h = vctx->free_handles) != NULL) {
+		vctx->free_handles = h->next;
+		rc_destroy(h->rh);
+		free(h);
+	}
+	pthread_mutex_destroy(&vctx->lock);
 
 	if (vctx->rh != NULL)
 		rc_destroy(vctx->rh);
@@ -253,6 +320,7 @@ static void parse_groupnames(struct radius_ctx_st *pctx, const char *full)
 static int radius_auth_pass(void *ctx, const char *pass, unsigned pass_len)
 {
 	struct radius_ctx_st *pctx = ctx;
+	struct radius_handle_st *h;
 	VALUE_PAIR *send = NULL, *recvd = NULL;
 	uint32_t service;
 	char route[72];
@@ -260,16 +328,21 @@ static int radius_auth_pass(void *ctx, const char *pass, unsigned pass_len)
 	VALUE_PAIR *vp;
 	int ret;
 
+	h = radius_handle_get(pctx->vctx);
+	if (h == NULL)
+		return ERR_AUTH_FAIL;
+
 	/* send Access-Request */
 	syslog(LOG_DEBUG, "radius-auth: communicating username (%s) and password", pctx->username);
-	if (rc_avpair_add(pctx->vctx->rh, &send, PW_USER_NAME, pctx->username, -1, 0) == NULL) {
+	if (rc_avpair_add(h->rh, &send, PW_USER_NAME, pctx->username, -1, 0) == NULL) {
 		syslog(LOG_ERR,
 		       "%s:%u: error in constructing radius message for user '%s'", __func__, __LINE__,
 		       pctx->username);
-		return ERR_AUTH_FAIL;
+		ret = ERR_AUTH_FAIL;
+		goto cleanup;
 	}
 
-	if (rc_avpair_add(pctx->vctx->rh, &send, PW_USER_PASSWORD, (char*)pass, -1, 0) == NULL) {
+	if (rc_avpair_add(h->rh, &send, PW_USER_PASSWORD, (char*)pass, -1, 0) == NULL) {
 		syslog(LOG_ERR,
 		       "%s:%u: error in constructing radius message for user '%s'", __func__, __LINE__,
 		       pctx->username);
@@ -283,14 +356,14 @@ static int radius_auth_pass(void *ctx, const char *pass, unsigned pass_len)
 
 		if (inet_pton(AF_INET, pctx->our_ip, &in) != 0) {
 			in.s_addr = ntohl(in.s_addr);
-			rc_avpair_add(pctx->vctx->rh, &send, PW_NAS_IP_ADDRESS, (char*)&in, sizeof(struct in_addr), 0);
+			rc_avpair_add(h->rh, &send, PW_NAS_IP_ADDRESS, (char*)&in, sizeof(struct in_addr), 0);
 		} else if (inet_pton(AF_INET6, pctx->our_ip, &in6) != 0) {
-			rc_avpair_add(pctx->vctx->rh, &send, PW_NAS_IPV6_ADDRESS, (char*)&in6, sizeof(struct in6_addr), 0);
+			rc_avpair_add(h->rh, &send, PW_NAS_IPV6_ADDRESS, (char*)&in6, sizeof(struct in6_addr), 0);
 		}
 	}
 
 	if (pctx->vctx->nas_identifier[0] != 0) {
-		if (rc_avpair_add(pctx->vctx->rh, &send, PW_NAS_IDENTIFIER, pctx->vctx->nas_identifier, -1, 0) == NULL) {
+		if (rc_avpair_add(h->rh, &send, PW_NAS_IDENTIFIER, pctx->vctx->nas_identifier, -1, 0) == NULL) {
 			syslog(LOG_ERR,
 			       "%s:%u: error in constructing radius message for user '%s'", __func__, __LINE__,
 			       pctx->username);
@@ -299,7 +372,7 @@ static int radius_auth_pass(void *ctx, const char *pass, unsigned pass_len)
 		}
 	}
 
-	if (rc_avpair_add(pctx->vctx->rh, &send, PW_CALLING_STATION_ID, pctx->remote_ip, -1, 0) == NULL) {
+	if (rc_avpair_add(h->rh, &send, PW_CALLING_STATION_ID, pctx->remote_ip, -1, 0) == NULL) {
 		syslog(LOG_ERR,
 		       "%s:%u: error in constructing radius message for user '%s'", __func__, __LINE__,
 		       pctx->username);
@@ -308,7 +381,7 @@ static int radius_auth_pass(void *ctx, const char *pass, unsigned pass_len)
 	}
 
 	if (pctx->user_agent[0] != 0) {
-		if (rc_avpair_add(pctx->vctx->rh, &send, PW_CONNECT_INFO, pctx->user_agent, -1, 0) == NULL) {
+		if (rc_avpair_add(h->rh, &send, PW_CONNECT_INFO, pctx->user_agent, -1, 0) == NULL) {
 			syslog(LOG_ERR,
 			       "%s:%u: error in constructing radius message for user '%s'", __func__, __LINE__,
 			       pctx->username);
@@ -318,7 +391,7 @@ static int radius_auth_pass(void *ctx, const char *pass, unsigned pass_len)
 	}
 
 	service = PW_AUTHENTICATE_ONLY;
-	if (rc_avpair_add(pctx->vctx->rh, &send, PW_SERVICE_TYPE, &service, -1, 0) == NULL) {
+	if (rc_avpair_add(h->rh, &send, PW_SERVICE_TYPE, &service, -1, 0) == NULL) {
 		syslog(LOG_ERR,
 		       "%s:%u: error in constructing radius message for user '%s'", __func__, __LINE__,
 		       pctx->username);
@@ -327,7 +400,7 @@ static int radius_auth_pass(void *ctx, const char *pass, unsigned pass_len)
 	}
 
 	service = PW_ASYNC;
-	if (rc_avpair_add(pctx->vctx->rh, &send, PW_NAS_PORT_TYPE, &service, -1, 0) == NULL) {
+	if (rc_avpair_add(h->rh, &send, PW_NAS_PORT_TYPE, &service, -1, 0) == NULL) {
 		syslog(LOG_ERR,
 		       "%s:%u: error in constructing radius message for user '%s'", __func__, __LINE__,
 		       pctx->username);
@@ -336,7 +409,7 @@ static int radius_auth_pass(void *ctx, const char *pass, unsigned pass_len)
 	}
 
 	if (pctx->state != NULL) {
-		if (rc_avpair_add(pctx->vctx->rh, &send, PW_STATE, pctx->state, -1, 0) == NULL) {
+		if (rc_avpair_add(h->rh, &send, PW_STATE, pctx->state, -1, 0) == NULL) {
 			syslog(LOG_ERR,
 			       "%s:%u: error in constructing radius message for user '%s'", __func__, __LINE__,
 			       pctx->username);
@@ -348,7 +421,7 @@ static int radius_auth_pass(void *ctx, const char *pass, unsigned pass_len)
 	}
 
 	pctx->pass_msg[0] = 0;
-	ret = rc_aaa(pctx->vctx->rh, pctx->id, send, &recvd, pctx->pass_msg, 1, PW_ACCESS_REQUEST);
+	ret = rc_aaa(h->rh, pctx->id, send, &recvd, pctx->pass_msg, 1, PW_ACCESS_REQUEST);
 
 	if (ret == OK_RC) {
 		uint32_t ipv4;
@@ -483,6 +556,7 @@ static int radius_auth_pass(void *ctx, const char *pass, unsigned pass_len)
 		rc_avpair_free(send);
 	if (recvd != NULL)
 		rc_avpair_free(recvd);
+	radius_handle_put(pctx->vctx, h);
 	return ret;
 }
 
@@ -519,6 +593,7 @@ static void radius_auth_deinit(void *ctx)
 const struct auth_mod_st radius_auth_funcs = {
 	.type = AUTH_TYPE_RADIUS | AUTH_TYPE_USERNAME_PASS,
 	.allows_retries = 1,
+	.concurrency = AUTH_CONCURRENCY_UNLIMITED, /* a handle per call */
 	.vhost_init = radius_vhost_init,
 	.vhost_deinit = radius_vhost_deinit,
 	.auth_init = radius_auth_init,
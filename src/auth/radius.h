@@ -22,6 +22,7 @@
 # define RADIUS_H
 
 # include <sec-mod-auth.h>
+# include <pthread.h>
 
 # ifdef HAVE_RADIUS
 
@@ -31,9 +32,21 @@
 #   include <radcli/radcli.h>
 #  endif
 
-struct radius_vhost_ctx {
+/* A handle of the pool of a vhost */
+struct radius_handle_st {
 	rc_handle *rh;
+	struct radius_handle_st *next;
+};
+
+struct radius_vhost_ctx {
+	rc_handle *rh; /* for the configuration values only */
 	char nas_identifier[64];
+
+	/* each Access-Request takes a handle of its own, so that the
+	 * requests on the sec-mod auth threads run in parallel */
+	char *config;
+	pthread_mutex_t lock;
+	struct radius_handle_st *free_handles;
 };
 
 struct radius_ctx_st {
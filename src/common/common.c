@@ -119,6 +119,14 @@ const char *cmd_request_to_str(unsigned _cmd)
 		return "ban IP";
 	case CMD_BAN_IP_REPLY:
 		return "ban IP reply";
+	case CMD_WORKER_STATS:
+		return "worker stats";
+	case CMD_WORKER_START:
+		return "worker start";
+	case CMD_DTLS_PORT_FD:
+		return "DTLS port fd";
+	case CMD_ACCEPTED_CONN:
+		return "accepted connection";
 
 	case CMD_SEC_CLI_STATS:
 		return "sm: worker cli stats";
@@ -733,39 +741,21 @@ void *_talloc_size2(void *ctx, size_t size)
 	return talloc_size(ctx, size);
 }
 
-/* like recvfrom but also returns the address of our interface.
+/* Finds the address of our interface in the control messages of
+ * a datagram received with recvmsg(). If none is present, our_addr
+ * is left unchanged.
  *
  * @def_port: is provided to fill in the missing port number
  *   in our_addr.
  */
-ssize_t oc_recvfrom_at(int sockfd, void *buf, size_t len, int flags,
-		       struct sockaddr * src_addr, socklen_t * addrlen,
+int oc_msghdr_our_addr(struct msghdr *mh,
 		       struct sockaddr * our_addr, socklen_t * our_addrlen,
 		       int def_port)
 {
-	int ret;
-	char cmbuf[256];
-	struct iovec iov = { buf, len };
 	struct cmsghdr *cmsg;
-	struct msghdr mh = {
-		.msg_name = src_addr,
-		.msg_namelen = *addrlen,
-		.msg_iov = &iov,
-		.msg_iovlen = 1,
-		.msg_control = cmbuf,
-		.msg_controllen = sizeof(cmbuf),
-	};
-
-	do {
-		ret = recvmsg(sockfd, &mh, 0);
-	} while (ret == -1 && errno == EINTR);
-	if (ret < 0) {
-		return -1;
-	}
 
-	/* find our address */
-	for (cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL;
-	     cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+	for (cmsg = CMSG_FIRSTHDR(mh); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(mh, cmsg)) {
 #if defined(IP_PKTINFO)
 		if (cmsg->cmsg_level == IPPROTO_IP
 		    && cmsg->cmsg_type == IP_PKTINFO) {
@@ -821,11 +811,106 @@ ssize_t oc_recvfrom_at(int sockfd, void *buf, size_t len, int flags,
 		}
 #endif
 	}
+	return 0;
+}
+
+/* like recvfrom but also returns the address of our interface.
+ *
+ * @def_port: is provided to fill in the missing port number
+ *   in our_addr.
+ */
+ssize_t oc_recvfrom_at(int sockfd, void *buf, size_t len, int flags,
+		       struct sockaddr * src_addr, socklen_t * addrlen,
+		       struct sockaddr * our_addr, socklen_t * our_addrlen,
+		       int def_port)
+{
+	int ret;
+	char cmbuf[256];
+	struct iovec iov = { buf, len };
+	struct msghdr mh = {
+		.msg_name = src_addr,
+		.msg_namelen = *addrlen,
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = cmbuf,
+		.msg_controllen = sizeof(cmbuf),
+	};
+
+	do {
+		ret = recvmsg(sockfd, &mh, 0);
+	} while (ret == -1 && errno == EINTR);
+	if (ret < 0) {
+		return -1;
+	}
+
+	/* find our address */
+	if (oc_msghdr_our_addr(&mh, our_addr, our_addrlen, def_port) < 0)
+		return -1;
+
 	*addrlen = mh.msg_namelen;
 
 	return ret;
 }
 
+/* like sendto but sends from the address of our interface, as
+ * returned by oc_recvfrom_at(), on a socket bound to a wildcard
+ * address.
+ */
+ssize_t oc_sendto_from(int sockfd, const void *buf, size_t len, int flags,
+		       const struct sockaddr * dest_addr, socklen_t addrlen,
+		       const struct sockaddr * our_addr, socklen_t our_addrlen)
+{
+	ssize_t ret;
+	char cmbuf[256];
+	struct iovec iov = { (void *)buf, len };
+	struct cmsghdr *cmsg;
+	struct msghdr mh = {
+		.msg_name = (void *)dest_addr,
+		.msg_namelen = addrlen,
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+
+	memset(cmbuf, 0, sizeof(cmbuf));
+
+#if defined(IP_PKTINFO)
+	if (our_addrlen >= sizeof(struct sockaddr_in) && our_addr->sa_family == AF_INET) {
+		struct in_pktinfo *pi;
+
+		mh.msg_control = cmbuf;
+		mh.msg_controllen = CMSG_SPACE(sizeof(*pi));
+		cmsg = CMSG_FIRSTHDR(&mh);
+		cmsg->cmsg_level = IPPROTO_IP;
+		cmsg->cmsg_type = IP_PKTINFO;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(*pi));
+		pi = (void *)CMSG_DATA(cmsg);
+		memcpy(&pi->ipi_spec_dst, &((struct sockaddr_in *)our_addr)->sin_addr,
+		       sizeof(struct in_addr));
+	}
+#endif
+#ifdef IPV6_RECVPKTINFO
+	if (our_addrlen >= sizeof(struct sockaddr_in6) && our_addr->sa_family == AF_INET6) {
+		struct in6_pktinfo *pi;
+
+		mh.msg_control = cmbuf;
+		mh.msg_controllen = CMSG_SPACE(sizeof(*pi));
+		cmsg = CMSG_FIRSTHDR(&mh);
+		cmsg->cmsg_level = IPPROTO_IPV6;
+		cmsg->cmsg_type = IPV6_PKTINFO;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(*pi));
+		pi = (void *)CMSG_DATA(cmsg);
+		memcpy(&pi->ipi6_addr, &((struct sockaddr_in6 *)our_addr)->sin6_addr,
+		       sizeof(struct in6_addr));
+	}
+#endif
+
+	do {
+		ret = sendmsg(sockfd, &mh, flags);
+	} while (ret == -1 && errno == EINTR);
+
+	return ret;
+}
+
 #ifndef HAVE_STRLCPY
 
 /*
@@ -89,6 +89,12 @@ ssize_t oc_recvfrom_at(int sockfd, void *buf, size_t len, int flags,
                     struct sockaddr *src_addr, socklen_t *addrlen,
                     struct sockaddr *our_addr, socklen_t *our_addrlen,
                     int def_port);
+ssize_t oc_sendto_from(int sockfd, const void *buf, size_t len, int flags,
+                    const struct sockaddr *dest_addr, socklen_t addrlen,
+                    const struct sockaddr *our_addr, socklen_t our_addrlen);
+int oc_msghdr_our_addr(struct msghdr *mh,
+                    struct sockaddr *our_addr, socklen_t *our_addrlen,
+                    int def_port);
 
 inline static
 void safe_memset(void *data, int c, size_t size)
@@ -265,6 +265,56 @@ static void figure_auth_funcs(void *pool, const char *vhostname,
 	talloc_free(auth);
 }
 
+/* Sets the timeouts of the authentication backends, given as
+ * 'seconds' for all of them or as 'method:seconds'.
+ */
+static void figure_auth_timeouts(const char *vhostname, struct perm_cfg_st *config,
+				 char **timeouts, unsigned timeouts_size)
+{
+	const struct auth_mod_st *mod;
+	unsigned i, j;
+	const char *p;
+	int secs;
+
+	if (timeouts == NULL)
+		return;
+
+	for (j=0;j<timeouts_size;j++) {
+		mod = NULL;
+		p = strchr(timeouts[j], ':');
+		if (p != NULL) {
+			for (i=0;i<sizeof(avail_auth_types)/sizeof(avail_auth_types[0]);i++) {
+				if (avail_auth_types[i].mod != NULL && avail_auth_types[i].name_size == (unsigned)(p - timeouts[j]) &&
+				    c_strncasecmp(timeouts[j], avail_auth_types[i].name, avail_auth_types[i].name_size) == 0) {
+					mod = avail_auth_types[i].mod;
+					break;
+				}
+			}
+
+			if (mod == NULL) {
+				fprintf(stderr, ERRSTR"%s: unknown or unsupported auth method in auth-backend-timeout: %s\n", vhostname, timeouts[j]);
+				exit(1);
+			}
+			p++;
+		} else {
+			p = timeouts[j];
+		}
+
+		secs = atoi(p);
+		if (secs <= 0) {
+			fprintf(stderr, ERRSTR"%s: invalid auth-backend-timeout: %s\n", vhostname, timeouts[j]);
+			exit(1);
+		}
+
+		for (i=0;i<config->auth_methods;i++) {
+			if (mod == NULL || config->auth[i].amod == mod)
+				config->auth[i].timeout = secs;
+		}
+		talloc_free(timeouts[j]);
+	}
+	talloc_free(timeouts);
+}
+
 typedef struct acct_types_st {
 	const char *name;
 	unsigned name_size;
@@ -491,10 +541,23 @@ static void apply_default_conf(vhost_cfg_st *vhost, unsigned reload)
 	if (!reload) { /* perm config defaults */
 		tls_vhost_init(vhost);
 		vhost->perm_config.stats_reset_time = 24*60*60*7; /* weekly */
+		vhost->perm_config.pkcs11_key_concurrency = 1;
 	}
 
 	vhost->perm_config.config->mobile_idle_timeout = (unsigned)-1;
 	vhost->perm_config.config->no_compress_limit = DEFAULT_NO_COMPRESS_LIMIT;
+	vhost->perm_config.config->packet_batch_size = DEFAULT_PACKET_BATCH_SIZE;
+	vhost->perm_config.config->client_hello_timeout = DEFAULT_CLIENT_HELLO_TIMEOUT;
+	vhost->perm_config.config->udp_port_rate_limit = DEFAULT_UDP_PORT_RATE_LIMIT;
+	vhost->perm_config.config->rate_limit_burst = DEFAULT_RATE_LIMIT_BURST;
+	vhost->perm_config.config->net_rate_limit_burst = DEFAULT_NET_RATE_LIMIT_BURST;
+	vhost->perm_config.config->dtls_hello_verify = 1;
+	vhost->perm_config.config->dtls_tx_queue_size = DEFAULT_DTLS_TX_QUEUE_SIZE;
+	vhost->perm_config.config->bandwidth_queue_size = DEFAULT_BANDWIDTH_QUEUE_SIZE;
+	vhost->perm_config.config->fq_codel_flows = DEFAULT_FQ_CODEL_FLOWS;
+	vhost->perm_config.config->fq_codel_limit = DEFAULT_FQ_CODEL_LIMIT;
+	vhost->perm_config.config->fq_codel_target = DEFAULT_FQ_CODEL_TARGET;
+	vhost->perm_config.config->fq_codel_interval = DEFAULT_FQ_CODEL_INTERVAL;
 	vhost->perm_config.config->rekey_time = 24*60*60;
 	vhost->perm_config.config->cookie_timeout = DEFAULT_COOKIE_RECON_TIMEOUT;
 	vhost->perm_config.config->auth_timeout = DEFAULT_AUTH_TIMEOUT_SECS;
@@ -716,6 +779,8 @@ static int cfg_ini_handler(void *_ctx, const char *section, const char *name, co
 			READ_MULTI_LINE(vhost->auth, vhost->auth_size);
 		} else if (strcmp(name, "enable-auth") == 0) {
 			READ_MULTI_LINE(vhost->eauth, vhost->eauth_size);
+		} else if (strcmp(name, "auth-backend-timeout") == 0) {
+			READ_MULTI_LINE(vhost->auth_timeout, vhost->auth_timeout_size);
 		} else if (strcmp(name, "acct") == 0) {
 			vhost->acct = talloc_strdup(pool, value);
 		} else if (strcmp(name, "listen-host") == 0) {
@@ -731,6 +796,17 @@ static int cfg_ini_handler(void *_ctx, const char *section, const char *name, co
 		} else if (strcmp(name, "udp-port") == 0) {
 			if (!PWARN_ON_VHOST(vhost->name, "udp-port", udp_port))
 				READ_NUMERIC(vhost->perm_config.udp_port);
+		} else if (strcmp(name, "dtls-port-range") == 0) {
+			if (!PWARN_ON_VHOST(vhost->name, "dtls-port-range", dtls_port_min)) {
+				if (sscanf(value, "%u-%u", &vhost->perm_config.dtls_port_min,
+					   &vhost->perm_config.dtls_port_max) != 2 ||
+				    vhost->perm_config.dtls_port_min == 0 ||
+				    vhost->perm_config.dtls_port_min > vhost->perm_config.dtls_port_max ||
+				    vhost->perm_config.dtls_port_max > 65535) {
+					fprintf(stderr, ERRSTR"invalid dtls-port-range: %s\n", value);
+					exit(1);
+				}
+			}
 		} else if (strcmp(name, "run-as-user") == 0) {
 			if (!PWARN_ON_VHOST(vhost->name, "run-as-user", uid)) {
 				const struct passwd* pwd = getpwnam(value);
@@ -771,6 +847,9 @@ static int cfg_ini_handler(void *_ctx, const char *section, const char *name, co
 		} else if (strcmp(name, "occtl-socket-file") == 0) {
 			if (!PWARN_ON_VHOST_STRDUP(vhost->name, "occtl-socket-file", occtl_socket_file))
 				PREAD_STRING(pool, vhost->perm_config.occtl_socket_file);
+		} else if (strcmp(name, "state-file") == 0) {
+			if (!PWARN_ON_VHOST_STRDUP(vhost->name, "state-file", state_file))
+				PREAD_STRING(pool, vhost->perm_config.state_file);
 		} else if (strcmp(name, "chroot-dir") == 0) {
 			if (!PWARN_ON_VHOST_STRDUP(vhost->name, "chroot-dir", chroot_dir))
 				PREAD_STRING(pool, vhost->perm_config.chroot_dir);
@@ -779,6 +858,15 @@ static int cfg_ini_handler(void *_ctx, const char *section, const char *name, co
 			 * re-read configuration too */
 			if (!PWARN_ON_VHOST(vhost->name, "server-stats-reset-time", stats_reset_time))
 				READ_NUMERIC(vhost->perm_config.stats_reset_time);
+		} else if (strcmp(name, "sec-mod-signers") == 0) {
+			if (!PWARN_ON_VHOST(vhost->name, "sec-mod-signers", sec_mod_signers))
+				READ_NUMERIC(vhost->perm_config.sec_mod_signers);
+		} else if (strcmp(name, "sec-mod-auth-threads") == 0) {
+			if (!PWARN_ON_VHOST(vhost->name, "sec-mod-auth-threads", sec_mod_auth_threads))
+				READ_NUMERIC(vhost->perm_config.sec_mod_auth_threads);
+		} else if (strcmp(name, "pkcs11-key-concurrency") == 0) {
+			if (!PWARN_ON_VHOST(vhost->name, "pkcs11-key-concurrency", pkcs11_key_concurrency))
+				READ_NUMERIC(vhost->perm_config.pkcs11_key_concurrency);
 		} else if (strcmp(name, "pid-file") == 0) {
 			if (pid_file[0] == 0) {
 				READ_STATIC_STRING(pid_file);
@@ -804,6 +892,12 @@ static int cfg_ini_handler(void *_ctx, const char *section, const char *name, co
 	} else if (strcmp(name, "listen-proxy-proto") == 0) {
 		if (!WARN_ON_VHOST(vhost->name, "listen-proxy-proto", listen_proxy_proto))
 			READ_TF(config->listen_proxy_proto);
+	} else if (strcmp(name, "listen-shards") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "listen-shards", listen_shards))
+			READ_NUMERIC(config->listen_shards);
+	} else if (strcmp(name, "listen-shard-by-cpu") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "listen-shard-by-cpu", listen_shard_by_cpu))
+			READ_TF(config->listen_shard_by_cpu);
 	} else if (strcmp(name, "append-routes") == 0) {
 		READ_TF(config->append_routes);
 #ifdef HAVE_GSSAPI
@@ -823,6 +917,30 @@ static int cfg_ini_handler(void *_ctx, const char *section, const char *name, co
 	} else if (strcmp(name, "rate-limit-ms") == 0) {
 		if (!WARN_ON_VHOST(vhost->name, "rate-limit-ms", rate_limit_ms))
 			READ_NUMERIC(config->rate_limit_ms);
+	} else if (strcmp(name, "rate-limit-burst") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "rate-limit-burst", rate_limit_burst))
+			READ_NUMERIC(config->rate_limit_burst);
+	} else if (strcmp(name, "net-rate-limit-ms") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "net-rate-limit-ms", net_rate_limit_ms))
+			READ_NUMERIC(config->net_rate_limit_ms);
+	} else if (strcmp(name, "net-rate-limit-burst") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "net-rate-limit-burst", net_rate_limit_burst))
+			READ_NUMERIC(config->net_rate_limit_burst);
+	} else if (strcmp(name, "load-shedding-threshold") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "load-shedding-threshold", load_shedding_threshold))
+			READ_NUMERIC(config->load_shedding_threshold);
+	} else if (strcmp(name, "worker-pool-size") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "worker-pool-size", worker_pool_size))
+			READ_NUMERIC(config->worker_pool_size);
+	} else if (strcmp(name, "client-hello-timeout") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "client-hello-timeout", client_hello_timeout))
+			READ_NUMERIC(config->client_hello_timeout);
+	} else if (strcmp(name, "udp-port-rate-limit") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "udp-port-rate-limit", udp_port_rate_limit))
+			READ_NUMERIC(config->udp_port_rate_limit);
+	} else if (strcmp(name, "dtls-hello-verify") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "dtls-hello-verify", dtls_hello_verify))
+			READ_TF(config->dtls_hello_verify);
 	} else if (strcmp(name, "ocsp-response") == 0) {
 		READ_STRING(config->ocsp_response);
 	} else if (strcmp(name, "user-profile") == 0) {
@@ -897,6 +1015,12 @@ static int cfg_ini_handler(void *_ctx, const char *section, const char *name, co
 	} else if (strcmp(name, "try-mtu-discovery") == 0) {
 		if (!WARN_ON_VHOST(vhost->name, "try-mtu-discovery", try_mtu))
 			READ_TF(config->try_mtu);
+	} else if (strcmp(name, "ktls") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "ktls", ktls))
+			READ_TF(config->ktls);
+	} else if (strcmp(name, "udp-gso") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "udp-gso", udp_gso))
+			READ_TF(config->udp_gso);
 	} else if (strcmp(name, "ping-leases") == 0) {
 		if (!WARN_ON_VHOST(vhost->name, "ping_leases", ping_leases))
 			READ_TF(config->ping_leases);
@@ -916,12 +1040,47 @@ static int cfg_ini_handler(void *_ctx, const char *section, const char *name, co
 		READ_PRIO_TOS(config->net_priority);
 	} else if (strcmp(name, "output-buffer") == 0) {
 		READ_NUMERIC(config->output_buffer);
+	} else if (strcmp(name, "packet-batch-size") == 0) {
+		READ_NUMERIC(config->packet_batch_size);
+	} else if (strcmp(name, "dtls-tx-queue-size") == 0) {
+		READ_NUMERIC(config->dtls_tx_queue_size);
+	} else if (strcmp(name, "dtls-tx-drop-policy") == 0) {
+		if (strcmp(value, "tail") == 0)
+			config->dtls_tx_drop_head = 0;
+		else if (strcmp(value, "head") == 0)
+			config->dtls_tx_drop_head = 1;
+		else {
+			fprintf(stderr, ERRSTR"unknown DTLS drop policy '%s'\n", value);
+			exit(1);
+		}
+	} else if (strcmp(name, "cstp-coalesce-size") == 0) {
+		READ_NUMERIC(config->cstp_coalesce_size);
+	} else if (strcmp(name, "io-uring") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "io-uring", io_uring))
+			READ_TF(config->io_uring);
+	} else if (strcmp(name, "worker-tx-thread") == 0) {
+		if (!WARN_ON_VHOST(vhost->name, "worker-tx-thread", worker_tx_thread))
+			READ_TF(config->worker_tx_thread);
 	} else if (strcmp(name, "rx-data-per-sec") == 0) {
 		READ_NUMERIC(config->rx_per_sec);
 		config->rx_per_sec /= 1000; /* in kb */
 	} else if (strcmp(name, "tx-data-per-sec") == 0) {
 		READ_NUMERIC(config->tx_per_sec);
 		config->tx_per_sec /= 1000; /* in kb */
+	} else if (strcmp(name, "bandwidth-burst") == 0) {
+		READ_NUMERIC(config->bandwidth_burst);
+	} else if (strcmp(name, "bandwidth-queue-size") == 0) {
+		READ_NUMERIC(config->bandwidth_queue_size);
+	} else if (strcmp(name, "fq-codel") == 0) {
+		READ_TF(config->fq_codel);
+	} else if (strcmp(name, "fq-codel-flows") == 0) {
+		READ_NUMERIC(config->fq_codel_flows);
+	} else if (strcmp(name, "fq-codel-limit") == 0) {
+		READ_NUMERIC(config->fq_codel_limit);
+	} else if (strcmp(name, "fq-codel-target") == 0) {
+		READ_NUMERIC(config->fq_codel_target);
+	} else if (strcmp(name, "fq-codel-interval") == 0) {
+		READ_NUMERIC(config->fq_codel_interval);
 	} else if (strcmp(name, "deny-roaming") == 0) {
 		READ_TF(config->deny_roaming);
 	} else if (strcmp(name, "stats-report-time") == 0) {
@@ -1110,6 +1269,7 @@ static void parse_cfg_file(void *pool, const char *file, struct list_head *head,
 
 			figure_auth_funcs(vhost, PREFIX_VHOST(vhost), &vhost->perm_config, vhost->auth, vhost->auth_size, 1);
 			figure_auth_funcs(vhost, PREFIX_VHOST(vhost), &vhost->perm_config, vhost->eauth, vhost->eauth_size, 0);
+			figure_auth_timeouts(PREFIX_VHOST(vhost), &vhost->perm_config, vhost->auth_timeout, vhost->auth_timeout_size);
 
 			figure_acct_funcs(vhost, PREFIX_VHOST(vhost), &vhost->perm_config, vhost->acct);
 
@@ -1188,6 +1348,24 @@ static void check_cfg(vhost_cfg_st *vhost, vhost_cfg_st *defvhost, unsigned sile
 		}
 	}
 
+	if (vhost->perm_config.sec_mod_signers > MAX_SEC_MOD_THREADS)
+		vhost->perm_config.sec_mod_signers = MAX_SEC_MOD_THREADS;
+	if (vhost->perm_config.sec_mod_auth_threads > MAX_SEC_MOD_THREADS)
+		vhost->perm_config.sec_mod_auth_threads = MAX_SEC_MOD_THREADS;
+#ifndef ENABLE_WORKER_THREADS
+	if (vhost->perm_config.sec_mod_signers) {
+		fprintf(stderr, WARNSTR"sec-mod-signers is not supported in this build\n");
+		vhost->perm_config.sec_mod_signers = 0;
+	}
+	if (vhost->perm_config.sec_mod_auth_threads) {
+		fprintf(stderr, WARNSTR"sec-mod-auth-threads is not supported in this build\n");
+		vhost->perm_config.sec_mod_auth_threads = 0;
+	}
+#endif
+
+	if (vhost->perm_config.pkcs11_key_concurrency == 0)
+		vhost->perm_config.pkcs11_key_concurrency = 1;
+
 	if (vhost->perm_config.cert_size == 0 || vhost->perm_config.key_size == 0) {
 		fprintf(stderr, ERRSTR"%sthe 'server-cert' and 'server-key' configuration options must be specified!\n", PREFIX_VHOST(vhost));
 		exit(1);
@@ -1284,6 +1462,25 @@ static void check_cfg(vhost_cfg_st *vhost, vhost_cfg_st *defvhost, unsigned sile
 		}
 	}
 
+#ifndef HAVE_GNUTLS_KTLS
+	if (config->ktls) {
+		if (!silent)
+			fprintf(stderr, WARNSTR"ktls is not supported by this GnuTLS version\n");
+		config->ktls = 0;
+	}
+#endif
+
+	/* the TLS 1.3 key updates cannot be applied to the keys in the
+	 * kernel, so that version is not negotiated with kTLS */
+	if ((defvhost ? defvhost : vhost)->perm_config.config->ktls &&
+	    strstr(config->priorities, ":-VERS-TLS1.3") == NULL) {
+		config->priorities = talloc_asprintf_append(config->priorities, ":-VERS-TLS1.3");
+		if (config->priorities == NULL) {
+			fprintf(stderr, ERRSTR"memory\n");
+			exit(1);
+		}
+	}
+
 	if (vhost->perm_config.occtl_socket_file == NULL)
 		vhost->perm_config.occtl_socket_file = talloc_strdup(vhost, OCCTL_UNIX_SOCKET);
 
@@ -1329,6 +1526,62 @@ static void check_cfg(vhost_cfg_st *vhost, vhost_cfg_st *defvhost, unsigned sile
 	if (config->no_compress_limit < MIN_NO_COMPRESS_LIMIT)
 		config->no_compress_limit = MIN_NO_COMPRESS_LIMIT;
 
+	if (config->packet_batch_size == 0)
+		config->packet_batch_size = 1;
+	else if (config->packet_batch_size > MAX_PACKET_BATCH_SIZE)
+		config->packet_batch_size = MAX_PACKET_BATCH_SIZE;
+
+	if (config->dtls_tx_queue_size == 0)
+		config->dtls_tx_queue_size = 1;
+	else if (config->dtls_tx_queue_size > MAX_DTLS_TX_QUEUE_SIZE)
+		config->dtls_tx_queue_size = MAX_DTLS_TX_QUEUE_SIZE;
+
+	if (config->bandwidth_queue_size > MAX_BANDWIDTH_QUEUE_SIZE)
+		config->bandwidth_queue_size = MAX_BANDWIDTH_QUEUE_SIZE;
+
+	if (config->fq_codel_flows == 0)
+		config->fq_codel_flows = 1;
+	else if (config->fq_codel_flows > MAX_FQ_CODEL_FLOWS)
+		config->fq_codel_flows = MAX_FQ_CODEL_FLOWS;
+
+	if (config->fq_codel_limit == 0)
+		config->fq_codel_limit = 1;
+	else if (config->fq_codel_limit > MAX_FQ_CODEL_LIMIT)
+		config->fq_codel_limit = MAX_FQ_CODEL_LIMIT;
+
+	if (config->fq_codel_interval == 0)
+		config->fq_codel_interval = DEFAULT_FQ_CODEL_INTERVAL;
+
+	if (config->worker_pool_size > MAX_WORKER_POOL_SIZE)
+		config->worker_pool_size = MAX_WORKER_POOL_SIZE;
+
+	if (config->listen_shards > MAX_LISTEN_SHARDS)
+		config->listen_shards = MAX_LISTEN_SHARDS;
+
+	if (config->load_shedding_threshold > 100)
+		config->load_shedding_threshold = 100;
+#ifndef SO_REUSEPORT
+	if (config->listen_shards > 1) {
+		fprintf(stderr, WARNSTR"listen-shards is not supported on this system\n");
+		config->listen_shards = 1;
+	}
+#endif
+
+#ifndef ENABLE_WORKER_THREADS
+	if (config->worker_tx_thread) {
+		fprintf(stderr, WARNSTR"worker-tx-thread is not supported in this build\n");
+		config->worker_tx_thread = 0;
+	}
+#endif
+
+	if (config->worker_tx_thread && config->io_uring) {
+		fprintf(stderr, WARNSTR"io-uring cannot be combined with worker-tx-thread; disabling io-uring\n");
+		config->io_uring = 0;
+	}
+
+	if (config->cstp_coalesce_size > MAX_CSTP_COALESCE_SIZE)
+		config->cstp_coalesce_size = MAX_CSTP_COALESCE_SIZE;
+
 	/* use tcp listen host by default */
 	if (vhost->perm_config.udp_listen_host ==  NULL) {
 		vhost->perm_config.udp_listen_host = vhost->perm_config.listen_host;
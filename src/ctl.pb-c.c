@@ -457,7 +457,7 @@ void   unban_req__free_unpacked
   assert(message->base.descriptor == &unban_req__descriptor);
   protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
 }
-static const ProtobufCFieldDescriptor status_rep__field_descriptors[24] =
+static const ProtobufCFieldDescriptor status_rep__field_descriptors[39] =
 {
   {
     "status",
@@ -747,20 +747,215 @@ static const ProtobufCFieldDescriptor status_rep__field_descriptors[24] =
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "avg_handshake_us",
+    26,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(StatusRep, has_avg_handshake_us),
+    offsetof(StatusRep, avg_handshake_us),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "max_handshake_us",
+    27,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(StatusRep, has_max_handshake_us),
+    offsetof(StatusRep, max_handshake_us),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "idle_workers",
+    28,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(StatusRep, has_idle_workers),
+    offsetof(StatusRep, idle_workers),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "no_hello_conns",
+    29,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(StatusRep, has_no_hello_conns),
+    offsetof(StatusRep, no_hello_conns),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "conns_rate_limited",
+    30,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(StatusRep, has_conns_rate_limited),
+    offsetof(StatusRep, conns_rate_limited),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "conns_shed",
+    31,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(StatusRep, has_conns_shed),
+    offsetof(StatusRep, conns_shed),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "accept_backlog",
+    32,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(StatusRep, has_accept_backlog),
+    offsetof(StatusRep, accept_backlog),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "ipv4_pool_size",
+    33,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(StatusRep, has_ipv4_pool_size),
+    offsetof(StatusRep, ipv4_pool_size),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "ipv4_pool_used",
+    34,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(StatusRep, has_ipv4_pool_used),
+    offsetof(StatusRep, ipv4_pool_used),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "ipv6_pool_size",
+    35,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(StatusRep, has_ipv6_pool_size),
+    offsetof(StatusRep, ipv6_pool_size),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "ipv6_pool_used",
+    36,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(StatusRep, has_ipv6_pool_used),
+    offsetof(StatusRep, ipv6_pool_used),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "avg_key_op_us",
+    37,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(StatusRep, has_avg_key_op_us),
+    offsetof(StatusRep, avg_key_op_us),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "max_key_op_us",
+    38,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(StatusRep, has_max_key_op_us),
+    offsetof(StatusRep, max_key_op_us),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "max_key_op_queue",
+    39,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(StatusRep, has_max_key_op_queue),
+    offsetof(StatusRep, max_key_op_queue),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "conns_max_clients",
+    40,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(StatusRep, has_conns_max_clients),
+    offsetof(StatusRep, conns_max_clients),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned status_rep__field_indices_by_name[] = {
+  30,   /* field[30] = accept_backlog */
   3,   /* field[3] = active_clients */
   21,   /* field[21] = auth_failures */
   17,   /* field[17] = avg_auth_time */
+  24,   /* field[24] = avg_handshake_us */
+  35,   /* field[35] = avg_key_op_us */
   18,   /* field[18] = avg_session_mins */
   6,   /* field[6] = banned_ips */
+  38,   /* field[38] = conns_max_clients */
+  28,   /* field[28] = conns_rate_limited */
+  29,   /* field[29] = conns_shed */
+  26,   /* field[26] = idle_workers */
+  31,   /* field[31] = ipv4_pool_size */
+  32,   /* field[32] = ipv4_pool_used */
+  33,   /* field[33] = ipv6_pool_size */
+  34,   /* field[34] = ipv6_pool_used */
   12,   /* field[12] = kbytes_in */
   13,   /* field[13] = kbytes_out */
   16,   /* field[16] = last_reset */
   19,   /* field[19] = max_auth_time */
+  25,   /* field[25] = max_handshake_us */
+  37,   /* field[37] = max_key_op_queue */
+  36,   /* field[36] = max_key_op_us */
   15,   /* field[15] = max_mtu */
   20,   /* field[20] = max_session_mins */
   14,   /* field[14] = min_mtu */
+  27,   /* field[27] = no_hello_conns */
   1,   /* field[1] = pid */
   2,   /* field[2] = sec_mod_pid */
   7,   /* field[7] = secmod_client_entries */
@@ -778,7 +973,7 @@ static const ProtobufCIntRange status_rep__number_ranges[2 + 1] =
 {
   { 1, 0 },
   { 7, 5 },
-  { 0, 24 }
+  { 0, 39 }
 };
 const ProtobufCMessageDescriptor status_rep__descriptor =
 {
@@ -788,7 +983,7 @@ const ProtobufCMessageDescriptor status_rep__descriptor =
   "StatusRep",
   "",
   sizeof(StatusRep),
-  24,
+  39,
   status_rep__field_descriptors,
   status_rep__field_indices_by_name,
   2,  status_rep__number_ranges,
@@ -834,7 +1029,7 @@ const ProtobufCMessageDescriptor bool_msg__descriptor =
   (ProtobufCMessageInit) bool_msg__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor user_info_rep__field_descriptors[33] =
+static const ProtobufCFieldDescriptor user_info_rep__field_descriptors[42] =
 {
   {
     "id",
@@ -1232,8 +1427,118 @@ static const ProtobufCFieldDescriptor user_info_rep__field_descriptors[33] =
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "batch_wakeups",
+    34,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(UserInfoRep, has_batch_wakeups),
+    offsetof(UserInfoRep, batch_wakeups),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "batch_packets",
+    35,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(UserInfoRep, has_batch_packets),
+    offsetof(UserInfoRep, batch_packets),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "ktls",
+    36,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(UserInfoRep, has_ktls),
+    offsetof(UserInfoRep, ktls),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "dtls_tx_queued",
+    37,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(UserInfoRep, has_dtls_tx_queued),
+    offsetof(UserInfoRep, dtls_tx_queued),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "dtls_tx_dropped",
+    38,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(UserInfoRep, has_dtls_tx_dropped),
+    offsetof(UserInfoRep, dtls_tx_dropped),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "fq_flows",
+    39,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(UserInfoRep, has_fq_flows),
+    offsetof(UserInfoRep, fq_flows),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "fq_queued",
+    40,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(UserInfoRep, has_fq_queued),
+    offsetof(UserInfoRep, fq_queued),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "fq_overlimit_drops",
+    41,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(UserInfoRep, has_fq_overlimit_drops),
+    offsetof(UserInfoRep, fq_overlimit_drops),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "fq_codel_drops",
+    42,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(UserInfoRep, has_fq_codel_drops),
+    offsetof(UserInfoRep, fq_codel_drops),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned user_info_rep__field_indices_by_name[] = {
+  34,   /* field[34] = batch_packets */
+  33,   /* field[33] = batch_wakeups */
   9,   /* field[9] = conn_time */
   22,   /* field[22] = cstp_compr */
   17,   /* field[17] = dns */
@@ -1241,6 +1546,12 @@ static const unsigned user_info_rep__field_indices_by_name[] = {
   27,   /* field[27] = dpd */
   14,   /* field[14] = dtls_ciphersuite */
   23,   /* field[23] = dtls_compr */
+  37,   /* field[37] = dtls_tx_dropped */
+  36,   /* field[36] = dtls_tx_queued */
+  41,   /* field[41] = fq_codel_drops */
+  38,   /* field[38] = fq_flows */
+  40,   /* field[40] = fq_overlimit_drops */
+  39,   /* field[39] = fq_queued */
   30,   /* field[30] = fw_ports */
   2,   /* field[2] = groupname */
   10,   /* field[10] = hostname */
@@ -1248,6 +1559,7 @@ static const unsigned user_info_rep__field_indices_by_name[] = {
   3,   /* field[3] = ip */
   20,   /* field[20] = iroutes */
   28,   /* field[28] = keepalive */
+  35,   /* field[35] = ktls */
   25,   /* field[25] = local_dev_ip */
   6,   /* field[6] = local_ip */
   8,   /* field[8] = local_ip6 */
@@ -1271,7 +1583,7 @@ static const unsigned user_info_rep__field_indices_by_name[] = {
 static const ProtobufCIntRange user_info_rep__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 33 }
+  { 0, 42 }
 };
 const ProtobufCMessageDescriptor user_info_rep__descriptor =
 {
@@ -1281,7 +1593,7 @@ const ProtobufCMessageDescriptor user_info_rep__descriptor =
   "UserInfoRep",
   "",
   sizeof(UserInfoRep),
-  33,
+  42,
   user_info_rep__field_descriptors,
   user_info_rep__field_indices_by_name,
   1,  user_info_rep__number_ranges,
@@ -63,10 +63,40 @@ struct  _StatusRep
   uint64_t auth_failures;
   uint64_t total_sessions_closed;
   uint64_t total_auth_failures;
+  protobuf_c_boolean has_avg_handshake_us;
+  uint32_t avg_handshake_us;
+  protobuf_c_boolean has_max_handshake_us;
+  uint32_t max_handshake_us;
+  protobuf_c_boolean has_idle_workers;
+  uint32_t idle_workers;
+  protobuf_c_boolean has_no_hello_conns;
+  uint64_t no_hello_conns;
+  protobuf_c_boolean has_conns_rate_limited;
+  uint64_t conns_rate_limited;
+  protobuf_c_boolean has_conns_shed;
+  uint64_t conns_shed;
+  protobuf_c_boolean has_accept_backlog;
+  uint32_t accept_backlog;
+  protobuf_c_boolean has_ipv4_pool_size;
+  uint64_t ipv4_pool_size;
+  protobuf_c_boolean has_ipv4_pool_used;
+  uint64_t ipv4_pool_used;
+  protobuf_c_boolean has_ipv6_pool_size;
+  uint64_t ipv6_pool_size;
+  protobuf_c_boolean has_ipv6_pool_used;
+  uint64_t ipv6_pool_used;
+  protobuf_c_boolean has_avg_key_op_us;
+  uint32_t avg_key_op_us;
+  protobuf_c_boolean has_max_key_op_us;
+  uint32_t max_key_op_us;
+  protobuf_c_boolean has_max_key_op_queue;
+  uint32_t max_key_op_queue;
+  protobuf_c_boolean has_conns_max_clients;
+  uint64_t conns_max_clients;
 };
 #define STATUS_REP__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&status_rep__descriptor) \
-    , 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+    , 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
 
 
 struct  _BoolMsg
@@ -134,10 +164,28 @@ struct  _UserInfoRep
    */
   ProtobufCBinaryData safe_id;
   char *vhost;
+  protobuf_c_boolean has_batch_wakeups;
+  uint64_t batch_wakeups;
+  protobuf_c_boolean has_batch_packets;
+  uint64_t batch_packets;
+  protobuf_c_boolean has_ktls;
+  uint32_t ktls;
+  protobuf_c_boolean has_dtls_tx_queued;
+  uint32_t dtls_tx_queued;
+  protobuf_c_boolean has_dtls_tx_dropped;
+  uint64_t dtls_tx_dropped;
+  protobuf_c_boolean has_fq_flows;
+  uint32_t fq_flows;
+  protobuf_c_boolean has_fq_queued;
+  uint32_t fq_queued;
+  protobuf_c_boolean has_fq_overlimit_drops;
+  uint64_t fq_overlimit_drops;
+  protobuf_c_boolean has_fq_codel_drops;
+  uint64_t fq_codel_drops;
 };
 #define USER_INFO_REP__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&user_info_rep__descriptor) \
-    , 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, NULL, NULL, 0, NULL, NULL, 0, 0, 0, 0, 0,NULL, 0,NULL, 0,NULL, 0,NULL, 0, 0, NULL, NULL, 0,NULL, NULL, 0,NULL, 0, 0, 0, 0,NULL, {0,NULL}, NULL }
+    , 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, NULL, NULL, 0, NULL, NULL, 0, 0, 0, 0, 0,NULL, 0,NULL, 0,NULL, 0,NULL, 0, 0, NULL, NULL, 0,NULL, NULL, 0,NULL, 0, 0, 0, 0,NULL, {0,NULL}, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
 
 
 struct  _UserListRep
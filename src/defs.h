@@ -73,6 +73,10 @@ typedef enum {
 	CMD_SESSION_INFO = 13,
 	CMD_BAN_IP = 16,
 	CMD_BAN_IP_REPLY = 17,
+	CMD_WORKER_STATS = 18,
+	CMD_WORKER_START = 19,
+	CMD_DTLS_PORT_FD = 20,
+	CMD_ACCEPTED_CONN = 21, /* from acceptor to main */
 
 	/* from worker to sec-mod */
 	CMD_SEC_AUTH_INIT = 120,
@@ -116,6 +120,9 @@ typedef enum {
 #define ERR_PEER_TERMINATED -11
 #define ERR_CTL -12
 #define ERR_NO_CMD_FD -13
+#define ERR_WAIT_FOR_PING -14
+#define ERR_WAIT_FOR_SEC_MOD -15
+#define ERR_WAIT_FOR_THREAD -16
 
 #define ERR_WORKER_TERMINATED ERR_PEER_TERMINATED
 
@@ -25,6 +25,7 @@
 #include <config.h>
 #include <time.h>
 #include <sys/time.h>
+#include <stdint.h>
 
 /* emulate gnulib's gettime using gettimeofday to avoid linking to
  * librt */
@@ -43,6 +44,17 @@ struct timeval tv;
 #endif
 }
 
+/* the time of the monotonic clock, in microseconds */
+inline static
+uint64_t
+gettime_mono_us (void)
+{
+  struct timespec t;
+
+  clock_gettime (CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
 inline static
 unsigned int
 timespec_sub_ms (struct timespec *a, struct timespec *b)
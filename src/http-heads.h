@@ -35,7 +35,7 @@
 #line 6 "http-heads.gperf"
 struct http_headers_st { const char *name; unsigned id; };
 
-#define TOTAL_KEYWORDS 17
+#define TOTAL_KEYWORDS 18
 #define MIN_WORD_LENGTH 6
 #define MAX_WORD_LENGTH 34
 #define MIN_HASH_VALUE 6
@@ -130,7 +130,9 @@ static const struct http_headers_st wordlist[] =
     {""},
 #line 11 "http-heads.gperf"
     {"X-DTLS-Accept-Encoding", HEADER_DTLS_ENCODING},
-    {""}, {""},
+#line 25 "http-heads.gperf"
+    {"X-CSTP-Coalescing-Capability", HEADER_CSTP_COALESCING},
+    {""},
 #line 19 "http-heads.gperf"
     {"X-CSTP-Hostname", HEADER_HOSTNAME},
     {""},
@@ -86,7 +86,8 @@
 #include <errno.h>
 #include <gnutls/crypto.h>
 #include <icmp-ping.h>
-#include <poll.h>
+#include <ip-lease.h>
+#include <cloexec.h>
 
 #ifndef ICMP_DEST_UNREACH
 # ifdef ICMP_UNREACH
@@ -148,201 +149,258 @@ inline static int retry(int e)
 
 #define PING_TIMEOUT 3
 
+static void lease_ping_io_cb(struct ev_loop *loop, ev_io *w, int revents);
+
 static
-ssize_t recvfrom_timeout(int sockfd, void *buf, size_t len, int flags,
-			 struct sockaddr *src_addr, socklen_t * addrlen)
+int lease_ping_destructor(struct lease_ping_st *p)
 {
-	int ret;
-    struct pollfd pfd;
+	main_server_st *s = ev_userdata(loop);
 
-    pfd.fd = sockfd;
-    pfd.events = POLLIN;
-    pfd.revents = 0;
+	ev_timer_stop(loop, &p->timer);
+	list_del(&p->list);
+	s->lease_ping_list.total--;
+	return 0;
+}
 
-    ret = poll(&pfd, 1, 250);
-	if (ret == -1)
-		return -1;
-	else if (ret > 0)
-		return recvfrom(sockfd, buf, len, 0, src_addr, addrlen);
-	else
-		return -1;
+/* Completes the request; the reported result is forwarded to
+ * ip_lease_ping_done(), which may free p->proc.
+ */
+static void lease_ping_done(main_server_st *s, struct lease_ping_st *p,
+			    unsigned in_use)
+{
+	struct proc_st *proc = p->proc;
+	struct ip_lease_st *lease = p->lease;
+	char buf[64];
 
+	mslog(s, proc, LOG_INFO, "pinged %s and is %sin use",
+	      human_addr((void *)&lease->rip, lease->rip_len, buf, sizeof(buf)),
+	      in_use ? "" : "not ");
 
+	talloc_free(p);
+	ip_lease_ping_done(s, proc, lease, in_use);
 }
 
-int icmp_ping4(main_server_st * s, struct sockaddr_in *addr1)
+static void lease_ping_timeout_cb(struct ev_loop *loop, ev_timer *w, int revents)
 {
-	struct icmp *pkt;
-	int pingsock, c, e;
-	char packet1[DEFDATALEN + MAXIPLEN + MAXICMPLEN];
-	char buf1[64];
-	time_t now;
-	uint16_t id1;
-	unsigned gotreply = 0, unreachable = 0;
+	main_server_st *s = ev_userdata(loop);
 
-	if (GETCONFIG(s)->ping_leases == 0)
-		return 0;
+	lease_ping_done(s, (struct lease_ping_st *)w, 0);
+}
 
-	gnutls_rnd(GNUTLS_RND_NONCE, &id1, sizeof(id1));
+static int open_ping_socket(main_server_st *s, int family)
+{
+	ev_io *io = (family == AF_INET) ? &s->lease_ping_list.io4 : &s->lease_ping_list.io6;
+	int fd, e;
+#if defined(SOL_RAW) && defined(IPV6_CHECKSUM)
+	int sockopt;
+#endif
+#ifdef ICMP6_FILTER
+	struct icmp6_filter filter;
+#endif
+
+	if (io->fd >= 0)
+		return io->fd;
 
-	pingsock = socket(AF_INET, SOCK_RAW, 1);
-	if (pingsock == -1) {
+	if (family == AF_INET)
+		fd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+	else
+		fd = socket(AF_INET6, SOCK_RAW, IPPROTO_ICMPV6);
+	if (fd == -1) {
 		e = errno;
 		mslog(s, NULL, LOG_INFO,
 		      "could not open raw socket for ping: %s", strerror(e));
-		return 0;
+		return -1;
 	}
 
-	pkt = (struct icmp *) packet1;
-	memset(pkt, 0, sizeof(packet1));
-	pkt->icmp_type = ICMP_ECHO;
-	pkt->icmp_id = id1;
-	pkt->icmp_cksum =
-	    in_cksum((unsigned short *) pkt, sizeof(packet1));
-
-	while ((c = sendto(pingsock, packet1, DEFDATALEN + ICMP_MINLEN, 0,
-			   (struct sockaddr *) addr1,
-			   sizeof(*addr1)) == -1) && retry(errno));
-	/* listen for replies */
-
-	now = time(0);
-	while (time(0) - now < PING_TIMEOUT
-	       && (unreachable + gotreply) < 2) {
-		struct sockaddr_in from;
-		socklen_t fromlen = sizeof(from);
-
-		c = recvfrom_timeout(pingsock, packet1, sizeof(packet1), 0,
-				     (struct sockaddr *) &from, &fromlen);
-
-		if (c < 0) {
-			continue;
-		} else if (c >= 76 && fromlen == sizeof(struct sockaddr_in)) {	/* icmp6_hdr */
-			if (memcmp
-			    (SA_IN_P(&from), SA_IN_P(addr1),
-			     SA_IN_SIZE(sizeof(*addr1))) == 0) {
+	set_cloexec_flag(fd, 1);
+	set_non_block(fd);
 
-#ifdef HAVE_STRUCT_IPHDR_IHL
-				struct iphdr *iphdr =
-				    (struct iphdr *) packet1;
-				pkt = (struct icmp *) (packet1 + (iphdr->ihl << 2));	/* skip ip hdr */
-#else
-				pkt = (struct icmp *) (packet1 + ((packet1[0] & 0x0f) << 2));	/* skip ip hdr */
+	if (family == AF_INET6) {
+#if defined(SOL_RAW) && defined(IPV6_CHECKSUM)
+		sockopt = offsetof(struct icmp6_hdr, icmp6_cksum);
+		setsockopt(fd, SOL_RAW, IPV6_CHECKSUM,
+			   &sockopt, sizeof(sockopt));
+#endif
+#ifdef ICMP6_FILTER
+		/* we only care about the replies */
+		ICMP6_FILTER_SETBLOCKALL(&filter);
+		ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY, &filter);
+		setsockopt(fd, IPPROTO_ICMPV6, ICMP6_FILTER,
+			   &filter, sizeof(filter));
 #endif
-				if (pkt->icmp_id == id1) {
-					if (pkt->icmp_type == ICMP_ECHOREPLY)
-						gotreply++;
-					else if (pkt->icmp_type == ICMP_DEST_UNREACH)
-						unreachable++;
-                                }
-			}
-		}
 	}
 
-	close(pingsock);
+	ev_io_init(io, lease_ping_io_cb, fd, EV_READ);
+	ev_io_start(loop, io);
 
-	if (gotreply > 0) {
-		mslog(s, NULL, LOG_INFO,
-		      "pinged %s and is in use",
-		      human_addr((void *) addr1,
-				 sizeof(struct sockaddr_in), buf1,
-				 sizeof(buf1)));
-		return gotreply;
-	} else {
-		mslog(s, NULL, LOG_INFO,
-		      "pinged %s and is not in use",
-		      human_addr((void *) addr1,
-				 sizeof(struct sockaddr_in), buf1,
-				 sizeof(buf1)));
-		return 0;
-	}
+	return fd;
 }
 
-int icmp_ping6(main_server_st * s,
-	       struct sockaddr_in6 *addr1)
+/* Sends an echo request to the remote address of lease, which is
+ * already reserved for proc. The session setup resumes at
+ * ip_lease_ping_done() once there is a reply, or after PING_TIMEOUT
+ * seconds. All the requests share a raw socket per family, so that
+ * they are all checked concurrently by the main loop.
+ *
+ * Returns 1 if the request was sent, 0 if the lease cannot be checked,
+ * or a negative error code.
+ */
+int icmp_ping_lease(main_server_st *s, struct proc_st *proc, struct ip_lease_st *lease)
 {
-	struct icmp6_hdr *pkt;
-	char buf1[64];
-	int pingsock, c, e;
-#if defined(SOL_RAW) && defined(IPV6_CHECKSUM)
-	int sockopt;
-#endif
 	char packet1[DEFDATALEN + MAXIPLEN + MAXICMPLEN];
+	struct lease_ping_st *p;
+	struct icmp *pkt;
+	struct icmp6_hdr *pkt6;
+	int fd, ret, e;
+	size_t len;
 	uint16_t id1;
-	unsigned gotreply = 0, unreachable = 0;
-	time_t now;
 
-	if (GETCONFIG(s)->ping_leases == 0)
+	fd = open_ping_socket(s, lease->rip.ss_family);
+	if (fd < 0)
 		return 0;
 
 	gnutls_rnd(GNUTLS_RND_NONCE, &id1, sizeof(id1));
 
-	pingsock = socket(AF_INET6, SOCK_RAW, IPPROTO_ICMPV6);
-	if (pingsock == -1) {
+	memset(packet1, 0, sizeof(packet1));
+	if (lease->rip.ss_family == AF_INET) {
+		pkt = (struct icmp *) packet1;
+		pkt->icmp_type = ICMP_ECHO;
+		pkt->icmp_id = id1;
+		pkt->icmp_cksum =
+		    in_cksum((unsigned short *) pkt, sizeof(packet1));
+		len = DEFDATALEN + ICMP_MINLEN;
+	} else {
+		pkt6 = (struct icmp6_hdr *) packet1;
+		pkt6->icmp6_type = ICMP6_ECHO_REQUEST;
+		pkt6->icmp6_id = id1;
+		len = DEFDATALEN + sizeof(struct icmp6_hdr);
+	}
+
+	while ((ret = sendto(fd, packet1, len, 0,
+			     (struct sockaddr *) &lease->rip,
+			     lease->rip_len)) == -1 && retry(errno));
+	if (ret == -1) {
 		e = errno;
-		mslog(s, NULL, LOG_INFO,
-		      "could not open raw socket for ping: %s", strerror(e));
+		mslog(s, proc, LOG_INFO,
+		      "could not send ping: %s", strerror(e));
 		return 0;
 	}
 
-	pkt = (struct icmp6_hdr *) packet1;
-	memset(pkt, 0, sizeof(packet1));
-	pkt->icmp6_type = ICMP6_ECHO_REQUEST;
-	pkt->icmp6_id = id1;
+	p = talloc_zero(proc, struct lease_ping_st);
+	if (p == NULL)
+		return ERR_MEM;
 
-#if defined(SOL_RAW) && defined(IPV6_CHECKSUM)
-	sockopt = offsetof(struct icmp6_hdr, icmp6_cksum);
-	setsockopt(pingsock, SOL_RAW, IPV6_CHECKSUM,
-		   &sockopt, sizeof(sockopt));
+	p->proc = proc;
+	p->lease = lease;
+	p->id = id1;
+
+	list_add_tail(&s->lease_ping_list.head, &p->list);
+	s->lease_ping_list.total++;
+	talloc_set_destructor(p, lease_ping_destructor);
+
+	ev_timer_init(&p->timer, lease_ping_timeout_cb, PING_TIMEOUT, 0);
+	ev_timer_start(loop, &p->timer);
+
+	return 1;
+}
+
+/* Returns the echo reply identifier in the packet read from a raw
+ * socket of family, or -1 if it isn't an echo reply.
+ */
+static int echo_reply_id(int family, uint8_t *packet1, ssize_t c)
+{
+	struct icmp *pkt;
+	struct icmp6_hdr *pkt6;
+	unsigned hlen;
+
+	if (family == AF_INET) {
+		if (c < 1)
+			return -1;
+#ifdef HAVE_STRUCT_IPHDR_IHL
+		hlen = ((struct iphdr *) packet1)->ihl << 2;	/* skip ip hdr */
+#else
+		hlen = (packet1[0] & 0x0f) << 2;	/* skip ip hdr */
 #endif
-	while ((c =
-		sendto(pingsock, packet1,
-		       DEFDATALEN + sizeof(struct icmp6_hdr), 0,
-		       (struct sockaddr *) addr1,
-		       sizeof(*addr1)) == -1) && retry(errno));
-
-	/* listen for replies */
-	now = time(0);
-	while (time(0) - now < PING_TIMEOUT
-	       && (unreachable + gotreply) < 2) {
-		struct sockaddr_in6 from;
-		socklen_t fromlen = sizeof(from);
-		c = recvfrom_timeout(pingsock, packet1,
-				     sizeof(packet1), 0,
-				     (struct sockaddr *)
-				     &from, &fromlen);
-		if (c < 0) {
+		if (c < hlen + ICMP_MINLEN)
+			return -1;
+
+		pkt = (struct icmp *) (packet1 + hlen);
+		if (pkt->icmp_type != ICMP_ECHOREPLY)
+			return -1;
+		return pkt->icmp_id;
+	} else {
+		if (c < sizeof(struct icmp6_hdr))
+			return -1;
+
+		pkt6 = (struct icmp6_hdr *) packet1;
+		if (pkt6->icmp6_type != ICMP6_ECHO_REPLY)
+			return -1;
+		return pkt6->icmp6_id;
+	}
+}
+
+static void lease_ping_io_cb(struct ev_loop *loop, ev_io *w, int revents)
+{
+	main_server_st *s = ev_userdata(loop);
+	struct lease_ping_st *p = NULL, *pos;
+	int family = (w == &s->lease_ping_list.io4) ? AF_INET : AF_INET6;
+	uint8_t packet1[DEFDATALEN + MAXIPLEN + MAXICMPLEN];
+	struct sockaddr_storage from;
+	socklen_t fromlen;
+	ssize_t c;
+	int id;
+
+	for (;;) {
+		fromlen = sizeof(from);
+		c = recvfrom(w->fd, packet1, sizeof(packet1), 0,
+			     (struct sockaddr *) &from, &fromlen);
+		if (c < 0)
+			break;
+
+		id = echo_reply_id(family, packet1, c);
+		if (id < 0 || from.ss_family != family)
 			continue;
-		} else if (c >= 8 && fromlen == sizeof(struct sockaddr_in6)) {	/* icmp6_hdr */
-			if (memcmp
-			    (SA_IN6_P(&from), SA_IN6_P(addr1),
-			     SA_IN_SIZE(sizeof(*addr1))) == 0) {
-
-				pkt = (struct icmp6_hdr *) packet1;
-				if (pkt->icmp6_id == id1) {
-					if (pkt->icmp6_type == ICMP6_ECHO_REPLY)
-						gotreply++;
-					else if (pkt->icmp6_type == ICMP6_DST_UNREACH)
-						unreachable++;
-				}
+
+		list_for_each_safe(&s->lease_ping_list.head, p, pos, list) {
+			if (p->id == id && p->lease->rip.ss_family == family &&
+			    memcmp(SA_IN_P_GENERIC(&from, fromlen),
+				   SA_IN_P_GENERIC(&p->lease->rip, p->lease->rip_len),
+				   SA_IN_SIZE(p->lease->rip_len)) == 0) {
+				/* this may free any request, so look up the
+				 * next reply from the start */
+				lease_ping_done(s, p, 1);
+				break;
 			}
 		}
 	}
+}
 
-	close(pingsock);
+void icmp_ping_init(main_server_st *s)
+{
+	list_head_init(&s->lease_ping_list.head);
+	ev_io_init(&s->lease_ping_list.io4, lease_ping_io_cb, -1, EV_READ);
+	ev_io_init(&s->lease_ping_list.io6, lease_ping_io_cb, -1, EV_READ);
+}
 
-	if (gotreply > 0) {
-		mslog(s, NULL, LOG_INFO,
-		      "pinged %s and is in use",
-		      human_addr((void *) addr1,
-				 sizeof(struct sockaddr_in6), buf1,
-				 sizeof(buf1)));
-		return gotreply;
-	} else {
-		mslog(s, NULL, LOG_INFO,
-		      "pinged %s and is not in use",
-		      human_addr((void *) addr1,
-				 sizeof(struct sockaddr_in6), buf1,
-				 sizeof(buf1)));
-		return 0;
+/* Cancels any requests and closes the raw sockets. To be used after fork().
+ */
+void icmp_ping_deinit(main_server_st *s)
+{
+	struct lease_ping_st *p = NULL, *pos;
+
+	list_for_each_safe(&s->lease_ping_list.head, p, pos, list) {
+		talloc_free(p);
+	}
+
+	if (s->lease_ping_list.io4.fd >= 0) {
+		ev_io_stop(loop, &s->lease_ping_list.io4);
+		close(s->lease_ping_list.io4.fd);
+		s->lease_ping_list.io4.fd = -1;
+	}
+
+	if (s->lease_ping_list.io6.fd >= 0) {
+		ev_io_stop(loop, &s->lease_ping_list.io6);
+		close(s->lease_ping_list.io6.fd);
+		s->lease_ping_list.io6.fd = -1;
 	}
 }
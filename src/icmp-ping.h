@@ -23,9 +23,11 @@
 
 #include <main.h>
 
-/* returns the number of positive replies received or
- * 0 if no host with this IP exists. */
-int icmp_ping4(main_server_st* s, struct sockaddr_in* addr1);
-int icmp_ping6(main_server_st* s, struct sockaddr_in6* addr1);
+void icmp_ping_init(main_server_st* s);
+void icmp_ping_deinit(main_server_st* s);
+
+/* returns 1 if an echo request was sent; the result is reported
+ * to ip_lease_ping_done(). */
+int icmp_ping_lease(main_server_st* s, struct proc_st* proc, struct ip_lease_st* lease);
 
 #endif
@@ -52,6 +52,7 @@ void ip_lease_deinit(struct ip_lease_db_st* db)
 {
 struct ip_lease_st * cache;
 struct htable_iter iter;
+struct ip_pool_st *pool = NULL, *pos;
 
 	cache = htable_first(&db->ht, &iter);
 	while(cache != NULL) {
@@ -62,7 +63,12 @@ struct htable_iter iter;
 		cache = htable_next(&db->ht, &iter);
 	}
 	htable_clear(&db->ht);
-	
+
+	list_for_each_safe(&db->pools, pool, pos, list) {
+		list_del(&pool->list);
+		talloc_free(pool);
+	}
+
 	return;
 }
 
@@ -76,6 +82,107 @@ const struct ip_lease_st * e = _e;
 void ip_lease_init(struct ip_lease_db_st* db)
 {
 	htable_init(&db->ht, rehash, NULL);
+	list_head_init(&db->pools);
+}
+
+/* Returns the pool of the leases of lease_prefix in network/prefix,
+ * creating it on first use, or NULL if the range is too large to be
+ * kept in a pool.
+ */
+static struct ip_pool_st *get_ip_pool(main_server_st *s, int family,
+				      struct sockaddr_storage *network,
+				      unsigned prefix, unsigned lease_prefix)
+{
+	struct ip_pool_st *pool = NULL;
+	const uint8_t *net;
+	unsigned net_size;
+
+	if (family == AF_INET) {
+		net = SA_IN_U8_P(network);
+		net_size = sizeof(struct in_addr);
+	} else {
+		net = SA_IN6_U8_P(network);
+		net_size = sizeof(struct in6_addr);
+	}
+
+	list_for_each(&s->ip_leases.pools, pool, list) {
+		if (pool->family == family && pool->prefix == prefix &&
+		    pool->lease_prefix == lease_prefix &&
+		    memcmp(pool->network, net, net_size) == 0)
+			return pool;
+	}
+
+	if (lease_prefix <= prefix || lease_prefix - prefix > IP_POOL_MAX_BITS)
+		return NULL;
+
+	pool = talloc(s, struct ip_pool_st);
+	if (pool == NULL)
+		return NULL;
+
+	if (ip_pool_init(pool, pool, family, net, prefix, lease_prefix) < 0) {
+		talloc_free(pool);
+		return NULL;
+	}
+
+	/* the network, our (local) address and the broadcast address
+	 * are never leased. In IPv6 our address is in the first subnet. */
+	ip_pool_reserve(pool, 0);
+	if (family == AF_INET) {
+		ip_pool_reserve(pool, 1);
+		ip_pool_reserve(pool, pool->size - 1);
+	}
+
+	list_add_tail(&s->ip_leases.pools, &pool->list);
+
+	return pool;
+}
+
+/* Reports the number of leases (excluding the reserved addresses) and
+ * the used ones in the pools of family.
+ */
+void ip_lease_pool_usage(main_server_st *s, int family,
+			 uint64_t *size, uint64_t *used)
+{
+	struct ip_pool_st *pool = NULL;
+
+	*size = 0;
+	*used = 0;
+	list_for_each(&s->ip_leases.pools, pool, list) {
+		if (pool->family != family)
+			continue;
+		*size += pool->size - pool->reserved;
+		*used += pool->used;
+	}
+}
+
+/* Leases an address of the pool, preferring the address in rnd. On
+ * success rnd is set to the address, and the lease's index is stored
+ * in lease.
+ */
+static int get_pool_lease(struct ip_pool_st *pool, struct ip_lease_st *lease,
+			  uint8_t *rnd)
+{
+	int64_t i;
+
+	i = ip_pool_alloc(pool, ip_pool_index(pool, rnd));
+	if (i < 0)
+		return ERR_NO_IP;
+
+	ip_pool_set_index(pool, rnd, i);
+	lease->pool = pool;
+	lease->pool_index = i;
+
+	return 0;
+}
+
+/* Returns the address of the lease to its pool. */
+static void put_pool_lease(struct ip_lease_st *lease)
+{
+	if (lease->pool == NULL)
+		return;
+
+	ip_pool_free(lease->pool, lease->pool_index);
+	lease->pool = NULL;
 }
 
 static bool ip_lease_cmp(const void* _c1, void* _c2)
@@ -105,6 +212,10 @@ struct ip_lease_st t;
 
 void steal_ip_leases(struct proc_st* proc, struct proc_st *thief)
 {
+	/* leases which are still being pinged stay with their owner */
+	if (proc->lease_pings_pending)
+		return;
+
 	/* here we reset the old tun device, and assign the old addresses
 	 * to a new device. We cannot re-use the old device because the
 	 * fd is only available to the worker process and not here (main)
@@ -152,13 +263,46 @@ static int is_ipv4_ok(main_server_st *s, struct sockaddr_storage *ip, struct soc
 #define MAX_IP_TRIES 16
 #define FIXED_IPS 5
 
+/* The pool addresses found in use outside the pool (e.g., by an
+ * explicit lease, or one from the pool of a previous configuration)
+ * during a lease attempt. They stay allocated until the attempt ends,
+ * so that the pool offers the next free address meanwhile.
+ */
+struct pool_skip_st {
+	struct ip_pool_st *pool;
+	unsigned n;
+	uint32_t index[MAX_IP_TRIES];
+};
+
+static void skip_pool_lease(struct pool_skip_st *skip, struct ip_lease_st *lease)
+{
+	if (lease->pool == NULL)
+		return;
+
+	skip->pool = lease->pool;
+	skip->index[skip->n++] = lease->pool_index;
+	lease->pool = NULL;
+}
+
+static void put_skipped_pool_leases(struct pool_skip_st *skip)
+{
+	unsigned i;
+
+	for (i = 0; i < skip->n; i++)
+		ip_pool_free(skip->pool, skip->index[i]);
+	skip->n = 0;
+}
+
 static
 int get_ipv4_lease(main_server_st* s, struct proc_st* proc)
 {
 
 	struct sockaddr_storage tmp, mask, network, rnd;
-	unsigned i;
+	struct ip_pool_st *pool = NULL;
+	struct pool_skip_st skip = { .n = 0 };
+	unsigned i, prefix;
 	unsigned max_loops = MAX_IP_TRIES;
+	uint32_t m;
 	int ret;
 	const char *c_network, *c_netmask;
 	char buf[64];
@@ -245,6 +389,7 @@ int get_ipv4_lease(main_server_st* s, struct proc_st* proc)
 	if (proc->ipv4 == NULL)
 		return ERR_MEM;
 	proc->ipv4->db = &s->ip_leases;
+	proc->ipv4->is_random = 1;
 
        	memcpy(&tmp, &network, sizeof(tmp));
      	((struct sockaddr_in*)&tmp)->sin_family = AF_INET;
@@ -254,6 +399,11 @@ int get_ipv4_lease(main_server_st* s, struct proc_st* proc)
 	((struct sockaddr_in*)&rnd)->sin_family = AF_INET;
 	((struct sockaddr_in*)&rnd)->sin_port = 0;
 
+	m = ntohl(SA_IN_P(&mask)->s_addr);
+	prefix = __builtin_popcount(m);
+	if (prefix > 0 && m == 0xffffffff << (32 - prefix))
+		pool = get_ip_pool(s, AF_INET, &network, prefix, 32);
+
 	do {
 		if (max_loops == 0) {
 			mslog(s, proc, LOG_ERR, "could not figure out a valid IPv4 IP");
@@ -281,10 +431,18 @@ int get_ipv4_lease(main_server_st* s, struct proc_st* proc)
         	for (i=0;i<sizeof(struct in_addr);i++)
         		SA_IN_U8_P(&rnd)[i] |= (SA_IN_U8_P(&network)[i]);
 
+		/* with a pool that is only the preferred address */
+		if (pool != NULL && get_pool_lease(pool, proc->ipv4, SA_IN_U8_P(&rnd)) < 0) {
+			mslog(s, proc, LOG_ERR, "could not figure out a valid IPv4 IP; all addresses of %s are in use", c_network);
+			ret = ERR_NO_IP;
+			goto fail;
+		}
+
 		/* check if it exists in the hash table */
 		if (is_ipv4_ok(s, &rnd, &network, &mask) == 0) {
 			mslog(s, proc, LOG_DEBUG, "cannot assign remote IP %s; it is in use or invalid", 
 			      human_addr((void*)&rnd, sizeof(struct sockaddr_in), buf, sizeof(buf)));
+			skip_pool_lease(&skip, proc->ipv4);
 			continue;
 		}
 
@@ -299,19 +457,21 @@ int get_ipv4_lease(main_server_st* s, struct proc_st* proc)
 		SA_IN_U8_P(&proc->ipv4->lip)[3] |= 1;
 
 		if (memcmp(SA_IN_U8_P(&proc->ipv4->lip), SA_IN_U8_P(&proc->ipv4->rip), sizeof(struct in_addr)) == 0) {
+			skip_pool_lease(&skip, proc->ipv4);
 			continue;
 		}
 
 		mslog(s, proc, LOG_DEBUG, "selected IP: %s",
 		      human_addr((void*)&proc->ipv4->rip, proc->ipv4->rip_len, buf, sizeof(buf)));
-
-       		if (icmp_ping4(s, (void*)&proc->ipv4->rip) == 0)
-       			break;
+		break;
 	} while(1);
 
+	put_skipped_pool_leases(&skip);
 	return 0;
 
 fail:
+	put_skipped_pool_leases(&skip);
+	put_pool_lease(proc->ipv4);
 	talloc_free(proc->ipv4);
 	proc->ipv4 = NULL;
 
@@ -323,6 +483,8 @@ int get_ipv6_lease(main_server_st* s, struct proc_st* proc)
 {
 
 	struct sockaddr_storage tmp, mask, network, rnd, subnet_mask;
+	struct ip_pool_st *pool;
+	struct pool_skip_st skip = { .n = 0 };
 	unsigned i, max_loops = MAX_IP_TRIES;
 	const char* c_network = NULL;
 	unsigned prefix, subnet_prefix ;
@@ -406,11 +568,14 @@ int get_ipv6_lease(main_server_st* s, struct proc_st* proc)
 	if (proc->ipv6 == NULL)
 		return ERR_MEM;
 	proc->ipv6->db = &s->ip_leases;
+	proc->ipv6->is_random = 1;
 
   	memcpy(&tmp, &network, sizeof(tmp));
        	((struct sockaddr_in6*)&tmp)->sin6_family = AF_INET6;
        	((struct sockaddr_in6*)&tmp)->sin6_port = 0;
 
+	pool = get_ip_pool(s, AF_INET6, &network, prefix, subnet_prefix);
+
 	do {
 		if (max_loops == 0) {
 			mslog(s, NULL, LOG_ERR, "could not figure out a valid IPv6 IP");
@@ -442,6 +607,13 @@ int get_ipv6_lease(main_server_st* s, struct proc_st* proc)
        		for (i=0;i<sizeof(struct in6_addr);i++)
        			SA_IN6_U8_P(&rnd)[i] |= (SA_IN6_U8_P(&network)[i]);
 
+		/* with a pool that is only the preferred subnet */
+		if (pool != NULL && get_pool_lease(pool, proc->ipv6, SA_IN6_U8_P(&rnd)) < 0) {
+			mslog(s, proc, LOG_ERR, "could not figure out a valid IPv6 IP; all subnets of %s are in use", c_network);
+			ret = ERR_NO_IP;
+			goto fail;
+		}
+
 		/* make the sig of our subnet */
 	       	((struct sockaddr_in6*)&proc->ipv6->sig)->sin6_family = AF_INET6;
 	       	((struct sockaddr_in6*)&proc->ipv6->sig)->sin6_port = 0;
@@ -453,6 +625,7 @@ int get_ipv6_lease(main_server_st* s, struct proc_st* proc)
 		if (is_ipv6_ok(s, &rnd, &network, &proc->ipv6->sig) == 0) {
 			mslog(s, proc, LOG_DEBUG, "cannot assign local IP %s; it is in use or invalid", 
 			      human_addr((void*)&rnd, sizeof(struct sockaddr_in6), buf, sizeof(buf)));
+			skip_pool_lease(&skip, proc->ipv6);
 			continue;
 		}
 
@@ -461,9 +634,7 @@ int get_ipv6_lease(main_server_st* s, struct proc_st* proc)
 
 		mslog(s, proc, LOG_DEBUG, "selected IP: %s",
 		      human_addr((void*)&proc->ipv6->rip, proc->ipv6->rip_len, buf, sizeof(buf)));
-
-        	if (proc->ipv6->prefix != 128 || icmp_ping6(s, (void*)&proc->ipv6->rip) == 0)
-        		break;
+		break;
         } while(1);
 
  finish:
@@ -475,8 +646,11 @@ int get_ipv6_lease(main_server_st* s, struct proc_st* proc)
 
 	proc->ipv6->prefix = subnet_prefix;
 
+	put_skipped_pool_leases(&skip);
 	return 0;
 fail:
+	put_skipped_pool_leases(&skip);
+	put_pool_lease(proc->ipv6);
 	talloc_free(proc->ipv6);
 	proc->ipv6 = NULL;
 
@@ -489,11 +663,43 @@ int unref_ip_lease(struct ip_lease_st *lease)
 {
 	if (lease->db) {
 		htable_del(&lease->db->ht, rehash(lease, NULL), lease);
+		put_pool_lease(lease);
 	}
 
 	return 0;
 }
 
+/* Sends an echo request to a newly reserved lease, if ping-leases
+ * is set. As before the checks were asynchronous, the explicit
+ * addresses are accepted without one. Returns 1 if we have to wait
+ * for the result.
+ */
+static int ping_lease(main_server_st *s, struct proc_st *proc, struct ip_lease_st *lease)
+{
+	int ret;
+
+	if (GETCONFIG(s)->ping_leases == 0 || lease->is_random == 0)
+		return 0;
+
+	if (proc->lease_pings >= MAX_IP_TRIES) {
+		mslog(s, proc, LOG_ERR, "could not figure out a valid IP; all pinged addresses are in use");
+		return ERR_NO_IP;
+	}
+
+	ret = icmp_ping_lease(s, proc, lease);
+	if (ret > 0) {
+		proc->lease_pings++;
+		proc->lease_pings_pending++;
+	}
+
+	return ret;
+}
+
+/* Obtains the IP leases of proc. With ping-leases, the leases are
+ * reserved and ERR_WAIT_FOR_PING is returned; once their echo requests
+ * complete, resume_cookie_auth() calls this again to obtain a lease
+ * in place of any address which replied.
+ */
 int get_ip_leases(main_server_st *s, struct proc_st *proc)
 {
 int ret;
@@ -505,11 +711,15 @@ char buf[128];
 			return ret;
 
 		if (proc->ipv4 && proc->ipv4->db) {
+			talloc_set_destructor(proc->ipv4, unref_ip_lease);
 			if (htable_add(&s->ip_leases.ht, rehash(proc->ipv4, NULL), proc->ipv4) == 0) {
 				mslog(s, proc, LOG_ERR, "could not add IPv4 lease to hash table");
 				return -1;
 			}
-			talloc_set_destructor(proc->ipv4, unref_ip_lease);
+
+			ret = ping_lease(s, proc, proc->ipv4);
+			if (ret < 0)
+				return ret;
 		}
 	}
 
@@ -519,14 +729,24 @@ char buf[128];
 			return ret;
 
 		if (proc->ipv6 && proc->ipv6->db) {
+			talloc_set_destructor(proc->ipv6, unref_ip_lease);
 			if (htable_add(&s->ip_leases.ht, rehash(proc->ipv6, NULL), proc->ipv6) == 0) {
 				mslog(s, proc, LOG_ERR, "could not add IPv6 lease to hash table");
 				return -1;
 			}
-			talloc_set_destructor(proc->ipv6, unref_ip_lease);
+
+			/* only single addresses can be checked */
+			if (proc->ipv6->prefix == 128) {
+				ret = ping_lease(s, proc, proc->ipv6);
+				if (ret < 0)
+					return ret;
+			}
 		}
 	}
 
+	if (proc->lease_pings_pending)
+		return ERR_WAIT_FOR_PING;
+
 	if (proc->ipv4 == 0 && proc->ipv6 == 0) {
 		mslog(s, proc, LOG_ERR, "no IPv4 or IPv6 addresses are configured. Cannot obtain lease");
 		return -1;
@@ -544,6 +764,27 @@ char buf[128];
 	return 0;
 }
 
+/* Called when the echo request to a lease of proc completes. A lease
+ * which is in use is detached from proc, but stays reserved (as a child
+ * of proc) so that it is not selected again. Once all the requests
+ * of proc complete, its authentication is resumed.
+ */
+void ip_lease_ping_done(main_server_st *s, struct proc_st *proc,
+			struct ip_lease_st *lease, unsigned in_use)
+{
+	if (in_use) {
+		if (proc->ipv4 == lease)
+			proc->ipv4 = NULL;
+		else if (proc->ipv6 == lease)
+			proc->ipv6 = NULL;
+	}
+
+	if (--proc->lease_pings_pending > 0)
+		return;
+
+	resume_cookie_auth(s, proc, 0);
+}
+
 void remove_ip_leases(main_server_st* s, struct proc_st* proc)
 {
 	if (proc->ipv4) {
@@ -26,6 +26,7 @@
 #include <sys/socket.h>
 #include <ccan/hash/hash.h>
 #include <main.h>
+#include <ip-pool.h>
 
 struct ip_lease_st {
         /* In IPv4 this is the same as rip, in IPv6
@@ -41,6 +42,12 @@ struct ip_lease_st {
         unsigned prefix; /* in ipv6 */
 
         struct ip_lease_db_st* db;
+        /* the pool this lease was allocated from, if any */
+        struct ip_pool_st *pool;
+        uint32_t pool_index;
+        /* chosen by us rather than configured (explicit-ipv4/6 or
+         * RADIUS); only those are checked with ping-leases */
+        unsigned is_random;
 };
 
 void ip_lease_deinit(struct ip_lease_db_st* db);
@@ -51,5 +58,9 @@ void steal_ip_leases(struct proc_st* proc, struct proc_st *thief);
 int get_ip_leases(struct main_server_st* s, struct proc_st* proc);
 void remove_ip_leases(struct main_server_st* s, struct proc_st* proc);
 void remove_ip_lease(main_server_st* s, struct ip_lease_st * lease);
+void ip_lease_pool_usage(main_server_st* s, int family,
+			 uint64_t *size, uint64_t *used);
+void ip_lease_ping_done(main_server_st* s, struct proc_st* proc,
+			struct ip_lease_st *lease, unsigned in_use);
 
 #endif
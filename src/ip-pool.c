@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This file is part of ocserv.
+ *
+ * ocserv is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ocserv is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <talloc.h>
+#include <ip-pool.h>
+
+#define FULL_WORD (~(uint64_t)0)
+
+/* Initializes a pool with the leases of size lease_prefix in
+ * network/prefix. Returns -1 if the range is not suitable for
+ * a pool.
+ */
+int ip_pool_init(void *pool, ip_pool_st *p, int family, const uint8_t *network,
+		 unsigned prefix, unsigned lease_prefix)
+{
+	unsigned l, i, max = (family == AF_INET) ? 32 : 128;
+	uint64_t nbits;
+
+	memset(p, 0, sizeof(*p));
+
+	if (lease_prefix > max || lease_prefix <= prefix ||
+	    lease_prefix - prefix > IP_POOL_MAX_BITS)
+		return -1;
+
+	p->family = family;
+	memcpy(p->network, network, max / 8);
+	p->prefix = prefix;
+	p->lease_prefix = lease_prefix;
+	p->size = 1 << (lease_prefix - prefix);
+
+	nbits = p->size;
+	for (l = 0; l < IP_POOL_LEVELS; l++) {
+		p->words[l] = (nbits + 63) / 64;
+		p->bits[l] = talloc_zero_array(pool, uint64_t, p->words[l]);
+		if (p->bits[l] == NULL)
+			goto fail;
+
+		/* the bits past the end of each level are never free */
+		if (nbits % 64)
+			p->bits[l][p->words[l] - 1] = FULL_WORD << (nbits % 64);
+
+		p->levels = l + 1;
+		if (p->words[l] == 1)
+			break;
+		nbits = p->words[l];
+	}
+
+	if (p->words[p->levels - 1] != 1)
+		goto fail;
+
+	/* mark the summary bits of the full words */
+	for (l = 0; l + 1 < p->levels; l++) {
+		for (i = 0; i < p->words[l]; i++) {
+			if (p->bits[l][i] == FULL_WORD)
+				p->bits[l + 1][i / 64] |= (uint64_t)1 << (i % 64);
+		}
+	}
+
+	return 0;
+ fail:
+	ip_pool_deinit(p);
+	return -1;
+}
+
+void ip_pool_deinit(ip_pool_st *p)
+{
+	unsigned l;
+
+	for (l = 0; l < IP_POOL_LEVELS; l++) {
+		talloc_free(p->bits[l]);
+		p->bits[l] = NULL;
+	}
+	p->levels = 0;
+}
+
+unsigned ip_pool_is_used(const ip_pool_st *p, uint32_t i)
+{
+	if (i >= p->size)
+		return 1;
+	return (p->bits[0][i / 64] >> (i % 64)) & 1;
+}
+
+static void set_used(ip_pool_st *p, uint32_t i)
+{
+	unsigned l;
+
+	for (l = 0; l < p->levels; l++) {
+		p->bits[l][i / 64] |= (uint64_t)1 << (i % 64);
+		if (p->bits[l][i / 64] != FULL_WORD)
+			break;
+		i /= 64;
+	}
+}
+
+static void set_free(ip_pool_st *p, uint32_t i)
+{
+	unsigned l, full;
+
+	for (l = 0; l < p->levels; l++) {
+		full = (p->bits[l][i / 64] == FULL_WORD);
+		p->bits[l][i / 64] &= ~((uint64_t)1 << (i % 64));
+		if (!full)
+			break;
+		i /= 64;
+	}
+}
+
+/* Returns the first clear bit of level l at or after pos, or -1.
+ */
+static int64_t next_clear(const ip_pool_st *p, unsigned l, uint64_t pos)
+{
+	uint64_t w = pos / 64, word;
+	int64_t nw;
+
+	if (w >= p->words[l])
+		return -1;
+
+	word = p->bits[l][w] | (((uint64_t)1 << (pos % 64)) - 1);
+	if (word != FULL_WORD)
+		return w * 64 + __builtin_ctzll(~word);
+
+	if (l + 1 >= p->levels)
+		return -1;
+
+	/* a clear bit above marks a word with a clear bit here */
+	nw = next_clear(p, l + 1, w + 1);
+	if (nw < 0)
+		return -1;
+
+	return nw * 64 + __builtin_ctzll(~p->bits[l][nw]);
+}
+
+/* Leases the index hint if free, or else the next free one
+ * (wrapping around). Returns the index or -1 if the pool is full.
+ */
+int64_t ip_pool_alloc(ip_pool_st *p, uint32_t hint)
+{
+	int64_t i;
+
+	hint %= p->size;
+	i = next_clear(p, 0, hint);
+	if (i < 0)
+		i = next_clear(p, 0, 0);
+	if (i < 0)
+		return -1;
+
+	set_used(p, i);
+	p->used++;
+
+	return i;
+}
+
+/* Marks an index that is never to be leased */
+void ip_pool_reserve(ip_pool_st *p, uint32_t i)
+{
+	if (ip_pool_is_used(p, i))
+		return;
+
+	set_used(p, i);
+	p->reserved++;
+}
+
+void ip_pool_free(ip_pool_st *p, uint32_t i)
+{
+	if (!ip_pool_is_used(p, i))
+		return;
+
+	set_free(p, i);
+	p->used--;
+}
+
+/* Returns the index of the lease which contains addr; that is the
+ * bits between the network and the lease prefix. */
+uint32_t ip_pool_index(const ip_pool_st *p, const uint8_t *addr)
+{
+	uint32_t i = 0;
+	unsigned b;
+
+	for (b = p->prefix; b < p->lease_prefix; b++)
+		i = (i << 1) | ((addr[b / 8] >> (7 - b % 8)) & 1);
+
+	return i;
+}
+
+/* Sets the bits of addr between the network and the lease prefix
+ * to the index i. */
+void ip_pool_set_index(const ip_pool_st *p, uint8_t *addr, uint32_t i)
+{
+	unsigned b;
+
+	for (b = p->lease_prefix; b-- > p->prefix; i >>= 1) {
+		if (i & 1)
+			addr[b / 8] |= 1 << (7 - b % 8);
+		else
+			addr[b / 8] &= ~(1 << (7 - b % 8));
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This file is part of ocserv.
+ *
+ * ocserv is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ocserv is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IP_POOL_H
+# define IP_POOL_H
+
+#include <stdint.h>
+#include <ccan/list/list.h>
+
+/* The largest range (in bits of lease index) that is kept in a pool;
+ * larger ones, as in IPv6, are leased at random. */
+#define IP_POOL_MAX_BITS 24
+#define IP_POOL_LEVELS 4
+
+/* The leases of a network. Each lease is an index, which is the bits
+ * of its address between the network prefix and the lease prefix.
+ *
+ * The used leases are kept in a bitmap, with a summary level on top
+ * of it for each 64 bits, which marks the full words of the level
+ * below. A free lease is thus found in a constant number of steps,
+ * independently of the pool's utilization.
+ */
+typedef struct ip_pool_st {
+	struct list_node list;
+
+	int family;
+	uint8_t network[16];
+	unsigned prefix;
+	unsigned lease_prefix;
+
+	uint32_t size;
+	uint32_t reserved; /* never leased (e.g., the network address) */
+	uint32_t used; /* leased */
+
+	unsigned levels;
+	uint32_t words[IP_POOL_LEVELS];
+	uint64_t *bits[IP_POOL_LEVELS];
+} ip_pool_st;
+
+int ip_pool_init(void *pool, ip_pool_st *p, int family, const uint8_t *network,
+		 unsigned prefix, unsigned lease_prefix);
+void ip_pool_deinit(ip_pool_st *p);
+
+int64_t ip_pool_alloc(ip_pool_st *p, uint32_t hint);
+void ip_pool_reserve(ip_pool_st *p, uint32_t i);
+void ip_pool_free(ip_pool_st *p, uint32_t i);
+unsigned ip_pool_is_used(const ip_pool_st *p, uint32_t i);
+
+uint32_t ip_pool_index(const ip_pool_st *p, const uint8_t *addr);
+void ip_pool_set_index(const ip_pool_st *p, uint8_t *addr, uint32_t i);
+
+#endif
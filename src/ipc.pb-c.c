@@ -1087,6 +1087,141 @@ void   secm_list_cookies_reply_msg__free_unpacked
   assert(message->base.descriptor == &secm_list_cookies_reply_msg__descriptor);
   protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
 }
+void   worker_stats_msg__init
+                     (WorkerStatsMsg         *message)
+{
+  static const WorkerStatsMsg init_value = WORKER_STATS_MSG__INIT;
+  *message = init_value;
+}
+size_t worker_stats_msg__get_packed_size
+                     (const WorkerStatsMsg *message)
+{
+  assert(message->base.descriptor == &worker_stats_msg__descriptor);
+  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));
+}
+size_t worker_stats_msg__pack
+                     (const WorkerStatsMsg *message,
+                      uint8_t       *out)
+{
+  assert(message->base.descriptor == &worker_stats_msg__descriptor);
+  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);
+}
+size_t worker_stats_msg__pack_to_buffer
+                     (const WorkerStatsMsg *message,
+                      ProtobufCBuffer *buffer)
+{
+  assert(message->base.descriptor == &worker_stats_msg__descriptor);
+  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);
+}
+WorkerStatsMsg *
+       worker_stats_msg__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data)
+{
+  return (WorkerStatsMsg *)
+     protobuf_c_message_unpack (&worker_stats_msg__descriptor,
+                                allocator, len, data);
+}
+void   worker_stats_msg__free_unpacked
+                     (WorkerStatsMsg *message,
+                      ProtobufCAllocator *allocator)
+{
+  if(!message)
+    return;
+  assert(message->base.descriptor == &worker_stats_msg__descriptor);
+  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
+}
+void   worker_start_msg__init
+                     (WorkerStartMsg         *message)
+{
+  static const WorkerStartMsg init_value = WORKER_START_MSG__INIT;
+  *message = init_value;
+}
+size_t worker_start_msg__get_packed_size
+                     (const WorkerStartMsg *message)
+{
+  assert(message->base.descriptor == &worker_start_msg__descriptor);
+  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));
+}
+size_t worker_start_msg__pack
+                     (const WorkerStartMsg *message,
+                      uint8_t       *out)
+{
+  assert(message->base.descriptor == &worker_start_msg__descriptor);
+  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);
+}
+size_t worker_start_msg__pack_to_buffer
+                     (const WorkerStartMsg *message,
+                      ProtobufCBuffer *buffer)
+{
+  assert(message->base.descriptor == &worker_start_msg__descriptor);
+  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);
+}
+WorkerStartMsg *
+       worker_start_msg__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data)
+{
+  return (WorkerStartMsg *)
+     protobuf_c_message_unpack (&worker_start_msg__descriptor,
+                                allocator, len, data);
+}
+void   worker_start_msg__free_unpacked
+                     (WorkerStartMsg *message,
+                      ProtobufCAllocator *allocator)
+{
+  if(!message)
+    return;
+  assert(message->base.descriptor == &worker_start_msg__descriptor);
+  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
+}
+void   secm_client_state_msg__init
+                     (SecmClientStateMsg         *message)
+{
+  static const SecmClientStateMsg init_value = SECM_CLIENT_STATE_MSG__INIT;
+  *message = init_value;
+}
+size_t secm_client_state_msg__get_packed_size
+                     (const SecmClientStateMsg *message)
+{
+  assert(message->base.descriptor == &secm_client_state_msg__descriptor);
+  return protobuf_c_message_get_packed_size ((const ProtobufCMessage*)(message));
+}
+size_t secm_client_state_msg__pack
+                     (const SecmClientStateMsg *message,
+                      uint8_t       *out)
+{
+  assert(message->base.descriptor == &secm_client_state_msg__descriptor);
+  return protobuf_c_message_pack ((const ProtobufCMessage*)message, out);
+}
+size_t secm_client_state_msg__pack_to_buffer
+                     (const SecmClientStateMsg *message,
+                      ProtobufCBuffer *buffer)
+{
+  assert(message->base.descriptor == &secm_client_state_msg__descriptor);
+  return protobuf_c_message_pack_to_buffer ((const ProtobufCMessage*)message, buffer);
+}
+SecmClientStateMsg *
+       secm_client_state_msg__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data)
+{
+  return (SecmClientStateMsg *)
+     protobuf_c_message_unpack (&secm_client_state_msg__descriptor,
+                                allocator, len, data);
+}
+void   secm_client_state_msg__free_unpacked
+                     (SecmClientStateMsg *message,
+                      ProtobufCAllocator *allocator)
+{
+  if(!message)
+    return;
+  assert(message->base.descriptor == &secm_client_state_msg__descriptor);
+  protobuf_c_message_free_unpacked ((ProtobufCMessage*)message, allocator);
+}
 static const ProtobufCFieldDescriptor auth_cookie_request_msg__field_descriptors[1] =
 {
   {
@@ -1645,7 +1780,7 @@ const ProtobufCMessageDescriptor group_cfg_st__descriptor =
   (ProtobufCMessageInit) group_cfg_st__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor auth_cookie_reply_msg__field_descriptors[11] =
+static const ProtobufCFieldDescriptor auth_cookie_reply_msg__field_descriptors[12] =
 {
   {
     "reply",
@@ -1779,9 +1914,22 @@ static const ProtobufCFieldDescriptor auth_cookie_reply_msg__field_descriptors[1
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "dtls_port",
+    21,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(AuthCookieReplyMsg, has_dtls_port),
+    offsetof(AuthCookieReplyMsg, dtls_port),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned auth_cookie_reply_msg__field_indices_by_name[] = {
   10,   /* field[10] = config */
+  11,   /* field[11] = dtls_port */
   4,   /* field[4] = group_name */
   5,   /* field[5] = ipv4 */
   7,   /* field[7] = ipv4_local */
@@ -1798,7 +1946,7 @@ static const ProtobufCIntRange auth_cookie_reply_msg__number_ranges[3 + 1] =
   { 1, 0 },
   { 3, 1 },
   { 20, 10 },
-  { 0, 11 }
+  { 0, 12 }
 };
 const ProtobufCMessageDescriptor auth_cookie_reply_msg__descriptor =
 {
@@ -1808,7 +1956,7 @@ const ProtobufCMessageDescriptor auth_cookie_reply_msg__descriptor =
   "AuthCookieReplyMsg",
   "",
   sizeof(AuthCookieReplyMsg),
-  11,
+  12,
   auth_cookie_reply_msg__field_descriptors,
   auth_cookie_reply_msg__field_indices_by_name,
   3,  auth_cookie_reply_msg__number_ranges,
@@ -2203,7 +2351,7 @@ const ProtobufCMessageDescriptor cli_stats_msg__descriptor =
   NULL,NULL,NULL    /* reserved[123] */
 };
 static const protobuf_c_boolean udp_fd_msg__hello__default_value = 1;
-static const ProtobufCFieldDescriptor udp_fd_msg__field_descriptors[2] =
+static const ProtobufCFieldDescriptor udp_fd_msg__field_descriptors[5] =
 {
   {
     "hello",
@@ -2229,15 +2377,54 @@ static const ProtobufCFieldDescriptor udp_fd_msg__field_descriptors[2] =
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "record_seq",
+    3,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(UdpFdMsg, has_record_seq),
+    offsetof(UdpFdMsg, record_seq),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "hsk_read_seq",
+    4,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(UdpFdMsg, has_hsk_read_seq),
+    offsetof(UdpFdMsg, hsk_read_seq),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "hsk_write_seq",
+    5,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(UdpFdMsg, has_hsk_write_seq),
+    offsetof(UdpFdMsg, hsk_write_seq),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned udp_fd_msg__field_indices_by_name[] = {
   1,   /* field[1] = data */
   0,   /* field[0] = hello */
+  3,   /* field[3] = hsk_read_seq */
+  4,   /* field[4] = hsk_write_seq */
+  2,   /* field[2] = record_seq */
 };
 static const ProtobufCIntRange udp_fd_msg__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 2 }
+  { 0, 5 }
 };
 const ProtobufCMessageDescriptor udp_fd_msg__descriptor =
 {
@@ -2247,14 +2434,14 @@ const ProtobufCMessageDescriptor udp_fd_msg__descriptor =
   "UdpFdMsg",
   "",
   sizeof(UdpFdMsg),
-  2,
+  5,
   udp_fd_msg__field_descriptors,
   udp_fd_msg__field_indices_by_name,
   1,  udp_fd_msg__number_ranges,
   (ProtobufCMessageInit) udp_fd_msg__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor session_info_msg__field_descriptors[9] =
+static const ProtobufCFieldDescriptor session_info_msg__field_descriptors[11] =
 {
   {
     "tls_ciphersuite",
@@ -2364,13 +2551,39 @@ static const ProtobufCFieldDescriptor session_info_msg__field_descriptors[9] =
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "ktls",
+    10,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(SessionInfoMsg, has_ktls),
+    offsetof(SessionInfoMsg, ktls),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "handshake_us",
+    11,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(SessionInfoMsg, has_handshake_us),
+    offsetof(SessionInfoMsg, handshake_us),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned session_info_msg__field_indices_by_name[] = {
   3,   /* field[3] = cstp_compr */
   8,   /* field[8] = device_type */
   1,   /* field[1] = dtls_ciphersuite */
   4,   /* field[4] = dtls_compr */
+  10,   /* field[10] = handshake_us */
   7,   /* field[7] = hostname */
+  9,   /* field[9] = ktls */
   5,   /* field[5] = our_addr */
   6,   /* field[6] = remote_addr */
   0,   /* field[0] = tls_ciphersuite */
@@ -2379,7 +2592,7 @@ static const unsigned session_info_msg__field_indices_by_name[] = {
 static const ProtobufCIntRange session_info_msg__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 9 }
+  { 0, 11 }
 };
 const ProtobufCMessageDescriptor session_info_msg__descriptor =
 {
@@ -2389,7 +2602,7 @@ const ProtobufCMessageDescriptor session_info_msg__descriptor =
   "SessionInfoMsg",
   "",
   sizeof(SessionInfoMsg),
-  9,
+  11,
   session_info_msg__field_descriptors,
   session_info_msg__field_indices_by_name,
   1,  session_info_msg__number_ranges,
@@ -2992,7 +3205,7 @@ const ProtobufCMessageDescriptor sec_get_pk_msg__descriptor =
   (ProtobufCMessageInit) sec_get_pk_msg__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor secm_session_open_msg__field_descriptors[3] =
+static const ProtobufCFieldDescriptor secm_session_open_msg__field_descriptors[4] =
 {
   {
     "sid",
@@ -3030,8 +3243,21 @@ static const ProtobufCFieldDescriptor secm_session_open_msg__field_descriptors[3
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "id",
+    8,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(SecmSessionOpenMsg, has_id),
+    offsetof(SecmSessionOpenMsg, id),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned secm_session_open_msg__field_indices_by_name[] = {
+  3,   /* field[3] = id */
   1,   /* field[1] = ipv4 */
   2,   /* field[2] = ipv6 */
   0,   /* field[0] = sid */
@@ -3040,7 +3266,7 @@ static const ProtobufCIntRange secm_session_open_msg__number_ranges[2 + 1] =
 {
   { 1, 0 },
   { 6, 1 },
-  { 0, 3 }
+  { 0, 4 }
 };
 const ProtobufCMessageDescriptor secm_session_open_msg__descriptor =
 {
@@ -3050,7 +3276,7 @@ const ProtobufCMessageDescriptor secm_session_open_msg__descriptor =
   "SecmSessionOpenMsg",
   "",
   sizeof(SecmSessionOpenMsg),
-  3,
+  4,
   secm_session_open_msg__field_descriptors,
   secm_session_open_msg__field_indices_by_name,
   2,  secm_session_open_msg__number_ranges,
@@ -3161,7 +3387,7 @@ const ProtobufCMessageDescriptor secm_session_close_msg__descriptor =
   (ProtobufCMessageInit) secm_session_close_msg__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor secm_stats_msg__field_descriptors[5] =
+static const ProtobufCFieldDescriptor secm_stats_msg__field_descriptors[8] =
 {
   {
     "secmod_client_entries",
@@ -3223,18 +3449,57 @@ static const ProtobufCFieldDescriptor secm_stats_msg__field_descriptors[5] =
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "secmod_avg_key_op_us",
+    6,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(SecmStatsMsg, has_secmod_avg_key_op_us),
+    offsetof(SecmStatsMsg, secmod_avg_key_op_us),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "secmod_max_key_op_us",
+    7,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(SecmStatsMsg, has_secmod_max_key_op_us),
+    offsetof(SecmStatsMsg, secmod_max_key_op_us),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "secmod_max_key_op_queue",
+    8,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(SecmStatsMsg, has_secmod_max_key_op_queue),
+    offsetof(SecmStatsMsg, secmod_max_key_op_queue),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned secm_stats_msg__field_indices_by_name[] = {
   2,   /* field[2] = secmod_auth_failures */
   3,   /* field[3] = secmod_avg_auth_time */
+  5,   /* field[5] = secmod_avg_key_op_us */
   0,   /* field[0] = secmod_client_entries */
   4,   /* field[4] = secmod_max_auth_time */
+  7,   /* field[7] = secmod_max_key_op_queue */
+  6,   /* field[6] = secmod_max_key_op_us */
   1,   /* field[1] = secmod_tlsdb_entries */
 };
 static const ProtobufCIntRange secm_stats_msg__number_ranges[1 + 1] =
 {
   { 1, 0 },
-  { 0, 5 }
+  { 0, 8 }
 };
 const ProtobufCMessageDescriptor secm_stats_msg__descriptor =
 {
@@ -3244,14 +3509,14 @@ const ProtobufCMessageDescriptor secm_stats_msg__descriptor =
   "SecmStatsMsg",
   "",
   sizeof(SecmStatsMsg),
-  5,
+  8,
   secm_stats_msg__field_descriptors,
   secm_stats_msg__field_indices_by_name,
   1,  secm_stats_msg__number_ranges,
   (ProtobufCMessageInit) secm_stats_msg__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
-static const ProtobufCFieldDescriptor secm_session_reply_msg__field_descriptors[9] =
+static const ProtobufCFieldDescriptor secm_session_reply_msg__field_descriptors[10] =
 {
   {
     "reply",
@@ -3361,10 +3626,23 @@ static const ProtobufCFieldDescriptor secm_session_reply_msg__field_descriptors[
     0,             /* flags */
     0,NULL,NULL    /* reserved1,reserved2, etc */
   },
+  {
+    "id",
+    12,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(SecmSessionReplyMsg, has_id),
+    offsetof(SecmSessionReplyMsg, id),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
 };
 static const unsigned secm_session_reply_msg__field_indices_by_name[] = {
   1,   /* field[1] = config */
   3,   /* field[3] = groupname */
+  9,   /* field[9] = id */
   4,   /* field[4] = ip */
   5,   /* field[5] = ipv4_seed */
   0,   /* field[0] = reply */
@@ -3378,7 +3656,7 @@ static const ProtobufCIntRange secm_session_reply_msg__number_ranges[3 + 1] =
   { 1, 0 },
   { 6, 4 },
   { 8, 5 },
-  { 0, 9 }
+  { 0, 10 }
 };
 const ProtobufCMessageDescriptor secm_session_reply_msg__descriptor =
 {
@@ -3388,7 +3666,7 @@ const ProtobufCMessageDescriptor secm_session_reply_msg__descriptor =
   "SecmSessionReplyMsg",
   "",
   sizeof(SecmSessionReplyMsg),
-  9,
+  10,
   secm_session_reply_msg__field_descriptors,
   secm_session_reply_msg__field_indices_by_name,
   3,  secm_session_reply_msg__number_ranges,
@@ -3614,6 +3892,445 @@ const ProtobufCMessageDescriptor secm_list_cookies_reply_msg__descriptor =
   (ProtobufCMessageInit) secm_list_cookies_reply_msg__init,
   NULL,NULL,NULL    /* reserved[123] */
 };
+static const ProtobufCFieldDescriptor worker_stats_msg__field_descriptors[8] =
+{
+  {
+    "batch_wakeups",
+    1,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(WorkerStatsMsg, has_batch_wakeups),
+    offsetof(WorkerStatsMsg, batch_wakeups),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "batch_packets",
+    2,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(WorkerStatsMsg, has_batch_packets),
+    offsetof(WorkerStatsMsg, batch_packets),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "dtls_tx_queued",
+    3,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(WorkerStatsMsg, has_dtls_tx_queued),
+    offsetof(WorkerStatsMsg, dtls_tx_queued),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "dtls_tx_dropped",
+    4,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(WorkerStatsMsg, has_dtls_tx_dropped),
+    offsetof(WorkerStatsMsg, dtls_tx_dropped),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "fq_flows",
+    5,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(WorkerStatsMsg, has_fq_flows),
+    offsetof(WorkerStatsMsg, fq_flows),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "fq_queued",
+    6,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT32,
+    offsetof(WorkerStatsMsg, has_fq_queued),
+    offsetof(WorkerStatsMsg, fq_queued),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "fq_overlimit_drops",
+    7,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(WorkerStatsMsg, has_fq_overlimit_drops),
+    offsetof(WorkerStatsMsg, fq_overlimit_drops),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "fq_codel_drops",
+    8,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_UINT64,
+    offsetof(WorkerStatsMsg, has_fq_codel_drops),
+    offsetof(WorkerStatsMsg, fq_codel_drops),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
+static const unsigned worker_stats_msg__field_indices_by_name[] = {
+  1,   /* field[1] = batch_packets */
+  0,   /* field[0] = batch_wakeups */
+  3,   /* field[3] = dtls_tx_dropped */
+  2,   /* field[2] = dtls_tx_queued */
+  7,   /* field[7] = fq_codel_drops */
+  4,   /* field[4] = fq_flows */
+  6,   /* field[6] = fq_overlimit_drops */
+  5,   /* field[5] = fq_queued */
+};
+static const ProtobufCIntRange worker_stats_msg__number_ranges[1 + 1] =
+{
+  { 1, 0 },
+  { 0, 8 }
+};
+const ProtobufCMessageDescriptor worker_stats_msg__descriptor =
+{
+  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
+  "worker_stats_msg",
+  "WorkerStatsMsg",
+  "WorkerStatsMsg",
+  "",
+  sizeof(WorkerStatsMsg),
+  8,
+  worker_stats_msg__field_descriptors,
+  worker_stats_msg__field_indices_by_name,
+  1,  worker_stats_msg__number_ranges,
+  (ProtobufCMessageInit) worker_stats_msg__init,
+  NULL,NULL,NULL    /* reserved[123] */
+};
+static const ProtobufCFieldDescriptor worker_start_msg__field_descriptors[4] =
+{
+  {
+    "remote_addr",
+    1,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_BYTES,
+    0,   /* quantifier_offset */
+    offsetof(WorkerStartMsg, remote_addr),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "our_addr",
+    2,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_BYTES,
+    0,   /* quantifier_offset */
+    offsetof(WorkerStartMsg, our_addr),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "sock_type",
+    3,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_UINT32,
+    0,   /* quantifier_offset */
+    offsetof(WorkerStartMsg, sock_type),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "accept_time",
+    4,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(WorkerStartMsg, accept_time),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
+static const unsigned worker_start_msg__field_indices_by_name[] = {
+  3,   /* field[3] = accept_time */
+  1,   /* field[1] = our_addr */
+  0,   /* field[0] = remote_addr */
+  2,   /* field[2] = sock_type */
+};
+static const ProtobufCIntRange worker_start_msg__number_ranges[1 + 1] =
+{
+  { 1, 0 },
+  { 0, 4 }
+};
+const ProtobufCMessageDescriptor worker_start_msg__descriptor =
+{
+  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
+  "worker_start_msg",
+  "WorkerStartMsg",
+  "WorkerStartMsg",
+  "",
+  sizeof(WorkerStartMsg),
+  4,
+  worker_start_msg__field_descriptors,
+  worker_start_msg__field_indices_by_name,
+  1,  worker_start_msg__number_ranges,
+  (ProtobufCMessageInit) worker_start_msg__init,
+  NULL,NULL,NULL    /* reserved[123] */
+};
+static const ProtobufCFieldDescriptor secm_client_state_msg__field_descriptors[16] =
+{
+  {
+    "sid",
+    1,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_BYTES,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, sid),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "vhost",
+    2,
+    PROTOBUF_C_LABEL_OPTIONAL,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, vhost),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "username",
+    3,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, username),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "groupname",
+    4,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, groupname),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "remote_ip",
+    5,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, remote_ip),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "our_ip",
+    6,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, our_ip),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "user_agent",
+    7,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_STRING,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, user_agent),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "auth_type",
+    8,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_UINT32,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, auth_type),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "tls_auth_ok",
+    9,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_BOOL,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, tls_auth_ok),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "session_is_open",
+    10,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_BOOL,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, session_is_open),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "created",
+    11,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, created),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "exptime",
+    12,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, exptime),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "ipv4_seed",
+    13,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_UINT32,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, ipv4_seed),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "bytes_in",
+    14,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, bytes_in),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "bytes_out",
+    15,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, bytes_out),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+  {
+    "uptime",
+    16,
+    PROTOBUF_C_LABEL_REQUIRED,
+    PROTOBUF_C_TYPE_UINT64,
+    0,   /* quantifier_offset */
+    offsetof(SecmClientStateMsg, uptime),
+    NULL,
+    NULL,
+    0,             /* flags */
+    0,NULL,NULL    /* reserved1,reserved2, etc */
+  },
+};
+static const unsigned secm_client_state_msg__field_indices_by_name[] = {
+  7,   /* field[7] = auth_type */
+  13,   /* field[13] = bytes_in */
+  14,   /* field[14] = bytes_out */
+  10,   /* field[10] = created */
+  11,   /* field[11] = exptime */
+  3,   /* field[3] = groupname */
+  12,   /* field[12] = ipv4_seed */
+  5,   /* field[5] = our_ip */
+  4,   /* field[4] = remote_ip */
+  9,   /* field[9] = session_is_open */
+  0,   /* field[0] = sid */
+  8,   /* field[8] = tls_auth_ok */
+  15,   /* field[15] = uptime */
+  6,   /* field[6] = user_agent */
+  2,   /* field[2] = username */
+  1,   /* field[1] = vhost */
+};
+static const ProtobufCIntRange secm_client_state_msg__number_ranges[1 + 1] =
+{
+  { 1, 0 },
+  { 0, 16 }
+};
+const ProtobufCMessageDescriptor secm_client_state_msg__descriptor =
+{
+  PROTOBUF_C__MESSAGE_DESCRIPTOR_MAGIC,
+  "secm_client_state_msg",
+  "SecmClientStateMsg",
+  "SecmClientStateMsg",
+  "",
+  sizeof(SecmClientStateMsg),
+  16,
+  secm_client_state_msg__field_descriptors,
+  secm_client_state_msg__field_indices_by_name,
+  1,  secm_client_state_msg__number_ranges,
+  (ProtobufCMessageInit) secm_client_state_msg__init,
+  NULL,NULL,NULL    /* reserved[123] */
+};
 static const ProtobufCEnumValue auth__rep__enum_values_by_number[3] =
 {
   { "OK", "AUTH__REP__OK", 1 },
@@ -39,6 +39,9 @@ typedef struct _SecmStatsMsg SecmStatsMsg;
 typedef struct _SecmSessionReplyMsg SecmSessionReplyMsg;
 typedef struct _CookieIntMsg CookieIntMsg;
 typedef struct _SecmListCookiesReplyMsg SecmListCookiesReplyMsg;
+typedef struct _WorkerStatsMsg WorkerStatsMsg;
+typedef struct _WorkerStartMsg WorkerStartMsg;
+typedef struct _SecmClientStateMsg SecmClientStateMsg;
 
 
 /* --- enums --- */
@@ -189,10 +192,12 @@ struct  _AuthCookieReplyMsg
    * additional config 
    */
   GroupCfgSt *config;
+  protobuf_c_boolean has_dtls_port;
+  uint32_t dtls_port;
 };
 #define AUTH_COOKIE_REPLY_MSG__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&auth_cookie_reply_msg__descriptor) \
-    , AUTH__REP__OK, 0, {0,NULL}, NULL, NULL, NULL, NULL, NULL, NULL, NULL, {0,NULL}, NULL }
+    , AUTH__REP__OK, 0, {0,NULL}, NULL, NULL, NULL, NULL, NULL, NULL, NULL, {0,NULL}, NULL, 0, 0 }
 
 
 /*
@@ -298,10 +303,16 @@ struct  _UdpFdMsg
    * the first packet in the fd 
    */
   ProtobufCBinaryData data;
+  protobuf_c_boolean has_record_seq;
+  uint32_t record_seq;
+  protobuf_c_boolean has_hsk_read_seq;
+  uint32_t hsk_read_seq;
+  protobuf_c_boolean has_hsk_write_seq;
+  uint32_t hsk_write_seq;
 };
 #define UDP_FD_MSG__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&udp_fd_msg__descriptor) \
-    , 1, {0,NULL} }
+    , 1, {0,NULL}, 0, 0, 0, 0, 0, 0 }
 
 
 /*
@@ -326,10 +337,14 @@ struct  _SessionInfoMsg
   ProtobufCBinaryData remote_addr;
   char *hostname;
   char *device_type;
+  protobuf_c_boolean has_ktls;
+  uint32_t ktls;
+  protobuf_c_boolean has_handshake_us;
+  uint32_t handshake_us;
 };
 #define SESSION_INFO_MSG__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&session_info_msg__descriptor) \
-    , NULL, NULL, NULL, NULL, NULL, 0, {0,NULL}, 0, {0,NULL}, NULL, NULL }
+    , NULL, NULL, NULL, NULL, NULL, 0, {0,NULL}, 0, {0,NULL}, NULL, NULL, 0, 0, 0, 0 }
 
 
 /*
@@ -483,10 +498,12 @@ struct  _SecmSessionOpenMsg
   ProtobufCBinaryData sid;
   char *ipv4;
   char *ipv6;
+  protobuf_c_boolean has_id;
+  uint32_t id;
 };
 #define SECM_SESSION_OPEN_MSG__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&secm_session_open_msg__descriptor) \
-    , {0,NULL}, NULL, NULL }
+    , {0,NULL}, NULL, NULL, 0, 0 }
 
 
 /*
@@ -533,10 +550,16 @@ struct  _SecmStatsMsg
    * max auth time in seconds 
    */
   uint32_t secmod_max_auth_time;
+  protobuf_c_boolean has_secmod_avg_key_op_us;
+  uint32_t secmod_avg_key_op_us;
+  protobuf_c_boolean has_secmod_max_key_op_us;
+  uint32_t secmod_max_key_op_us;
+  protobuf_c_boolean has_secmod_max_key_op_queue;
+  uint32_t secmod_max_key_op_queue;
 };
 #define SECM_STATS_MSG__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&secm_stats_msg__descriptor) \
-    , 0, 0, 0, 0, 0 }
+    , 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
 
 
 /*
@@ -554,10 +577,12 @@ struct  _SecmSessionReplyMsg
   ProtobufCBinaryData sid;
   protobuf_c_boolean tls_auth_ok;
   char *vhost;
+  protobuf_c_boolean has_id;
+  uint32_t id;
 };
 #define SECM_SESSION_REPLY_MSG__INIT \
  { PROTOBUF_C_MESSAGE_INIT (&secm_session_reply_msg__descriptor) \
-    , AUTH__REP__OK, NULL, NULL, NULL, NULL, 0, {0,NULL}, 0, NULL }
+    , AUTH__REP__OK, NULL, NULL, NULL, NULL, 0, {0,NULL}, 0, NULL, 0, 0 }
 
 
 /*
@@ -601,6 +626,75 @@ struct  _SecmListCookiesReplyMsg
     , 0,NULL }
 
 
+/*
+ * WORKER_STATS: sent periodically from worker to main 
+ */
+struct  _WorkerStatsMsg
+{
+  ProtobufCMessage base;
+  protobuf_c_boolean has_batch_wakeups;
+  uint64_t batch_wakeups;
+  protobuf_c_boolean has_batch_packets;
+  uint64_t batch_packets;
+  protobuf_c_boolean has_dtls_tx_queued;
+  uint32_t dtls_tx_queued;
+  protobuf_c_boolean has_dtls_tx_dropped;
+  uint64_t dtls_tx_dropped;
+  protobuf_c_boolean has_fq_flows;
+  uint32_t fq_flows;
+  protobuf_c_boolean has_fq_queued;
+  uint32_t fq_queued;
+  protobuf_c_boolean has_fq_overlimit_drops;
+  uint64_t fq_overlimit_drops;
+  protobuf_c_boolean has_fq_codel_drops;
+  uint64_t fq_codel_drops;
+};
+#define WORKER_STATS_MSG__INIT \
+ { PROTOBUF_C_MESSAGE_INIT (&worker_stats_msg__descriptor) \
+    , 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+
+
+struct  _WorkerStartMsg
+{
+  ProtobufCMessage base;
+  ProtobufCBinaryData remote_addr;
+  ProtobufCBinaryData our_addr;
+  uint32_t sock_type;
+  uint64_t accept_time;
+};
+#define WORKER_START_MSG__INIT \
+ { PROTOBUF_C_MESSAGE_INIT (&worker_start_msg__descriptor) \
+    , {0,NULL}, {0,NULL}, 0, 0 }
+
+
+/*
+ * internal: a client entry of sec-mod as kept in the state-file 
+ */
+struct  _SecmClientStateMsg
+{
+  ProtobufCMessage base;
+  ProtobufCBinaryData sid;
+  char *vhost;
+  char *username;
+  char *groupname;
+  char *remote_ip;
+  char *our_ip;
+  char *user_agent;
+  uint32_t auth_type;
+  protobuf_c_boolean tls_auth_ok;
+  protobuf_c_boolean session_is_open;
+  uint64_t created;
+  uint64_t exptime;
+  uint32_t ipv4_seed;
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t uptime;
+};
+#define SECM_CLIENT_STATE_MSG__INIT \
+ { PROTOBUF_C_MESSAGE_INIT (&secm_client_state_msg__descriptor) \
+    , {0,NULL}, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+
+
 /* AuthCookieRequestMsg methods */
 void   auth_cookie_request_msg__init
                      (AuthCookieRequestMsg         *message);
@@ -1057,6 +1151,63 @@ SecmListCookiesReplyMsg *
 void   secm_list_cookies_reply_msg__free_unpacked
                      (SecmListCookiesReplyMsg *message,
                       ProtobufCAllocator *allocator);
+/* WorkerStatsMsg methods */
+void   worker_stats_msg__init
+                     (WorkerStatsMsg         *message);
+size_t worker_stats_msg__get_packed_size
+                     (const WorkerStatsMsg   *message);
+size_t worker_stats_msg__pack
+                     (const WorkerStatsMsg   *message,
+                      uint8_t             *out);
+size_t worker_stats_msg__pack_to_buffer
+                     (const WorkerStatsMsg   *message,
+                      ProtobufCBuffer     *buffer);
+WorkerStatsMsg *
+       worker_stats_msg__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data);
+void   worker_stats_msg__free_unpacked
+                     (WorkerStatsMsg *message,
+                      ProtobufCAllocator *allocator);
+/* WorkerStartMsg methods */
+void   worker_start_msg__init
+                     (WorkerStartMsg         *message);
+size_t worker_start_msg__get_packed_size
+                     (const WorkerStartMsg   *message);
+size_t worker_start_msg__pack
+                     (const WorkerStartMsg   *message,
+                      uint8_t             *out);
+size_t worker_start_msg__pack_to_buffer
+                     (const WorkerStartMsg   *message,
+                      ProtobufCBuffer     *buffer);
+WorkerStartMsg *
+       worker_start_msg__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data);
+void   worker_start_msg__free_unpacked
+                     (WorkerStartMsg *message,
+                      ProtobufCAllocator *allocator);
+/* SecmClientStateMsg methods */
+void   secm_client_state_msg__init
+                     (SecmClientStateMsg         *message);
+size_t secm_client_state_msg__get_packed_size
+                     (const SecmClientStateMsg   *message);
+size_t secm_client_state_msg__pack
+                     (const SecmClientStateMsg   *message,
+                      uint8_t             *out);
+size_t secm_client_state_msg__pack_to_buffer
+                     (const SecmClientStateMsg   *message,
+                      ProtobufCBuffer     *buffer);
+SecmClientStateMsg *
+       secm_client_state_msg__unpack
+                     (ProtobufCAllocator  *allocator,
+                      size_t               len,
+                      const uint8_t       *data);
+void   secm_client_state_msg__free_unpacked
+                     (SecmClientStateMsg *message,
+                      ProtobufCAllocator *allocator);
 /* --- per-message closures --- */
 
 typedef void (*AuthCookieRequestMsg_Closure)
@@ -1131,6 +1282,15 @@ typedef void (*CookieIntMsg_Closure)
 typedef void (*SecmListCookiesReplyMsg_Closure)
                  (const SecmListCookiesReplyMsg *message,
                   void *closure_data);
+typedef void (*WorkerStatsMsg_Closure)
+                 (const WorkerStatsMsg *message,
+                  void *closure_data);
+typedef void (*WorkerStartMsg_Closure)
+                 (const WorkerStartMsg *message,
+                  void *closure_data);
+typedef void (*SecmClientStateMsg_Closure)
+                 (const SecmClientStateMsg *message,
+                  void *closure_data);
 
 /* --- services --- */
 
@@ -1163,6 +1323,9 @@ extern const ProtobufCMessageDescriptor secm_stats_msg__descriptor;
 extern const ProtobufCMessageDescriptor secm_session_reply_msg__descriptor;
 extern const ProtobufCMessageDescriptor cookie_int_msg__descriptor;
 extern const ProtobufCMessageDescriptor secm_list_cookies_reply_msg__descriptor;
+extern const ProtobufCMessageDescriptor worker_stats_msg__descriptor;
+extern const ProtobufCMessageDescriptor worker_start_msg__descriptor;
+extern const ProtobufCMessageDescriptor secm_client_state_msg__descriptor;
 
 PROTOBUF_C__END_DECLS
 
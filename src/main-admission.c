@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This file is part of ocserv.
+ *
+ * ocserv is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ocserv is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <talloc.h>
+#include <ccan/hash/hash.h>
+#include <main-admission.h>
+
+int admission_init(void *pool, admission_st *a, uint32_t seed)
+{
+	memset(a, 0, sizeof(*a));
+
+	a->nets = talloc_zero_array(pool, admission_bucket_st, ADMISSION_NET_SLOTS);
+	if (a->nets == NULL)
+		return -1;
+	a->seed = seed;
+
+	return 0;
+}
+
+/* Takes a token from the bucket. Returns non-zero if there was one.
+ */
+unsigned admission_take(admission_bucket_st *b, uint64_t interval_us,
+			unsigned burst, uint64_t now_us)
+{
+	uint64_t tolerance;
+
+	if (burst == 0)
+		burst = 1;
+	tolerance = (burst - 1) * interval_us;
+
+	if (b->due_us > now_us + tolerance)
+		return 0;
+
+	if (b->due_us < now_us)
+		b->due_us = now_us;
+	b->due_us += interval_us;
+
+	return 1;
+}
+
+/* Returns the microseconds until the bucket has a token, or
+ * zero if it has one now.
+ */
+uint64_t admission_wait(admission_bucket_st *b, uint64_t interval_us,
+			unsigned burst, uint64_t now_us)
+{
+	uint64_t tolerance;
+
+	if (burst == 0)
+		burst = 1;
+	tolerance = (burst - 1) * interval_us;
+
+	if (b->due_us <= now_us + tolerance)
+		return 0;
+
+	return b->due_us - tolerance - now_us;
+}
+
+/* Takes a token from the bucket of the network of the address.
+ * Returns non-zero if there was one, or if the address is not
+ * an IP one.
+ */
+unsigned admission_take_net(admission_st *a, const struct sockaddr_storage *addr,
+			    socklen_t addr_size, uint64_t interval_us,
+			    unsigned burst, uint64_t now_us)
+{
+	const struct sockaddr_in *a4 = (const struct sockaddr_in *)addr;
+	const struct sockaddr_in6 *a6 = (const struct sockaddr_in6 *)addr;
+	const uint8_t *net;
+	admission_bucket_st *b;
+	unsigned net_size;
+	uint32_t key;
+
+	if (a->nets == NULL)
+		return 1;
+
+	if (addr->ss_family == AF_INET && addr_size >= sizeof(*a4)) {
+		net = (const uint8_t *)&a4->sin_addr;
+		net_size = 3;
+	} else if (addr->ss_family == AF_INET6 && addr_size >= sizeof(*a6)) {
+		if (IN6_IS_ADDR_V4MAPPED(&a6->sin6_addr)) {
+			net = (const uint8_t *)&a6->sin6_addr + 12;
+			net_size = 3;
+		} else {
+			net = (const uint8_t *)&a6->sin6_addr;
+			net_size = 8;
+		}
+	} else {
+		return 1;
+	}
+
+	/* a colliding network shares the bucket, rather than resetting it;
+	 * the seed keeps the collisions out of the clients' control */
+	key = hash_any(net, net_size, a->seed);
+	b = &a->nets[key % ADMISSION_NET_SLOTS];
+
+	return admission_take(b, interval_us, burst, now_us);
+}
+
+/* Returns non-zero if a new connection is to be rejected. Once the
+ * active clients reach the threshold (a percentage of max_clients),
+ * an increasing share of the new connections is rejected, until all
+ * are at max_clients. rnd is a random value.
+ */
+unsigned admission_shed(unsigned active, unsigned max_clients,
+			unsigned threshold, uint32_t rnd)
+{
+	unsigned start;
+
+	if (threshold == 0 || max_clients == 0)
+		return 0;
+
+	start = ((uint64_t)max_clients * threshold) / 100;
+	if (active < start)
+		return 0;
+	if (active >= max_clients)
+		return 1;
+
+	return (rnd % (max_clients - start + 1)) < (active - start + 1);
+}
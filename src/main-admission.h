@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This file is part of ocserv.
+ *
+ * ocserv is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ocserv is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MAIN_ADMISSION_H
+# define MAIN_ADMISSION_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+/* The size of the table of per-network buckets */
+#define ADMISSION_NET_SLOTS 4096
+
+/* A token bucket which releases a token every interval, and holds up
+ * to burst tokens. It is kept as the time its next token is due, so
+ * that it needs no periodic refill.
+ */
+typedef struct admission_bucket_st {
+	uint64_t due_us;
+} admission_bucket_st;
+
+typedef struct admission_st {
+	admission_bucket_st global;
+
+	/* the buckets of the /24 IPv4 and /64 IPv6 networks, indexed by
+	 * a keyed hash of the network; colliding networks share a slot */
+	admission_bucket_st *nets;
+	uint32_t seed;
+} admission_st;
+
+int admission_init(void *pool, admission_st *a, uint32_t seed);
+
+unsigned admission_take(admission_bucket_st *b, uint64_t interval_us,
+			unsigned burst, uint64_t now_us);
+uint64_t admission_wait(admission_bucket_st *b, uint64_t interval_us,
+			unsigned burst, uint64_t now_us);
+
+unsigned admission_take_net(admission_st *a, const struct sockaddr_storage *addr,
+			    socklen_t addr_size, uint64_t interval_us,
+			    unsigned burst, uint64_t now_us);
+
+unsigned admission_shed(unsigned active, unsigned max_clients,
+			unsigned threshold, uint32_t rnd);
+
+#endif
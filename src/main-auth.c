@@ -104,6 +104,7 @@ int send_cookie_auth_reply(main_server_st* s, struct proc_st* proc,
 {
 	AuthCookieReplyMsg msg = AUTH_COOKIE_REPLY_MSG__INIT;
 	int ret;
+	int dtls_fd = -1;
 
 	if (r == AUTH__REP__OK && proc->tun_lease.name[0] != 0) {
 		char ipv6[MAX_IP_STR];
@@ -141,10 +142,22 @@ int send_cookie_auth_reply(main_server_st* s, struct proc_st* proc,
 
 		msg.config = proc->config;
 
+		if (proc->config && proc->config->no_udp == 0) {
+			dtls_fd = open_dtls_port(s, proc, &msg.dtls_port);
+			if (dtls_fd != -1)
+				msg.has_dtls_port = 1;
+		}
+
 		ret = send_socket_msg_to_worker(s, proc, AUTH_COOKIE_REP, proc->tun_lease.fd,
 			 &msg,
 			 (pack_size_func)auth_cookie_reply_msg__get_packed_size,
 			 (pack_func)auth_cookie_reply_msg__pack);
+
+		if (ret >= 0 && dtls_fd != -1)
+			ret = send_socket_msg_to_worker(s, proc, CMD_DTLS_PORT_FD, dtls_fd,
+				 NULL, NULL, NULL);
+		if (dtls_fd != -1)
+			close(dtls_fd);
 	} else {
 		msg.reply = AUTH__REP__FAILED;
 
@@ -167,7 +180,6 @@ int handle_auth_cookie_req(main_server_st* s, struct proc_st* proc,
  			   const AuthCookieRequestMsg * req)
 {
 int ret;
-struct proc_st *old_proc;
 
 	if (req->cookie.data == NULL || req->cookie.len != sizeof(proc->sid))
 		return -1;
@@ -179,21 +191,32 @@ struct proc_st *old_proc;
 		return -1;
 	proc->dtls_session_id_size = sizeof(proc->dtls_session_id);
 
-	/* loads sup config and basic proc info (e.g., username) */
+	/* loads sup config and basic proc info (e.g., username); the
+	 * reply of sec-mod is handled by handle_auth_cookie_rep() */
 	ret = session_open(s, proc, req->cookie.data, req->cookie.len);
 	if (ret < 0) {
 		mslog(s, proc, LOG_INFO, "could not open session");
 		return -1;
 	}
 
+	return ERR_WAIT_FOR_SEC_MOD;
+}
+
+/* Continues handle_auth_cookie_req() once the session is opened
+ * by sec-mod. The cookie is in proc->pending_sid.
+ */
+int handle_auth_cookie_rep(main_server_st* s, struct proc_st* proc)
+{
+struct proc_st *old_proc;
+
 	/* Put into right cgroup */
         if (proc->config->cgroup != NULL) {
         	put_into_cgroup(s, proc->config->cgroup, proc->pid);
 	}
 
 	/* check for a user with the same sid as in the cookie */
-	old_proc = proc_search_sid(s, req->cookie.data);
-	if (old_proc != NULL) {
+	old_proc = proc_search_sid(s, proc->pending_sid);
+	if (old_proc != NULL && old_proc != proc) {
 		mslog(s, old_proc, LOG_INFO, "disconnecting previous user session due to session re-use");
 
 		if (strcmp(proc->username, old_proc->username) != 0) {
@@ -213,8 +236,8 @@ struct proc_st *old_proc;
 		mslog(s, proc, LOG_INFO, "new user session");
 	}
 
-	/* update the SID */
-	memcpy(proc->sid, req->cookie.data, req->cookie.len);
+	memcpy(proc->sid, proc->pending_sid, sizeof(proc->sid));
+	safe_memset(proc->pending_sid, 0, sizeof(proc->pending_sid));
 	/* this also hints to call session_close() */
 	proc->active_sid = 1;
 
@@ -204,6 +204,34 @@ static void method_status(method_ctx *ctx, int cfd, uint8_t * msg,
 	rep.total_auth_failures = ctx->s->stats.total_auth_failures;
 	rep.total_sessions_closed = ctx->s->stats.total_sessions_closed;
 
+	rep.avg_handshake_us = ctx->s->stats.avg_handshake_us;
+	rep.has_avg_handshake_us = 1;
+	rep.max_handshake_us = ctx->s->stats.max_handshake_us;
+	rep.has_max_handshake_us = 1;
+	rep.idle_workers = ctx->s->idle_worker_list.total;
+	rep.has_idle_workers = 1;
+	rep.no_hello_conns = ctx->s->stats.no_hello_conns;
+	rep.has_no_hello_conns = 1;
+	rep.conns_rate_limited = ctx->s->stats.conns_rate_limited;
+	rep.has_conns_rate_limited = 1;
+	rep.conns_shed = ctx->s->stats.conns_shed;
+	rep.has_conns_shed = 1;
+	rep.conns_max_clients = ctx->s->stats.conns_max_clients;
+	rep.has_conns_max_clients = 1;
+	rep.accept_backlog = listen_backlog(ctx->s);
+	rep.has_accept_backlog = 1;
+
+	ip_lease_pool_usage(ctx->s, AF_INET, &rep.ipv4_pool_size, &rep.ipv4_pool_used);
+	rep.has_ipv4_pool_size = rep.has_ipv4_pool_used = 1;
+	ip_lease_pool_usage(ctx->s, AF_INET6, &rep.ipv6_pool_size, &rep.ipv6_pool_used);
+	rep.has_ipv6_pool_size = rep.has_ipv6_pool_used = 1;
+	rep.avg_key_op_us = ctx->s->stats.avg_key_op_us;
+	rep.has_avg_key_op_us = 1;
+	rep.max_key_op_us = ctx->s->stats.max_key_op_us;
+	rep.has_max_key_op_us = 1;
+	rep.max_key_op_queue = ctx->s->stats.max_key_op_queue;
+	rep.has_max_key_op_queue = 1;
+
 	ret = send_msg(ctx->pool, cfd, CTL_CMD_STATUS_REP, &rep,
 		       (pack_size_func) status_rep__get_packed_size,
 		       (pack_func) status_rep__pack);
@@ -391,6 +419,36 @@ static int append_user_info(method_ctx *ctx,
 		rep->has_mtu = 1;
 	}
 
+	if (ctmp->batch_wakeups > 0) {
+		rep->batch_wakeups = ctmp->batch_wakeups;
+		rep->has_batch_wakeups = 1;
+		rep->batch_packets = ctmp->batch_packets;
+		rep->has_batch_packets = 1;
+	}
+
+	if (ctmp->dtls_tx_queued > 0 || ctmp->dtls_tx_dropped > 0) {
+		rep->dtls_tx_queued = ctmp->dtls_tx_queued;
+		rep->has_dtls_tx_queued = 1;
+		rep->dtls_tx_dropped = ctmp->dtls_tx_dropped;
+		rep->has_dtls_tx_dropped = 1;
+	}
+
+	if (ctmp->fq != 0) {
+		rep->fq_flows = ctmp->fq_flows;
+		rep->has_fq_flows = 1;
+		rep->fq_queued = ctmp->fq_queued;
+		rep->has_fq_queued = 1;
+		rep->fq_overlimit_drops = ctmp->fq_overlimit_drops;
+		rep->has_fq_overlimit_drops = 1;
+		rep->fq_codel_drops = ctmp->fq_codel_drops;
+		rep->has_fq_codel_drops = 1;
+	}
+
+	if (ctmp->ktls != 0) {
+		rep->ktls = ctmp->ktls;
+		rep->has_ktls = 1;
+	}
+
 	if (ctmp->config) {
 		rep->restrict_to_routes = ctmp->config->restrict_user_to_routes;
 
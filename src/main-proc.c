@@ -106,6 +106,9 @@ void remove_proc(main_server_st * s, struct proc_st *proc, unsigned flags)
 	list_del(&proc->list);
 	s->stats.active_clients--;
 
+	if (proc->session_open_id != 0)
+		session_open_cancel(s, proc);
+
 	if ((flags&RPROC_KILL) && proc->pid != -1 && proc->pid != 0)
 		kill(proc->pid, SIGTERM);
 
@@ -156,6 +159,7 @@ void remove_proc(main_server_st * s, struct proc_st *proc, unsigned flags)
 	}
 
 	safe_memset(proc->sid, 0, sizeof(proc->sid));
+	safe_memset(proc->pending_sid, 0, sizeof(proc->pending_sid));
 	talloc_free(proc);
 }
 
@@ -66,6 +66,8 @@ static void update_auth_failures(main_server_st * s, uint64_t auth_failures)
 	s->stats.total_auth_failures += auth_failures;
 }
 
+static void session_open_reply(main_server_st *s, void *mpool, SecmSessionReplyMsg *msg);
+
 int handle_sec_mod_commands(main_server_st * s)
 {
 	struct iovec iov[3];
@@ -173,6 +175,28 @@ int handle_sec_mod_commands(main_server_st * s)
 			safe_memset(raw, 0, raw_len);
 		}
 
+		break;
+	case CMD_SECM_SESSION_REPLY:{
+			SecmSessionReplyMsg *rmsg;
+			void *mpool = talloc_new(s);
+			PROTOBUF_ALLOCATOR(mpa, mpool);
+
+			if (mpool == NULL) {
+				ret = ERR_MEM;
+				goto cleanup;
+			}
+
+			rmsg = secm_session_reply_msg__unpack(&mpa, raw_len, raw);
+			if (rmsg == NULL) {
+				mslog(s, NULL, LOG_ERR, "error unpacking sec-mod data");
+				talloc_free(mpool);
+				ret = ERR_BAD_COMMAND;
+				goto cleanup;
+			}
+
+			session_open_reply(s, mpool, rmsg);
+		}
+
 		break;
 	case CMD_SECM_STATS:{
 			SecmStatsMsg *smsg = NULL;
@@ -188,6 +212,9 @@ int handle_sec_mod_commands(main_server_st * s)
 			s->stats.tlsdb_entries = smsg->secmod_tlsdb_entries;
 			s->stats.max_auth_time = smsg->secmod_max_auth_time;
 			s->stats.avg_auth_time = smsg->secmod_avg_auth_time;
+			s->stats.avg_key_op_us = smsg->secmod_avg_key_op_us;
+			s->stats.max_key_op_us = smsg->secmod_max_key_op_us;
+			s->stats.max_key_op_queue = smsg->secmod_max_key_op_queue;
 			update_auth_failures(s, smsg->secmod_auth_failures);
 
 		}
@@ -444,16 +471,18 @@ void apply_default_config(main_server_st *s, proc_st *proc, GroupCfgSt *gc)
 	(*proc->config_usage_count)++;
 }
 
+/* Sends the session open request for the cookie to sec-mod, over the
+ * async socket. The proc waits for the reply, which is handled by
+ * session_open_reply(), and several requests may be in flight.
+ */
 int session_open(main_server_st *s, struct proc_st *proc, const uint8_t *cookie, unsigned cookie_size)
 {
-	int ret, e;
+	int ret;
 	SecmSessionOpenMsg ireq = SECM_SESSION_OPEN_MSG__INIT;
-	SecmSessionReplyMsg *msg = NULL;
 	char str_ipv4[MAX_IP_STR];
 	char str_ipv6[MAX_IP_STR];
-	char str_ip[MAX_IP_STR];
 
-	if (cookie == NULL || cookie_size != SID_SIZE)
+	if (cookie == NULL || cookie_size != SID_SIZE || proc->session_open_id != 0)
 		return -1;
 
 	ireq.sid.data = (void*)cookie;
@@ -471,9 +500,15 @@ int session_open(main_server_st *s, struct proc_st *proc, const uint8_t *cookie,
 		ireq.ipv6 = str_ipv6;
 	}
 
+	/* zero marks a proc which doesn't wait */
+	if (++s->session_open_list.next_id == 0)
+		s->session_open_list.next_id = 1;
+	ireq.id = s->session_open_list.next_id;
+	ireq.has_id = 1;
+
 	mslog(s, proc, LOG_DEBUG, "sending msg %s to sec-mod", cmd_request_to_str(CMD_SECM_SESSION_OPEN));
 
-	ret = send_msg(proc, s->sec_mod_fd_sync, CMD_SECM_SESSION_OPEN,
+	ret = send_msg(proc, s->sec_mod_fd, CMD_SECM_SESSION_OPEN,
 		&ireq, (pack_size_func)secm_session_open_msg__get_packed_size,
 		(pack_func)secm_session_open_msg__pack);
 	if (ret < 0) {
@@ -482,13 +517,28 @@ int session_open(main_server_st *s, struct proc_st *proc, const uint8_t *cookie,
 		return -1;
 	}
 
-	ret = recv_msg(proc, s->sec_mod_fd_sync, CMD_SECM_SESSION_REPLY,
-	       (void *)&msg, (unpack_func) secm_session_reply_msg__unpack, MAIN_SEC_MOD_TIMEOUT);
-	if (ret < 0) {
-		e = errno;
-		mslog(s, proc, LOG_ERR, "error receiving auth reply message from sec-mod cmd socket: %s", strerror(e));
-		return ret;
-	}
+	memcpy(proc->pending_sid, cookie, cookie_size);
+	proc->session_open_id = ireq.id;
+	list_add_tail(&s->session_open_list.head, &proc->session_open_list);
+
+	return 0;
+}
+
+/* Stops waiting for the reply to session_open(); a reply that
+ * arrives later is ignored.
+ */
+void session_open_cancel(main_server_st *s, struct proc_st *proc)
+{
+	list_del(&proc->session_open_list);
+	proc->session_open_id = 0;
+}
+
+/* Applies the reply of sec-mod to session_open() to the proc. The
+ * reply is allocated under the proc.
+ */
+static int apply_session_reply(main_server_st *s, struct proc_st *proc, SecmSessionReplyMsg *msg)
+{
+	char str_ip[MAX_IP_STR];
 
 	if (msg->reply != AUTH__REP__OK) {
 		mslog(s, proc, LOG_DEBUG, "session initiation was rejected");
@@ -539,6 +589,43 @@ int session_open(main_server_st *s, struct proc_st *proc, const uint8_t *cookie,
 	return 0;
 }
 
+/* Handles a CMD_SECM_SESSION_REPLY, and continues the authentication
+ * of the proc which waits for it. The msg is allocated under mpool,
+ * which is freed or kept with the proc.
+ */
+static void session_open_reply(main_server_st *s, void *mpool, SecmSessionReplyMsg *msg)
+{
+	struct proc_st *proc = NULL, *ctmp;
+	int ret;
+
+	if (msg->has_id) {
+		list_for_each(&s->session_open_list.head, ctmp, session_open_list) {
+			if (ctmp->session_open_id == msg->id) {
+				proc = ctmp;
+				break;
+			}
+		}
+	}
+
+	if (proc == NULL) {
+		mslog(s, NULL, LOG_DEBUG, "ignoring session reply %u of a disconnected client", (unsigned)msg->id);
+		talloc_free(mpool);
+		return;
+	}
+
+	session_open_cancel(s, proc);
+	talloc_steal(proc, mpool);
+
+	ret = apply_session_reply(s, proc, msg);
+	if (ret < 0) {
+		mslog(s, proc, LOG_INFO, "could not open session");
+	} else {
+		ret = handle_auth_cookie_rep(s, proc);
+	}
+
+	resume_cookie_auth(s, proc, ret);
+}
+
 static void reset_stats(main_server_st *s, time_t now)
 {
 	mslog(s, NULL, LOG_INFO, "Start statistics block");
@@ -554,6 +641,14 @@ static void reset_stats(main_server_st *s, time_t now)
 	mslog(s, NULL, LOG_INFO, "Authentication failures: %lu", (unsigned long)s->stats.auth_failures);
 	mslog(s, NULL, LOG_INFO, "Maximum authentication time: %lu sec", (unsigned long)s->stats.max_auth_time);
 	mslog(s, NULL, LOG_INFO, "Average authentication time: %lu sec", (unsigned long)s->stats.avg_auth_time);
+	mslog(s, NULL, LOG_INFO, "Maximum TLS handshake time: %lu usec", (unsigned long)s->stats.max_handshake_us);
+	mslog(s, NULL, LOG_INFO, "Average TLS handshake time: %lu usec", (unsigned long)s->stats.avg_handshake_us);
+	mslog(s, NULL, LOG_INFO, "Maximum key operation time: %lu usec", (unsigned long)s->stats.max_key_op_us);
+	mslog(s, NULL, LOG_INFO, "Average key operation time: %lu usec", (unsigned long)s->stats.avg_key_op_us);
+	mslog(s, NULL, LOG_INFO, "Closed before TLS hello: %lu", (unsigned long)s->stats.no_hello_conns);
+	mslog(s, NULL, LOG_INFO, "Rate-limited connections: %lu", (unsigned long)s->stats.conns_rate_limited);
+	mslog(s, NULL, LOG_INFO, "Rejected connections (max-clients): %lu", (unsigned long)s->stats.conns_max_clients);
+	mslog(s, NULL, LOG_INFO, "Rejected connections (load): %lu", (unsigned long)s->stats.conns_shed);
 	mslog(s, NULL, LOG_INFO, "Data in: %lu, out: %lu kbytes", (unsigned long)s->stats.kbytes_in, (unsigned long)s->stats.kbytes_out);
 	mslog(s, NULL, LOG_INFO, "End of statistics block; resetting non-total stats");
 
@@ -567,6 +662,14 @@ static void reset_stats(main_server_st *s, time_t now)
 	s->stats.kbytes_out = 0;
 	s->stats.max_session_mins = 0;
 	s->stats.max_auth_time = 0;
+	s->stats.handshakes = 0;
+	s->stats.avg_handshake_us = 0;
+	s->stats.max_handshake_us = 0;
+	s->stats.max_key_op_us = 0;
+	s->stats.no_hello_conns = 0;
+	s->stats.conns_rate_limited = 0;
+	s->stats.conns_max_clients = 0;
+	s->stats.conns_shed = 0;
 }
 
 static void update_main_stats(main_server_st * s, struct proc_st *proc)
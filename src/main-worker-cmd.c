@@ -146,6 +146,20 @@ int handle_script_exit(main_server_st *s, struct proc_st *proc, int code)
 	return ret;
 }
 
+static void update_handshake_stats(main_server_st *s, uint32_t us)
+{
+	s->stats.handshakes++;
+	if (s->stats.handshakes == 0) { /* reset stats */
+		s->stats.avg_handshake_us = 0;
+		s->stats.max_handshake_us = 0;
+		return;
+	}
+
+	if (us > s->stats.max_handshake_us)
+		s->stats.max_handshake_us = us;
+	s->stats.avg_handshake_us = (s->stats.avg_handshake_us*(s->stats.handshakes-1)+us) / s->stats.handshakes;
+}
+
 /* This is the function after which proc is populated */
 static int accept_user(main_server_st * s, struct proc_st *proc, unsigned cmd)
 {
@@ -162,7 +176,11 @@ static int accept_user(main_server_st * s, struct proc_st *proc, unsigned cmd)
 	}
 
 	ret = open_tun(s, proc);
-	if (ret < 0) {
+	if (ret == ERR_WAIT_FOR_PING) {
+		/* resume_cookie_auth() will be called once the leases
+		 * are checked */
+		return ret;
+	} else if (ret < 0) {
 		return -1;
 	}
 
@@ -204,7 +222,9 @@ static int handle_cookie_auth_res(main_server_st *s, struct proc_st *proc,
 
 	if (result == 0) {
 		ret = accept_user(s, proc, cmd);
-		if (ret < 0) {
+		if (ret == ERR_WAIT_FOR_PING) {
+			return 0;
+		} else if (ret < 0) {
 			proc->status = PS_AUTH_FAILED;
 			goto finished;
 		}
@@ -234,6 +254,21 @@ static int handle_cookie_auth_res(main_server_st *s, struct proc_st *proc,
 	return ret;
 }
 
+/* Continues the authentication of a user, after sec-mod replies to
+ * session_open() or the echo requests to its IP leases complete (see
+ * get_ip_leases()).
+ */
+void resume_cookie_auth(main_server_st *s, struct proc_st *proc, int result)
+{
+	int ret;
+
+	ret = handle_cookie_auth_res(s, proc, AUTH_COOKIE_REQ, result);
+	if (ret < 0) {
+		/* takes care of free */
+		remove_proc(s, proc, RPROC_KILL);
+	}
+}
+
 int handle_worker_commands(main_server_st * s, struct proc_st *proc)
 {
 	uint8_t cmd;
@@ -375,6 +410,12 @@ int handle_worker_commands(main_server_st * s, struct proc_st *proc)
 				user_hostname_update(s, proc);
 			}
 
+			if (tmsg->has_ktls)
+				proc->ktls = tmsg->ktls;
+
+			if (tmsg->has_handshake_us)
+				update_handshake_stats(s, tmsg->handshake_us);
+
 			if (GETCONFIG(s)->listen_proxy_proto) {
 				if (tmsg->has_remote_addr && tmsg->remote_addr.len <= sizeof(struct sockaddr_storage)) {
 					proc_table_update_ip(s, proc, (struct sockaddr_storage*)tmsg->remote_addr.data, tmsg->remote_addr.len);
@@ -398,6 +439,43 @@ int handle_worker_commands(main_server_st * s, struct proc_st *proc)
 			session_info_msg__free_unpacked(tmsg, &pa);
 		}
 
+		break;
+	case CMD_WORKER_STATS:{
+			WorkerStatsMsg *tmsg;
+
+			if (proc->status != PS_AUTH_COMPLETED) {
+				mslog(s, proc, LOG_ERR,
+				      "received worker stats in unauthenticated state.");
+				ret = ERR_BAD_COMMAND;
+				goto cleanup;
+			}
+
+			tmsg = worker_stats_msg__unpack(&pa, raw_len, raw);
+			if (tmsg == NULL) {
+				mslog(s, proc, LOG_ERR, "error unpacking worker stats data");
+				ret = ERR_BAD_COMMAND;
+				goto cleanup;
+			}
+
+			if (tmsg->has_batch_wakeups)
+				proc->batch_wakeups = tmsg->batch_wakeups;
+			if (tmsg->has_batch_packets)
+				proc->batch_packets = tmsg->batch_packets;
+			if (tmsg->has_dtls_tx_queued)
+				proc->dtls_tx_queued = tmsg->dtls_tx_queued;
+			if (tmsg->has_dtls_tx_dropped)
+				proc->dtls_tx_dropped = tmsg->dtls_tx_dropped;
+			if (tmsg->has_fq_queued) {
+				proc->fq = 1;
+				proc->fq_flows = tmsg->fq_flows;
+				proc->fq_queued = tmsg->fq_queued;
+				proc->fq_overlimit_drops = tmsg->fq_overlimit_drops;
+				proc->fq_codel_drops = tmsg->fq_codel_drops;
+			}
+
+			worker_stats_msg__free_unpacked(tmsg, &pa);
+		}
+
 		break;
 	case AUTH_COOKIE_REQ:
 		if (proc->status != PS_AUTH_INACTIVE) {
@@ -422,6 +500,13 @@ int handle_worker_commands(main_server_st * s, struct proc_st *proc)
 
 		auth_cookie_request_msg__free_unpacked(auth_cookie_req, &pa);
 
+		if (ret == ERR_WAIT_FOR_SEC_MOD) {
+			/* resume_cookie_auth() will be called on the
+			 * reply of sec-mod */
+			proc->status = PS_AUTH_INIT;
+			break;
+		}
+
 		ret = handle_cookie_auth_res(s, proc, cmd, ret);
 		if (ret < 0) {
 			goto cleanup;
@@ -25,8 +25,15 @@
 #include <sys/types.h>
 #include <sys/select.h>
 #include <sys/wait.h>
+#include <poll.h>
 #include <fcntl.h>
 #include <sys/socket.h>
+#include <netinet/udp.h>
+#include <netinet/tcp.h>
+#ifdef __linux__
+# include <linux/filter.h>
+# include <sched.h>
+#endif
 #include <netdb.h>
 #include <system.h>
 #include <errno.h>
@@ -35,6 +42,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <cloexec.h>
+#include <gettime.h>
 #ifdef HAVE_MALLOC_TRIM
 # include <malloc.h> /* for malloc_trim() */
 #endif
@@ -42,6 +50,7 @@
 
 #include <gnutls/x509.h>
 #include <gnutls/crypto.h>
+#include <gnutls/dtls.h>
 #include <tlslib.h>
 #include "setproctitle.h"
 #ifdef HAVE_LIBWRAP
@@ -55,13 +64,17 @@
 #include <main.h>
 #include <main-ctl.h>
 #include <main-ban.h>
+#include <main-admission.h>
 #include <route-add.h>
 #include <worker.h>
 #include <proc-search.h>
 #include <tun.h>
 #include <grp.h>
 #include <ip-lease.h>
+#include <icmp-ping.h>
 #include <ccan/list/list.h>
+#include <ccan/hash/hash.h>
+#include <ccan/container_of/container_of.h>
 
 #ifdef HAVE_GSSAPI
 # include <libtasn1.h>
@@ -83,20 +96,23 @@ struct ev_loop *loop = NULL;
 ev_io ctl_watcher;
 ev_io sec_mod_watcher;
 ev_timer maintenance_watcher;
+ev_timer admission_watcher;
 ev_signal maintenance_sig_watcher;
 ev_signal term_sig_watcher;
 ev_signal int_sig_watcher;
 ev_signal reload_sig_watcher;
 ev_child child_watcher;
+ev_idle worker_pool_watcher;
 
 static void add_listener(void *pool, struct listen_list_st *list,
 	int fd, int family, int socktype, int protocol,
-	struct sockaddr* addr, socklen_t addr_len)
+	struct sockaddr* addr, socklen_t addr_len, int shard)
 {
 	struct listener_st *tmp;
 
 	tmp = talloc_zero(pool, struct listener_st);
 	tmp->fd = fd;
+	tmp->shard = shard;
 	tmp->family = family;
 	tmp->sock_type = socktype;
 	tmp->protocol = protocol;
@@ -146,12 +162,106 @@ static void set_common_socket_options(int fd)
 	set_cloexec_flag (fd, 1);
 }
 
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_AD_CPU)
+/* Makes the kernel select the socket of the reuseport group by the CPU
+ * which handled the incoming connection. */
+static void attach_shard_by_cpu(int fd, unsigned shards)
+{
+	struct sock_filter code[] = {
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, shards },
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog prog = {
+		.len = sizeof(code)/sizeof(code[0]),
+		.filter = code,
+	};
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+		       &prog, sizeof(prog)) < 0)
+		perror("setsockopt(SO_ATTACH_REUSEPORT_CBPF) failed");
+}
+#else
+static void attach_shard_by_cpu(int fd, unsigned shards)
+{
+	fprintf(stderr, "listen-shard-by-cpu is not supported on this system\n");
+}
+#endif
+
+/* Returns the socket, -1 if the address should be skipped, or -2 on
+ * a fatal error. */
+static
+int _listen_port(struct perm_cfg_st* config, struct addrinfo *ptr,
+		 unsigned shards)
+{
+	int s, y;
+
+	s = socket(ptr->ai_family, ptr->ai_socktype,
+		   ptr->ai_protocol);
+	if (s < 0) {
+		perror("socket() failed");
+		return -1;
+	}
+
+#if defined(IPV6_V6ONLY)
+	if (ptr->ai_family == AF_INET6) {
+		y = 1;
+		/* avoid listen on ipv6 addresses failing
+		 * because already listening on ipv4 addresses: */
+		setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY,
+			   (const void *) &y, sizeof(y));
+	}
+#endif
+
+	y = 1;
+	if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR,
+		       (const void *) &y, sizeof(y)) < 0) {
+		perror("setsockopt(SO_REUSEADDR) failed");
+	}
+
+#ifdef SO_REUSEPORT
+	if (shards > 1) {
+		y = 1;
+		if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT,
+			       (const void *) &y, sizeof(y)) < 0) {
+			perror("setsockopt(SO_REUSEPORT) failed");
+			close(s);
+			return -1;
+		}
+	}
+#endif
+
+	if (ptr->ai_socktype == SOCK_DGRAM) {
+		set_udp_socket_options(config, s, ptr->ai_family);
+	}
+
+
+	if (bind(s, ptr->ai_addr, ptr->ai_addrlen) < 0) {
+		perror("bind() failed");
+		close(s);
+		return -1;
+	}
+
+	if (ptr->ai_socktype == SOCK_STREAM) {
+		if (listen(s, 1024) < 0) {
+			perror("listen() failed");
+			close(s);
+			return -2;
+		}
+	}
+
+	set_common_socket_options(s);
+
+	return s;
+}
+
 static 
 int _listen_ports(void *pool, struct perm_cfg_st* config, 
 		struct addrinfo *res, struct listen_list_st *list)
 {
 	struct addrinfo *ptr;
-	int s, y;
+	int s;
+	unsigned i, shards;
 	const char* type = NULL;
 	char buf[512];
 
@@ -166,58 +276,30 @@ int _listen_ports(void *pool, struct perm_cfg_st* config,
 		else
 			continue;
 
+		shards = 1;
+		if (ptr->ai_socktype == SOCK_STREAM && config->config->listen_shards > 1)
+			shards = config->config->listen_shards;
+
 		if (config->foreground != 0)
 			fprintf(stderr, "listening (%s) on %s...\n",
 				type, human_addr(ptr->ai_addr, ptr->ai_addrlen,
 					   buf, sizeof(buf)));
 
-		s = socket(ptr->ai_family, ptr->ai_socktype,
-			   ptr->ai_protocol);
-		if (s < 0) {
-			perror("socket() failed");
-			continue;
-		}
-
-#if defined(IPV6_V6ONLY)
-		if (ptr->ai_family == AF_INET6) {
-			y = 1;
-			/* avoid listen on ipv6 addresses failing
-			 * because already listening on ipv4 addresses: */
-			setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY,
-				   (const void *) &y, sizeof(y));
-		}
-#endif
-
-		y = 1;
-		if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR,
-			       (const void *) &y, sizeof(y)) < 0) {
-			perror("setsockopt(SO_REUSEADDR) failed");
-		}
-
-		if (ptr->ai_socktype == SOCK_DGRAM) {
-			set_udp_socket_options(config, s, ptr->ai_family);
-		}
-
-
-		if (bind(s, ptr->ai_addr, ptr->ai_addrlen) < 0) {
-			perror("bind() failed");
-			close(s);
-			continue;
-		}
-
-		if (ptr->ai_socktype == SOCK_STREAM) {
-			if (listen(s, 1024) < 0) {
-				perror("listen() failed");
-				close(s);
+		for (i = 0; i < shards; i++) {
+			s = _listen_port(config, ptr, shards);
+			if (s == -2)
 				return -1;
-			}
-		}
+			if (s < 0)
+				break;
 
-		set_common_socket_options(s);
-
-		add_listener(pool, list, s, ptr->ai_family, ptr->ai_socktype==SOCK_STREAM?SOCK_TYPE_TCP:SOCK_TYPE_UDP,
-			ptr->ai_protocol, ptr->ai_addr, ptr->ai_addrlen);
+			/* the program applies to the whole group */
+			if (i == 0 && shards > 1 && config->config->listen_shard_by_cpu)
+				attach_shard_by_cpu(s, shards);
 
+			add_listener(pool, list, s, ptr->ai_family, ptr->ai_socktype==SOCK_STREAM?SOCK_TYPE_TCP:SOCK_TYPE_UDP,
+				ptr->ai_protocol, ptr->ai_addr, ptr->ai_addrlen,
+				shards > 1 ? (int)i : -1);
+		}
 	}
 
 	fflush(stderr);
@@ -274,7 +356,7 @@ int _listen_unix_ports(void *pool, struct perm_cfg_st* config,
 			       sa.sun_path, strerror(e));
 			exit(1);
 		}
-		add_listener(pool, list, s, AF_UNIX, SOCK_TYPE_UNIX, 0, (struct sockaddr *)&sa, sizeof(sa));
+		add_listener(pool, list, s, AF_UNIX, SOCK_TYPE_UNIX, 0, (struct sockaddr *)&sa, sizeof(sa), -1);
 	}
 	fflush(stderr);
 
@@ -352,7 +434,7 @@ listen_ports(void *pool, struct perm_cfg_st* config,
 					config->udp_port = ntohs(((struct sockaddr_in6*)&tmp_sock)->sin6_port);
 			}
 
-			add_listener(pool, list, fd, family, type==SOCK_STREAM?SOCK_TYPE_TCP:SOCK_TYPE_UDP, 0, (struct sockaddr*)&tmp_sock, tmp_sock_len);
+			add_listener(pool, list, fd, family, type==SOCK_STREAM?SOCK_TYPE_TCP:SOCK_TYPE_UDP, 0, (struct sockaddr*)&tmp_sock, tmp_sock_len, -1);
 		}
 
 		if (list->total == 0) {
@@ -440,7 +522,7 @@ listen_ports(void *pool, struct perm_cfg_st* config,
 /* Sets the options needed in the UDP socket we forward to
  * worker */
 static
-void set_worker_udp_opts(main_server_st *s, int fd, int family)
+void set_worker_udp_opts(main_server_st *s, int fd, int family, unsigned reuseaddr)
 {
 int y;
 
@@ -454,12 +536,22 @@ int y;
 	}
 #endif
 
-	y = 1;
-	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const void *) &y, sizeof(y));
+	if (reuseaddr) {
+		y = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const void *) &y, sizeof(y));
+	}
 
 	if (GETCONFIG(s)->try_mtu) {
 		set_mtu_disc(fd, family, 1);
 	}
+
+#ifdef UDP_GRO
+	if (GETCONFIG(s)->udp_gso) {
+		y = 1;
+		if (setsockopt(fd, SOL_UDP, UDP_GRO, (const void *) &y, sizeof(y)) < 0)
+			mslog(s, NULL, LOG_DEBUG, "setsockopt(UDP, UDP_GRO) failed: %s", strerror(errno));
+	}
+#endif
 	set_cloexec_flag (fd, 1);
 
 	return;
@@ -576,6 +668,11 @@ void clear_lists(main_server_st *s)
 	struct listener_st *ltmp = NULL, *lpos;
 	struct proc_st *ctmp = NULL, *cpos;
 	struct script_wait_st *script_tmp = NULL, *script_pos;
+	struct idle_worker_st *iw_tmp = NULL, *iw_pos;
+	struct pending_conn_st *pc_tmp = NULL, *pc_pos;
+	struct acceptor_st *a_tmp = NULL, *a_pos;
+
+	icmp_ping_deinit(s);
 
 	list_for_each_safe(&s->listen_list.head, ltmp, lpos, list) {
 		close(ltmp->fd);
@@ -603,6 +700,40 @@ void clear_lists(main_server_st *s)
 		talloc_free(script_tmp);
 	}
 
+	list_for_each_safe(&s->idle_worker_list.head, iw_tmp, iw_pos, list) {
+		close(iw_tmp->fd);
+		list_del(&iw_tmp->list);
+		ev_child_stop(loop, &iw_tmp->ev_child);
+		talloc_free(iw_tmp);
+		s->idle_worker_list.total--;
+	}
+
+	list_for_each_safe(&s->acceptor_list.head, a_tmp, a_pos, list) {
+		if (a_tmp->fd != -1)
+			close(a_tmp->fd);
+		list_del(&a_tmp->list);
+		ev_io_stop(loop, &a_tmp->io);
+		ev_child_stop(loop, &a_tmp->ev_child);
+		ev_timer_stop(loop, &a_tmp->restart);
+		talloc_free(a_tmp);
+		s->acceptor_list.total--;
+	}
+
+	list_for_each_safe(&s->pending_conn_list.head, pc_tmp, pc_pos, list) {
+		close(pc_tmp->fd);
+		list_del(&pc_tmp->list);
+		ev_io_stop(loop, &pc_tmp->io);
+		ev_timer_stop(loop, &pc_tmp->timer);
+		talloc_free(pc_tmp);
+		s->pending_conn_list.total--;
+	}
+
+	if (s->dtls_cookie_key.data != NULL) {
+		safe_memset(s->dtls_cookie_key.data, 0, s->dtls_cookie_key.size);
+		gnutls_free(s->dtls_cookie_key.data);
+		s->dtls_cookie_key.data = NULL;
+	}
+
 	ip_lease_deinit(&s->ip_leases);
 	proc_table_deinit(s);
 	ctl_handler_deinit(s);
@@ -613,184 +744,204 @@ void clear_lists(main_server_st *s)
 		ev_io_stop (loop, &ctl_watcher);
 		ev_io_stop (loop, &sec_mod_watcher);
 		ev_child_stop (loop, &child_watcher);
+		ev_idle_stop (loop, &worker_pool_watcher);
 		ev_timer_stop(loop, &maintenance_watcher);
+		ev_timer_stop(loop, &admission_watcher);
 		/* free memory and descriptors by the event loop */
 		ev_loop_destroy (loop);
 	}
 }
 
-#define SKIP16(pos, total) { \
-	uint16_t _s; \
-	if (pos+2 > total) goto fallback; \
-	_s = (buffer[pos] << 8) | buffer[pos+1]; \
-	if ((size_t)(pos+2+_s) > total) goto fallback; \
-	pos += 2+_s; \
-	}
+/* The number of ports of dtls-port-range tried for a new session */
+#define DTLS_PORT_TRIES 32
 
-#define SKIP8(pos, total) { \
-	uint8_t _s; \
-	if (pos+1 > total) goto fallback; \
-	_s = buffer[pos]; \
-	if ((size_t)(pos+1+_s) > total) goto fallback; \
-	pos += 1+_s; \
-	}
+/* Opens a UDP socket for the DTLS channel of the session, bound to a
+ * port of dtls-port-range on the address the client connected to. Its
+ * packets are then delivered by the kernel directly to the worker,
+ * instead of being matched against one connected socket per session
+ * on the shared UDP port. Returns the socket, or -1 if the shared port
+ * must be used. */
+int open_dtls_port(main_server_st *s, struct proc_st *proc, unsigned *port)
+{
+	struct perm_cfg_st *config = GETPCONFIG(s);
+	struct sockaddr_storage addr;
+	unsigned range, i, p;
+	int fd, family = proc->our_addr.ss_family;
 
-#define TLS_EXT_APP_ID 48018
-#define RECORD_PAYLOAD_POS 13
-#define HANDSHAKE_SESSION_ID_POS 46
+	if (config->dtls_port_max == 0 || config->udp_port == 0 ||
+	    GETCONFIG(s)->listen_proxy_proto)
+		return -1;
 
-/* This returns either the application-specific ID extension contents,
- * or the session ID contents. The former is used on the new protocol,
- * while the latter on the legacy protocol.
- *
- * Extension ID: 48018
- * opaque ApplicationID<1..2^8-1>;
- *
- * struct {
- *          ExtensionType extension_type;
- *          opaque extension_data<0..2^16-1>;
- *      } Extension;
- *
- *      struct {
- *          ProtocolVersion server_version;
- *          Random random;
- *          SessionID session_id;
- *          opaque cookie<0..2^8-1>;
- *          CipherSuite cipher_suite;
- *          CompressionMethod compression_method;
- *          Extension server_hello_extension_list<0..2^16-1>;
- *      } ServerHello;
- */
-static
-unsigned get_session_id(main_server_st* s, uint8_t *buffer, size_t buffer_size, uint8_t **id, int *id_size)
-{
-	size_t pos;
+	if (family != AF_INET && family != AF_INET6)
+		return -1;
 
-	/* A client hello packet. We can get the session ID and figure
-	 * the associated connection. */
-	if (buffer_size < RECORD_PAYLOAD_POS+HANDSHAKE_SESSION_ID_POS+GNUTLS_MAX_SESSION_ID+2) {
-		return 0;
+	fd = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+	if (fd < 0) {
+		mslog(s, proc, LOG_ERR, "new UDP socket failed: %s", strerror(errno));
+		return -1;
 	}
 
-	if (!GETCONFIG(s)->dtls_psk)
-		goto fallback;
+	/* no SO_REUSEADDR; the port must not be shared with another session */
+	set_worker_udp_opts(s, fd, family, 0);
 
-	/* try to read the extension data */
-	pos = RECORD_PAYLOAD_POS+HANDSHAKE_SESSION_ID_POS;
-	SKIP8(pos, buffer_size);
+	memcpy(&addr, &proc->our_addr, proc->our_addr_len);
+	range = config->dtls_port_max - config->dtls_port_min + 1;
 
-	/* Cookie */
-	SKIP8(pos, buffer_size);
+	for (i = 0; i < MIN(range, DTLS_PORT_TRIES); i++) {
+		p = config->dtls_port_min + (s->dtls_port_next % range);
+		s->dtls_port_next++;
 
-	/* CipherSuite */
-	SKIP16(pos, buffer_size);
+		if (family == AF_INET)
+			((struct sockaddr_in *)&addr)->sin_port = htons(p);
+		else
+			((struct sockaddr_in6 *)&addr)->sin6_port = htons(p);
 
-	/* CompressionMethod */
+		if (bind(fd, (struct sockaddr *)&addr, proc->our_addr_len) == 0) {
+			*port = p;
+			return fd;
+		}
 
-	SKIP8(pos, buffer_size);
+		if (errno != EADDRINUSE)
+			break;
+	}
 
-	if (pos+2 > buffer_size)
-		goto fallback;
-	pos+=2;
+	mslog(s, proc, LOG_INFO, "could not bind to a port of dtls-port-range: %s; using the UDP port",
+	      strerror(errno));
+	close(fd);
+	return -1;
+}
 
-	/* Extension(s) */
-	while (pos < buffer_size) {
-		uint16_t type;
-		uint16_t s;
+/* A UDP fd will not be forwarded to worker process before this number of
+ * seconds has passed. That is to prevent a duplicate message messing the worker.
+ */
+#define UDP_FD_RESEND_TIME 3
 
-		if (pos+4 > buffer_size)
-			goto fallback;
+/* Datagrams longer than that on the UDP port are not client hellos */
+#define UDP_BATCH_BUF_SIZE 4096
 
-		type = (buffer[pos] << 8) | buffer[pos+1];
-		pos+=2;
-		if (type != TLS_EXT_APP_ID) {
-			SKIP16(pos, buffer_size);
-		} else { /* found */
-			if (pos+2 > buffer_size)
-				return 0; /* invalid format */
+#ifdef HAVE_RECVMMSG
+typedef struct mmsghdr udp_mmsg_t;
+#else
+typedef struct {
+	struct msghdr msg_hdr;
+	unsigned int msg_len;
+} udp_mmsg_t;
+#endif
 
-			s = (buffer[pos] << 8) | buffer[pos+1];
-			if ((size_t)(pos+2+s) > buffer_size)
-				return 0; /* invalid format */
-			pos+=2;
+struct udp_batch_st {
+	udp_mmsg_t msgs[UDP_BATCH_SIZE];
+	struct iovec iov[UDP_BATCH_SIZE];
+	struct sockaddr_storage cli_addr[UDP_BATCH_SIZE];
+	char cmsg[UDP_BATCH_SIZE][256];
+	uint8_t data[UDP_BATCH_SIZE][UDP_BATCH_BUF_SIZE];
+};
+
+struct hello_verify_ptr_st {
+	int fd;
+	struct sockaddr_storage *cli_addr;
+	socklen_t cli_addr_size;
+	struct sockaddr_storage *our_addr;
+	socklen_t our_addr_size;
+};
+
+static ssize_t hello_verify_push(gnutls_transport_ptr_t ptr, const void *data, size_t size)
+{
+	struct hello_verify_ptr_st *p = ptr;
 
-			s = buffer[pos];
-			if ((size_t)(pos+1+s) > buffer_size)
-				return 0; /* invalid format */
-			pos++;
-			*id_size = s;
-			*id = &buffer[pos];
-			return 1;
-		}
+	return oc_sendto_from(p->fd, data, size, MSG_DONTWAIT,
+			      (struct sockaddr*)p->cli_addr, p->cli_addr_size,
+			      (struct sockaddr*)p->our_addr, p->our_addr_size);
+}
+
+/* Returns non-zero if the datagram from the address exceeds the
+ * udp-port-rate-limit. The counters are kept in a fixed table indexed
+ * by a keyed hash of the address, so that a flood from many addresses
+ * costs no memory; an address colliding with another one only gets
+ * its counter restarted.
+ */
+static unsigned udp_rate_limited(main_server_st *s, struct sockaddr_storage *addr,
+				 socklen_t addr_size, time_t now)
+{
+	unsigned limit = GETCONFIG(s)->udp_port_rate_limit;
+	struct sockaddr_in6 *a6 = (struct sockaddr_in6 *)addr;
+	struct udp_rate_st *e;
+	char tbuf[64];
+	uint32_t key;
+
+	if (limit == 0)
+		return 0;
+
+	if (s->udp_rate == NULL) {
+		s->udp_rate = talloc_zero_array(s, struct udp_rate_st, UDP_RATE_SLOTS);
+		if (s->udp_rate == NULL)
+			return 0;
+	}
+
+	if (addr_size == sizeof(struct sockaddr_in6) && !IN6_IS_ADDR_V4MAPPED(&a6->sin6_addr)) {
+		/* an IPv6 host usually has a whole /64 */
+		key = hash_any(&a6->sin6_addr, 8, s->udp_rate_seed);
+	} else if (addr_size == sizeof(struct sockaddr_in) || addr_size == sizeof(struct sockaddr_in6)) {
+		key = hash_any(SA_IN_P_GENERIC(addr, addr_size), SA_IN_SIZE(addr_size), s->udp_rate_seed);
+	} else {
+		return 0;
+	}
+
+	e = &s->udp_rate[key % UDP_RATE_SLOTS];
+	if (e->key != key || e->time != now) {
+		e->key = key;
+		e->time = now;
+		e->count = 0;
 	}
 
- fallback:
-	/* read session_id */
-	*id_size = buffer[RECORD_PAYLOAD_POS+HANDSHAKE_SESSION_ID_POS];
-	*id = &buffer[RECORD_PAYLOAD_POS+HANDSHAKE_SESSION_ID_POS+1];
+	if (++e->count <= limit)
+		return 0;
 
+	if (e->count == limit + 1)
+		mslog(s, NULL, LOG_DEBUG, "%s: exceeded udp-port-rate-limit; dropping its datagrams",
+		      human_addr((struct sockaddr*)addr, addr_size, tbuf, sizeof(tbuf)));
 	return 1;
 }
 
-/* A UDP fd will not be forwarded to worker process before this number of
- * seconds has passed. That is to prevent a duplicate message messing the worker.
- */
-#define UDP_FD_RESEND_TIME 3
-
-static int forward_udp_to_owner(main_server_st* s, struct listener_st *listener)
+static int forward_udp_to_owner(main_server_st* s, struct listener_st *listener,
+				uint8_t *buf, ssize_t buffer_size,
+				struct sockaddr_storage *cli_addr, socklen_t cli_addr_size,
+				struct sockaddr_storage *our_addr, socklen_t our_addr_size,
+				time_t now)
 {
 int ret, e;
-struct sockaddr_storage cli_addr;
-struct sockaddr_storage our_addr;
 struct proc_st *proc_to_send = NULL;
-socklen_t cli_addr_size, our_addr_size;
 char tbuf[64];
 uint8_t  *session_id = NULL;
 int session_id_size = 0;
-ssize_t buffer_size;
 int match_ip_only = 0;
-time_t now;
 int sfd = -1;
 
-	/* first receive from the correct client and connect socket */
-	cli_addr_size = sizeof(cli_addr);
-	our_addr_size = sizeof(our_addr);
-	ret = oc_recvfrom_at(listener->fd, s->msg_buffer, sizeof(s->msg_buffer), 0,
-			  (struct sockaddr*)&cli_addr, &cli_addr_size,
-			  (struct sockaddr*)&our_addr, &our_addr_size,
-			  GETPCONFIG(s)->udp_port);
-	if (ret < 0) {
-		mslog(s, NULL, LOG_INFO, "error receiving in UDP socket");
-		return -1;
-	}
-	buffer_size = ret;
-
 	if (buffer_size < RECORD_PAYLOAD_POS) {
 		mslog(s, NULL, LOG_INFO, "%s: too short UDP packet",
-		      human_addr((struct sockaddr*)&cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
+		      human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
 		goto fail;
 	}
 
 	/* check version */
-	if (s->msg_buffer[0] == 22) {
+	if (buf[0] == 22) {
 		mslog(s, NULL, LOG_DEBUG, "new DTLS session from %s (record v%u.%u, hello v%u.%u)", 
-			human_addr((struct sockaddr*)&cli_addr, cli_addr_size, tbuf, sizeof(tbuf)),
-			(unsigned int)s->msg_buffer[1], (unsigned int)s->msg_buffer[2],
-			(unsigned int)s->msg_buffer[RECORD_PAYLOAD_POS], (unsigned int)s->msg_buffer[RECORD_PAYLOAD_POS+1]);
+			human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)),
+			(unsigned int)buf[1], (unsigned int)buf[2],
+			(unsigned int)buf[RECORD_PAYLOAD_POS], (unsigned int)buf[RECORD_PAYLOAD_POS+1]);
 	}
 
-	if (s->msg_buffer[1] != 254 && (s->msg_buffer[1] != 1 && s->msg_buffer[2] != 0) &&
-		s->msg_buffer[RECORD_PAYLOAD_POS] != 254 && (s->msg_buffer[RECORD_PAYLOAD_POS] != 0 && s->msg_buffer[RECORD_PAYLOAD_POS+1] != 0)) {
+	if (buf[1] != 254 && (buf[1] != 1 && buf[2] != 0) &&
+		buf[RECORD_PAYLOAD_POS] != 254 && (buf[RECORD_PAYLOAD_POS] != 0 && buf[RECORD_PAYLOAD_POS+1] != 0)) {
 		mslog(s, NULL, LOG_INFO, "%s: unknown DTLS record version: %u.%u", 
-		      human_addr((struct sockaddr*)&cli_addr, cli_addr_size, tbuf, sizeof(tbuf)),
-		      (unsigned)s->msg_buffer[1], (unsigned)s->msg_buffer[2]);
+		      human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)),
+		      (unsigned)buf[1], (unsigned)buf[2]);
 		goto fail;
 	}
 
-	if (s->msg_buffer[0] != 22) {
+	if (buf[0] != 22) {
 		mslog(s, NULL, LOG_DEBUG, "%s: unexpected DTLS content type: %u; possibly a firewall disassociated a UDP session",
-		      human_addr((struct sockaddr*)&cli_addr, cli_addr_size, tbuf, sizeof(tbuf)),
-		      (unsigned int)s->msg_buffer[0]);
+		      human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)),
+		      (unsigned int)buf[0]);
 		/* Here we received a non-client-hello packet. It may be that
 		 * the client's NAT changed its UDP source port and the previous
 		 * connection is invalidated. Try to see if we can simply match
@@ -802,20 +953,18 @@ int sfd = -1;
 		if (GETPCONFIG(s)->unix_conn_file)
 			goto fail;
 	} else {
-		if (!get_session_id(s, s->msg_buffer, buffer_size, &session_id, &session_id_size)) {
+		if (!get_dtls_session_id(buf, buffer_size, GETCONFIG(s)->dtls_psk, &session_id, &session_id_size)) {
 			mslog(s, NULL, LOG_INFO, "%s: too short handshake packet",
-			      human_addr((struct sockaddr*)&cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
+			      human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
 			goto fail;
 		}
 	}
 
 	/* search for the IP and the session ID in all procs */
-	now = time(0);
-
 	if (match_ip_only == 0) {
 		proc_to_send = proc_search_dtls_id(s, session_id, session_id_size);
 	} else {
-		proc_to_send = proc_search_single_ip(s, &cli_addr, cli_addr_size);
+		proc_to_send = proc_search_single_ip(s, cli_addr, cli_addr_size);
 	}
 
 	if (proc_to_send != 0) {
@@ -823,10 +972,50 @@ int sfd = -1;
 
 		if (now - proc_to_send->udp_fd_receive_time <= UDP_FD_RESEND_TIME) {
 			mslog(s, proc_to_send, LOG_DEBUG, "received UDP connection too soon from %s",
-			      human_addr((struct sockaddr*)&cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
+			      human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
 			goto fail;
 		}
 
+		/* Verify that the client can receive at its address before
+		 * passing a socket connected to it. The pre-standard DTLS 0.9
+		 * clients do not support HelloVerifyRequest. */
+		if (match_ip_only == 0 && GETCONFIG(s)->dtls_hello_verify &&
+		    buf[1] == 254) {
+			gnutls_dtls_prestate_st prestate;
+
+			memset(&prestate, 0, sizeof(prestate));
+			ret = gnutls_dtls_cookie_verify(&s->dtls_cookie_key,
+							cli_addr, cli_addr_size,
+							buf, buffer_size, &prestate);
+			if (ret < 0) {
+				struct hello_verify_ptr_st hvp = {
+					.fd = listener->fd,
+					.cli_addr = cli_addr,
+					.cli_addr_size = cli_addr_size,
+					.our_addr = our_addr,
+					.our_addr_size = our_addr_size
+				};
+
+				ret = gnutls_dtls_cookie_send(&s->dtls_cookie_key,
+							      cli_addr, cli_addr_size,
+							      &prestate, &hvp, hello_verify_push);
+				if (ret < 0)
+					mslog(s, proc_to_send, LOG_DEBUG, "could not send DTLS cookie to %s",
+					      human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
+				else
+					mslog(s, proc_to_send, LOG_DEBUG, "sent DTLS cookie to %s",
+					      human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
+				goto fail;
+			}
+
+			msg.has_record_seq = 1;
+			msg.record_seq = prestate.record_seq;
+			msg.has_hsk_read_seq = 1;
+			msg.hsk_read_seq = prestate.hsk_read_seq;
+			msg.has_hsk_write_seq = 1;
+			msg.hsk_write_seq = prestate.hsk_write_seq;
+		}
+
 		sfd = socket(listener->family, SOCK_DGRAM, listener->protocol);
 		if (sfd < 0) {
 			e = errno;
@@ -835,10 +1024,10 @@ int sfd = -1;
 			goto fail;
 		}
 
-		set_worker_udp_opts(s, sfd, listener->family);
+		set_worker_udp_opts(s, sfd, listener->family, 1);
 
 		if (our_addr_size > 0) {
-			ret = bind(sfd, (struct sockaddr *)&our_addr, our_addr_size);
+			ret = bind(sfd, (struct sockaddr *)our_addr, our_addr_size);
 			if (ret == -1) {
 				e = errno;
 				mslog(s, proc_to_send, LOG_INFO, "bind UDP to %s: %s",
@@ -847,11 +1036,11 @@ int sfd = -1;
 			}
 		}
 
-		ret = connect(sfd, (void*)&cli_addr, cli_addr_size);
+		ret = connect(sfd, (void*)cli_addr, cli_addr_size);
 		if (ret == -1) {
 			e = errno;
 			mslog(s, proc_to_send, LOG_ERR, "connect UDP socket from %s: %s",
-			      human_addr((struct sockaddr*)&cli_addr, cli_addr_size, tbuf, sizeof(tbuf)),
+			      human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)),
 			      strerror(e));
 			goto fail;
 		}
@@ -860,10 +1049,10 @@ int sfd = -1;
 			msg.hello = 0; /* by default this is one */
 		} else {
 			/* a new DTLS session, store the DTLS IPs into proc and add it into hash table */
-			proc_table_update_dtls_ip(s, proc_to_send, &cli_addr, cli_addr_size);
+			proc_table_update_dtls_ip(s, proc_to_send, cli_addr, cli_addr_size);
 		}
 
-		msg.data.data = s->msg_buffer;
+		msg.data.data = buf;
 		msg.data.len = buffer_size;
 
 		ret = send_socket_msg_to_worker(s, proc_to_send, CMD_UDP_FD,
@@ -873,11 +1062,11 @@ int sfd = -1;
 			(pack_func)udp_fd_msg__pack);
 		if (ret < 0) {
 			mslog(s, proc_to_send, LOG_ERR, "error passing UDP socket from %s",
-			      human_addr((struct sockaddr*)&cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
+			      human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
 			goto fail;
 		}
 		mslog(s, proc_to_send, LOG_DEBUG, "passed UDP socket from %s",
-		      human_addr((struct sockaddr*)&cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
+		      human_addr((struct sockaddr*)cli_addr, cli_addr_size, tbuf, sizeof(tbuf)));
 		proc_to_send->udp_fd_receive_time = now;
 	}
 
@@ -889,6 +1078,93 @@ fail:
 
 }
 
+/* Reads the datagrams pending on the UDP port, up to UDP_BATCH_SIZE
+ * with a single recvmmsg() where available, and passes each one that
+ * is within the udp-port-rate-limit to forward_udp_to_owner().
+ */
+static void udp_listener_recv(main_server_st *s, struct listener_st *listener)
+{
+	struct udp_batch_st *b = s->udp_batch;
+	struct sockaddr_storage our_addr;
+	socklen_t our_addr_size;
+	char tbuf[64];
+	time_t now;
+	int i, n;
+
+	if (b == NULL) {
+		b = s->udp_batch = talloc_zero(s, struct udp_batch_st);
+		if (b == NULL) {
+			mslog(s, NULL, LOG_ERR, "memory error");
+			return;
+		}
+	}
+
+	for (i = 0; i < UDP_BATCH_SIZE; i++) {
+		struct msghdr *mh = &b->msgs[i].msg_hdr;
+
+		b->iov[i].iov_base = b->data[i];
+		b->iov[i].iov_len = sizeof(b->data[i]);
+		mh->msg_name = &b->cli_addr[i];
+		mh->msg_namelen = sizeof(b->cli_addr[i]);
+		mh->msg_iov = &b->iov[i];
+		mh->msg_iovlen = 1;
+		mh->msg_control = b->cmsg[i];
+		mh->msg_controllen = sizeof(b->cmsg[i]);
+		mh->msg_flags = 0;
+	}
+
+#ifdef HAVE_RECVMMSG
+	do {
+		n = recvmmsg(listener->fd, b->msgs, UDP_BATCH_SIZE, MSG_DONTWAIT, NULL);
+	} while (n == -1 && errno == EINTR);
+#else
+	for (n = 0; n < UDP_BATCH_SIZE; n++) {
+		ssize_t ret;
+
+		do {
+			ret = recvmsg(listener->fd, &b->msgs[n].msg_hdr, MSG_DONTWAIT);
+		} while (ret == -1 && errno == EINTR);
+		if (ret < 0)
+			break;
+		b->msgs[n].msg_len = ret;
+	}
+	if (n == 0)
+		n = -1;
+#endif
+	if (n < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			mslog(s, NULL, LOG_INFO, "error receiving in UDP socket: %s",
+			      strerror(errno));
+		return;
+	}
+
+	now = time(0);
+	for (i = 0; i < n; i++) {
+		struct msghdr *mh = &b->msgs[i].msg_hdr;
+
+		if (udp_rate_limited(s, &b->cli_addr[i], mh->msg_namelen, now))
+			continue;
+
+		if (mh->msg_flags & MSG_TRUNC) {
+			mslog(s, NULL, LOG_DEBUG, "%s: too long UDP packet",
+			      human_addr((struct sockaddr*)&b->cli_addr[i], mh->msg_namelen, tbuf, sizeof(tbuf)));
+			continue;
+		}
+
+		memset(&our_addr, 0, sizeof(our_addr));
+		our_addr_size = sizeof(our_addr);
+		if (oc_msghdr_our_addr(mh, (struct sockaddr*)&our_addr, &our_addr_size,
+				       GETPCONFIG(s)->udp_port) < 0)
+			continue;
+		if (our_addr.ss_family == AF_UNSPEC)
+			our_addr_size = 0;
+
+		forward_udp_to_owner(s, listener, b->data[i], b->msgs[i].msg_len,
+				     &b->cli_addr[i], mh->msg_namelen,
+				     &our_addr, our_addr_size, now);
+	}
+}
+
 #ifdef HAVE_LIBWRAP
 static int check_tcp_wrapper(int fd)
 {
@@ -967,9 +1243,60 @@ static void worker_child_watcher_cb(struct ev_loop *loop, ev_child *w, int reven
 	ev_child_stop(loop, w);
 }
 
+static void idle_worker_remove(main_server_st *s, struct idle_worker_st *iw)
+{
+	close(iw->fd);
+	list_del(&iw->list);
+	ev_child_stop(loop, &iw->ev_child);
+	talloc_free(iw);
+	s->idle_worker_list.total--;
+}
+
+static void idle_worker_child_watcher_cb(struct ev_loop *loop, ev_child *w, int revents)
+{
+	main_server_st *s = ev_userdata(loop);
+	struct idle_worker_st *iw = (struct idle_worker_st *)w;
+
+	if (WIFSIGNALED(w->rstatus))
+		mslog(s, NULL, LOG_ERR, "idle worker %u died with signal %d\n",
+		      (unsigned)w->pid, (int)WTERMSIG(w->rstatus));
+
+	idle_worker_remove(s, iw);
+
+	if (s->idle_worker_list.total < GETCONFIG(s)->worker_pool_size)
+		ev_idle_start(loop, &worker_pool_watcher);
+}
+
+/* Closes the command sockets of the pre-forked workers, which exit
+ * once they notice. They were forked with the configuration and the
+ * credentials of that time, so they are replaced after a reload. */
+static void idle_workers_flush(main_server_st *s)
+{
+	struct idle_worker_st *iw = NULL, *pos;
+
+	list_for_each_safe(&s->idle_worker_list.head, iw, pos, list) {
+		idle_worker_remove(s, iw);
+	}
+}
+
 static void kill_children(main_server_st* s)
 {
 	struct proc_st *ctmp = NULL, *cpos;
+	struct idle_worker_st *iw = NULL, *ipos;
+	struct acceptor_st *a;
+
+	list_for_each_safe(&s->idle_worker_list.head, iw, ipos, list) {
+		kill(iw->pid, SIGTERM);
+		idle_worker_remove(s, iw);
+	}
+
+	list_for_each(&s->acceptor_list.head, a, list) {
+		/* do not restart it */
+		ev_child_stop(loop, &a->ev_child);
+		ev_timer_stop(loop, &a->restart);
+		if (a->pid != -1)
+			kill(a->pid, SIGTERM);
+	}
 
 	/* kill the security module server */
 	list_for_each_safe(&s->proc_list.head, ctmp, cpos, list) {
@@ -984,11 +1311,16 @@ static void term_sig_watcher_cb(struct ev_loop *loop, ev_signal *w, int revents)
 {
 	main_server_st *s = ev_userdata(loop);
 	unsigned total = 10;
+	pid_t pid;
 
 	mslog(s, NULL, LOG_INFO, "termination request received; waiting for children to die");
 	kill_children(s);
 
-	while (waitpid(-1, NULL, WNOHANG) >= 0) {
+	while ((pid = waitpid(-1, NULL, WNOHANG)) >= 0) {
+		/* collect all the children which exited before sleeping */
+		if (pid > 0)
+			continue;
+
 		if (total == 0) {
 			mslog(s, NULL, LOG_INFO, "not everyone died; forcing kill");
 			kill(0, SIGKILL);
@@ -1018,6 +1350,10 @@ static void reload_sig_watcher_cb(struct ev_loop *loop, ev_signal *w, int revent
 	}
 
 	reload_cfg_file(s->config_pool, s->vconfig, 0);
+
+	idle_workers_flush(s);
+	if (GETCONFIG(s)->worker_pool_size > 0)
+		ev_idle_start(loop, &worker_pool_watcher);
 }
 
 static void cmd_watcher_cb (EV_P_ ev_io *w, int revents)
@@ -1033,15 +1369,494 @@ static void cmd_watcher_cb (EV_P_ ev_io *w, int revents)
 	}
 }
 
-static void listen_watcher_cb (EV_P_ ev_io *w, int revents)
+/* Prepares a newly forked worker process. It closes any open
+ * descriptors, and erases sensitive data before running the
+ * worker. Only ws is left of the main process' state.
+ */
+static void worker_child_init(main_server_st *s, struct worker_st *ws, int cmd_fd)
+{
+	sigprocmask(SIG_SETMASK, &sig_default_set, NULL);
+	clear_lists(s);
+	if (s->top_fd != -1) close(s->top_fd);
+	close(s->sec_mod_fd);
+	close(s->sec_mod_fd_sync);
+
+	setproctitle(PACKAGE_NAME"-worker");
+	kill_on_parent_kill(SIGTERM);
+
+	/* write sec-mod's address */
+	memcpy(&ws->secmod_addr, &s->secmod_addr, s->secmod_addr_len);
+	ws->secmod_addr_len = s->secmod_addr_len;
+	ws->secmod_fd = -1;
+
+	ws->main_pool = s->main_pool;
+
+	ws->vconfig = s->vconfig;
+
+	ws->cmd_fd = cmd_fd;
+	ws->tun_fd = -1;
+	ws->dtls_tptr.fd = -1;
+	ws->udp_port_fd = -1;
+
+#ifdef ENABLE_WORKER_THREADS
+	/* the thread cannot be created once the privileges are dropped */
+	if (GETCONFIG(s)->worker_tx_thread &&
+	    worker_tx_thread_init(ws) < 0)
+		mslog(s, NULL, LOG_ERR, "could not create the transmit thread of the worker");
+#endif
+
+	/* Drop privileges after this point */
+	drop_privileges(s);
+
+	/* creds and config are not allocated
+	 * under s.
+	 */
+	talloc_free(s);
+#ifdef HAVE_MALLOC_TRIM
+	/* try to return all the pages we've freed to
+	 * the operating system, to prevent the child from
+	 * accessing them. That's totally unreliable, so
+	 * sensitive data have to be overwritten anyway. */
+	malloc_trim(0);
+#endif
+}
+
+/* Forks a worker which waits for a connection, and adds it to
+ * the pool of idle workers. */
+static int idle_worker_fork(main_server_st *s)
+{
+	struct worker_st *ws = s->ws;
+	struct idle_worker_st *iw;
+	int cmd_fd[2];
+	pid_t pid;
+	int ret;
+
+	iw = talloc_zero(s, struct idle_worker_st);
+	if (iw == NULL)
+		return -1;
+
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, cmd_fd);
+	if (ret < 0) {
+		mslog(s, NULL, LOG_ERR, "error creating command socket");
+		talloc_free(iw);
+		return -1;
+	}
+
+	pid = fork();
+	if (pid == 0) {	/* child */
+		close(cmd_fd[0]);
+		worker_child_init(s, ws, cmd_fd[1]);
+		vpn_server_wait(ws);
+		exit(0);
+	} else if (pid == -1) {
+		mslog(s, NULL, LOG_ERR, "fork failed");
+		close(cmd_fd[0]);
+		close(cmd_fd[1]);
+		talloc_free(iw);
+		return -1;
+	}
+
+	close(cmd_fd[1]);
+	set_cloexec_flag(cmd_fd[0], 1);
+
+	iw->pid = pid;
+	iw->fd = cmd_fd[0];
+	list_add_tail(&s->idle_worker_list.head, &iw->list);
+	s->idle_worker_list.total++;
+
+	ev_child_init(&iw->ev_child, idle_worker_child_watcher_cb, pid, 0);
+	ev_child_start(loop, &iw->ev_child);
+
+	return 0;
+}
+
+/* Refills the pool of idle workers, one at a time, when there
+ * are no other events to process. */
+static void worker_pool_watcher_cb(EV_P_ ev_idle *w, int revents)
 {
 	main_server_st *s = ev_userdata(loop);
-	struct listener_st *ltmp = (struct listener_st *)w;
-	struct proc_st *ctmp = NULL;
+
+	if (s->idle_worker_list.total >= GETCONFIG(s)->worker_pool_size ||
+	    idle_worker_fork(s) < 0)
+		ev_idle_stop(loop, w);
+}
+
+/* Passes an accepted connection to an idle worker. Returns the new
+ * proc entry, or NULL if there is no idle worker which can take it. */
+static struct proc_st *idle_worker_start(main_server_st *s, int fd,
+					 sock_type_t stype, uint64_t accept_time)
+{
 	struct worker_st *ws = s->ws;
-	int fd, ret;
+	struct idle_worker_st *iw;
+	struct proc_st *ctmp;
+	WorkerStartMsg msg = WORKER_START_MSG__INIT;
+	int ret;
+
+	msg.remote_addr.data = (uint8_t *)&ws->remote_addr;
+	msg.remote_addr.len = ws->remote_addr_len;
+	msg.our_addr.data = (uint8_t *)&ws->our_addr;
+	msg.our_addr.len = ws->our_addr_len;
+	msg.sock_type = stype;
+	msg.accept_time = accept_time;
+
+	while ((iw = list_top(&s->idle_worker_list.head, struct idle_worker_st, list)) != NULL) {
+		ret = send_socket_msg(s, iw->fd, CMD_WORKER_START, fd, &msg,
+				      (pack_size_func) worker_start_msg__get_packed_size,
+				      (pack_func) worker_start_msg__pack);
+		if (ret < 0) {
+			/* it may have died in the meantime */
+			mslog(s, NULL, LOG_INFO, "could not pass connection to idle worker %u",
+			      (unsigned)iw->pid);
+			kill(iw->pid, SIGTERM);
+			idle_worker_remove(s, iw);
+			continue;
+		}
+
+		ctmp = new_proc(s, iw->pid, iw->fd,
+				&ws->remote_addr, ws->remote_addr_len,
+				&ws->our_addr, ws->our_addr_len,
+				ws->sid, sizeof(ws->sid));
+		if (ctmp == NULL) {
+			kill(iw->pid, SIGTERM);
+			idle_worker_remove(s, iw);
+			return NULL;
+		}
+
+		/* the command socket now belongs to the proc entry */
+		ev_child_stop(loop, &iw->ev_child);
+		list_del(&iw->list);
+		talloc_free(iw);
+		s->idle_worker_list.total--;
+
+		ev_io_init(&ctmp->io, cmd_watcher_cb, ctmp->fd, EV_READ);
+		ev_io_start(loop, &ctmp->io);
+
+		ev_child_init(&ctmp->ev_child, worker_child_watcher_cb, ctmp->pid, 0);
+		ev_child_start(loop, &ctmp->ev_child);
+
+		ev_idle_start(loop, &worker_pool_watcher);
+		return ctmp;
+	}
+
+	return NULL;
+}
+
+/* Starts a worker for the accepted connection fd; the addresses of
+ * the connection are read from s->ws. The caller closes fd. */
+static void worker_start(main_server_st *s, int fd, sock_type_t stype,
+			 uint64_t accept_time)
+{
+	struct worker_st *ws = s->ws;
+	struct proc_st *ctmp = NULL;
 	int cmd_fd[2];
 	pid_t pid;
+	int ret;
+
+	/* pass it to a pre-forked worker if there is one */
+	ctmp = idle_worker_start(s, fd, stype, accept_time);
+	if (ctmp != NULL)
+		return;
+
+	/* Create a command socket */
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, cmd_fd);
+	if (ret < 0) {
+		mslog(s, NULL, LOG_ERR, "error creating command socket");
+		return;
+	}
+
+	pid = fork();
+	if (pid == 0) {	/* child */
+		close(cmd_fd[0]);
+		ws->conn_fd = fd;
+		ws->conn_type = stype;
+		ws->accept_time = accept_time;
+
+		worker_child_init(s, ws, cmd_fd[1]);
+		vpn_server(ws);
+		exit(0);
+	} else if (pid == -1) {
+fork_failed:
+		mslog(s, NULL, LOG_ERR, "fork failed");
+		close(cmd_fd[0]);
+	} else { /* parent */
+		/* add_proc */
+		ctmp = new_proc(s, pid, cmd_fd[0], 
+				&ws->remote_addr, ws->remote_addr_len,
+				&ws->our_addr, ws->our_addr_len,
+				ws->sid, sizeof(ws->sid));
+		if (ctmp == NULL) {
+			kill(pid, SIGTERM);
+			goto fork_failed;
+		}
+
+		ev_io_init(&ctmp->io, cmd_watcher_cb, cmd_fd[0], EV_READ);
+		ev_io_start(loop, &ctmp->io);
+
+		ev_child_init(&ctmp->ev_child, worker_child_watcher_cb, pid, 0);
+		ev_child_start(loop, &ctmp->ev_child);
+	}
+	close(cmd_fd[1]);
+}
+
+static void pending_conn_remove(main_server_st *s, struct pending_conn_st *pc)
+{
+	ev_io_stop(loop, &pc->io);
+	ev_timer_stop(loop, &pc->timer);
+	list_del(&pc->list);
+	s->pending_conn_list.total--;
+}
+
+static void pending_conn_close(main_server_st *s, struct pending_conn_st *pc)
+{
+	pending_conn_remove(s, pc);
+	close(pc->fd);
+	talloc_free(pc);
+}
+
+static void pending_conn_drop(main_server_st *s, struct pending_conn_st *pc,
+			      const char *reason)
+{
+	char buf[MAX_IP_STR];
+
+	mslog(s, NULL, LOG_DEBUG, "closing connection from %s: %s",
+	      human_addr2((struct sockaddr *)&pc->remote_addr, pc->remote_addr_len,
+			  buf, sizeof(buf), 0), reason);
+	s->stats.no_hello_conns++;
+	pending_conn_close(s, pc);
+}
+
+static void pending_conn_timer_cb(EV_P_ ev_timer *w, int revents)
+{
+	main_server_st *s = ev_userdata(loop);
+	struct pending_conn_st *pc = container_of(w, struct pending_conn_st, timer);
+
+	pending_conn_drop(s, pc, "timed out waiting for the TLS client hello");
+}
+
+static void pending_conn_io_cb(EV_P_ ev_io *w, int revents)
+{
+	main_server_st *s = ev_userdata(loop);
+	struct pending_conn_st *pc = (struct pending_conn_st *)w;
+	struct worker_st *ws = s->ws;
+	uint8_t c;
+	int ret;
+
+	ret = recv(pc->fd, &c, 1, MSG_PEEK|MSG_DONTWAIT);
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return;
+
+	if (ret <= 0) {
+		pending_conn_drop(s, pc, "closed before the TLS client hello");
+		return;
+	}
+
+	/* a TLS handshake record, or an SSLv2 compatible client hello */
+	if (c != 0x16 && (c & 0x80) == 0) {
+		pending_conn_drop(s, pc, "not a TLS client hello");
+		return;
+	}
+
+	memcpy(&ws->remote_addr, &pc->remote_addr, pc->remote_addr_len);
+	ws->remote_addr_len = pc->remote_addr_len;
+	memcpy(&ws->our_addr, &pc->our_addr, pc->our_addr_len);
+	ws->our_addr_len = pc->our_addr_len;
+
+	/* remove it first, so that a forked worker does not close it in clear_lists() */
+	pending_conn_remove(s, pc);
+	worker_start(s, pc->fd, SOCK_TYPE_TCP, pc->accept_time);
+	close(pc->fd);
+	talloc_free(pc);
+}
+
+/* Keeps the accepted connection in main until the client sends its
+ * TLS hello, so that connections which never start a handshake do
+ * not cost a worker. */
+static void pending_conn_add(main_server_st *s, int fd, uint64_t accept_time)
+{
+	struct worker_st *ws = s->ws;
+	struct pending_conn_st *pc;
+
+	if (s->pending_conn_list.total >= MAX_PENDING_CONNS) {
+		pc = list_top(&s->pending_conn_list.head, struct pending_conn_st, list);
+		pending_conn_drop(s, pc, "too many connections waiting for the TLS client hello");
+	}
+
+	pc = talloc_zero(s, struct pending_conn_st);
+	if (pc == NULL) {
+		close(fd);
+		return;
+	}
+
+	pc->fd = fd;
+	pc->accept_time = accept_time;
+	memcpy(&pc->remote_addr, &ws->remote_addr, ws->remote_addr_len);
+	pc->remote_addr_len = ws->remote_addr_len;
+	memcpy(&pc->our_addr, &ws->our_addr, ws->our_addr_len);
+	pc->our_addr_len = ws->our_addr_len;
+
+	list_add_tail(&s->pending_conn_list.head, &pc->list);
+	s->pending_conn_list.total++;
+
+	ev_io_init(&pc->io, pending_conn_io_cb, fd, EV_READ);
+	ev_io_start(loop, &pc->io);
+
+	ev_timer_init(&pc->timer, pending_conn_timer_cb,
+		      GETCONFIG(s)->client_hello_timeout, 0);
+	ev_timer_start(loop, &pc->timer);
+}
+
+/* Stops accepting connections for the given time. In the meantime
+ * new connections wait in the listen queue, while main keeps serving
+ * its other events. */
+static void pause_listeners(main_server_st *s, uint64_t wait_us)
+{
+	struct listener_st *ltmp;
+	struct acceptor_st *a;
+
+	list_for_each(&s->listen_list.head, ltmp, list) {
+		if (ltmp->fd == -1 || ltmp->sock_type == SOCK_TYPE_UDP)
+			continue;
+		ev_io_stop(loop, &ltmp->io);
+	}
+
+	list_for_each(&s->acceptor_list.head, a, list) {
+		ev_io_stop(loop, &a->io);
+	}
+
+	ev_timer_stop(loop, &admission_watcher);
+	ev_timer_set(&admission_watcher, (ev_tstamp)wait_us / 1000000, 0);
+	ev_timer_start(loop, &admission_watcher);
+}
+
+static void admission_watcher_cb(EV_P_ ev_timer *w, int revents)
+{
+	main_server_st *s = ev_userdata(loop);
+	struct listener_st *ltmp;
+	struct acceptor_st *a;
+
+	list_for_each(&s->listen_list.head, ltmp, list) {
+		if (ltmp->fd == -1 || ltmp->sock_type == SOCK_TYPE_UDP ||
+		    ltmp->shard >= 0)
+			continue;
+		ev_io_start(loop, &ltmp->io);
+	}
+
+	list_for_each(&s->acceptor_list.head, a, list) {
+		if (a->fd != -1)
+			ev_io_start(loop, &a->io);
+	}
+}
+
+/* Returns the number of connections waiting in the listen queues
+ * of the TCP ports. */
+unsigned listen_backlog(main_server_st *s)
+{
+	unsigned backlog = 0;
+#if defined(__linux__) && defined(TCP_INFO)
+	struct listener_st *ltmp;
+	struct tcp_info ti;
+	socklen_t ti_size;
+
+	list_for_each(&s->listen_list.head, ltmp, list) {
+		if (ltmp->fd == -1 || ltmp->sock_type != SOCK_TYPE_TCP)
+			continue;
+
+		/* on a listening socket it holds the accept queue length */
+		ti_size = sizeof(ti);
+		if (getsockopt(ltmp->fd, IPPROTO_TCP, TCP_INFO, &ti, &ti_size) == 0)
+			backlog += ti.tcpi_unacked;
+	}
+#endif
+	return backlog;
+}
+
+/* Admits a connection accepted by main or by an acceptor, whose
+ * remote address is in s->ws, and starts a worker for it. */
+static void conn_accepted(main_server_st *s, int fd, int stype, uint64_t accept_time)
+{
+	struct worker_st *ws = s->ws;
+
+	if (GETCONFIG(s)->rate_limit_ms > 0) {
+		uint64_t interval = (uint64_t)GETCONFIG(s)->rate_limit_ms * 1000;
+		uint64_t wait;
+
+		admission_take(&s->admission.global, interval,
+			       GETCONFIG(s)->rate_limit_burst, accept_time);
+		wait = admission_wait(&s->admission.global, interval,
+				      GETCONFIG(s)->rate_limit_burst, accept_time);
+		if (wait > 0)
+			pause_listeners(s, wait);
+	}
+
+	if (GETCONFIG(s)->max_clients > 0 && s->stats.active_clients >= GETCONFIG(s)->max_clients) {
+		close(fd);
+		s->stats.conns_max_clients++;
+		mslog(s, NULL, LOG_INFO, "reached maximum client limit (active: %u)", s->stats.active_clients);
+		return;
+	}
+
+	if (GETCONFIG(s)->load_shedding_threshold > 0) {
+		uint32_t rnd = 0;
+
+		gnutls_rnd(GNUTLS_RND_NONCE, &rnd, sizeof(rnd));
+		if (admission_shed(s->stats.active_clients, GETCONFIG(s)->max_clients,
+				   GETCONFIG(s)->load_shedding_threshold, rnd)) {
+			close(fd);
+			s->stats.conns_shed++;
+			mslog(s, NULL, LOG_INFO, "shedding load; rejected connection (active: %u)", s->stats.active_clients);
+			return;
+		}
+	}
+
+	if (check_tcp_wrapper(fd) < 0) {
+		close(fd);
+		mslog(s, NULL, LOG_INFO, "TCP wrappers rejected the connection (see /etc/hosts->[allow|deny])");
+		return;
+	}
+
+	if (ws->conn_type != SOCK_TYPE_UNIX && !GETCONFIG(s)->listen_proxy_proto) {
+		memset(&ws->our_addr, 0, sizeof(ws->our_addr));
+		ws->our_addr_len = sizeof(ws->our_addr);
+		if (getsockname(fd, (struct sockaddr*)&ws->our_addr, &ws->our_addr_len) < 0)
+			ws->our_addr_len = 0;
+
+		if (check_if_banned(s, &ws->remote_addr, ws->remote_addr_len) != 0) {
+			close(fd);
+			return;
+		}
+
+		if (GETCONFIG(s)->net_rate_limit_ms > 0 &&
+		    !admission_take_net(&s->admission, &ws->remote_addr, ws->remote_addr_len,
+					(uint64_t)GETCONFIG(s)->net_rate_limit_ms * 1000,
+					GETCONFIG(s)->net_rate_limit_burst, accept_time)) {
+			char tbuf[64];
+
+			close(fd);
+			s->stats.conns_rate_limited++;
+			mslog(s, NULL, LOG_INFO, "%s: reached net-rate-limit-ms; rejected connection",
+			      human_addr((struct sockaddr*)&ws->remote_addr, ws->remote_addr_len, tbuf, sizeof(tbuf)));
+			return;
+		}
+	}
+
+	/* with the proxy protocol the first bytes are the proxy header */
+	if (stype == SOCK_TYPE_TCP && GETCONFIG(s)->client_hello_timeout > 0 &&
+	    !GETCONFIG(s)->listen_proxy_proto) {
+		pending_conn_add(s, fd, accept_time);
+		return;
+	}
+
+	worker_start(s, fd, stype, accept_time);
+	close(fd);
+}
+
+static void listen_watcher_cb (EV_P_ ev_io *w, int revents)
+{
+	main_server_st *s = ev_userdata(loop);
+	struct listener_st *ltmp = (struct listener_st *)w;
+	struct worker_st *ws = s->ws;
+	int fd;
+	uint64_t accept_time;
 
 	if (ltmp->sock_type == SOCK_TYPE_TCP || ltmp->sock_type == SOCK_TYPE_UNIX) {
 		/* connection on TCP port */
@@ -1054,119 +1869,324 @@ static void listen_watcher_cb (EV_P_ ev_io *w, int revents)
 			       "error in accept(): %s", strerror(errno));
 			return;
 		}
+		accept_time = gettime_mono_us();
 		set_cloexec_flag (fd, 1);
 #ifndef __linux__
 		/* OpenBSD sets the non-blocking flag if accept's fd is non-blocking */
 		set_block(fd);
 #endif
 
-		if (GETCONFIG(s)->max_clients > 0 && s->stats.active_clients >= GETCONFIG(s)->max_clients) {
-			close(fd);
-			mslog(s, NULL, LOG_INFO, "reached maximum client limit (active: %u)", s->stats.active_clients);
-			return;
+		conn_accepted(s, fd, stype, accept_time);
+	} else if (ltmp->sock_type == SOCK_TYPE_UDP) {
+		/* datagrams on UDP port */
+		udp_listener_recv(s, ltmp);
+	}
+}
+
+/* Pins an acceptor to the CPUs whose connections listen-shard-by-cpu
+ * steers to its shard, so that they are accepted where they arrived. */
+static void acceptor_set_affinity(unsigned shard, unsigned shards)
+{
+#if defined(__linux__) && defined(CPU_SET)
+	cpu_set_t set, cur;
+	unsigned i, n = 0;
+
+	if (sched_getaffinity(0, sizeof(cur), &cur) < 0)
+		return;
+
+	CPU_ZERO(&set);
+	for (i = shard; i < CPU_SETSIZE; i += shards) {
+		if (CPU_ISSET(i, &cur)) {
+			CPU_SET(i, &set);
+			n++;
 		}
+	}
 
-		if (check_tcp_wrapper(fd) < 0) {
-			close(fd);
-			mslog(s, NULL, LOG_INFO, "TCP wrappers rejected the connection (see /etc/hosts->[allow|deny])");
-			return;
+	if (n > 0 && sched_setaffinity(0, sizeof(set), &set) < 0)
+		mslog(NULL, NULL, LOG_INFO, "could not set the CPU affinity of acceptor %u", shard);
+#endif
+}
+
+/* The loop of an acceptor process. It accepts the connections of its
+ * listeners and passes them to main. The sends block while main does
+ * not read, e.g., when it pauses the listeners, and the connections
+ * then wait in the listen queues. It exits when main closes cmd_fd. */
+static void acceptor_run(int cmd_fd, int *fds, unsigned nfds)
+{
+	WorkerStartMsg msg = WORKER_START_MSG__INIT;
+	struct sockaddr_storage remote_addr;
+	socklen_t remote_addr_len;
+	struct pollfd *pfd;
+	unsigned i;
+	int fd, ret, e;
+	void *pool;
+
+	pool = talloc_named(NULL, 0, "acceptor");
+	pfd = talloc_array(pool, struct pollfd, nfds + 1);
+	if (pfd == NULL)
+		exit(1);
+
+	for (i = 0; i < nfds; i++) {
+		pfd[i].fd = fds[i];
+		pfd[i].events = POLLIN;
+	}
+	pfd[nfds].fd = cmd_fd;
+	pfd[nfds].events = POLLIN;
+
+	msg.sock_type = SOCK_TYPE_TCP;
+
+	for (;;) {
+		ret = poll(pfd, nfds + 1, -1);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			exit(1);
 		}
 
-		if (ws->conn_type != SOCK_TYPE_UNIX && !GETCONFIG(s)->listen_proxy_proto) {
-			memset(&ws->our_addr, 0, sizeof(ws->our_addr));
-			ws->our_addr_len = sizeof(ws->our_addr);
-			if (getsockname(fd, (struct sockaddr*)&ws->our_addr, &ws->our_addr_len) < 0)
-				ws->our_addr_len = 0;
+		/* main never writes to us */
+		if (pfd[nfds].revents != 0)
+			exit(0);
+
+		for (i = 0; i < nfds; i++) {
+			if (!(pfd[i].revents & POLLIN))
+				continue;
 
-			if (check_if_banned(s, &ws->remote_addr, ws->remote_addr_len) != 0) {
-				close(fd);
-				return;
+			remote_addr_len = sizeof(remote_addr);
+			fd = accept(pfd[i].fd, (void*)&remote_addr, &remote_addr_len);
+			if (fd < 0) {
+				e = errno;
+				if (e != EAGAIN && e != EINTR && e != ECONNABORTED)
+					mslog(NULL, NULL, LOG_ERR,
+					      "error in accept(): %s", strerror(e));
+				continue;
 			}
-		}
+#ifndef __linux__
+			set_block(fd);
+#endif
 
-		/* Create a command socket */
-		ret = socketpair(AF_UNIX, SOCK_STREAM, 0, cmd_fd);
-		if (ret < 0) {
-			mslog(s, NULL, LOG_ERR, "error creating command socket");
+			msg.accept_time = gettime_mono_us();
+			msg.remote_addr.data = (void*)&remote_addr;
+			msg.remote_addr.len = remote_addr_len;
+
+			ret = send_socket_msg(pool, cmd_fd, CMD_ACCEPTED_CONN, fd, &msg,
+					      (pack_size_func) worker_start_msg__get_packed_size,
+					      (pack_func) worker_start_msg__pack);
 			close(fd);
-			return;
+			if (ret < 0)
+				exit(1);
 		}
+	}
+}
+
+/* Prepares a newly forked acceptor process, as worker_child_init()
+ * does for a worker; only the listeners of its shard are kept. */
+static void acceptor_child_init(main_server_st *s, unsigned shard, int cmd_fd)
+{
+	struct listener_st *ltmp = NULL, *lpos;
+	unsigned shards = GETCONFIG(s)->listen_shards;
+	unsigned by_cpu = GETCONFIG(s)->listen_shard_by_cpu;
+	unsigned nfds = 0;
+	int *fds;
+
+	sigprocmask(SIG_SETMASK, &sig_default_set, NULL);
+	ocsignal(SIGTERM, SIG_DFL);
+	ocsignal(SIGINT, SIG_DFL);
+	ocsignal(SIGHUP, SIG_IGN);
+	ocsignal(SIGUSR2, SIG_IGN);
+
+	fds = talloc_array(NULL, int, s->listen_list.total);
+	if (fds == NULL)
+		exit(1);
 
-		pid = fork();
-		if (pid == 0) {	/* child */
-			/* close any open descriptors, and erase
-			 * sensitive data before running the worker
-			 */
-			sigprocmask(SIG_SETMASK, &sig_default_set, NULL);
-			close(cmd_fd[0]);
-			clear_lists(s);
-			if (s->top_fd != -1) close(s->top_fd);
-			close(s->sec_mod_fd);
-			close(s->sec_mod_fd_sync);
-
-			setproctitle(PACKAGE_NAME"-worker");
-			kill_on_parent_kill(SIGTERM);
-
-			/* write sec-mod's address */
-			memcpy(&ws->secmod_addr, &s->secmod_addr, s->secmod_addr_len);
-			ws->secmod_addr_len = s->secmod_addr_len;
-
-			ws->main_pool = s->main_pool;
-
-			ws->vconfig = s->vconfig;
-
-			ws->cmd_fd = cmd_fd[1];
-			ws->tun_fd = -1;
-			ws->dtls_tptr.fd = -1;
-			ws->conn_fd = fd;
-			ws->conn_type = stype;
-
-			/* Drop privileges after this point */
-			drop_privileges(s);
-
-			/* creds and config are not allocated
-			 * under s.
-			 */
-			talloc_free(s);
+	list_for_each_safe(&s->listen_list.head, ltmp, lpos, list) {
+		if (ltmp->fd == -1 || ltmp->shard != (int)shard)
+			continue;
+		fds[nfds++] = ltmp->fd;
+		/* keep it out of clear_lists() */
+		list_del(&ltmp->list);
+		talloc_free(ltmp);
+		s->listen_list.total--;
+	}
+
+	clear_lists(s);
+	if (s->top_fd != -1) close(s->top_fd);
+	close(s->sec_mod_fd);
+	close(s->sec_mod_fd_sync);
+
+	setproctitle(PACKAGE_NAME"-acceptor");
+	kill_on_parent_kill(SIGTERM);
+
+	if (by_cpu)
+		acceptor_set_affinity(shard, shards);
+
+	drop_privileges(s);
+
+	talloc_free(s);
 #ifdef HAVE_MALLOC_TRIM
-			/* try to return all the pages we've freed to
-			 * the operating system, to prevent the child from
-			 * accessing them. That's totally unreliable, so
-			 * sensitive data have to be overwritten anyway. */
-			malloc_trim(0);
+	malloc_trim(0);
 #endif
-			vpn_server(ws);
-			exit(0);
-		} else if (pid == -1) {
-fork_failed:
-			mslog(s, NULL, LOG_ERR, "fork failed");
-			close(cmd_fd[0]);
-		} else { /* parent */
-			/* add_proc */
-			ctmp = new_proc(s, pid, cmd_fd[0], 
-					&ws->remote_addr, ws->remote_addr_len,
-					&ws->our_addr, ws->our_addr_len,
-					ws->sid, sizeof(ws->sid));
-			if (ctmp == NULL) {
-				kill(pid, SIGTERM);
-				goto fork_failed;
-			}
 
-			ev_io_init(&ctmp->io, cmd_watcher_cb, cmd_fd[0], EV_READ);
-			ev_io_start(loop, &ctmp->io);
+	acceptor_run(cmd_fd, fds, nfds);
+}
+
+static void acceptor_child_watcher_cb(struct ev_loop *loop, ev_child *w, int revents);
+static void acceptor_watcher_cb(EV_P_ ev_io *w, int revents);
 
-			ev_child_init(&ctmp->ev_child, worker_child_watcher_cb, pid, 0);
-			ev_child_start(loop, &ctmp->ev_child);
-		}
+/* Forks the acceptor of a shard. Returns -1 on error, in which case
+ * the caller retries later. */
+static int acceptor_fork(main_server_st *s, struct acceptor_st *a)
+{
+	int cmd_fd[2];
+	int y = 1;
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, cmd_fd) < 0) {
+		mslog(s, NULL, LOG_ERR, "error creating command socket");
+		return -1;
+	}
+
+	/* only queue a few connections when main does not read */
+	setsockopt(cmd_fd[1], SOL_SOCKET, SO_SNDBUF, &y, sizeof(y));
+
+	pid = fork();
+	if (pid == 0) {	/* child */
+		close(cmd_fd[0]);
+		acceptor_child_init(s, a->shard, cmd_fd[1]);
+		exit(0);
+	} else if (pid == -1) {
+		mslog(s, NULL, LOG_ERR, "fork failed");
+		close(cmd_fd[0]);
 		close(cmd_fd[1]);
-		close(fd);
-	} else if (ltmp->sock_type == SOCK_TYPE_UDP) {
-		/* connection on UDP port */
-		forward_udp_to_owner(s, ltmp);
+		return -1;
+	}
+
+	close(cmd_fd[1]);
+	set_cloexec_flag(cmd_fd[0], 1);
+
+	a->pid = pid;
+	a->fd = cmd_fd[0];
+
+	ev_io_init(&a->io, acceptor_watcher_cb, a->fd, EV_READ);
+	/* unless the listeners are paused */
+	if (!ev_is_active(&admission_watcher))
+		ev_io_start(loop, &a->io);
+
+	ev_child_init(&a->ev_child, acceptor_child_watcher_cb, pid, 0);
+	ev_child_start(loop, &a->ev_child);
+
+	return 0;
+}
+
+static void acceptor_restart_cb(EV_P_ ev_timer *w, int revents)
+{
+	main_server_st *s = ev_userdata(loop);
+	struct acceptor_st *a = container_of(w, struct acceptor_st, restart);
+
+	if (acceptor_fork(s, a) < 0)
+		ev_timer_start(loop, w);
+}
+
+/* Closes the acceptor's side of main, and restarts it after a second.
+ * Its connections wait in the listen queues in the meantime. */
+static void acceptor_remove(main_server_st *s, struct acceptor_st *a)
+{
+	ev_io_stop(loop, &a->io);
+	if (a->fd != -1) {
+		close(a->fd);
+		a->fd = -1;
+	}
+
+	ev_timer_set(&a->restart, 1, 0);
+	ev_timer_start(loop, &a->restart);
+}
+
+static void acceptor_child_watcher_cb(struct ev_loop *loop, ev_child *w, int revents)
+{
+	main_server_st *s = ev_userdata(loop);
+	struct acceptor_st *a = container_of(w, struct acceptor_st, ev_child);
+
+	if (WIFSIGNALED(w->rstatus))
+		mslog(s, NULL, LOG_ERR, "acceptor %u (PID %u) died by signal %d",
+		      a->shard, (unsigned)w->rpid, (int)WTERMSIG(w->rstatus));
+	else
+		mslog(s, NULL, LOG_ERR, "acceptor %u (PID %u) exited with status %d",
+		      a->shard, (unsigned)w->rpid, (int)WEXITSTATUS(w->rstatus));
+
+	ev_child_stop(loop, w);
+	a->pid = -1;
+	acceptor_remove(s, a);
+}
+
+static void acceptor_watcher_cb(EV_P_ ev_io *w, int revents)
+{
+	main_server_st *s = ev_userdata(loop);
+	struct acceptor_st *a = (struct acceptor_st *)w;
+	struct worker_st *ws = s->ws;
+	WorkerStartMsg *msg = NULL;
+	int fd = -1, ret;
+	uint64_t accept_time;
+	PROTOBUF_ALLOCATOR(pa, s);
+
+	ret = recv_socket_msg(s, a->fd, CMD_ACCEPTED_CONN, &fd,
+			      (void *)&msg,
+			      (unpack_func) worker_start_msg__unpack, 0);
+	if (ret < 0 || fd == -1 ||
+	    msg->remote_addr.len > sizeof(ws->remote_addr)) {
+		if (ret != ERR_PEER_TERMINATED)
+			mslog(s, NULL, LOG_ERR, "error receiving a connection from acceptor %u", a->shard);
+		if (fd != -1)
+			close(fd);
+		if (msg != NULL)
+			worker_start_msg__free_unpacked(msg, &pa);
+		if (a->pid != -1)
+			kill(a->pid, SIGTERM);
+		/* the child watcher restarts it */
+		ev_io_stop(loop, &a->io);
+		return;
 	}
 
-	if (GETCONFIG(s)->rate_limit_ms > 0)
-		ms_sleep(GETCONFIG(s)->rate_limit_ms);
+	memcpy(&ws->remote_addr, msg->remote_addr.data, msg->remote_addr.len);
+	ws->remote_addr_len = msg->remote_addr.len;
+	accept_time = msg->accept_time;
+	worker_start_msg__free_unpacked(msg, &pa);
+
+	set_cloexec_flag(fd, 1);
+	conn_accepted(s, fd, SOCK_TYPE_TCP, accept_time);
+}
+
+/* Forks an acceptor for each shard of the TCP listeners. Main
+ * keeps these listeners open, but does not accept on them. */
+static void acceptors_start(main_server_st *s)
+{
+	struct listener_st *ltmp;
+	struct acceptor_st *a;
+	unsigned i, sharded = 0;
+
+	/* sockets passed by systemd are not sharded */
+	list_for_each(&s->listen_list.head, ltmp, list) {
+		if (ltmp->fd != -1 && ltmp->shard >= 0)
+			sharded++;
+	}
+
+	if (sharded == 0)
+		return;
+
+	for (i = 0; i < GETCONFIG(s)->listen_shards; i++) {
+		a = talloc_zero(s, struct acceptor_st);
+		if (a == NULL) {
+			mslog(s, NULL, LOG_ERR, "memory error");
+			exit(1);
+		}
+		a->shard = i;
+		a->pid = -1;
+		a->fd = -1;
+		ev_init(&a->restart, acceptor_restart_cb);
+		list_add_tail(&s->acceptor_list.head, &a->list);
+		s->acceptor_list.total++;
+
+		if (acceptor_fork(s, a) < 0)
+			acceptor_remove(s, a);
+	}
 }
 
 static void sec_mod_watcher_cb (EV_P_ ev_io *w, int revents)
@@ -1201,6 +2221,11 @@ static void perform_maintenance(main_server_st *s)
 	list_for_each_rev(s->vconfig, vhost, list) {
 		tls_reload_crl(s, vhost, 0);
 	}
+
+	/* the idle workers would not see a reloaded CRL */
+	idle_workers_flush(s);
+	if (GETCONFIG(s)->worker_pool_size > 0)
+		ev_idle_start(loop, &worker_pool_watcher);
 }
 
 static void maintenance_watcher_cb(EV_P_ ev_timer *w, int revents)
@@ -1236,6 +2261,7 @@ int main(int argc, char** argv)
 	void *worker_pool;
 	void *main_pool, *config_pool;
 	main_server_st *s;
+	uint32_t seed;
 
 #ifdef DEBUG_LEAKS
 	talloc_enable_leak_report_full();
@@ -1270,6 +2296,11 @@ int main(int argc, char** argv)
 
 	list_head_init(&s->proc_list.head);
 	list_head_init(&s->script_list.head);
+	list_head_init(&s->idle_worker_list.head);
+	list_head_init(&s->acceptor_list.head);
+	list_head_init(&s->pending_conn_list.head);
+	list_head_init(&s->session_open_list.head);
+	icmp_ping_init(s);
 	ip_lease_init(&s->ip_leases);
 	proc_table_init(s);
 	main_ban_db_init(s);
@@ -1281,6 +2312,20 @@ int main(int argc, char** argv)
 	/* Initialize GnuTLS */
 	tls_global_init();
 
+	ret = gnutls_key_generate(&s->dtls_cookie_key, GNUTLS_COOKIE_KEY_SIZE);
+	if (ret < 0) {
+		fprintf(stderr, "could not generate the DTLS cookie key: %s\n",
+			gnutls_strerror(ret));
+		exit(1);
+	}
+	gnutls_rnd(GNUTLS_RND_NONCE, &s->udp_rate_seed, sizeof(s->udp_rate_seed));
+
+	gnutls_rnd(GNUTLS_RND_NONCE, &seed, sizeof(seed));
+	if (admission_init(s, &s->admission, seed) < 0) {
+		fprintf(stderr, "memory error\n");
+		exit(1);
+	}
+
 	/* load configuration */
 	s->vconfig = talloc_zero(config_pool, struct list_head);
 	if (s->vconfig == NULL) {
@@ -1418,6 +2463,9 @@ int main(int argc, char** argv)
 	list_for_each(&s->listen_list.head, ltmp, list) {
 		if (ltmp->fd == -1) continue;
 
+		/* the acceptors accept on the sharded listeners */
+		if (ltmp->shard >= 0) continue;
+
 		ev_io_start (loop, &ltmp->io);
 	}
 
@@ -1430,10 +2478,17 @@ int main(int argc, char** argv)
 	ev_child_init(&child_watcher, sec_mod_child_watcher_cb, s->sec_mod_pid, 0);
 	ev_child_start (loop, &child_watcher);
 
+	ev_init(&admission_watcher, admission_watcher_cb);
 	ev_init(&maintenance_watcher, maintenance_watcher_cb);
 	ev_timer_set(&maintenance_watcher, MAIN_MAINTENANCE_TIME, MAIN_MAINTENANCE_TIME);
 	ev_timer_start(loop, &maintenance_watcher);
 
+	acceptors_start(s);
+
+	ev_idle_init(&worker_pool_watcher, worker_pool_watcher_cb);
+	if (GETCONFIG(s)->worker_pool_size > 0)
+		ev_idle_start(loop, &worker_pool_watcher);
+
 	/* allow forcing maintenance with SIGUSR2 */
 	ev_init (&maintenance_sig_watcher, maintenance_sig_watcher_cb);
 	ev_signal_set (&maintenance_sig_watcher, SIGUSR2);
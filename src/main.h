@@ -36,6 +36,7 @@
 #include <ev.h>
 
 #include "vhost.h"
+#include "main-admission.h"
 
 #if defined(__FreeBSD__) || defined(__OpenBSD__)
 # include <limits.h>
@@ -64,6 +65,7 @@ struct listener_st {
 	socklen_t addr_len;
 	int family;
 	int protocol;
+	int shard; /* the acceptor which owns it, or -1 if main accepts */
 };
 
 struct listen_list_st {
@@ -81,6 +83,97 @@ struct script_wait_st {
 	struct proc_st* proc;
 };
 
+/* A pre-forked worker process, waiting for main to pass it
+ * an accepted connection */
+struct idle_worker_st {
+	/* must be first so that this structure can behave as ev_child */
+	struct ev_child ev_child;
+
+	struct list_node list;
+
+	pid_t pid;
+	int fd; /* the command file descriptor */
+};
+
+struct idle_worker_list_st {
+	struct list_head head;
+	unsigned int total;
+};
+
+/* A process which accepts the connections of one shard of the
+ * listen-shards sockets, and passes them to main */
+struct acceptor_st {
+	/* must be first so that this structure can behave as ev_io */
+	struct ev_io io;
+	struct ev_child ev_child;
+	struct ev_timer restart;
+
+	struct list_node list;
+
+	pid_t pid;
+	int fd; /* the command file descriptor, or -1 while restarting */
+	unsigned shard;
+};
+
+struct acceptor_list_st {
+	struct list_head head;
+	unsigned int total;
+};
+
+/* An accepted connection on which main waits for the TLS client
+ * hello, before it starts a worker for it */
+struct pending_conn_st {
+	/* This is first so this structure can behave as an ev_io */
+	struct ev_io io;
+	struct ev_timer timer;
+
+	struct list_node list;
+	int fd;
+	uint64_t accept_time;
+
+	struct sockaddr_storage remote_addr;
+	socklen_t remote_addr_len;
+	struct sockaddr_storage our_addr;
+	socklen_t our_addr_len;
+};
+
+struct pending_conn_list_st {
+	struct list_head head;
+	unsigned int total;
+};
+
+/* the maximum number of connections waiting for a client hello;
+ * the oldest is closed to make room for a new one */
+#define MAX_PENDING_CONNS 1024
+
+/* An echo request sent by ping-leases to an IP lease which is
+ * reserved for proc, before it is handed to the session */
+struct lease_ping_st {
+	/* must be first so that this structure can behave as ev_timer */
+	struct ev_timer timer;
+
+	struct list_node list;
+	struct proc_st *proc;
+	struct ip_lease_st *lease;
+	uint16_t id;
+};
+
+/* the procs which wait for the reply of sec-mod to session_open() */
+struct session_open_list_st {
+	struct list_head head;
+	uint32_t next_id;
+};
+
+struct lease_ping_list_st {
+	struct list_head head;
+	unsigned int total;
+
+	/* the raw ICMP sockets shared by all the requests; they
+	 * are opened on first use */
+	ev_io io4;
+	ev_io io6;
+};
+
 /* Each worker process maps to a unique proc_st structure.
  */
 typedef struct proc_st {
@@ -102,6 +195,12 @@ typedef struct proc_st {
 	struct ip_lease_st *ipv4;
 	struct ip_lease_st *ipv6;
 	unsigned leases_in_use; /* someone else got our IP leases */
+	unsigned lease_pings; /* echo requests sent for our leases */
+	unsigned lease_pings_pending; /* and not yet answered or timed out */
+
+	/* non-zero while the reply of sec-mod to session_open() is awaited */
+	uint32_t session_open_id;
+	struct list_node session_open_list;
 
 	struct sockaddr_storage remote_addr; /* peer address (CSTP) */
 	socklen_t remote_addr_len;
@@ -115,6 +214,9 @@ typedef struct proc_st {
 	/* The SID which acts as a cookie */
 	uint8_t sid[SID_SIZE];
 	unsigned active_sid;
+	/* the cookie of the session being opened; it is the SID once
+	 * sec-mod accepts it (sid is the key of the SID hash table) */
+	uint8_t pending_sid[SID_SIZE];
 
 	/* whether the host-update script has already been called */
 	unsigned host_updated;
@@ -139,6 +241,22 @@ typedef struct proc_st {
 	char dtls_compr[8];
 	unsigned mtu;
 
+	/* data channel batching statistics, periodically sent by the worker */
+	uint64_t batch_wakeups;
+	uint64_t batch_packets;
+	/* DTLS transmit queue statistics */
+	unsigned dtls_tx_queued;
+	uint64_t dtls_tx_dropped;
+	/* fair queueing statistics; fq is set if enabled */
+	unsigned fq;
+	unsigned fq_flows;
+	unsigned fq_queued;
+	uint64_t fq_overlimit_drops;
+	uint64_t fq_codel_drops;
+
+	/* kernel TLS status of the CSTP channel as reported by the worker */
+	unsigned ktls;
+
 	/* if the session is initiated by a cookie the following two are set
 	 * and are considered when generating an IP address. That is used to
 	 * generate the same address as previously allocated.
@@ -171,6 +289,8 @@ inline static void kill_proc(proc_st *proc)
 
 struct ip_lease_db_st {
 	struct htable ht;
+	/* the pools of the configured networks (see ip-pool.h) */
+	struct list_head pools;
 };
 
 struct proc_list_st {
@@ -214,11 +334,43 @@ struct main_stats_st {
 	uint32_t max_session_mins;
 	uint64_t auth_failures; /* authentication failures */
 
+	/* the time from accept() to the end of the TLS handshake */
+	uint32_t avg_handshake_us;
+	uint32_t max_handshake_us;
+	uint64_t handshakes;
+	/* connections closed without a TLS client hello */
+	uint64_t no_hello_conns;
+	/* connections rejected by net-rate-limit-ms */
+	uint64_t conns_rate_limited;
+	/* connections rejected at max-clients */
+	uint64_t conns_max_clients;
+	/* connections rejected by load shedding */
+	uint64_t conns_shed;
+
+	/* updated from sec-mod: the time of its private key operations,
+	 * and their longest queue since the last update */
+	uint32_t avg_key_op_us;
+	uint32_t max_key_op_us;
+	uint32_t max_key_op_queue;
+
 	/* These are counted since start time */
 	uint64_t total_auth_failures; /* authentication failures since start_time */
 	uint64_t total_sessions_closed; /* sessions closed since start_time */
 };
 
+/* The number of datagrams read from the UDP port on a wakeup */
+#define UDP_BATCH_SIZE 32
+/* The size of the table of udp-port-rate-limit counters */
+#define UDP_RATE_SLOTS 4096
+
+struct udp_batch_st;
+
+struct udp_rate_st {
+	uint32_t key;
+	time_t time;
+	unsigned count;
+};
+
 typedef struct main_server_st {
 	/* virtual hosts are only being added to that list, never removed */
 	struct list_head *vconfig;
@@ -230,6 +382,15 @@ typedef struct main_server_st {
 	struct listen_list_st listen_list;
 	struct proc_list_st proc_list;
 	struct script_list_st script_list;
+	struct idle_worker_list_st idle_worker_list;
+	struct acceptor_list_st acceptor_list;
+	struct pending_conn_list_st pending_conn_list;
+	struct lease_ping_list_st lease_ping_list;
+	struct session_open_list_st session_open_list;
+	/* the accept rate limits */
+	admission_st admission;
+	/* the next port of dtls-port-range to try */
+	unsigned dtls_port_next;
 	/* maps DTLS session IDs to proc entries */
 	struct proc_hash_db_st proc_table;
 	
@@ -255,11 +416,18 @@ typedef struct main_server_st {
 	void *main_pool; /* talloc main pool */
 	void *config_pool; /* talloc config pool */
 
-	/* used as temporary buffer (currently by forward_udp_to_owner) */
-	uint8_t msg_buffer[MAX_MSG_SIZE];
+	/* datagrams read from the UDP port (see forward_udp_to_owner) */
+	struct udp_batch_st *udp_batch;
+	/* per-address counters of udp-port-rate-limit */
+	struct udp_rate_st *udp_rate;
+	uint32_t udp_rate_seed;
+	/* the key of the stateless DTLS cookies sent by main */
+	gnutls_datum_t dtls_cookie_key;
 } main_server_st;
 
 void clear_lists(main_server_st *s);
+unsigned listen_backlog(main_server_st *s);
+int open_dtls_port(main_server_st *s, struct proc_st *proc, unsigned *port);
 
 int handle_worker_commands(main_server_st *s, struct proc_st* cur);
 int handle_sec_mod_commands(main_server_st *s);
@@ -271,6 +439,7 @@ void user_disconnected(main_server_st *s, struct proc_st* cur);
 int send_udp_fd(main_server_st* s, struct proc_st * proc, int fd);
 
 int session_open(main_server_st * s, struct proc_st *proc, const uint8_t *cookie, unsigned cookie_size);
+void session_open_cancel(main_server_st * s, struct proc_st *proc);
 int session_close(main_server_st * s, struct proc_st *proc);
 
 #ifdef UNDER_TEST
@@ -308,9 +477,11 @@ int send_cookie_auth_reply(main_server_st* s, struct proc_st* proc,
 
 int handle_auth_cookie_req(main_server_st* s, struct proc_st* proc,
  			   const AuthCookieRequestMsg * req);
+int handle_auth_cookie_rep(main_server_st* s, struct proc_st* proc);
 
 int check_multiple_users(main_server_st *s, struct proc_st* proc);
 int handle_script_exit(main_server_st *s, struct proc_st* proc, int code);
+void resume_cookie_auth(main_server_st *s, struct proc_st* proc, int result);
 
 int run_sec_mod(main_server_st * s, int *sync_fd);
 
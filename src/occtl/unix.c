@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <signal.h>
 #include <c-ctype.h>
@@ -246,6 +247,22 @@ int handle_status_cmd(struct unix_ctx *ctx, const char *arg, cmd_params_st *para
 		print_single_value_int(stdout, params, "Total sessions", rep->total_sessions_closed, 1);
 		print_single_value_int(stdout, params, "Total authentication failures", rep->total_auth_failures, 1);
 		print_single_value_int(stdout, params, "IPs in ban list", rep->banned_ips, 1);
+		if (rep->has_idle_workers && rep->idle_workers > 0)
+			print_single_value_int(stdout, params, "Idle workers", rep->idle_workers, 1);
+		if (rep->has_accept_backlog)
+			print_single_value_int(stdout, params, "Accept backlog", rep->accept_backlog, 1);
+		if (rep->has_ipv4_pool_size && rep->ipv4_pool_size > 0) {
+			snprintf(buf, sizeof(buf), "%"PRIu64"/%"PRIu64" (%.1f%%)",
+				 rep->ipv4_pool_used, rep->ipv4_pool_size,
+				 (double)rep->ipv4_pool_used * 100 / rep->ipv4_pool_size);
+			print_single_value(stdout, params, "IPv4 pool usage", buf, 1);
+		}
+		if (rep->has_ipv6_pool_size && rep->ipv6_pool_size > 0) {
+			snprintf(buf, sizeof(buf), "%"PRIu64"/%"PRIu64" (%.1f%%)",
+				 rep->ipv6_pool_used, rep->ipv6_pool_size,
+				 (double)rep->ipv6_pool_used * 100 / rep->ipv6_pool_size);
+			print_single_value(stdout, params, "IPv6 pool usage", buf, 1);
+		}
 		if (params && params->debug) {
 			print_single_value_int(stdout, params, "Sec-mod client entries", rep->secmod_client_entries, 1);
 			print_single_value_int(stdout, params, "TLS DB entries", rep->stored_tls_sessions, 1);
@@ -269,6 +286,14 @@ int handle_status_cmd(struct unix_ctx *ctx, const char *arg, cmd_params_st *para
 		print_single_value_int(stdout, params, "Timed out (idle) sessions", rep->session_idle_timeouts, 1);
 		print_single_value_int(stdout, params, "Closed due to error sessions", rep->session_errors, 1);
 		print_single_value_int(stdout, params, "Authentication failures", rep->auth_failures, 1);
+		if (rep->has_no_hello_conns)
+			print_single_value_int(stdout, params, "Closed before TLS hello", rep->no_hello_conns, 1);
+		if (rep->has_conns_rate_limited)
+			print_single_value_int(stdout, params, "Rate-limited connections", rep->conns_rate_limited, 1);
+		if (rep->has_conns_max_clients)
+			print_single_value_int(stdout, params, "Rejected connections (max-clients)", rep->conns_max_clients, 1);
+		if (rep->has_conns_shed)
+			print_single_value_int(stdout, params, "Rejected connections (load)", rep->conns_shed, 1);
 
 		print_time_ival7(buf, rep->avg_auth_time, 0);
 		print_single_value(stdout, params, "Average auth time", buf, 1);
@@ -276,6 +301,24 @@ int handle_status_cmd(struct unix_ctx *ctx, const char *arg, cmd_params_st *para
 		print_time_ival7(buf, rep->max_auth_time, 0);
 		print_single_value(stdout, params, "Max auth time", buf, 1);
 
+		if (rep->has_avg_handshake_us && rep->max_handshake_us > 0) {
+			snprintf(buf, sizeof(buf), "%.1fms", (double)rep->avg_handshake_us/1000);
+			print_single_value(stdout, params, "Average TLS handshake time", buf, 1);
+
+			snprintf(buf, sizeof(buf), "%.1fms", (double)rep->max_handshake_us/1000);
+			print_single_value(stdout, params, "Max TLS handshake time", buf, 1);
+		}
+
+		if (rep->has_avg_key_op_us && rep->max_key_op_us > 0) {
+			snprintf(buf, sizeof(buf), "%.1fms", (double)rep->avg_key_op_us/1000);
+			print_single_value(stdout, params, "Average key operation time", buf, 1);
+
+			snprintf(buf, sizeof(buf), "%.1fms", (double)rep->max_key_op_us/1000);
+			print_single_value(stdout, params, "Max key operation time", buf, 1);
+
+			print_single_value_int(stdout, params, "Max key operation queue", rep->max_key_op_queue, 1);
+		}
+
 		print_time_ival7(buf, rep->avg_session_mins*60, 0);
 		print_single_value(stdout, params, "Average session time", buf, 1);
 
@@ -1134,6 +1177,37 @@ int common_info_cmd(UserListRep * args, FILE *out, cmd_params_st *params)
 
 		print_pair_value(out, params, "DPD", int2str(tmpbuf, args->user[i]->dpd), "KeepAlive", int2str(tmpbuf2, args->user[i]->keepalive), 1);
 
+		if (args->user[i]->has_batch_wakeups && args->user[i]->batch_wakeups > 0) {
+			snprintf(tmpbuf, sizeof(tmpbuf), "%.2f",
+				 (double)args->user[i]->batch_packets/(double)args->user[i]->batch_wakeups);
+			print_single_value(out, params, "Avg batch", tmpbuf, 1);
+		}
+
+		if (args->user[i]->has_dtls_tx_dropped) {
+			snprintf(tmpbuf2, sizeof(tmpbuf2), "%"PRIu64, (uint64_t)args->user[i]->dtls_tx_dropped);
+			print_pair_value(out, params, "DTLS TX queue",
+					 int2str(tmpbuf, args->user[i]->dtls_tx_queued),
+					 "Dropped", tmpbuf2, 1);
+		}
+
+		if (args->user[i]->has_fq_queued) {
+			snprintf(tmpbuf2, sizeof(tmpbuf2), "%u", (unsigned)args->user[i]->fq_queued);
+			print_pair_value(out, params, "FQ flows",
+					 int2str(tmpbuf, args->user[i]->fq_flows),
+					 "Queued", tmpbuf2, 1);
+
+			snprintf(tmpbuf, sizeof(tmpbuf), "%"PRIu64, (uint64_t)args->user[i]->fq_overlimit_drops);
+			snprintf(tmpbuf2, sizeof(tmpbuf2), "%"PRIu64, (uint64_t)args->user[i]->fq_codel_drops);
+			print_pair_value(out, params, "FQ overlimit drops",
+					 tmpbuf, "CoDel drops", tmpbuf2, 1);
+		}
+
+		if (args->user[i]->has_ktls && args->user[i]->ktls != 0) {
+			print_single_value(out, params, "kTLS",
+					   args->user[i]->ktls == 3 ? "rx/tx" :
+					   (args->user[i]->ktls == 2 ? "tx" : "rx"), 1);
+		}
+
 		print_single_value(out, params, "Hostname", args->user[i]->hostname, 1);
 
 		print_time_ival7(tmpbuf, time(0), t);
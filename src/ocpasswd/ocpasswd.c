@@ -359,12 +359,164 @@ unlock_user(const char *fpasswd, const char *username)
 	free(tmp_passwd);
 }
 
+/* The first line of a file written in the indexed form */
+#define INDEX_HEADER "#ocpasswd-index"
+
+typedef struct entry_st {
+	char *line;
+	size_t username_len;
+	unsigned pos;
+} entry_st;
+
+static int entry_cmp(const void *_e1, const void *_e2)
+{
+	const entry_st *e1 = _e1, *e2 = _e2;
+	size_t l = MIN(e1->username_len, e2->username_len);
+	int ret;
+
+	ret = memcmp(e1->line, e2->line, l);
+	if (ret == 0 && e1->username_len != e2->username_len)
+		ret = (e1->username_len < e2->username_len) ? -1 : 1;
+	if (ret == 0)
+		ret = (e1->pos < e2->pos) ? -1 : 1;
+	return ret;
+}
+
+/* Returns non-zero if the file is in the indexed form */
+static int
+is_indexed(const char *fpasswd)
+{
+	FILE *fd;
+	char line[sizeof(INDEX_HEADER)+1];
+	int ret = 0;
+
+	fd = fopen(fpasswd, "r");
+	if (fd == NULL)
+		return 0;
+
+	if (fgets(line, sizeof(line), fd) != NULL &&
+	    strcmp(line, INDEX_HEADER"\n") == 0)
+		ret = 1;
+
+	fclose(fd);
+	return ret;
+}
+
+/* Rewrites the file in the indexed form: an entry per user, sorted by
+ * username, without the lines which are not entries, or the entries
+ * shadowed by a previous one of the same user.
+ */
+static void
+index_passwd(const char *fpasswd)
+{
+	FILE * fd, *fd2;
+	char *tmp_passwd;
+	char *line, *p;
+	unsigned fpasswd_len = strlen(fpasswd);
+	unsigned tmp_passwd_len;
+	entry_st *entries = NULL, *e;
+	size_t entries_size = 0, entries_max = 0;
+	size_t line_size, i;
+	ssize_t len;
+	int ret;
+	struct stat st;
+
+	tmp_passwd_len = fpasswd_len + 5;
+	tmp_passwd = malloc(tmp_passwd_len);
+	if (tmp_passwd == NULL) {
+		fprintf(stderr, "memory error\n");
+		exit(1);
+	}
+
+	snprintf(tmp_passwd, tmp_passwd_len, "%s.tmp", fpasswd);
+	if (stat(tmp_passwd, &st) != -1) {
+		fprintf(stderr, "file '%s' is locked.\n", fpasswd);
+		exit(1);
+	}
+
+	fd = fopen(fpasswd, "r");
+	if (fd == NULL) {
+		fprintf(stderr, "Cannot open '%s' for reading.\n", fpasswd);
+		exit(1);
+	}
+
+	for (;;) {
+		line = NULL;
+		line_size = 0;
+		len = getline(&line, &line_size, fd);
+		if (len <= 0) {
+			free(line);
+			break;
+		}
+
+		while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+			line[--len] = 0;
+
+		/* only username:groupname:encoded-password lines are kept */
+		p = strchr(line, ':');
+		if (len <= 3 || p == NULL || strchr(p+1, ':') == NULL) {
+			free(line);
+			continue;
+		}
+
+		if (entries_size == entries_max) {
+			entries_max = entries_max ? entries_max*2 : 256;
+			entries = realloc(entries, entries_max*sizeof(entry_st));
+			if (entries == NULL) {
+				fprintf(stderr, "memory error\n");
+				exit(1);
+			}
+		}
+
+		e = &entries[entries_size];
+		e->line = line;
+		e->username_len = p-line;
+		e->pos = entries_size++;
+	}
+	fclose(fd);
+
+	qsort(entries, entries_size, sizeof(entry_st), entry_cmp);
+
+	fd2 = fopen(tmp_passwd, "w");
+	if (fd2 == NULL) {
+		fprintf(stderr, "Cannot open '%s' for writing.\n", tmp_passwd);
+		exit(1);
+	}
+
+	fprintf(fd2, "%s\n", INDEX_HEADER);
+	for (i = 0; i < entries_size; i++) {
+		e = &entries[i];
+		/* ocserv uses the first entry of a user */
+		if (i == 0 || e->username_len != e[-1].username_len ||
+		    memcmp(e->line, e[-1].line, e->username_len) != 0)
+			fprintf(fd2, "%s\n", e->line);
+	}
+
+	for (i = 0; i < entries_size; i++)
+		free(entries[i].line);
+	free(entries);
+
+	if (fclose(fd2) != 0) {
+		fprintf(stderr, "Cannot write to '%s'.\n", tmp_passwd);
+		unlink(tmp_passwd);
+		exit(1);
+	}
+
+	ret = rename(tmp_passwd, fpasswd);
+	if (ret == -1) {
+		fprintf(stderr, "Cannot write to '%s'.\n", fpasswd);
+		exit(1);
+	}
+	free(tmp_passwd);
+}
+
 static const struct option long_options[] = {
 	{"passwd", 1, 0, 'c'},
 	{"groupname", 1, 0, 'g'},
 	{"delete", 0, 0, 'd'},
 	{"lock", 0, 0, 'l'},
 	{"unlock", 0, 0, 'u'},
+	{"index", 0, 0, 'i'},
 	{"help", 0, 0, 'h'},
 	{"version", 0, 0, 'v'},
 	{NULL, 0, 0, 0}
@@ -375,12 +527,14 @@ void usage(void)
 {
 	fprintf(stderr, "ocpasswd - OpenConnect server password utility\n");
 	fprintf(stderr, "Usage:  ocpasswd [ -<flag> [<val>] | --<name>[{=| }<val>] ]... [username]\n");
+	fprintf(stderr, "        ocpasswd -i [ -c <file> ]\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "   -c, --passwd=file          Password file\n");
 	fprintf(stderr, "   -g, --groupname=str        User's group name\n");
 	fprintf(stderr, "   -d, --delete               Delete user\n");
 	fprintf(stderr, "   -l, --lock                 Lock user\n");
 	fprintf(stderr, "   -u, --unlock               Unlock user\n");
+	fprintf(stderr, "   -i, --index                Write the file in the indexed form\n");
 	fprintf(stderr, "   -v, --version              output version information and exit\n");
 	fprintf(stderr, "   -h, --help                 display extended usage information and exit\n");
 	fprintf(stderr, "\n");
@@ -415,6 +569,7 @@ int main(int argc, char **argv)
 	unsigned free_passwd = 0;
 	size_t l, i;
 	unsigned flags = 0;
+	unsigned indexed = 0;
 
 	if ((ret = gnutls_global_init()) < 0) {
 		fprintf(stderr, "global_init: %s\n", gnutls_strerror(ret));
@@ -424,7 +579,7 @@ int main(int argc, char **argv)
 	umask(066);
 
 	while (1) {
-		c = getopt_long(argc, argv, "c:g:dluvh", long_options, NULL);
+		c = getopt_long(argc, argv, "c:g:dluivh", long_options, NULL);
 		if (c == -1)
 			break;
 
@@ -464,6 +619,9 @@ int main(int argc, char **argv)
 				}
 				flags |= FLAG_LOCK;
 				break;
+			case 'i':
+				indexed = 1;
+				break;
 			case 'h':
 				usage();
 				exit(0);
@@ -475,6 +633,8 @@ int main(int argc, char **argv)
 
 	if (optind < argc && argc-optind == 1) {
 		username = argv[optind++];
+	} else if (optind == argc && indexed && !flags && !groupname) {
+		username = NULL; /* only index */
 	} else {
 		usage();
 		exit(1);
@@ -485,7 +645,13 @@ int main(int argc, char **argv)
 	if (!fpasswd)
 		fpasswd = strdup(DEFAULT_OCPASSWD);
 
-	if (flags & FLAG_LOCK) {
+	/* an indexed file is kept in that form */
+	if (is_indexed(fpasswd))
+		indexed = 1;
+
+	if (username == NULL) {
+		/* nothing to do but index */
+	} else if (flags & FLAG_LOCK) {
 		lock_user(fpasswd, username);
 	} else if (flags & FLAG_UNLOCK) {
 		unlock_user(fpasswd, username);
@@ -533,6 +699,9 @@ int main(int argc, char **argv)
 			free(passwd);
 	}
 
+	if (indexed)
+		index_passwd(fpasswd);
+
 	free(fpasswd);
 	free(groupname);
 	gnutls_global_deinit();
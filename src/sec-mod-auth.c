@@ -53,6 +53,7 @@
 #include <sec-mod-sup-config.h>
 #include <sec-mod-acct.h>
 #include <c-strcase.h>
+#include <gettime.h>
 
 #ifdef HAVE_GSSAPI
 # include <gssapi/gssapi.h>
@@ -419,13 +420,15 @@ static void stats_add_to(stats_st *dst, stats_st *src1, stats_st *src2)
 }
 
 static
-int send_failed_session_open_reply(sec_mod_st *sec, int fd)
+int send_failed_session_open_reply(sec_mod_st *sec, int fd, const SecmSessionOpenMsg *req)
 {
 	SecmSessionReplyMsg rep = SECM_SESSION_REPLY_MSG__INIT;
 	void *lpool;
 	int ret;
 
 	rep.reply = AUTH__REP__FAILED;
+	rep.id = req->id;
+	rep.has_id = req->has_id;
 
 	lpool = talloc_new(sec);
 	if (lpool == NULL) {
@@ -457,24 +460,24 @@ int handle_secm_session_open_cmd(sec_mod_st *sec, int fd, const SecmSessionOpenM
 	if (req->sid.len != SID_SIZE) {
 		seclog(sec, LOG_ERR, "auth session open but with illegal sid size (%d)!",
 		       (int)req->sid.len);
-		return send_failed_session_open_reply(sec, fd);
+		return send_failed_session_open_reply(sec, fd, req);
 	}
 
 	e = find_client_entry(sec, req->sid.data);
 	if (e == NULL) {
 		seclog(sec, LOG_INFO, "session open but with non-existing SID!");
-		return send_failed_session_open_reply(sec, fd);
+		return send_failed_session_open_reply(sec, fd, req);
 	}
 
 	if (e->status != PS_AUTH_COMPLETED) {
 		seclog(sec, LOG_ERR, "session open received in unauthenticated client %s "SESSION_STR"!", e->acct_info.username, e->acct_info.safe_id);
-		return send_failed_session_open_reply(sec, fd);
+		return send_failed_session_open_reply(sec, fd, req);
 	}
 
 	if IS_CLIENT_ENTRY_EXPIRED(sec, e, time(0)) {
 		seclog(sec, LOG_ERR, "session expired; denied session for user '%s' "SESSION_STR, e->acct_info.username, e->acct_info.safe_id);
 		e->status = PS_AUTH_FAILED;
-		return send_failed_session_open_reply(sec, fd);
+		return send_failed_session_open_reply(sec, fd, req);
 	}
 
 	if (req->ipv4)
@@ -487,7 +490,7 @@ int handle_secm_session_open_cmd(sec_mod_st *sec, int fd, const SecmSessionOpenM
 		if (ret < 0) {
 			e->status = PS_AUTH_FAILED;
 			seclog(sec, LOG_INFO, "denied session for user '%s' "SESSION_STR, e->acct_info.username, e->acct_info.safe_id);
-			return send_failed_session_open_reply(sec, fd);
+			return send_failed_session_open_reply(sec, fd, req);
 		}
 	}
 	e->session_is_open = 1;
@@ -498,17 +501,25 @@ int handle_secm_session_open_cmd(sec_mod_st *sec, int fd, const SecmSessionOpenM
 	rep.tls_auth_ok = e->tls_auth_ok;
 	rep.vhost = e->vhost->name;
 
-	/* Fixme: possibly we should allow for completely random seeds */
-	if (e->vhost->perm_config.config->predictable_ips != 0) {
-		rep.ipv4_seed = hash_any(e->acct_info.username, strlen(e->acct_info.username), 0);
-	} else {
-		ret = gnutls_rnd(GNUTLS_RND_NONCE, &rep.ipv4_seed, sizeof(rep.ipv4_seed));
-		if (ret < 0)
-			return -1;
+	/* the seed is kept with the session, so that a reconnection (or a
+	 * session restored from the state-file) gets the same address */
+	if (e->ipv4_seed_set == 0) {
+		/* Fixme: possibly we should allow for completely random seeds */
+		if (e->vhost->perm_config.config->predictable_ips != 0) {
+			e->ipv4_seed = hash_any(e->acct_info.username, strlen(e->acct_info.username), 0);
+		} else {
+			ret = gnutls_rnd(GNUTLS_RND_NONCE, &e->ipv4_seed, sizeof(e->ipv4_seed));
+			if (ret < 0)
+				return send_failed_session_open_reply(sec, fd, req);
+		}
+		e->ipv4_seed_set = 1;
 	}
+	rep.ipv4_seed = e->ipv4_seed;
 
 	rep.sid.data = e->sid;
 	rep.sid.len = sizeof(e->sid);
+	rep.id = req->id;
+	rep.has_id = req->has_id;
 
 	rep.reply = AUTH__REP__OK;
 
@@ -522,7 +533,7 @@ int handle_secm_session_open_cmd(sec_mod_st *sec, int fd, const SecmSessionOpenM
 		if (ret < 0) {
 			seclog(sec, LOG_ERR, "error reading additional configuration for '%s' "SESSION_STR, e->acct_info.username, e->acct_info.safe_id);
 			talloc_free(lpool);
-			return send_failed_session_open_reply(sec, fd);
+			return send_failed_session_open_reply(sec, fd, req);
 		}
 	}
 
@@ -679,7 +690,262 @@ int handle_sec_auth_stats_cmd(sec_mod_st * sec, const CliStatsMsg * req, pid_t p
 	return 0;
 }
 
-int handle_sec_auth_cont(int cfd, sec_mod_st * sec, const SecAuthContMsg * req)
+/* A call of auth_init() or auth_pass() of a module which is run on an
+ * auth thread. The job is a talloc context of its own, and holds
+ * copies of what the call uses, as the message is released once the
+ * call is queued. It also holds the authentication context of the
+ * entry while the call runs, so that the thread never touches the
+ * entry. Once the entry is answered on timeout, or freed, the job is
+ * detached from it, and its result is discarded.
+ */
+typedef struct sec_auth_job_st {
+	sec_mod_job_st job;
+	struct list_node list; /* in sec->auth_jobs */
+
+	client_entry_st *e; /* NULL once detached */
+	const struct auth_mod_st *module;
+	void *vhost_auth_ctx;
+	void *auth_ctx;
+
+	char *username;
+	char *ip;
+	char *our_ip;
+	char *user_agent;
+	unsigned id;
+	char *password; /* for auth_pass(); NULL for auth_init() */
+
+	int ret;
+	uint64_t deadline_us; /* zero for none */
+	unsigned timed_out; /* the worker was answered */
+} sec_auth_job_st;
+
+static void auth_job_run(sec_mod_job_st *_job, unsigned thread)
+{
+	sec_auth_job_st *job = (sec_auth_job_st *)_job;
+	common_auth_init_st st;
+
+	if (job->password != NULL) {
+		job->ret = job->module->auth_pass(job->auth_ctx, job->password,
+						  strlen(job->password));
+		return;
+	}
+
+	st.username = job->username;
+	st.ip = job->ip;
+	st.our_ip = job->our_ip;
+	st.user_agent = job->user_agent;
+	st.id = job->id;
+
+	job->ret = job->module->auth_init(&job->auth_ctx, job, job->vhost_auth_ctx, &st);
+}
+
+static void free_auth_job(sec_auth_job_st *job)
+{
+	if (job->auth_ctx != NULL)
+		job->module->auth_deinit(job->auth_ctx);
+	if (job->password != NULL)
+		safe_memset(job->password, 0, strlen(job->password));
+	talloc_free(job);
+}
+
+static int finish_auth_cont(int cfd, sec_mod_st * sec, client_entry_st * e, int result)
+{
+	if (result < 0 && result != ERR_AUTH_CONTINUE) {
+		seclog(sec, LOG_DEBUG,
+		       "error in password given in auth cont for user '%s' "SESSION_STR,
+		       e->acct_info.username, e->acct_info.safe_id);
+	}
+
+	return handle_sec_auth_res(cfd, sec, e, result);
+}
+
+static int auth_job_done(sec_mod_st *sec, sec_mod_job_st *_job, void *pool)
+{
+	sec_auth_job_st *job = (sec_auth_job_st *)_job;
+	client_entry_st *e = job->e;
+	int ret = 0;
+
+	list_del(&job->list);
+
+	if (e == NULL) {
+		seclog(sec, LOG_INFO, "discarding a late authentication result");
+		/* unless it timed out, the entry was freed and the worker
+		 * cannot be answered */
+		ret = (job->job.conn != NULL) ? -1 : 0;
+		free_auth_job(job);
+		return ret;
+	}
+
+	e->auth_job = NULL;
+	e->auth_ctx = talloc_steal(e, job->auth_ctx);
+	job->auth_ctx = NULL;
+
+	if (job->password != NULL) {
+		ret = finish_auth_cont(job->job.conn->fd, sec, e, job->ret);
+	} else {
+		ret = handle_sec_auth_res(job->job.conn->fd, sec, e, job->ret);
+	}
+
+	free_auth_job(job);
+	return ret;
+}
+
+/* Queues the call of auth_init(), or of auth_pass() if a password is
+ * given, to an auth thread. Returns a negative number if the module
+ * of the entry is not run on threads, or on error; the call is then
+ * to be made inline.
+ */
+static int queue_auth_job(sec_mod_st *sec, sec_mod_conn_st *conn, client_entry_st *e,
+			  const common_auth_init_st *st, const char *password)
+{
+	sec_auth_job_st *job;
+	unsigned timeout;
+
+	if (sec->auth_threads == NULL || conn == NULL || e->module->concurrency == 0)
+		return -1;
+
+	/* not under sec, which the main loop keeps using */
+	job = talloc_zero(NULL, sec_auth_job_st);
+	if (job == NULL)
+		return -1;
+	job->module = e->module;
+	job->vhost_auth_ctx = e->vhost_auth_ctx;
+
+	if (password != NULL) {
+		job->password = talloc_strdup(job, password);
+		if (job->password == NULL)
+			goto fail;
+	} else {
+		job->username = talloc_strdup(job, st->username);
+		job->ip = talloc_strdup(job, st->ip);
+		job->our_ip = talloc_strdup(job, st->our_ip);
+		job->user_agent = talloc_strdup(job, st->user_agent);
+		job->id = st->id;
+		if ((st->username != NULL && job->username == NULL) ||
+		    (st->ip != NULL && job->ip == NULL) ||
+		    (st->our_ip != NULL && job->our_ip == NULL) ||
+		    (st->user_agent != NULL && job->user_agent == NULL))
+			goto fail;
+	}
+
+	job->job.run = auth_job_run;
+	job->job.done = auth_job_done;
+	job->job.conn = conn;
+	job->job.cls = e->module;
+	job->job.cls_limit = e->module->concurrency;
+	job->e = e;
+	job->auth_ctx = talloc_steal(job, e->auth_ctx);
+	e->auth_ctx = NULL;
+
+	timeout = e->auth_timeout;
+	if (timeout == 0)
+		timeout = e->vhost->perm_config.config->auth_timeout;
+	if (timeout > 0)
+		job->deadline_us = gettime_mono_us() + timeout * 1000000ULL;
+
+	if (sec_mod_threads_queue(sec->auth_threads, &job->job) < 0) {
+		e->auth_ctx = talloc_steal(e, job->auth_ctx);
+		job->auth_ctx = NULL;
+		goto fail;
+	}
+
+	e->auth_job = job;
+	list_add_tail(&sec->auth_jobs, &job->list);
+	return 0;
+
+ fail:
+	free_auth_job(job);
+	return -1;
+}
+
+/* Unlike send_sec_auth_reply(), this does not use the entry as the
+ * memory pool. */
+static void send_sec_auth_timeout_reply(sec_mod_st *sec, int cfd)
+{
+	SecAuthReplyMsg msg = SEC_AUTH_REPLY_MSG__INIT;
+	void *lpool;
+	int ret;
+
+	sec->auth_failures++;
+
+	lpool = talloc_new(sec);
+	if (lpool == NULL)
+		return;
+
+	msg.reply = AUTH__REP__FAILED;
+
+	ret = send_msg(lpool, cfd, CMD_SEC_AUTH_REPLY, &msg,
+		       (pack_size_func) sec_auth_reply_msg__get_packed_size,
+		       (pack_func) sec_auth_reply_msg__pack);
+	if (ret < 0) {
+		int e = errno;
+		seclog(sec, LOG_ERR, "send_msg: %s", strerror(e));
+	}
+
+	talloc_free(lpool);
+}
+
+/* Fails the authentications whose backend calls exceeded their
+ * timeout. The workers are answered and their connections read
+ * again; the threads are left to finish the calls, whose results
+ * are discarded with the jobs.
+ */
+void sec_auth_expire_jobs(sec_mod_st *sec)
+{
+	sec_auth_job_st *job;
+	sec_mod_conn_st *conn;
+	client_entry_st *e;
+	uint64_t now;
+
+	if (list_empty(&sec->auth_jobs))
+		return;
+
+	now = gettime_mono_us();
+	list_for_each(&sec->auth_jobs, job, list) {
+		if (job->timed_out || job->deadline_us == 0 || now < job->deadline_us)
+			continue;
+
+		e = job->e;
+		seclog(sec, LOG_ERR, "authentication backend timed out for user '%s' "SESSION_STR,
+		       e->acct_info.username, e->acct_info.safe_id);
+
+		job->timed_out = 1;
+		e->status = PS_AUTH_FAILED;
+		e->auth_job = NULL;
+		job->e = NULL;
+
+		conn = job->job.conn;
+		conn->job = NULL;
+		job->job.conn = NULL;
+		sec_mod_conn_resume(sec, conn);
+		send_sec_auth_timeout_reply(sec, conn->fd);
+	}
+}
+
+/* Returns the time until the next backend call times out, if that is
+ * less than max_us.
+ */
+uint64_t sec_auth_next_deadline(sec_mod_st *sec, uint64_t max_us)
+{
+	sec_auth_job_st *job;
+	uint64_t now;
+
+	if (list_empty(&sec->auth_jobs))
+		return max_us;
+
+	now = gettime_mono_us();
+	list_for_each(&sec->auth_jobs, job, list) {
+		if (job->timed_out || job->deadline_us == 0)
+			continue;
+		if (job->deadline_us <= now)
+			return 0;
+		max_us = MIN(max_us, job->deadline_us - now);
+	}
+
+	return max_us;
+}
+
+int handle_sec_auth_cont(int cfd, sec_mod_st * sec, sec_mod_conn_st *conn, const SecAuthContMsg * req)
 {
 	client_entry_st *e;
 	int ret;
@@ -696,6 +962,12 @@ int handle_sec_auth_cont(int cfd, sec_mod_st * sec, const SecAuthContMsg * req)
 		return -1;
 	}
 
+	if (e->auth_job != NULL) {
+		seclog(sec, LOG_ERR, "auth cont received for %s "SESSION_STR" while the previous is processed",
+		       e->acct_info.username, e->acct_info.safe_id);
+		return -1;
+	}
+
 	if (e->status != PS_AUTH_INIT && e->status != PS_AUTH_CONT) {
 		seclog(sec, LOG_ERR, "auth cont received for %s "SESSION_STR" but we are on state %u!",
 		       e->acct_info.username, e->acct_info.safe_id, e->status);
@@ -720,23 +992,19 @@ int handle_sec_auth_cont(int cfd, sec_mod_st * sec, const SecAuthContMsg * req)
 
 	e->status = PS_AUTH_CONT;
 
+	/* the worker is answered once an auth thread is done */
+	if (queue_auth_job(sec, conn, e, NULL, req->password) >= 0)
+		return ERR_WAIT_FOR_THREAD;
+
 	ret =
 	    e->module->auth_pass(e->auth_ctx, req->password,
 			      strlen(req->password));
-	if (ret < 0) {
-		if (ret != ERR_AUTH_CONTINUE) {
-			seclog(sec, LOG_DEBUG,
-			       "error in password given in auth cont for user '%s' "SESSION_STR,
-			       e->acct_info.username, e->acct_info.safe_id);
-		}
-		goto cleanup;
-	}
+	return finish_auth_cont(cfd, sec, e, ret);
 
  cleanup:
 	return handle_sec_auth_res(cfd, sec, e, ret);
 }
 
-static
 int set_module(sec_mod_st * sec, vhost_cfg_st *vhost, client_entry_st *e, unsigned auth_type)
 {
 	unsigned i;
@@ -752,6 +1020,7 @@ int set_module(sec_mod_st * sec, vhost_cfg_st *vhost, client_entry_st *e, unsign
 			e->auth_type = vhost->perm_config.auth[i].type;
 			e->vhost_auth_ctx = vhost->perm_config.auth[i].auth_ctx;
 			e->vhost_acct_ctx = vhost->perm_config.acct.acct_ctx;
+			e->auth_timeout = vhost->perm_config.auth[i].timeout;
 
 			seclog(sec, LOG_INFO, "%susing '%s' authentication to authenticate user "SESSION_STR, PREFIX_VHOST(vhost), vhost->perm_config.auth[i].name, e->acct_info.safe_id);
 			return 0;
@@ -761,12 +1030,11 @@ int set_module(sec_mod_st * sec, vhost_cfg_st *vhost, client_entry_st *e, unsign
 	return -1;
 }
 
-int handle_sec_auth_init(int cfd, sec_mod_st *sec, const SecAuthInitMsg *req, pid_t pid)
+int handle_sec_auth_init(int cfd, sec_mod_st *sec, sec_mod_conn_st *conn, const SecAuthInitMsg *req, pid_t pid)
 {
 	int ret = -1;
 	client_entry_st *e;
 	unsigned i;
-	unsigned need_continue = 0;
 	vhost_cfg_st *vhost;
 
 	vhost = find_vhost(sec->vconfig, req->vhost);
@@ -783,24 +1051,6 @@ int handle_sec_auth_init(int cfd, sec_mod_st *sec, const SecAuthInitMsg *req, pi
 		goto cleanup;
 	}
 
-	if (e->module) {
-		common_auth_init_st st;
-
-		st.username = req->user_name;
-		st.ip = req->ip;
-		st.our_ip = req->our_ip;
-		st.user_agent = req->user_agent;
-		st.id = pid;
-
-		ret =
-		    e->module->auth_init(&e->auth_ctx, e, e->vhost_auth_ctx, &st);
-		if (ret == ERR_AUTH_CONTINUE) {
-			need_continue = 1;
-		} else if (ret < 0) {
-			goto cleanup;
-		}
-	}
-
 	e->tls_auth_ok = req->tls_auth_ok;
 
 	if (req->user_agent != NULL)
@@ -836,12 +1086,24 @@ int handle_sec_auth_init(int cfd, sec_mod_st *sec, const SecAuthInitMsg *req, pi
 	       req->tls_auth_ok?"(with cert) ":"",
 	       e->acct_info.username, e->acct_info.safe_id, e->acct_info.groupname, req->ip);
 
-	if (need_continue != 0) {
-		ret = ERR_AUTH_CONTINUE;
-		goto cleanup;
+	ret = 0;
+	if (e->module) {
+		common_auth_init_st st;
+
+		st.username = req->user_name;
+		st.ip = req->ip;
+		st.our_ip = req->our_ip;
+		st.user_agent = req->user_agent;
+		st.id = pid;
+
+		/* the worker is answered once an auth thread is done */
+		if (queue_auth_job(sec, conn, e, &st, NULL) >= 0)
+			return ERR_WAIT_FOR_THREAD;
+
+		ret =
+		    e->module->auth_init(&e->auth_ctx, e, e->vhost_auth_ctx, &st);
 	}
 
-	ret = 0;
  cleanup:
 	return handle_sec_auth_res(cfd, sec, e, ret);
 }
@@ -862,4 +1124,10 @@ void sec_auth_user_deinit(sec_mod_st *sec, client_entry_st *e)
 			e->module->auth_deinit(e->auth_ctx);
 		e->auth_ctx = NULL;
 	}
+
+	/* the result of a running call is discarded */
+	if (e->auth_job != NULL) {
+		e->auth_job->e = NULL;
+		e->auth_job = NULL;
+	}
 }
@@ -21,10 +21,12 @@
 #ifndef AUTH_H
 # define AUTH_H
 
+#include <limits.h>
 #include <main.h>
 #include <sec-mod.h>
 
 #define MAX_AUTH_REQS 8
+#define AUTH_CONCURRENCY_UNLIMITED UINT_MAX
 
 typedef struct passwd_msg_st {
 	char *msg_str;
@@ -34,6 +36,9 @@ typedef struct passwd_msg_st {
 typedef struct auth_mod_st {
 	unsigned int type;
 	unsigned int allows_retries; /* whether the module allows retries of the same password */
+	/* how many calls of auth_init() and auth_pass() may run at once on
+	 * the sec-mod auth threads; zero if they must run in its main loop */
+	unsigned int concurrency;
 	void (*vhost_init)(void **vctx, void *pool, void* additional);
 	void (*vhost_deinit)(void *vctx);
 	int (*auth_init)(void **ctx, void *pool, void *vctx, const common_auth_init_st *);
@@ -41,12 +41,16 @@
 #include <base64-helper.h>
 #include <tlslib.h>
 #include <sec-mod.h>
+#include <sec-mod-sup-config.h>
 #include <ccan/hash/hash.h>
 #include <ccan/htable/htable.h>
 
 #include <gnutls/gnutls.h>
 #include <gnutls/crypto.h>
 
+#define STATE_MAGIC "ocserv-state-1\n"
+#define STATE_MAGIC_SIZE (sizeof(STATE_MAGIC)-1)
+
 static size_t rehash(const void *_e, void *unused)
 {
 	const client_entry_st *e = _e;
@@ -219,3 +223,243 @@ void expire_client_entry(sec_mod_st *sec, client_entry_st * e)
 		}
 	}
 }
+
+/* Writes the authenticated client entries to the state-file, so that
+ * they can be restored by sec_mod_client_db_load() after a restart.
+ * The file is a magic string followed by SecmClientStateMsg records,
+ * each prefixed by its length, and is replaced atomically.
+ */
+void sec_mod_client_db_save(sec_mod_st *sec)
+{
+	struct htable *db = sec->client_db;
+	const char *file = GETPCONFIG(sec)->state_file;
+	SecmClientStateMsg msg;
+	client_entry_st *t;
+	struct htable_iter iter;
+	char *tmp_file;
+	void *lpool;
+	uint8_t *buf;
+	size_t len;
+	unsigned count = 0;
+	time_t now = time(0);
+	int fd, e;
+
+	if (file == NULL || db == NULL)
+		return;
+
+	lpool = talloc_new(sec);
+	if (lpool == NULL)
+		return;
+
+	tmp_file = talloc_asprintf(lpool, "%s.tmp", file);
+	if (tmp_file == NULL)
+		goto cleanup;
+
+	fd = open(tmp_file, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+	if (fd == -1) {
+		e = errno;
+		seclog(sec, LOG_ERR, "could not open '%s': %s", tmp_file, strerror(e));
+		goto cleanup;
+	}
+
+	if (force_write(fd, STATE_MAGIC, STATE_MAGIC_SIZE) < 0)
+		goto fail;
+
+	for (t = htable_first(db, &iter); t != NULL; t = htable_next(db, &iter)) {
+		if (t->status != PS_AUTH_COMPLETED || IS_CLIENT_ENTRY_EXPIRED(sec, t, now))
+			continue;
+
+		/* that config is obtained using the authentication context,
+		 * which cannot be restored */
+		if (t->vhost->perm_config.sup_config_type == SUP_CONFIG_RADIUS)
+			continue;
+
+		secm_client_state_msg__init(&msg);
+		msg.sid.data = t->sid;
+		msg.sid.len = sizeof(t->sid);
+		msg.vhost = t->vhost->name;
+		msg.username = t->acct_info.username;
+		msg.groupname = t->acct_info.groupname;
+		msg.remote_ip = t->acct_info.remote_ip;
+		msg.our_ip = t->acct_info.our_ip;
+		msg.user_agent = t->acct_info.user_agent;
+		msg.auth_type = t->auth_type;
+		msg.tls_auth_ok = t->tls_auth_ok;
+		msg.session_is_open = t->session_is_open;
+		msg.created = t->created;
+		msg.ipv4_seed = t->ipv4_seed;
+		msg.bytes_in = t->saved_stats.bytes_in + t->stats.bytes_in;
+		msg.bytes_out = t->saved_stats.bytes_out + t->stats.bytes_out;
+		msg.uptime = t->saved_stats.uptime + t->stats.uptime;
+
+		/* a session in use expires as if it was closed now */
+		if (t->in_use > 0)
+			msg.exptime = now + t->vhost->perm_config.config->cookie_timeout + AUTH_SLACK_TIME;
+		else
+			msg.exptime = (int64_t)t->exptime;
+
+		len = secm_client_state_msg__get_packed_size(&msg);
+		buf = talloc_size(lpool, 4 + len);
+		if (buf == NULL)
+			goto fail;
+
+		buf[0] = (len >> 24) & 0xff;
+		buf[1] = (len >> 16) & 0xff;
+		buf[2] = (len >> 8) & 0xff;
+		buf[3] = len & 0xff;
+		secm_client_state_msg__pack(&msg, buf + 4);
+
+		if (force_write(fd, buf, 4 + len) < 0)
+			goto fail;
+		talloc_free(buf);
+		count++;
+	}
+
+	if (fsync(fd) == -1)
+		goto fail;
+	close(fd);
+
+	if (rename(tmp_file, file) == -1) {
+		e = errno;
+		seclog(sec, LOG_ERR, "could not rename '%s' to '%s': %s", tmp_file, file, strerror(e));
+		remove(tmp_file);
+		goto cleanup;
+	}
+
+	seclog(sec, LOG_DEBUG, "saved %u sessions to '%s'", count, file);
+	goto cleanup;
+
+ fail:
+	e = errno;
+	seclog(sec, LOG_ERR, "could not write '%s': %s", tmp_file, strerror(e));
+	close(fd);
+	remove(tmp_file);
+ cleanup:
+	talloc_free(lpool);
+}
+
+static int restore_client_entry(sec_mod_st *sec, const SecmClientStateMsg *msg, time_t now)
+{
+	struct htable *db = sec->client_db;
+	vhost_cfg_st *vhost;
+	client_entry_st *e;
+
+	if (msg->sid.len != SID_SIZE || find_client_entry(sec, msg->sid.data) != NULL)
+		return -1;
+
+	vhost = find_vhost(sec->vconfig, msg->vhost);
+	if (msg->vhost != NULL && (vhost->name == NULL || c_strcasecmp(vhost->name, msg->vhost) != 0))
+		return -1;
+
+	if (vhost->perm_config.sup_config_type == SUP_CONFIG_RADIUS)
+		return -1;
+
+	e = talloc_zero(db, client_entry_st);
+	if (e == NULL)
+		return -1;
+
+	memcpy(e->sid, msg->sid.data, SID_SIZE);
+	e->vhost = vhost;
+	e->created = msg->created;
+	e->exptime = (time_t)(int64_t)msg->exptime;
+	if IS_CLIENT_ENTRY_EXPIRED(sec, e, now)
+		goto fail;
+
+	/* the method may no longer be enabled */
+	if (set_module(sec, vhost, e, msg->auth_type) < 0 || e->auth_type != msg->auth_type)
+		goto fail;
+
+	strlcpy(e->acct_info.username, msg->username, sizeof(e->acct_info.username));
+	strlcpy(e->acct_info.groupname, msg->groupname, sizeof(e->acct_info.groupname));
+	strlcpy(e->acct_info.remote_ip, msg->remote_ip, sizeof(e->acct_info.remote_ip));
+	strlcpy(e->acct_info.our_ip, msg->our_ip, sizeof(e->acct_info.our_ip));
+	strlcpy(e->acct_info.user_agent, msg->user_agent, sizeof(e->acct_info.user_agent));
+	calc_safe_id(e->sid, SID_SIZE, (char *)e->acct_info.safe_id, sizeof(e->acct_info.safe_id));
+
+	e->status = PS_AUTH_COMPLETED;
+	e->tls_auth_ok = msg->tls_auth_ok;
+	e->session_is_open = msg->session_is_open;
+	e->ipv4_seed = msg->ipv4_seed;
+	e->ipv4_seed_set = 1;
+	e->saved_stats.bytes_in = msg->bytes_in;
+	e->saved_stats.bytes_out = msg->bytes_out;
+	e->saved_stats.uptime = msg->uptime;
+
+	if (htable_add(db, rehash(e, NULL), e) == 0)
+		goto fail;
+
+	return 0;
+ fail:
+	talloc_free(e);
+	return -1;
+}
+
+/* Restores the client entries saved by sec_mod_client_db_save().
+ * The restored sessions have no authentication context; they can be
+ * used with their cookie, but cannot be re-authenticated.
+ */
+void sec_mod_client_db_load(sec_mod_st *sec)
+{
+	const char *file = GETPCONFIG(sec)->state_file;
+	PROTOBUF_ALLOCATOR(pa, sec);
+	SecmClientStateMsg *msg;
+	struct stat st;
+	uint8_t *buf = NULL;
+	size_t pos, len;
+	unsigned count = 0;
+	time_t now = time(0);
+	int fd, e;
+
+	if (file == NULL)
+		return;
+
+	fd = open(file, O_RDONLY|O_CLOEXEC);
+	if (fd == -1) {
+		e = errno;
+		if (e != ENOENT)
+			seclog(sec, LOG_ERR, "could not open '%s': %s", file, strerror(e));
+		return;
+	}
+
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+		goto fail;
+
+	if (st.st_uid != geteuid() || (st.st_mode & (S_IWGRP|S_IWOTH)) != 0) {
+		seclog(sec, LOG_ERR, "ignoring '%s' which is writable by other users", file);
+		goto cleanup;
+	}
+
+	buf = talloc_size(sec, st.st_size + 1);
+	if (buf == NULL || force_read(fd, buf, st.st_size) < 0)
+		goto fail;
+
+	if (st.st_size < STATE_MAGIC_SIZE || memcmp(buf, STATE_MAGIC, STATE_MAGIC_SIZE) != 0) {
+		seclog(sec, LOG_ERR, "ignoring '%s' which is not a state-file", file);
+		goto cleanup;
+	}
+
+	for (pos = STATE_MAGIC_SIZE; pos + 4 <= (size_t)st.st_size; pos += len) {
+		len = ((size_t)buf[pos] << 24) | (buf[pos+1] << 16) | (buf[pos+2] << 8) | buf[pos+3];
+		pos += 4;
+		if (len > (size_t)st.st_size - pos)
+			break;
+
+		msg = secm_client_state_msg__unpack(&pa, len, buf + pos);
+		if (msg == NULL)
+			continue;
+
+		if (restore_client_entry(sec, msg, now) == 0)
+			count++;
+		secm_client_state_msg__free_unpacked(msg, &pa);
+	}
+
+	seclog(sec, LOG_INFO, "restored %u sessions from '%s'", count, file);
+	goto cleanup;
+
+ fail:
+	e = errno;
+	seclog(sec, LOG_ERR, "could not read '%s': %s", file, strerror(e));
+ cleanup:
+	talloc_free(buf);
+	close(fd);
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This file is part of ocserv.
+ *
+ * ocserv is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ocserv is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <syslog.h>
+#include <common.h>
+#include <vpn.h>
+#include <tlslib.h>
+#include <sec-mod.h>
+#include <gettime.h>
+#include <cloexec.h>
+#include <gnutls/gnutls.h>
+#include <gnutls/abstract.h>
+#ifdef ENABLE_WORKER_THREADS
+# include <pthread.h>
+#endif
+
+/* Runs a private key operation of a worker using the handle of the
+ * given copy of the key, or the first one if there is no such copy.
+ */
+int sec_mod_key_op(vhost_cfg_st *vhost, unsigned copy, uint8_t cmd, unsigned key_idx,
+		   unsigned sig, const gnutls_datum_t *data, gnutls_datum_t *out)
+{
+	gnutls_privkey_t key = NULL;
+
+	if (copy > 0 && copy < vhost->key_copies)
+		key = vhost->key[copy * vhost->key_size + key_idx];
+	if (key == NULL)
+		key = vhost->key[key_idx];
+
+	switch (cmd) {
+#if GNUTLS_VERSION_NUMBER >= 0x030600
+	case CMD_SEC_SIGN_DATA:
+		return gnutls_privkey_sign_data2(key, sig, 0, data, out);
+	case CMD_SEC_SIGN_HASH:
+		return gnutls_privkey_sign_hash2(key, sig, 0, data, out);
+#endif
+	case CMD_SEC_DECRYPT:
+		return gnutls_privkey_decrypt_data(key, 0, data, out);
+	default:
+		return gnutls_privkey_sign_hash(key, 0,
+						GNUTLS_PRIVKEY_SIGN_FLAG_TLS1_RSA,
+						data, out);
+	}
+}
+
+/* The number of handles to load for each URL key */
+unsigned sec_mod_key_copies(struct perm_cfg_st *config)
+{
+	if (config->sec_mod_signers == 0 || config->pkcs11_key_concurrency <= 1)
+		return 1;
+
+	return MIN(config->sec_mod_signers, config->pkcs11_key_concurrency);
+}
+
+void sec_mod_key_op_stats(sec_mod_st *sec, uint64_t start_us)
+{
+	uint64_t us = gettime_mono_us() - start_us;
+
+	if (us > UINT32_MAX)
+		us = UINT32_MAX;
+
+	sec->key_ops++;
+	if (us > sec->max_key_op_us)
+		sec->max_key_op_us = us;
+	sec->avg_key_op_us = ((uint64_t)sec->avg_key_op_us*(sec->key_ops-1) + us) / sec->key_ops;
+}
+
+void sec_mod_signers_free_job(sec_mod_sign_job_st *job)
+{
+	free(job->data.data);
+	gnutls_free(job->out.data);
+	free(job);
+}
+
+#ifdef ENABLE_WORKER_THREADS
+
+/* The keys are shared by the signer threads, except for the URL ones
+ * which have a handle per copy; a handle of these is used by one
+ * thread at a time. */
+static pthread_mutex_t *copy_lock;
+static unsigned copies;
+
+static void sign_job_run(sec_mod_job_st *_job, unsigned thread)
+{
+	sec_mod_sign_job_st *job = (sec_mod_sign_job_st *)_job;
+	unsigned copy = thread % copies;
+	unsigned serialize;
+
+	serialize = gnutls_url_is_supported(job->vhost->perm_config.key[job->key_idx]);
+	if (serialize)
+		pthread_mutex_lock(&copy_lock[copy]);
+	job->ret = sec_mod_key_op(job->vhost, copy, job->cmd, job->key_idx,
+				  job->sig, &job->data, &job->out);
+	if (serialize)
+		pthread_mutex_unlock(&copy_lock[copy]);
+}
+
+int sec_mod_signers_init(sec_mod_st *sec, unsigned threads, unsigned key_copies)
+{
+	unsigned i;
+
+	copy_lock = talloc_array(sec, pthread_mutex_t, key_copies);
+	if (copy_lock == NULL)
+		return -1;
+
+	for (i = 0; i < key_copies; i++)
+		pthread_mutex_init(&copy_lock[i], NULL);
+	copies = key_copies;
+
+	sec->signers = sec_mod_threads_init(sec, "signer", threads);
+	if (sec->signers == NULL)
+		return -1;
+
+	return 0;
+}
+
+/* Queues a key operation for the connection; done() is called in the
+ * main loop once it is run. Returns the number of the queued
+ * operations, or a negative number on error.
+ */
+int sec_mod_signers_queue(sec_mod_st *sec, sec_mod_conn_st *conn, uint8_t cmd,
+			  vhost_cfg_st *vhost, unsigned key_idx, unsigned sig,
+			  const gnutls_datum_t *data,
+			  int (*done)(sec_mod_st *sec, sec_mod_job_st *job, void *pool))
+{
+	sec_mod_sign_job_st *job;
+	int ret;
+
+	job = calloc(1, sizeof(*job));
+	if (job == NULL)
+		return -1;
+
+	job->data.data = malloc(data->size);
+	if (job->data.data == NULL && data->size > 0) {
+		free(job);
+		return -1;
+	}
+	memcpy(job->data.data, data->data, data->size);
+	job->data.size = data->size;
+
+	job->job.run = sign_job_run;
+	job->job.done = done;
+	job->job.conn = conn;
+	job->cmd = cmd;
+	job->vhost = vhost;
+	job->key_idx = key_idx;
+	job->sig = sig;
+
+	ret = sec_mod_threads_queue(sec->signers, &job->job);
+	if (ret < 0)
+		sec_mod_signers_free_job(job);
+
+	return ret;
+}
+
+#else
+
+int sec_mod_signers_init(sec_mod_st *sec, unsigned threads, unsigned key_copies)
+{
+	return -1;
+}
+
+int sec_mod_signers_queue(sec_mod_st *sec, sec_mod_conn_st *conn, uint8_t cmd,
+			  vhost_cfg_st *vhost, unsigned key_idx, unsigned sig,
+			  const gnutls_datum_t *data,
+			  int (*done)(sec_mod_st *sec, sec_mod_job_st *job, void *pool))
+{
+	return -1;
+}
+
+#endif
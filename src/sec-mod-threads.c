@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This file is part of ocserv.
+ *
+ * ocserv is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ocserv is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <syslog.h>
+#include <common.h>
+#include <vpn.h>
+#include <sec-mod.h>
+#include <gettime.h>
+#include <cloexec.h>
+#ifdef ENABLE_WORKER_THREADS
+# include <pthread.h>
+#endif
+
+#ifdef ENABLE_WORKER_THREADS
+
+/* The jobs are queued to the threads, which put them to the done list
+ * once run, and wake up the main loop through the pipe. A queued job
+ * is skipped while the running ones of its class reach its limit.
+ */
+struct sec_mod_threads_st {
+	pthread_mutex_t lock;
+	pthread_cond_t cond; /* for the threads: a job may be run */
+	pthread_cond_t idle; /* for sec_mod_threads_wait() */
+
+	sec_mod_job_st *queue;
+	sec_mod_job_st **queue_tail;
+	sec_mod_job_st *done;
+	unsigned queued;
+	unsigned active;
+
+	sec_mod_job_st **running; /* the job of each thread */
+	unsigned threads;
+	int fd[2];
+};
+
+typedef struct job_thread_st {
+	struct sec_mod_threads_st *t;
+	unsigned idx;
+} job_thread_st;
+
+/* Removes and returns the first queued job which may run */
+static sec_mod_job_st *next_job(struct sec_mod_threads_st *t)
+{
+	sec_mod_job_st **p, *job;
+	unsigned i, running;
+
+	for (p = &t->queue; *p != NULL; p = &(*p)->next) {
+		job = *p;
+
+		if (job->cls_limit > 0) {
+			running = 0;
+			for (i = 0; i < t->threads; i++) {
+				if (t->running[i] != NULL && t->running[i]->cls == job->cls)
+					running++;
+			}
+			if (running >= job->cls_limit)
+				continue;
+		}
+
+		*p = job->next;
+		if (*p == NULL)
+			t->queue_tail = p;
+		t->queued--;
+		return job;
+	}
+
+	return NULL;
+}
+
+static void *job_thread(void *arg)
+{
+	job_thread_st *jt = arg;
+	struct sec_mod_threads_st *t = jt->t;
+	sec_mod_job_st *job;
+	int ret;
+
+	for (;;) {
+		pthread_mutex_lock(&t->lock);
+		while ((job = next_job(t)) == NULL)
+			pthread_cond_wait(&t->cond, &t->lock);
+
+		t->running[jt->idx] = job;
+		t->active++;
+		pthread_mutex_unlock(&t->lock);
+
+		job->run(job, jt->idx);
+
+		pthread_mutex_lock(&t->lock);
+		t->running[jt->idx] = NULL;
+		t->active--;
+		job->next = t->done;
+		t->done = job;
+		/* a skipped job of the same class may run now */
+		if (t->queued > 0)
+			pthread_cond_broadcast(&t->cond);
+		if (t->queued == 0 && t->active == 0)
+			pthread_cond_broadcast(&t->idle);
+		pthread_mutex_unlock(&t->lock);
+
+		/* if the pipe is full, the main loop is yet to read it */
+		do {
+			ret = write(t->fd[1], "", 1);
+		} while (ret == -1 && errno == EINTR);
+	}
+
+	return NULL;
+}
+
+/* Starts a pool of threads; returns NULL if none could be started */
+struct sec_mod_threads_st *sec_mod_threads_init(sec_mod_st *sec, const char *name, unsigned threads)
+{
+	struct sec_mod_threads_st *t;
+	job_thread_st *jt;
+	pthread_attr_t attr;
+	pthread_t thread;
+	unsigned i;
+	int ret;
+
+	t = talloc_zero(sec, struct sec_mod_threads_st);
+	if (t == NULL)
+		return NULL;
+
+	t->running = talloc_zero_array(t, sec_mod_job_st *, threads);
+	jt = talloc_array(t, job_thread_st, threads);
+	if (t->running == NULL || jt == NULL)
+		goto fail;
+
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_cond_init(&t->cond, NULL);
+	pthread_cond_init(&t->idle, NULL);
+	t->queue_tail = &t->queue;
+	t->threads = threads;
+
+	ret = pipe(t->fd);
+	if (ret == -1)
+		goto fail;
+	set_non_block(t->fd[0]);
+	set_non_block(t->fd[1]);
+	set_cloexec_flag(t->fd[0], 1);
+	set_cloexec_flag(t->fd[1], 1);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	for (i = 0; i < threads; i++) {
+		jt[i].t = t;
+		jt[i].idx = i;
+
+		ret = pthread_create(&thread, &attr, job_thread, &jt[i]);
+		if (ret != 0) {
+			seclog(sec, LOG_ERR, "could not create %s thread: %s",
+			       name, strerror(ret));
+			break;
+		}
+	}
+	pthread_attr_destroy(&attr);
+
+	if (i == 0) {
+		close(t->fd[0]);
+		close(t->fd[1]);
+		goto fail;
+	}
+
+	seclog(sec, LOG_DEBUG, "started %u %s threads", i, name);
+	return t;
+
+ fail:
+	talloc_free(t);
+	return NULL;
+}
+
+/* The descriptor which becomes readable when there are done jobs */
+int sec_mod_threads_fd(struct sec_mod_threads_st *t)
+{
+	return t->fd[0];
+}
+
+/* Queues a job. Returns the number of the queued jobs, or a negative
+ * number on error.
+ */
+int sec_mod_threads_queue(struct sec_mod_threads_st *t, sec_mod_job_st *job)
+{
+	int ret;
+
+	job->next = NULL;
+	job->queued_us = gettime_mono_us();
+	if (job->conn != NULL)
+		job->conn->job = job;
+
+	pthread_mutex_lock(&t->lock);
+	*t->queue_tail = job;
+	t->queue_tail = &job->next;
+	ret = ++t->queued;
+	pthread_cond_signal(&t->cond);
+	pthread_mutex_unlock(&t->lock);
+
+	return ret;
+}
+
+/* Returns the list of the done jobs */
+sec_mod_job_st *sec_mod_threads_done(struct sec_mod_threads_st *t)
+{
+	sec_mod_job_st *done;
+	char buf[64];
+
+	while (read(t->fd[0], buf, sizeof(buf)) > 0)
+		;
+
+	pthread_mutex_lock(&t->lock);
+	done = t->done;
+	t->done = NULL;
+	pthread_mutex_unlock(&t->lock);
+
+	return done;
+}
+
+/* Waits until no job is queued or running, for up to timeout seconds
+ * unless that is zero. Returns -1 if jobs remain.
+ */
+int sec_mod_threads_wait(struct sec_mod_threads_st *t, unsigned timeout)
+{
+	struct timespec ts;
+	int ret = 0;
+
+	if (t == NULL)
+		return 0;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout;
+
+	pthread_mutex_lock(&t->lock);
+	while ((t->queued > 0 || t->active > 0) && ret == 0) {
+		if (timeout == 0)
+			pthread_cond_wait(&t->idle, &t->lock);
+		else
+			ret = pthread_cond_timedwait(&t->idle, &t->lock, &ts);
+	}
+	ret = (t->queued > 0 || t->active > 0) ? -1 : 0;
+	pthread_mutex_unlock(&t->lock);
+
+	return ret;
+}
+
+#else
+
+struct sec_mod_threads_st *sec_mod_threads_init(sec_mod_st *sec, const char *name, unsigned threads)
+{
+	return NULL;
+}
+
+int sec_mod_threads_fd(struct sec_mod_threads_st *t)
+{
+	return -1;
+}
+
+int sec_mod_threads_queue(struct sec_mod_threads_st *t, sec_mod_job_st *job)
+{
+	return -1;
+}
+
+sec_mod_job_st *sec_mod_threads_done(struct sec_mod_threads_st *t)
+{
+	return NULL;
+}
+
+int sec_mod_threads_wait(struct sec_mod_threads_st *t, unsigned timeout)
+{
+	return 0;
+}
+
+#endif
@@ -24,7 +24,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
-#include <sys/select.h>
+#include <poll.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -43,6 +43,7 @@
 #include <sec-mod-sup-config.h>
 #include <sec-mod-resume.h>
 #include <cloexec.h>
+#include <gettime.h>
 #include <assert.h>
 
 #include <gnutls/gnutls.h>
@@ -50,6 +51,8 @@
 #include <gnutls/abstract.h>
 
 #define MAINTAINANCE_TIME 310
+/* how long a reload or the exit waits for the auth threads */
+#define AUTH_THREADS_WAIT_SECS 5
 
 static int need_maintainance = 0;
 static int need_reload = 0;
@@ -195,12 +198,32 @@ static int handle_op(void *pool, int cfd, sec_mod_st * sec, uint8_t type, uint8_
 	return 0;
 }
 
+/* Answers the connection of a key operation run by a signer thread */
+static int key_op_done(sec_mod_st *sec, sec_mod_job_st *_job, void *pool)
+{
+	sec_mod_sign_job_st *job = (sec_mod_sign_job_st *)_job;
+	int ret = -1;
+
+	if (job->ret < 0) {
+		seclog(sec, LOG_INFO, "error in crypto operation: %s",
+		       gnutls_strerror(job->ret));
+	} else {
+		sec_mod_key_op_stats(sec, job->job.queued_us);
+		ret = handle_op(pool, job->job.conn->fd, sec, job->cmd, job->out.data, job->out.size);
+	}
+
+	sec_mod_signers_free_job(job);
+	return ret;
+}
+
 static
-int process_worker_packet(void *pool, int cfd, pid_t pid, sec_mod_st *sec, cmd_request_t cmd,
-		   uint8_t * buffer, size_t buffer_size)
+int process_worker_packet(void *pool, int cfd, pid_t pid, sec_mod_conn_st *conn,
+			  sec_mod_st *sec, cmd_request_t cmd,
+			  uint8_t * buffer, size_t buffer_size)
 {
 	unsigned i;
 	gnutls_datum_t data, out;
+	uint64_t start;
 	int ret;
 	SecOpMsg *op;
 	vhost_cfg_st *vhost;
@@ -254,42 +277,6 @@ int process_worker_packet(void *pool, int cfd, pid_t pid, sec_mod_st *sec, cmd_r
 
 	case CMD_SEC_SIGN_DATA:
 	case CMD_SEC_SIGN_HASH:
-		op = sec_op_msg__unpack(&pa, data.size, data.data);
-		if (op == NULL) {
-			seclog(sec, LOG_INFO, "error unpacking sec op\n");
-			return -1;
-		}
-
-		vhost = find_vhost(sec->vconfig, op->vhost);
-		assert(vhost != NULL);
-
-		i = op->key_idx;
-		if (op->has_key_idx == 0 || i >= vhost->key_size) {
-			seclog(sec, LOG_INFO,
-			       "%sreceived out-of-bounds key index (%d); have %d keys", PREFIX_VHOST(vhost), i, vhost->key_size);
-			return -1;
-		}
-
-		data.data = op->data.data;
-		data.size = op->data.len;
-
-		if (cmd == CMD_SEC_SIGN_DATA) {
-			ret = gnutls_privkey_sign_data2(vhost->key[i], op->sig, 0, &data, &out);
-		} else {
-			ret = gnutls_privkey_sign_hash2(vhost->key[i], op->sig, 0, &data, &out);
-		}
-		sec_op_msg__free_unpacked(op, &pa);
-
-		if (ret < 0) {
-			seclog(sec, LOG_INFO, "error in crypto operation: %s",
-			       gnutls_strerror(ret));
-			return -1;
-		}
-
-		ret = handle_op(pool, cfd, sec, cmd, out.data, out.size);
-		gnutls_free(out.data);
-
-		return ret;
 #endif
 	case CMD_SEC_SIGN:
 	case CMD_SEC_DECRYPT:
@@ -312,16 +299,20 @@ int process_worker_packet(void *pool, int cfd, pid_t pid, sec_mod_st *sec, cmd_r
 		data.data = op->data.data;
 		data.size = op->data.len;
 
-		if (cmd == CMD_SEC_DECRYPT) {
-			ret =
-			    gnutls_privkey_decrypt_data(vhost->key[i], 0, &data,
-							&out);
-		} else {
-			ret =
-			    gnutls_privkey_sign_hash(vhost->key[i], 0,
-						     GNUTLS_PRIVKEY_SIGN_FLAG_TLS1_RSA,
-						     &data, &out);
+		/* the connection is answered once a signer thread is done */
+		if (sec->signers != NULL && conn != NULL) {
+			ret = sec_mod_signers_queue(sec, conn, cmd, vhost, i, op->sig, &data,
+						    key_op_done);
+			if (ret >= 0) {
+				if ((unsigned)ret > sec->max_key_op_queue)
+					sec->max_key_op_queue = ret;
+				sec_op_msg__free_unpacked(op, &pa);
+				return ERR_WAIT_FOR_THREAD;
+			}
 		}
+
+		start = gettime_mono_us();
+		ret = sec_mod_key_op(vhost, 0, cmd, i, op->sig, &data, &out);
 		sec_op_msg__free_unpacked(op, &pa);
 
 		if (ret < 0) {
@@ -329,6 +320,7 @@ int process_worker_packet(void *pool, int cfd, pid_t pid, sec_mod_st *sec, cmd_r
 			       gnutls_strerror(ret));
 			return -1;
 		}
+		sec_mod_key_op_stats(sec, start);
 
 		ret = handle_op(pool, cfd, sec, cmd, out.data, out.size);
 		gnutls_free(out.data);
@@ -361,7 +353,7 @@ int process_worker_packet(void *pool, int cfd, pid_t pid, sec_mod_st *sec, cmd_r
 				return -1;
 			}
 
-			ret = handle_sec_auth_init(cfd, sec, auth_init, pid);
+			ret = handle_sec_auth_init(cfd, sec, conn, auth_init, pid);
 			sec_auth_init_msg__free_unpacked(auth_init, &pa);
 			return ret;
 		}
@@ -376,7 +368,7 @@ int process_worker_packet(void *pool, int cfd, pid_t pid, sec_mod_st *sec, cmd_r
 				return -1;
 			}
 
-			ret = handle_sec_auth_cont(cfd, sec, auth_cont);
+			ret = handle_sec_auth_cont(cfd, sec, conn, auth_cont);
 			sec_auth_cont_msg__free_unpacked(auth_cont, &pa);
 			return ret;
 		}
@@ -589,6 +581,9 @@ static void send_stats_to_main(sec_mod_st *sec)
 		sec->auth_failures = 0;
 		sec->avg_auth_time = 0;
 		sec->max_auth_time = 0;
+		sec->avg_key_op_us = 0;
+		sec->max_key_op_us = 0;
+		sec->key_ops = 0;
 		sec->last_stats_reset = now;
 	}
 
@@ -597,8 +592,15 @@ static void send_stats_to_main(sec_mod_st *sec)
 	msg.secmod_auth_failures = sec->auth_failures;
 	msg.secmod_avg_auth_time = sec->avg_auth_time;
 	msg.secmod_max_auth_time = sec->max_auth_time;
-	/* we only report the number of failures since last call */
+	msg.secmod_avg_key_op_us = sec->avg_key_op_us;
+	msg.has_secmod_avg_key_op_us = 1;
+	msg.secmod_max_key_op_us = sec->max_key_op_us;
+	msg.has_secmod_max_key_op_us = 1;
+	msg.secmod_max_key_op_queue = sec->max_key_op_queue;
+	msg.has_secmod_max_key_op_queue = 1;
+	/* we only report the number of failures and the longest queue since last call */
 	sec->auth_failures = 0;
+	sec->max_key_op_queue = 0;
 
 	/* the following two are not resettable */
 	msg.secmod_client_entries = sec_mod_client_db_elems(sec);
@@ -620,6 +622,11 @@ static void reload_server(sec_mod_st *sec)
 	vhost_cfg_st *vhost = NULL;
 
 	seclog(sec, LOG_DEBUG, "reloading configuration");
+	sec_mod_threads_wait(sec->signers, 0);
+	/* the backend calls use the per-vhost contexts of the modules,
+	 * which are kept over a reload, but not the configuration */
+	if (sec_mod_threads_wait(sec->auth_threads, AUTH_THREADS_WAIT_SECS) < 0)
+		seclog(sec, LOG_ERR, "reloading while authentication backend calls are still running");
 	reload_cfg_file(sec, sec->vconfig, 1);
 	load_keys(sec, 0);
 
@@ -638,14 +645,25 @@ static void check_other_work(sec_mod_st *sec)
 	if (need_exit) {
 		unsigned i;
 
+		sec_mod_threads_wait(sec->signers, 0);
+		/* a hung backend call is abandoned, and the memory it
+		 * may use is left to the exit */
+		if (sec_mod_threads_wait(sec->auth_threads, AUTH_THREADS_WAIT_SECS) < 0) {
+			seclog(sec, LOG_ERR, "exiting while authentication backend calls are still running");
+			sec_mod_client_db_save(sec);
+			exit(0);
+		}
+
 		list_for_each(sec->vconfig, vhost, list) {
-			for (i = 0; i < vhost->key_size; i++) {
-				gnutls_privkey_deinit(vhost->key[i]);
+			for (i = 0; i < vhost->key_size * vhost->key_copies; i++) {
+				if (vhost->key[i] != NULL)
+					gnutls_privkey_deinit(vhost->key[i]);
 				vhost->key[i] = NULL;
 			}
 			vhost->key_size = 0;
 		}
 
+		sec_mod_client_db_save(sec);
 		sec_mod_client_db_deinit(sec);
 		tls_cache_deinit(&sec->tls_db);
 		talloc_free(sec->config_pool);
@@ -660,6 +678,7 @@ static void check_other_work(sec_mod_st *sec)
 	if (need_maintainance) {
 		seclog(sec, LOG_DEBUG, "performing maintenance");
 		cleanup_client_entries(sec);
+		sec_mod_client_db_save(sec);
 		expire_tls_sessions(sec);
 		send_stats_to_main(sec);
 		seclog(sec, LOG_DEBUG, "active sessions %d", 
@@ -720,7 +739,8 @@ int serve_request_main(sec_mod_st *sec, int fd, uint8_t *buffer, unsigned buffer
 }
 
 static
-int serve_request_worker(sec_mod_st *sec, int cfd, pid_t pid, uint8_t *buffer, unsigned buffer_size)
+int serve_request_worker(sec_mod_st *sec, int cfd, pid_t pid, sec_mod_conn_st *conn,
+			 uint8_t *buffer, unsigned buffer_size)
 {
 	int ret, e;
 	uint8_t cmd;
@@ -752,8 +772,8 @@ int serve_request_worker(sec_mod_st *sec, int cfd, pid_t pid, uint8_t *buffer, u
 		goto leave;
 	}
 
-	ret = process_worker_packet(pool, cfd, pid, sec, cmd, buffer, ret);
-	if (ret < 0) {
+	ret = process_worker_packet(pool, cfd, pid, conn, sec, cmd, buffer, ret);
+	if (ret < 0 && ret != ERR_WAIT_FOR_THREAD) {
 		seclog(sec, LOG_DEBUG, "error processing '%s' command (%d)", cmd_request_to_str(cmd), ret);
 	}
 	
@@ -761,10 +781,101 @@ int serve_request_worker(sec_mod_st *sec, int cfd, pid_t pid, uint8_t *buffer, u
 	return ret;
 }
 
+/* Keeps the connection of a worker open for its subsequent requests,
+ * in a slot of the polled descriptors. On memory error NULL is
+ * returned, and the connection is served once and closed.
+ */
+static sec_mod_conn_st *keep_worker_conn(sec_mod_st *sec, int cfd, pid_t pid)
+{
+	sec_mod_conn_st *conn;
+	struct pollfd *pfd;
+	sec_mod_conn_st **pfd_conn;
+	unsigned size;
+
+	if (sec->pfd_total == sec->pfd_size) {
+		size = sec->pfd_size * 2;
+
+		pfd = talloc_realloc(sec, sec->pfd, struct pollfd, size);
+		if (pfd == NULL)
+			return NULL;
+		sec->pfd = pfd;
+
+		pfd_conn = talloc_realloc(sec, sec->pfd_conn, sec_mod_conn_st *, size);
+		if (pfd_conn == NULL)
+			return NULL;
+		sec->pfd_conn = pfd_conn;
+
+		sec->pfd_size = size;
+	}
+
+	conn = talloc_zero(sec, sec_mod_conn_st);
+	if (conn == NULL)
+		return NULL;
+
+	conn->fd = cfd;
+	conn->pid = pid;
+	conn->idx = sec->pfd_total++;
+
+	sec->pfd[conn->idx].fd = cfd;
+	sec->pfd[conn->idx].events = POLLIN;
+	sec->pfd[conn->idx].revents = 0;
+	sec->pfd_conn[conn->idx] = conn;
+	return conn;
+}
+
+/* The last connection takes the slot of the closed one */
+static void close_worker_conn(sec_mod_st *sec, sec_mod_conn_st *conn)
+{
+	unsigned last = --sec->pfd_total;
+
+	if (conn->idx != last) {
+		sec->pfd[conn->idx] = sec->pfd[last];
+		sec->pfd_conn[conn->idx] = sec->pfd_conn[last];
+		sec->pfd_conn[conn->idx]->idx = conn->idx;
+	}
+
+	close(conn->fd);
+	talloc_free(conn);
+}
+
+/* A connection is not polled while it waits for a job */
+static void suspend_worker_conn(sec_mod_st *sec, sec_mod_conn_st *conn)
+{
+	sec->pfd[conn->idx].fd = -1;
+}
+
+void sec_mod_conn_resume(sec_mod_st *sec, sec_mod_conn_st *conn)
+{
+	sec->pfd[conn->idx].fd = conn->fd;
+}
+
+/* Completes the jobs the threads of the pool are done with. The
+ * connections of these are read again, unless they are closed on
+ * failure. */
+static void complete_jobs(sec_mod_st *sec, struct sec_mod_threads_st *t, void *pool)
+{
+	sec_mod_job_st *job, *next;
+	sec_mod_conn_st *conn;
+	int ret;
+
+	for (job = sec_mod_threads_done(t); job != NULL; job = next) {
+		next = job->next;
+		conn = job->conn;
+		if (conn != NULL) {
+			conn->job = NULL;
+			sec_mod_conn_resume(sec, conn);
+		}
+
+		ret = job->done(sec, job, pool);
+		if (ret < 0 && conn != NULL)
+			close_worker_conn(sec, conn);
+	}
+}
+
 #define CHECK_LOOP_ERR(x) \
 	if (force != 0) { GNUTLS_FATAL_ERR(x); } \
 	else { if (ret < 0) { \
-		seclog(sec, LOG_ERR, "could not reload key %s", vhost->perm_config.key[i]); \
+		seclog(sec, LOG_ERR, "could not reload key %s", vhost->perm_config.key[i % vhost->key_size]); \
 		continue; } \
 	}
 
@@ -801,34 +912,40 @@ static int load_keys(sec_mod_st *sec, unsigned force)
 		 */
 		if (vhost->key == NULL) {
 			vhost->key_size = vhost->perm_config.key_size;
-			vhost->key = talloc_zero_size(sec, sizeof(*vhost->key) * vhost->perm_config.key_size);
+			vhost->key_copies = sec_mod_key_copies(GETPCONFIG(sec));
+			vhost->key = talloc_zero_size(sec, sizeof(*vhost->key) * vhost->perm_config.key_size * vhost->key_copies);
 			if (vhost->key == NULL) {
 				seclog(sec, LOG_ERR, "error in memory allocation");
 				exit(1);
 			}
 		}
 
-		/* read private keys */
-		for (i = 0; i < vhost->key_size; i++) {
+		/* read private keys; the copies of the URL keys are
+		 * separate handles (e.g., PKCS #11 sessions) for the
+		 * signer threads */
+		for (i = 0; i < vhost->key_size * vhost->key_copies; i++) {
 			gnutls_privkey_t p;
+			const char *file = vhost->perm_config.key[i % vhost->key_size];
+
+			if (i >= vhost->key_size && gnutls_url_is_supported(file) == 0)
+				continue;
 
 			ret = gnutls_privkey_init(&p);
 			CHECK_LOOP_ERR(ret);
 
 			/* load the private key */
-			if (gnutls_url_is_supported(vhost->perm_config.key[i]) != 0) {
+			if (gnutls_url_is_supported(file) != 0) {
 				gnutls_privkey_set_pin_function(p,
 								pin_callback, &vhost->pins);
 				ret =
-				    gnutls_privkey_import_url(p,
-							      vhost->perm_config.key[i], 0);
+				    gnutls_privkey_import_url(p, file, 0);
 				CHECK_LOOP_ERR(ret);
 			} else {
 				gnutls_datum_t data;
-				ret = gnutls_load_file(vhost->perm_config.key[i], &data);
+				ret = gnutls_load_file(file, &data);
 				if (ret < 0) {
 					seclog(sec, LOG_ERR, "error loading file '%s'",
-					       vhost->perm_config.key[i]);
+					       file);
 					CHECK_LOOP_ERR(ret);
 				}
 
@@ -891,20 +1008,19 @@ void sec_mod_server(void *main_pool, void *config_pool, struct list_head *vconfi
 {
 	struct sockaddr_un sa;
 	socklen_t sa_len;
-	int cfd, ret, e, n;
-	unsigned buffer_size;
+	int cfd, ret, e;
+	unsigned buffer_size, idx;
 	uid_t uid;
 	uint8_t *buffer;
 	int sd;
 	sec_mod_st *sec;
 	void *sec_mod_pool;
 	vhost_cfg_st *vhost = NULL;
-	fd_set rd_set;
 	pid_t pid;
-#ifdef HAVE_PSELECT
+	sec_mod_conn_st *conn;
+	uint64_t wait_us;
+#ifdef HAVE_PPOLL
 	struct timespec ts;
-#else
-	struct timeval ts;
 #endif
 	sigset_t emptyset, blockset;
 
@@ -931,6 +1047,7 @@ void sec_mod_server(void *main_pool, void *config_pool, struct list_head *vconfi
 	}
 
 	sec->vconfig = vconfig;
+	list_head_init(&sec->auth_jobs);
 	sec->config_pool = config_pool;
 	sec->sec_mod_pool = sec_mod_pool;
 
@@ -963,6 +1080,7 @@ void sec_mod_server(void *main_pool, void *config_pool, struct list_head *vconfi
 		seclog(sec, LOG_ERR, "error in client db initialization");
 		exit(1);
 	}
+	sec_mod_client_db_load(sec);
 
 	sd = socket(AF_UNIX, SOCK_STREAM, 0);
 	if (sd == -1) {
@@ -1004,42 +1122,63 @@ void sec_mod_server(void *main_pool, void *config_pool, struct list_head *vconfi
 	}
 
 	sigprocmask(SIG_BLOCK, &blockset, &sig_default_set);
-	alarm(MAINTAINANCE_TIME);
-	seclog(sec, LOG_INFO, "sec-mod initialized (socket: %s)", SOCKET_FILE);
 
+	/* the threads are started with the signals blocked */
+	if (GETPCONFIG(sec)->sec_mod_signers > 0) {
+		ret = sec_mod_signers_init(sec, GETPCONFIG(sec)->sec_mod_signers,
+					   sec_mod_key_copies(GETPCONFIG(sec)));
+		if (ret < 0)
+			seclog(sec, LOG_ERR, "could not start the signer threads; running the key operations inline");
+	}
 
-	for (;;) {
-		check_other_work(sec);
+	if (GETPCONFIG(sec)->sec_mod_auth_threads > 0) {
+		sec->auth_threads = sec_mod_threads_init(sec, "auth", GETPCONFIG(sec)->sec_mod_auth_threads);
+		if (sec->auth_threads == NULL)
+			seclog(sec, LOG_ERR, "could not start the auth threads; running the auth backends inline");
+	}
 
-		FD_ZERO(&rd_set);
-		n = 0;
+	sec->pfd_size = SEC_MOD_POLL_CONNS + 64;
+	sec->pfd = talloc_array(sec, struct pollfd, sec->pfd_size);
+	sec->pfd_conn = talloc_zero_array(sec, sec_mod_conn_st *, sec->pfd_size);
+	if (sec->pfd == NULL || sec->pfd_conn == NULL) {
+		seclog(sec, LOG_ERR, "error in memory allocation");
+		exit(1);
+	}
 
-		FD_SET(cmd_fd, &rd_set);
-		n = MAX(n, cmd_fd);
+	sec->pfd[SEC_POLL_CMD_SYNC].fd = cmd_fd_sync;
+	sec->pfd[SEC_POLL_CMD].fd = cmd_fd;
+	sec->pfd[SEC_POLL_SIGNERS].fd = (sec->signers != NULL) ? sec_mod_threads_fd(sec->signers) : -1;
+	sec->pfd[SEC_POLL_AUTH_THREADS].fd = (sec->auth_threads != NULL) ? sec_mod_threads_fd(sec->auth_threads) : -1;
+	sec->pfd[SEC_POLL_LISTEN].fd = sd;
+	for (idx = 0; idx < SEC_MOD_POLL_CONNS; idx++)
+		sec->pfd[idx].events = POLLIN;
+	sec->pfd_total = SEC_MOD_POLL_CONNS;
+
+	alarm(MAINTAINANCE_TIME);
+	seclog(sec, LOG_INFO, "sec-mod initialized (socket: %s)", SOCKET_FILE);
 
-		FD_SET(cmd_fd_sync, &rd_set);
-		n = MAX(n, cmd_fd_sync);
 
-		FD_SET(sd, &rd_set);
-		n = MAX(n, sd);
+	for (;;) {
+		check_other_work(sec);
 
-#ifdef HAVE_PSELECT
-		ts.tv_nsec = 0;
-		ts.tv_sec = 120;
-		ret = pselect(n + 1, &rd_set, NULL, NULL, &ts, &emptyset);
+		/* wake up for the next auth backend call to time out */
+		wait_us = sec_auth_next_deadline(sec, 120 * 1000000ULL);
+#ifdef HAVE_PPOLL
+		ts.tv_nsec = (wait_us % 1000000) * 1000;
+		ts.tv_sec = wait_us / 1000000;
+		ret = ppoll(sec->pfd, sec->pfd_total, &ts, &emptyset);
 #else
-		ts.tv_usec = 0;
-		ts.tv_sec = 120;
 		sigprocmask(SIG_UNBLOCK, &blockset, NULL);
-		ret = select(n + 1, &rd_set, NULL, NULL, &ts);
+		ret = poll(sec->pfd, sec->pfd_total, (wait_us + 999) / 1000);
 		sigprocmask(SIG_BLOCK, &blockset, NULL);
 #endif
+		sec_auth_expire_jobs(sec);
 		if (ret == 0 || (ret == -1 && errno == EINTR))
 			continue;
 
 		if (ret < 0) {
 			e = errno;
-			seclog(sec, LOG_ERR, "Error in pselect(): %s",
+			seclog(sec, LOG_ERR, "Error in poll(): %s",
 			       strerror(e));
 			exit(1);
 		}
@@ -1056,7 +1195,7 @@ void sec_mod_server(void *main_pool, void *config_pool, struct list_head *vconfi
 		/* we use two fds for communication with main. The synchronous is for
 		 * ping-pong communication which each request is answered immediated. The
 		 * async is for messages sent back and forth in no particular order */
-		if (FD_ISSET(cmd_fd_sync, &rd_set)) {
+		if (sec->pfd[SEC_POLL_CMD_SYNC].revents) {
 			ret = serve_request_main(sec, cmd_fd_sync, buffer, buffer_size);
 			if (ret < 0 && ret == ERR_BAD_COMMAND) {
 				seclog(sec, LOG_ERR, "error processing sync command from main");
@@ -1064,7 +1203,7 @@ void sec_mod_server(void *main_pool, void *config_pool, struct list_head *vconfi
 			}
 		}
 
-		if (FD_ISSET(cmd_fd, &rd_set)) {
+		if (sec->pfd[SEC_POLL_CMD].revents) {
 			ret = serve_request_main(sec, cmd_fd, buffer, buffer_size);
 			if (ret < 0 && ret == ERR_BAD_COMMAND) {
 				seclog(sec, LOG_ERR, "error processing async command from main");
@@ -1072,7 +1211,31 @@ void sec_mod_server(void *main_pool, void *config_pool, struct list_head *vconfi
 			}
 		}
 		
-		if (FD_ISSET(sd, &rd_set)) {
+		if (sec->pfd[SEC_POLL_SIGNERS].revents)
+			complete_jobs(sec, sec->signers, buffer);
+
+		if (sec->pfd[SEC_POLL_AUTH_THREADS].revents)
+			complete_jobs(sec, sec->auth_threads, buffer);
+
+		/* the workers' requests are answered in order; on a failed
+		 * one the connection is closed, as the worker may no longer
+		 * be in sync. A connection with a queued job is not read
+		 * until that is answered. The slots are walked from the last,
+		 * as the last connection takes the slot of a closed one. */
+		for (idx = sec->pfd_total; idx-- > SEC_MOD_POLL_CONNS;) {
+			if (sec->pfd[idx].revents == 0)
+				continue;
+
+			conn = sec->pfd_conn[idx];
+			memset(buffer, 0, buffer_size);
+			ret = serve_request_worker(sec, conn->fd, conn->pid, conn, buffer, buffer_size);
+			if (ret < 0 && ret != ERR_WAIT_FOR_THREAD)
+				close_worker_conn(sec, conn);
+			else if (conn->job != NULL)
+				suspend_worker_conn(sec, conn);
+		}
+
+		if (sec->pfd[SEC_POLL_LISTEN].revents) {
 			sa_len = sizeof(sa);
 			cfd = accept(sd, (struct sockaddr *)&sa, &sa_len);
 			if (cfd == -1) {
@@ -1093,11 +1256,18 @@ void sec_mod_server(void *main_pool, void *config_pool, struct list_head *vconfi
 					     &uid, &pid);
 			if (ret < 0) {
 				seclog(sec, LOG_INFO, "rejected unauthorized connection");
+				close(cfd);
 			} else {
 				memset(buffer, 0, buffer_size);
-				serve_request_worker(sec, cfd, pid, buffer, buffer_size);
+				conn = keep_worker_conn(sec, cfd, pid);
+				ret = serve_request_worker(sec, cfd, pid, conn, buffer, buffer_size);
+				if (conn == NULL)
+					close(cfd);
+				else if (ret < 0 && ret != ERR_WAIT_FOR_THREAD)
+					close_worker_conn(sec, conn);
+				else if (conn->job != NULL)
+					suspend_worker_conn(sec, conn);
 			}
-			close(cfd);
 		}
  cont:
 		talloc_free(buffer);
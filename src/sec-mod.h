@@ -21,6 +21,7 @@
 #ifndef SEC_MOD_H
 # define SEC_MOD_H
 
+#include <poll.h>
 #include <gnutls/abstract.h>
 #include <ccan/htable/htable.h>
 #include <nettle/base64.h>
@@ -32,6 +33,61 @@
 #define SESSION_STR "(session: %.6s)"
 #define MAX_GROUPS 32
 
+/* The fixed slots of the polled descriptors of sec-mod */
+enum {
+	SEC_POLL_CMD_SYNC,
+	SEC_POLL_CMD,
+	SEC_POLL_SIGNERS,
+	SEC_POLL_AUTH_THREADS,
+	SEC_POLL_LISTEN,
+	SEC_MOD_POLL_CONNS /* the first slot of the worker connections */
+};
+
+struct sec_mod_job_st;
+struct sec_mod_st;
+
+/* A connection of a worker, which is kept open for its requests */
+typedef struct sec_mod_conn_st {
+	unsigned idx; /* its slot in sec_mod_st's pfd */
+	int fd;
+	pid_t pid;
+	/* the job the connection waits for; it is not read until
+	 * that is answered */
+	struct sec_mod_job_st *job;
+} sec_mod_conn_st;
+
+/* A job given to a pool of sec-mod threads. The run() function is
+ * called on one of the threads, and done() in the main loop once that
+ * is over; the latter releases the job, and returns a negative number
+ * if the connection is to be closed.
+ */
+typedef struct sec_mod_job_st {
+	struct sec_mod_job_st *next;
+	void (*run)(struct sec_mod_job_st *job, unsigned thread);
+	int (*done)(struct sec_mod_st *sec, struct sec_mod_job_st *job, void *pool);
+
+	sec_mod_conn_st *conn; /* the connection waiting for the job, if any */
+	const void *cls; /* at most cls_limit jobs of the same class run at once */
+	unsigned cls_limit; /* zero for no limit */
+	uint64_t queued_us; /* gettime_mono_us() */
+} sec_mod_job_st;
+
+/* A private key operation given to the signer threads */
+typedef struct sec_mod_sign_job_st {
+	sec_mod_job_st job;
+
+	uint8_t cmd;
+	vhost_cfg_st *vhost;
+	unsigned key_idx;
+	unsigned sig;
+	gnutls_datum_t data; /* allocated with malloc() */
+
+	int ret;
+	gnutls_datum_t out;
+} sec_mod_sign_job_st;
+
+struct sec_mod_threads_st;
+
 typedef struct sec_mod_st {
 	struct list_head *vconfig;
 	void *config_pool;
@@ -41,12 +97,29 @@ typedef struct sec_mod_st {
 	int cmd_fd;
 	int cmd_fd_sync;
 
+	/* the descriptors of the main loop; the first SEC_MOD_POLL_CONNS
+	 * slots are fixed, and the rest belong to the worker connections
+	 * of pfd_conn. A connection waiting for a job is not polled. */
+	struct pollfd *pfd;
+	sec_mod_conn_st **pfd_conn;
+	unsigned pfd_total;
+	unsigned pfd_size;
+
 	tls_sess_db_st tls_db;
 	uint64_t auth_failures; /* auth failures since the last update (SECM_CLI_STATS) we sent to main */
 	uint32_t max_auth_time; /* the maximum time spent in (sucessful) authentication */
 	uint32_t avg_auth_time; /* the average time spent in (sucessful) authentication */
 	uint32_t total_authentications; /* successful authentications: to calculate the average above */
 	time_t last_stats_reset;
+
+	struct sec_mod_threads_st *signers; /* NULL if the key operations are run inline */
+	uint32_t max_key_op_us; /* the maximum time of a key operation, including the queue */
+	uint32_t avg_key_op_us;
+	uint64_t key_ops; /* to calculate the average above */
+	unsigned max_key_op_queue; /* the longest queue since the last update we sent to main */
+
+	struct sec_mod_threads_st *auth_threads; /* NULL if the auth backends are run inline */
+	struct list_head auth_jobs; /* the pending ones, to time them out */
 } sec_mod_st;
 
 typedef struct stats_st {
@@ -75,7 +148,7 @@ typedef struct common_acct_info_st {
 	unsigned id;
 } common_acct_info_st;
 
-#define IS_CLIENT_ENTRY_EXPIRED_FULL(sec, e, now, clean) (e->exptime != -1 && now >= e->exptime && e->in_use == 0)
+#define IS_CLIENT_ENTRY_EXPIRED_FULL(sec, e, now, clean) (e->exptime != -1 && now >= e->exptime && e->in_use == 0 && e->auth_job == NULL)
 #define IS_CLIENT_ENTRY_EXPIRED(sec, e, now) IS_CLIENT_ENTRY_EXPIRED_FULL(sec, e, now, 0)
 
 typedef struct client_entry_st {
@@ -89,6 +162,10 @@ typedef struct client_entry_st {
 	void *auth_ctx; /* the context of authentication */
 	unsigned session_is_open; /* whether open_session was done */
 	unsigned in_use; /* counter of users of this structure */
+	/* the call of the module which runs on an auth thread, if any;
+	 * it holds auth_ctx meanwhile */
+	struct sec_auth_job_st *auth_job;
+	unsigned auth_timeout; /* the timeout of such a call in seconds */
 	unsigned tls_auth_ok;
 
 	char *msg_str;
@@ -108,6 +185,10 @@ typedef struct client_entry_st {
 
 	/* the auth type associated with the user */
 	unsigned auth_type;
+
+	/* the seed of the IPv4 address; set on the first session open */
+	uint32_t ipv4_seed;
+	unsigned ipv4_seed_set;
 	unsigned discon_reason; /* reason for disconnection */
 
 	struct common_acct_info_st acct_info;
@@ -127,6 +208,8 @@ typedef struct client_entry_st {
 	vhost_cfg_st *vhost;
 } client_entry_st;
 
+void sec_mod_conn_resume(sec_mod_st *sec, sec_mod_conn_st *conn);
+
 void *sec_mod_client_db_init(sec_mod_st *sec);
 void sec_mod_client_db_deinit(sec_mod_st *sec);
 unsigned sec_mod_client_db_elems(sec_mod_st *sec);
@@ -135,6 +218,25 @@ client_entry_st * find_client_entry(sec_mod_st *sec, uint8_t sid[SID_SIZE]);
 void del_client_entry(sec_mod_st *sec, client_entry_st * e);
 void expire_client_entry(sec_mod_st *sec, client_entry_st * e);
 void cleanup_client_entries(sec_mod_st *sec);
+void sec_mod_client_db_save(sec_mod_st *sec);
+void sec_mod_client_db_load(sec_mod_st *sec);
+
+int sec_mod_key_op(vhost_cfg_st *vhost, unsigned copy, uint8_t cmd, unsigned key_idx,
+		   unsigned sig, const gnutls_datum_t *data, gnutls_datum_t *out);
+unsigned sec_mod_key_copies(struct perm_cfg_st *config);
+int sec_mod_signers_init(sec_mod_st *sec, unsigned threads, unsigned copies);
+int sec_mod_signers_queue(sec_mod_st *sec, sec_mod_conn_st *conn, uint8_t cmd,
+			  vhost_cfg_st *vhost, unsigned key_idx, unsigned sig,
+			  const gnutls_datum_t *data,
+			  int (*done)(sec_mod_st *sec, sec_mod_job_st *job, void *pool));
+void sec_mod_signers_free_job(sec_mod_sign_job_st *job);
+void sec_mod_key_op_stats(sec_mod_st *sec, uint64_t start_us);
+
+struct sec_mod_threads_st *sec_mod_threads_init(sec_mod_st *sec, const char *name, unsigned threads);
+int sec_mod_threads_fd(struct sec_mod_threads_st *t);
+int sec_mod_threads_queue(struct sec_mod_threads_st *t, sec_mod_job_st *job);
+sec_mod_job_st *sec_mod_threads_done(struct sec_mod_threads_st *t);
+int sec_mod_threads_wait(struct sec_mod_threads_st *t, unsigned timeout);
 
 #ifdef __GNUC__
 # define seclog(sec, prio, fmt, ...) \
@@ -152,11 +254,14 @@ void  seclog_hex(const struct sec_mod_st* sec, int priority,
 		const char *prefix, uint8_t* bin, unsigned bin_size, unsigned b64);
 
 void sec_auth_init(struct vhost_cfg_st *vhost);
+int set_module(sec_mod_st * sec, vhost_cfg_st *vhost, client_entry_st *e, unsigned auth_type);
 
 void handle_secm_list_cookies_reply(void *pool, int fd, sec_mod_st *sec);
 void handle_sec_auth_ban_ip_reply(sec_mod_st *sec, const BanIpReplyMsg *msg);
-int handle_sec_auth_init(int cfd, sec_mod_st *sec, const SecAuthInitMsg * req, pid_t pid);
-int handle_sec_auth_cont(int cfd, sec_mod_st *sec, const SecAuthContMsg * req);
+int handle_sec_auth_init(int cfd, sec_mod_st *sec, sec_mod_conn_st *conn, const SecAuthInitMsg * req, pid_t pid);
+int handle_sec_auth_cont(int cfd, sec_mod_st *sec, sec_mod_conn_st *conn, const SecAuthContMsg * req);
+void sec_auth_expire_jobs(sec_mod_st *sec);
+uint64_t sec_auth_next_deadline(sec_mod_st *sec, uint64_t max_us);
 int handle_secm_session_open_cmd(sec_mod_st *sec, int fd, const SecmSessionOpenMsg *req);
 int handle_secm_session_close_cmd(sec_mod_st *sec, int fd, const SecmSessionCloseMsg *req);
 int handle_sec_auth_stats_cmd(sec_mod_st * sec, const CliStatsMsg * req, pid_t pid);
@@ -46,6 +46,7 @@
 #include <sys/un.h>
 #include <sys/uio.h>
 #include <sys/types.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -82,6 +83,82 @@ int cstp_uncork(worker_st *ws)
 	}
 }
 
+/* Sends the data buffered by gnutls_record_cork(). The socket is
+ * non-blocking, so wait for it to become writable on GNUTLS_E_AGAIN,
+ * for at most 10 seconds in total.
+ */
+static int cstp_flush_corked(worker_st *ws)
+{
+	struct pollfd pfd;
+	int counter = 100;
+	int ret;
+
+	for (;;) {
+		ret = gnutls_record_uncork(ws->session, 0);
+		if (ret >= 0)
+			return 0;
+
+		if (ret != GNUTLS_E_AGAIN && ret != GNUTLS_E_INTERRUPTED)
+			return ret;
+
+		if (counter-- == 0)
+			return GNUTLS_E_TIMEDOUT;
+
+		pfd.fd = ws->conn_fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		poll(&pfd, 1, 100);
+	}
+}
+
+/* Called around a batch of CSTP packets. When the TLS records are
+ * encrypted by the kernel the TCP socket is corked, so that the records
+ * of the batch are sent in full segments. Otherwise, if cstp-coalesce-size
+ * is set and the client announced that it can take several packets in a
+ * record, the packets are buffered by GnuTLS and sent in as few records
+ * as possible when the batch ends, or when that size is reached.
+ */
+void cstp_batch_start(worker_st *ws)
+{
+#if defined(HAVE_GNUTLS_KTLS) && defined(__linux__)
+	int state = 1;
+
+	if (ws->ktls & GNUTLS_KTLS_SEND) {
+		setsockopt(ws->conn_fd, IPPROTO_TCP, TCP_CORK, &state, sizeof(state));
+		return;
+	}
+#endif
+
+	if (ws->session != NULL && ws->cstp_coalescing && ws->cstp_corked == 0) {
+		gnutls_record_cork(ws->session);
+		ws->cstp_corked = 1;
+		ws->cstp_corked_size = 0;
+	}
+}
+
+int cstp_batch_end(worker_st *ws)
+{
+#if defined(HAVE_GNUTLS_KTLS) && defined(__linux__)
+	int state = 0;
+
+	if (ws->ktls & GNUTLS_KTLS_SEND) {
+		setsockopt(ws->conn_fd, IPPROTO_TCP, TCP_CORK, &state, sizeof(state));
+		return 0;
+	}
+#endif
+
+	if (ws->cstp_corked == 0)
+		return 0;
+
+	ws->cstp_corked = 0;
+	if (ws->cstp_corked_size == 0) {
+		gnutls_record_uncork(ws->session, 0);
+		return 0;
+	}
+
+	return cstp_flush_corked(ws);
+}
+
 
 ssize_t cstp_send(worker_st *ws, const void *data,
 			size_t data_size)
@@ -107,6 +184,17 @@ ssize_t cstp_send(worker_st *ws, const void *data,
 				p += ret;
 			}
 		}
+
+		if (ws->cstp_corked) {
+			ws->cstp_corked_size += data_size;
+			if (ws->cstp_corked_size >= WSCONFIG(ws)->cstp_coalesce_size) {
+				ws->cstp_corked_size = 0;
+				ret = cstp_flush_corked(ws);
+				if (ret < 0)
+					return ret;
+				gnutls_record_cork(ws->session);
+			}
+		}
 		return data_size;
 	} else {
 		return force_write(ws->conn_fd, data, data_size);
@@ -352,27 +440,18 @@ ssize_t dtls_send(worker_st *ws, const void *data,
 			size_t data_size)
 {
 	int ret;
-	int left = data_size;
-	const uint8_t* p = data;
 
-	while(left > 0) {
-		ret = gnutls_record_send(ws->dtls_session, p, data_size);
-		if (ret < 0) {
-			if (ret != GNUTLS_E_AGAIN && ret != GNUTLS_E_INTERRUPTED) {
-				return ret;
-			} else {
-				/* do not cause mayhem */
-				ms_sleep(20);
-			}
-		}
+	do {
+		ret = gnutls_record_send(ws->dtls_session, data, data_size);
+	} while (ret == GNUTLS_E_INTERRUPTED);
 
-		if (ret > 0) {
-			left -= ret;
-			p += ret;
-		}
-	}
+	/* The transport queues the records which do not fit in the socket
+	 * buffer (see dtls_push()), so this does not block; if even that is
+	 * not possible the packet is lost, as it could be in the network. */
+	if (ret == GNUTLS_E_AGAIN)
+		return data_size;
 
-	return data_size;
+	return ret;
 }
 
 void dtls_close(worker_st *ws)
@@ -670,19 +749,26 @@ int key_cb_common_func (gnutls_privkey_t key, void* userdata, const gnutls_datum
 
 	output->data = NULL;
 
-	sd = socket(AF_UNIX, SOCK_STREAM, 0);
-	if (sd == -1) {
-		e = errno;
-		syslog(LOG_ERR, "error opening socket: %s", strerror(e));
-		return GNUTLS_E_INTERNAL_ERROR;
-	}
+	if (global_ws != NULL) {
+		/* use the connection of the worker to sec-mod */
+		sd = connect_to_secmod(global_ws);
+		if (sd == -1)
+			return GNUTLS_E_INTERNAL_ERROR;
+	} else {
+		sd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (sd == -1) {
+			e = errno;
+			syslog(LOG_ERR, "error opening socket: %s", strerror(e));
+			return GNUTLS_E_INTERNAL_ERROR;
+		}
 
-	ret = connect(sd, (struct sockaddr *)&cdata->sa, cdata->sa_len);
-	if (ret == -1) {
-		e = errno;
-		syslog(LOG_ERR, "error connecting to sec-mod socket '%s': %s",
-			cdata->sa.sun_path, strerror(e));
-		goto error;
+		ret = connect(sd, (struct sockaddr *)&cdata->sa, cdata->sa_len);
+		if (ret == -1) {
+			e = errno;
+			syslog(LOG_ERR, "error connecting to sec-mod socket '%s': %s",
+				cdata->sa.sun_path, strerror(e));
+			goto error;
+		}
 	}
 
 	msg.has_key_idx = 1;
@@ -708,7 +794,8 @@ int key_cb_common_func (gnutls_privkey_t key, void* userdata, const gnutls_datum
 				strerror(e));
 		goto error;
 	}
-	close(sd);
+	if (global_ws == NULL)
+		close(sd);
 	sd = -1;
 
 	output->size = reply->data.len;
@@ -724,8 +811,12 @@ int key_cb_common_func (gnutls_privkey_t key, void* userdata, const gnutls_datum
 	return 0;
 
 error:
-	if (sd != -1)
-		close(sd);
+	if (sd != -1) {
+		if (global_ws != NULL)
+			disconnect_from_secmod(global_ws);
+		else
+			close(sd);
+	}
 	gnutls_free(output->data);
 	if (reply != NULL)
 		sec_op_msg__free_unpacked(reply, &pa);
@@ -1174,3 +1265,114 @@ size_t tls_get_overhead(gnutls_protocol_t version, gnutls_cipher_algorithm_t cip
 {
 	return gnutls_est_record_overhead_size(version, cipher, mac, GNUTLS_COMP_NULL, 0);
 }
+
+#define SKIP16(pos, total) { \
+	uint16_t _s; \
+	if (pos+2 > total) goto fallback; \
+	_s = (buffer[pos] << 8) | buffer[pos+1]; \
+	if ((size_t)(pos+2+_s) > total) goto fallback; \
+	pos += 2+_s; \
+	}
+
+#define SKIP8(pos, total) { \
+	uint8_t _s; \
+	if (pos+1 > total) goto fallback; \
+	_s = buffer[pos]; \
+	if ((size_t)(pos+1+_s) > total) goto fallback; \
+	pos += 1+_s; \
+	}
+
+#define TLS_EXT_APP_ID 48018
+
+/* This returns either the application-specific ID extension contents,
+ * or the session ID contents. The former is used on the new protocol,
+ * while the latter on the legacy protocol.
+ *
+ * Extension ID: 48018
+ * opaque ApplicationID<1..2^8-1>;
+ *
+ * struct {
+ *          ExtensionType extension_type;
+ *          opaque extension_data<0..2^16-1>;
+ *      } Extension;
+ *
+ *      struct {
+ *          ProtocolVersion server_version;
+ *          Random random;
+ *          SessionID session_id;
+ *          opaque cookie<0..2^8-1>;
+ *          CipherSuite cipher_suite;
+ *          CompressionMethod compression_method;
+ *          Extension server_hello_extension_list<0..2^16-1>;
+ *      } ServerHello;
+ */
+unsigned get_dtls_session_id(uint8_t *buffer, size_t buffer_size, unsigned psk,
+			     uint8_t **id, int *id_size)
+{
+	size_t pos;
+
+	/* A client hello packet. We can get the session ID and figure
+	 * the associated connection. */
+	if (buffer_size < RECORD_PAYLOAD_POS+DTLS_SESSION_ID_POS+GNUTLS_MAX_SESSION_ID+2) {
+		return 0;
+	}
+
+	if (!psk)
+		goto fallback;
+
+	/* try to read the extension data */
+	pos = RECORD_PAYLOAD_POS+DTLS_SESSION_ID_POS;
+	SKIP8(pos, buffer_size);
+
+	/* Cookie */
+	SKIP8(pos, buffer_size);
+
+	/* CipherSuite */
+	SKIP16(pos, buffer_size);
+
+	/* CompressionMethod */
+
+	SKIP8(pos, buffer_size);
+
+	if (pos+2 > buffer_size)
+		goto fallback;
+	pos+=2;
+
+	/* Extension(s) */
+	while (pos < buffer_size) {
+		uint16_t type;
+		uint16_t s;
+
+		if (pos+4 > buffer_size)
+			goto fallback;
+
+		type = (buffer[pos] << 8) | buffer[pos+1];
+		pos+=2;
+		if (type != TLS_EXT_APP_ID) {
+			SKIP16(pos, buffer_size);
+		} else { /* found */
+			if (pos+2 > buffer_size)
+				return 0; /* invalid format */
+
+			s = (buffer[pos] << 8) | buffer[pos+1];
+			if ((size_t)(pos+2+s) > buffer_size)
+				return 0; /* invalid format */
+			pos+=2;
+
+			s = buffer[pos];
+			if ((size_t)(pos+1+s) > buffer_size)
+				return 0; /* invalid format */
+			pos++;
+			*id_size = s;
+			*id = &buffer[pos];
+			return 1;
+		}
+	}
+
+ fallback:
+	/* read session_id */
+	*id_size = buffer[RECORD_PAYLOAD_POS+DTLS_SESSION_ID_POS];
+	*id = &buffer[RECORD_PAYLOAD_POS+DTLS_SESSION_ID_POS+1];
+
+	return 1;
+}
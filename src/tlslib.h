@@ -36,6 +36,11 @@
 #  define ZERO_COPY
 # endif
 
+# if GNUTLS_VERSION_NUMBER >= 0x030703
+#  include <gnutls/socket.h>
+#  define HAVE_GNUTLS_KTLS
+# endif
+
 #define PSK_KEY_SIZE 32
 #if TLS_MASTER_SIZE < PSK_KEY_SIZE
 # error
@@ -142,6 +147,8 @@ ssize_t cstp_send(struct worker_st *ws, const void *data,
 
 void cstp_cork(struct worker_st *ws);
 int cstp_uncork(struct worker_st *ws);
+void cstp_batch_start(struct worker_st *ws);
+int cstp_batch_end(struct worker_st *ws);
 
 /* DTLS API */
 void dtls_close(struct worker_st *ws);
@@ -162,6 +169,13 @@ ssize_t dtls_recv_packet(struct worker_st *ws, gnutls_datum_t *data, void **p);
 
 /* Helper functions */
 unsigned need_file_reload(const char *file, time_t last_access);
+
+/* DTLS record and client hello offsets */
+#define RECORD_PAYLOAD_POS 13
+#define DTLS_SESSION_ID_POS 46
+
+unsigned get_dtls_session_id(uint8_t *buffer, size_t buffer_size, unsigned psk,
+			     uint8_t **id, int *id_size);
 void safe_hash(const uint8_t *data, unsigned data_size, uint8_t output[20]);
 
 #endif
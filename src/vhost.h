@@ -51,8 +51,12 @@ typedef struct vhost_cfg_st {
 	time_t params_last_access; /* last reload/access of params in creds */
 	struct config_mod_st *config_module;
 
+	/* the keys, followed by key_copies-1 further sets of handles
+	 * for the sec-mod signers; these are only loaded for URL keys
+	 * and are NULL for the others */
 	gnutls_privkey_t *key;
 	unsigned key_size;
+	unsigned key_copies;
 
 	/* temporary values used during config loading
 	 */
@@ -61,6 +65,8 @@ typedef struct vhost_cfg_st {
 	size_t auth_size;
 	char **eauth;
 	size_t eauth_size;
+	char **auth_timeout;
+	size_t auth_timeout_size;
 	unsigned expose_iroutes;
 	unsigned auto_select_group;
 #ifdef HAVE_GSSAPI
@@ -105,6 +105,29 @@ inline static const char *proto_to_str(fw_proto_t proto)
 #define MIN_NO_COMPRESS_LIMIT 64
 #define DEFAULT_NO_COMPRESS_LIMIT 256
 
+/* The maximum number of packets the worker processes from
+ * each channel before polling again. */
+#define DEFAULT_PACKET_BATCH_SIZE 16
+#define MAX_PACKET_BATCH_SIZE 256
+#define MAX_CSTP_COALESCE_SIZE (64*1024)
+#define DEFAULT_DTLS_TX_QUEUE_SIZE 64
+#define MAX_DTLS_TX_QUEUE_SIZE 4096
+#define DEFAULT_BANDWIDTH_QUEUE_SIZE 32
+#define MAX_BANDWIDTH_QUEUE_SIZE 1024
+#define DEFAULT_FQ_CODEL_FLOWS 256
+#define MAX_FQ_CODEL_FLOWS 65536
+#define DEFAULT_FQ_CODEL_LIMIT 256
+#define MAX_FQ_CODEL_LIMIT 16384
+#define DEFAULT_FQ_CODEL_TARGET 5
+#define DEFAULT_FQ_CODEL_INTERVAL 100
+#define MAX_WORKER_POOL_SIZE 1024
+#define DEFAULT_CLIENT_HELLO_TIMEOUT 10
+#define DEFAULT_UDP_PORT_RATE_LIMIT 20
+#define DEFAULT_RATE_LIMIT_BURST 1
+#define DEFAULT_NET_RATE_LIMIT_BURST 8
+#define MAX_LISTEN_SHARDS 64
+#define MAX_SEC_MOD_THREADS 64
+
 /* The time after which a user will be forced to authenticate
  * or disconnect. */
 #define DEFAULT_AUTH_TIMEOUT_SECS 1800
@@ -193,6 +216,9 @@ typedef struct auth_struct_st {
 	unsigned type;
 	const struct auth_mod_st *amod;
 	void *auth_ctx;
+	/* the seconds a call of the backend may take when it is run on
+	 * the sec-mod auth threads; zero for the auth-timeout */
+	unsigned timeout;
 
 	bool enabled;
 } auth_struct_st;
@@ -223,6 +249,8 @@ typedef struct kkdcp_st {
 struct cfg_st {
 	unsigned int is_dyndns;
 	unsigned int listen_proxy_proto;
+	unsigned listen_shards; /* SO_REUSEPORT sockets per TCP address */
+	unsigned listen_shard_by_cpu;
 	unsigned int stats_report_time;
 
 	kkdcp_st *kkdcp;
@@ -294,19 +322,42 @@ struct cfg_st {
 	unsigned use_occtl; /* whether support for the occtl tool will be enabled */
 
 	unsigned try_mtu; /* MTU discovery enabled */
+	unsigned udp_gso; /* UDP segmentation and receive offload enabled */
+	unsigned ktls; /* kernel TLS is enabled for the CSTP channel */
 	unsigned cisco_client_compat; /* do not require client certificate, 
 	                               * and allow auth to complete in different
 	                               * TCP sessions. */
 	unsigned rate_limit_ms; /* if non zero force a connection every rate_limit milliseconds */
+	unsigned rate_limit_burst; /* connections accepted at once under rate_limit_ms */
+	unsigned net_rate_limit_ms; /* as rate_limit_ms for each /24 or /64 network */
+	unsigned net_rate_limit_burst;
+	unsigned load_shedding_threshold; /* % of max_clients from which connections are shed */
+	unsigned worker_pool_size; /* pre-forked workers waiting for connections */
+	unsigned client_hello_timeout; /* secs to wait for the TLS hello before starting a worker */
+	unsigned udp_port_rate_limit; /* datagrams per second main accepts from an address on the UDP port */
+	unsigned dtls_hello_verify; /* non zero if main does a DTLS cookie exchange before passing a UDP socket */
 	unsigned ping_leases; /* non zero if we need to ping prior to leasing */
 
 	size_t rx_per_sec;
 	size_t tx_per_sec;
+	size_t bandwidth_burst; /* token bucket size in bytes; 0 for the default */
+	unsigned bandwidth_queue_size; /* packets held by the shaper */
+	unsigned fq_codel; /* fair queueing of the packets sent to the client */
+	unsigned fq_codel_flows;
+	unsigned fq_codel_limit; /* packets */
+	unsigned fq_codel_target; /* ms */
+	unsigned fq_codel_interval; /* ms */
 	unsigned net_priority;
 
 	char *crl;
 
 	unsigned output_buffer;
+	unsigned packet_batch_size; /* packets processed per channel and wakeup */
+	unsigned io_uring; /* use io_uring in the worker's loop */
+	unsigned worker_tx_thread; /* send the tun packets from a separate thread */
+	unsigned cstp_coalesce_size; /* CSTP bytes buffered in a batch; 0 to disable */
+	unsigned dtls_tx_queue_size; /* DTLS records queued when the socket is full */
+	unsigned dtls_tx_drop_head; /* drop the oldest queued record when full */
 	unsigned default_mtu;
 	unsigned predictable_ips; /* boolean */
 
@@ -359,6 +410,7 @@ struct perm_cfg_st {
 	char *chroot_dir;	/* where the xml files are served from */
 	char* occtl_socket_file;
 	char* socket_file_prefix;
+	char *state_file; /* where sec-mod keeps the valid cookies over restarts */
 
 	uid_t uid;
 	gid_t gid;
@@ -377,6 +429,15 @@ struct perm_cfg_st {
 #endif
 
 	unsigned int stats_reset_time;
+	/* the threads of sec-mod which run the private key operations;
+	 * with zero they are run in its main loop */
+	unsigned int sec_mod_signers;
+	/* the operations which may run concurrently on a PKCS #11 key,
+	 * each using a separate session with the token */
+	unsigned int pkcs11_key_concurrency;
+	/* the threads of sec-mod which run the calls of the authentication
+	 * backends which allow it; with zero they are run in its main loop */
+	unsigned int sec_mod_auth_threads;
 	unsigned foreground;
 	unsigned no_chdir;
 	unsigned debug;
@@ -389,6 +450,9 @@ struct perm_cfg_st {
 	char* unix_conn_file;
 	unsigned int port;
 	unsigned int udp_port;
+	/* the ports handed to sessions for their own DTLS socket */
+	unsigned int dtls_port_min;
+	unsigned int dtls_port_max;
 
 	/* attic, where old config allocated values are stored */
 	struct list_head attic;
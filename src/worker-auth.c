@@ -33,6 +33,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <limits.h>
+#include <poll.h>
 #include <ipc.pb-c.h>
 #include <base64-helper.h>
 
@@ -671,6 +672,19 @@ static int recv_cookie_auth_reply(worker_st * ws)
 			if (msg->config->no_udp != 0)
 				WSPCONFIG(ws)->udp_port = 0;
 
+			/* the socket of the session's own DTLS port */
+			if (msg->has_dtls_port) {
+				ret = recv_socket_msg(ws, ws->cmd_fd, CMD_DTLS_PORT_FD,
+						      &ws->udp_port_fd, NULL, NULL,
+						      WSCONFIG(ws)->auth_timeout);
+				if (ret < 0 || ws->udp_port_fd == -1) {
+					oclog(ws, LOG_ERR, "error receiving the DTLS port socket");
+					ret = ERR_AUTH_FAIL;
+					goto cleanup;
+				}
+				ws->dtls_port = msg->dtls_port;
+			}
+
 			/* routes */
 			if (check_if_default_route(msg->config->routes, msg->config->n_routes))
 				ws->default_route = 1;
@@ -701,9 +715,26 @@ static int recv_cookie_auth_reply(worker_st * ws)
 }
 
 /* returns the fd */
+/* Returns the connection to sec-mod. It is kept open for the
+ * subsequent requests of the worker, which are answered in order.
+ * sec-mod closes it after a failed request; that is detected here
+ * and a new connection is made.
+ */
 int connect_to_secmod(worker_st * ws)
 {
 	int sd, ret, e;
+	struct pollfd pfd;
+
+	if (ws->secmod_fd != -1) {
+		/* nothing is expected to be read between requests; if it is
+		 * readable, it was closed, or holds a reply we gave up on */
+		pfd.fd = ws->secmod_fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 0) == 0)
+			return ws->secmod_fd;
+		disconnect_from_secmod(ws);
+	}
 
 	sd = socket(AF_UNIX, SOCK_STREAM, 0);
 	if (sd == -1) {
@@ -724,9 +755,22 @@ int connect_to_secmod(worker_st * ws)
 		      ws->secmod_addr.sun_path, strerror(e));
 		return -1;
 	}
+
+	ws->secmod_fd = sd;
 	return sd;
 }
 
+/* Closes the connection to sec-mod; to be called after a failed
+ * exchange, which may have left it out of sync.
+ */
+void disconnect_from_secmod(worker_st * ws)
+{
+	if (ws->secmod_fd != -1) {
+		close(ws->secmod_fd);
+		ws->secmod_fd = -1;
+	}
+}
+
 static int recv_auth_reply(worker_st * ws, int sd, char **txt, unsigned *pcounter)
 {
 	int ret;
@@ -1568,10 +1612,9 @@ int post_auth_handler(worker_st * ws, unsigned http_ver)
 	}
 
 	ret = recv_auth_reply(ws, sd, &msg, &pcounter);
-	if (sd != -1) {
-		close(sd);
-		sd = -1;
-	}
+	if (ret < 0 && ret != ERR_AUTH_CONTINUE)
+		disconnect_from_secmod(ws);
+	sd = -1;
 
 	if (ret == ERR_AUTH_CONTINUE) {
 		oclog(ws, LOG_DEBUG, "continuing authentication for '%s'",
@@ -1614,7 +1657,7 @@ int post_auth_handler(worker_st * ws, unsigned http_ver)
  auth_fail:
 
 	if (sd != -1)
-		close(sd);
+		disconnect_from_secmod(ws);
 	oclog(ws, LOG_HTTP_DEBUG, "HTTP sending: 401 Unauthorized");
 	cstp_printf(ws,
 		   "HTTP/1.%d 401 %s\r\nContent-Length: 0\r\n\r\n",
@@ -23,39 +23,149 @@
 #include <worker.h>
 #include <worker-bandwidth.h>
 #include <gettime.h>
+#include <talloc.h>
+#include <limits.h>
 
 #include <stdio.h>
 
+/* the maximum time accounted for in a single refill; the bucket is
+ * full by then for any sensible rate */
+#define MAX_REFILL_US (60*1000*1000)
 
-int _bandwidth_update(bandwidth_st* b, size_t bytes, struct timespec *now)
+int bandwidth_init(void *pool, bandwidth_st* b, size_t kb_per_sec,
+		   size_t burst, unsigned queue_size, struct timespec *now)
 {
-size_t sum;
-ssize_t t, remain;
-unsigned int diff;
-size_t transferred_kb;
+	memset(b, 0, sizeof(*b));
+	b->kb_per_sec = kb_per_sec;
+	if (kb_per_sec == 0)
+		return 0;
+
+	b->bytes_per_sec = kb_per_sec*1000;
+
+	if (burst == 0)
+		burst = (b->bytes_per_sec*DEFAULT_BURST_MS)/1000;
+	/* a packet larger than the burst could never be sent */
+	b->burst = MAX(burst, MIN_BURST_BYTES);
 
-	diff = timespec_sub_ms(now, &b->count_start);
-	if (diff >= COUNT_UPDATE_MS) {
-		transferred_kb = b->transferred_bytes / 1000;
-		transferred_kb = (transferred_kb*COUNT_UPDATE_MS)/diff;
+	b->tokens = b->burst;
+	memcpy(&b->last, now, sizeof(*now));
+
+	if (queue_size > 0) {
+		b->queue = talloc_zero_array(pool, bandwidth_pkt_st, queue_size);
+		if (b->queue == NULL)
+			return -1;
+		b->queue_size = queue_size;
+	}
 
-		memcpy(&b->count_start, now, sizeof(*now));
+	return 0;
+}
 
-		remain = b->allowed_kb - transferred_kb;
-		t = b->allowed_kb_per_count + remain;
+static void refill(bandwidth_st* b, struct timespec *now)
+{
+	int64_t us;
+	uint64_t t;
 
-		b->allowed_kb = MIN(t, b->kb_per_sec);
-		b->transferred_bytes = bytes;
-		
-		return 1;
+	us = (int64_t)(now->tv_sec - b->last.tv_sec) * 1000000 +
+	     (now->tv_nsec - b->last.tv_nsec) / 1000;
+	if (us <= 0) {
+		/* the clock went backwards */
+		if (us < 0)
+			memcpy(&b->last, now, sizeof(*now));
+		return;
 	}
-	
-	sum = b->transferred_bytes + bytes;
-	if (sum > b->allowed_kb*1000)
-		return 0; /* NO */
 
-	b->transferred_bytes = sum;
-	
+	if (us > MAX_REFILL_US)
+		us = MAX_REFILL_US;
+
+	t = ((uint64_t)us * b->bytes_per_sec) / 1000000;
+	/* keep the fractions for the next refill */
+	if (t == 0)
+		return;
+
+	b->tokens = MIN(b->tokens + t, b->burst);
+	memcpy(&b->last, now, sizeof(*now));
+}
+
+/* consumes the tokens for a packet of the given size, if available */
+static int take(bandwidth_st* b, size_t bytes)
+{
+	if (bytes > b->tokens && b->tokens < b->burst)
+		return 0;
+
+	b->tokens -= MIN(bytes, b->tokens);
+	return 1;
+}
+
+int _bandwidth_update(bandwidth_st* b, size_t bytes, struct timespec *now)
+{
+	refill(b, now);
+	return take(b, bytes);
+}
+
+/* Holds a packet until enough tokens are available. Returns
+ * a negative number if the packet was dropped. */
+int bandwidth_queue(bandwidth_st* b, const uint8_t *data, size_t size)
+{
+	bandwidth_pkt_st *pkt;
+
+	if (b->queue_count >= b->queue_size)
+		goto drop;
+
+	pkt = &b->queue[(b->queue_head + b->queue_count) % b->queue_size];
+	pkt->data = talloc_memdup(b->queue, data, size);
+	if (pkt->data == NULL)
+		goto drop;
+	pkt->size = size;
+
+	b->queue_count++;
+	return 0;
+
+ drop:
+	b->dropped++;
+	return -1;
+}
+
+/* Returns 1 and the oldest queued packet if it can be sent now,
+ * or zero otherwise. The packet's data must be released with
+ * talloc_free(). */
+int bandwidth_dequeue(bandwidth_st* b, struct timespec* now, bandwidth_pkt_st *pkt)
+{
+	bandwidth_pkt_st *head;
+
+	if (b->queue_count == 0)
+		return 0;
+
+	head = &b->queue[b->queue_head];
+
+	refill(b, now);
+	if (take(b, head->size) == 0)
+		return 0;
+
+	*pkt = *head;
+	head->data = NULL;
+	head->size = 0;
+
+	b->queue_head = (b->queue_head + 1) % b->queue_size;
+	b->queue_count--;
+
 	return 1;
 }
 
+/* Returns the milliseconds until the oldest queued packet can be
+ * sent, or UINT_MAX if there is none. */
+unsigned bandwidth_wait_ms(bandwidth_st* b, struct timespec* now)
+{
+	size_t size, deficit;
+
+	if (b->queue_count == 0)
+		return UINT_MAX;
+
+	refill(b, now);
+
+	size = MIN(b->queue[b->queue_head].size, b->burst);
+	if (size <= b->tokens)
+		return 0;
+
+	deficit = size - b->tokens;
+	return MAX(1, (deficit*1000 + b->bytes_per_sec - 1) / b->bytes_per_sec);
+}
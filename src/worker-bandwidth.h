@@ -24,30 +24,47 @@
 #include <gettime.h>
 #include <time.h>
 #include <unistd.h>
+#include <stdint.h>
 
-#define COUNT_UPDATE_MS 500
+/* The burst used when none is configured, as a fraction of
+ * a second's worth of data, and its lower limit */
+#define DEFAULT_BURST_MS 100
+#define MIN_BURST_BYTES (16*1024)
 
+typedef struct bandwidth_pkt_st {
+	uint8_t *data;
+	size_t size;
+} bandwidth_pkt_st;
+
+/* A token bucket shaper. Tokens are bytes; they accumulate at
+ * the configured rate up to the burst size. Packets that find
+ * no tokens are held in a small queue until enough tokens are
+ * available, and only dropped when that queue is full.
+ */
 typedef struct bandwidth_st {
-	struct timespec count_start;
-	size_t transferred_bytes;
-	size_t allowed_kb;
+	struct timespec last;
+	size_t tokens;
+
+	/* packets waiting for tokens, in order */
+	bandwidth_pkt_st *queue;
+	unsigned queue_size;
+	unsigned queue_head;
+	unsigned queue_count;
+	uint64_t dropped;
 
 	/* only touched once */
-	size_t allowed_kb_per_count;
+	size_t burst;
+	size_t bytes_per_sec;
 	size_t kb_per_sec;
 } bandwidth_st;
 
-inline static void bandwidth_init(bandwidth_st* b, size_t kb_per_sec)
-{
-	memset(b, 0, sizeof(*b));
-	b->kb_per_sec = kb_per_sec;
-	b->allowed_kb_per_count = (b->kb_per_sec*COUNT_UPDATE_MS)/1000;
-}
+int bandwidth_init(void *pool, bandwidth_st* b, size_t kb_per_sec,
+		    size_t burst, unsigned queue_size, struct timespec *now);
 
 int _bandwidth_update(bandwidth_st* b, size_t bytes, struct timespec* now);
 
 /* returns true or false, depending on whether to send
- * the bytes */
+ * the bytes now */
 inline static
 int bandwidth_update(bandwidth_st* b, size_t bytes, struct timespec* now)
 {
@@ -55,8 +72,15 @@ int bandwidth_update(bandwidth_st* b, size_t bytes, struct timespec* now)
 	if (b->kb_per_sec == 0)
 		return 1;
 
+	/* keep the order of queued packets */
+	if (b->queue_count > 0)
+		return 0;
+
 	return _bandwidth_update(b, bytes, now);
 }
 
+int bandwidth_queue(bandwidth_st* b, const uint8_t *data, size_t size);
+int bandwidth_dequeue(bandwidth_st* b, struct timespec* now, bandwidth_pkt_st *pkt);
+unsigned bandwidth_wait_ms(bandwidth_st* b, struct timespec* now);
 
 #endif
@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This file is part of ocserv.
+ *
+ * ocserv is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ocserv is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <sys/param.h>
+#include <talloc.h>
+#include <ccan/hash/hash.h>
+#include <worker-fq.h>
+
+struct fq_pkt_st {
+	struct fq_pkt_st *next;
+	uint64_t tstamp; /* enqueue time */
+	size_t size;
+	uint8_t data[];
+};
+
+worker_fq_st *worker_fq_init(void *pool, unsigned nflows, unsigned limit,
+			     unsigned quantum, unsigned target_ms,
+			     unsigned interval_ms, uint32_t perturbation)
+{
+	worker_fq_st *fq;
+
+	fq = talloc_zero(pool, worker_fq_st);
+	if (fq == NULL)
+		return NULL;
+
+	fq->flows = talloc_zero_array(fq, struct fq_flow_st, nflows);
+	if (fq->flows == NULL) {
+		talloc_free(fq);
+		return NULL;
+	}
+
+	fq->nflows = nflows;
+	fq->limit = limit;
+	fq->quantum = MAX(quantum, 1);
+	fq->target = (uint64_t)target_ms * 1000;
+	fq->interval = (uint64_t)interval_ms * 1000;
+	fq->perturbation = perturbation;
+	list_head_init(&fq->new_flows);
+	list_head_init(&fq->old_flows);
+
+	return fq;
+}
+
+/* Hashes the addresses, the protocol and the ports of an IP packet. The
+ * packets which cannot be parsed all go to the first flow. */
+static unsigned classify(worker_fq_st *fq, const uint8_t *data, size_t size)
+{
+	uint8_t key[2*16 + 1 + 4];
+	unsigned key_size, hlen, proto, has_ports;
+
+	if (size >= 20 && (data[0] >> 4) == 4) {
+		hlen = (data[0] & 0x0f) * 4;
+		proto = data[9];
+		memcpy(key, data + 12, 8);
+		key_size = 8;
+		/* only the first fragment has the ports */
+		has_ports = ((data[6] & 0x3f) | data[7]) == 0;
+	} else if (size >= 40 && (data[0] >> 4) == 6) {
+		hlen = 40;
+		proto = data[6];
+		memcpy(key, data + 8, 32);
+		key_size = 32;
+		has_ports = 1;
+	} else {
+		return 0;
+	}
+
+	key[key_size++] = proto;
+
+	/* TCP, UDP, UDP-Lite and SCTP */
+	if (has_ports && size >= hlen + 4 &&
+	    (proto == 6 || proto == 17 || proto == 136 || proto == 132)) {
+		memcpy(key + key_size, data + hlen, 4);
+		key_size += 4;
+	}
+
+	return hash(key, key_size, fq->perturbation) % fq->nflows;
+}
+
+static struct fq_pkt_st *flow_pop(worker_fq_st *fq, struct fq_flow_st *flow)
+{
+	struct fq_pkt_st *pkt = flow->head;
+
+	if (pkt == NULL)
+		return NULL;
+
+	flow->head = pkt->next;
+	if (flow->head == NULL)
+		flow->tail = NULL;
+	flow->backlog -= pkt->size;
+	fq->queued--;
+
+	return pkt;
+}
+
+static void codel_drop(worker_fq_st *fq, struct fq_pkt_st *pkt)
+{
+	fq->codel_drops++;
+	talloc_free(pkt);
+}
+
+/* Whether a packet, which was just removed from the flow, stayed
+ * in the queue above the target delay for at least an interval. */
+static unsigned codel_should_drop(worker_fq_st *fq, struct fq_flow_st *flow,
+				  struct fq_pkt_st *pkt, uint64_t now)
+{
+	if (pkt == NULL || now - pkt->tstamp < fq->target ||
+	    flow->backlog <= fq->quantum) {
+		flow->first_above_time = 0;
+		return 0;
+	}
+
+	if (flow->first_above_time == 0)
+		flow->first_above_time = now + fq->interval;
+	else if (now >= flow->first_above_time)
+		return 1;
+
+	return 0;
+}
+
+static unsigned isqrt(unsigned n)
+{
+	unsigned r = 0, b = 1u << 30;
+
+	while (b > n)
+		b >>= 2;
+
+	while (b != 0) {
+		if (n >= r + b) {
+			n -= r + b;
+			r = (r >> 1) + b;
+		} else {
+			r >>= 1;
+		}
+		b >>= 2;
+	}
+
+	return r;
+}
+
+static uint64_t codel_control_law(worker_fq_st *fq, uint64_t t, unsigned count)
+{
+	return t + fq->interval / MAX(isqrt(count), 1);
+}
+
+/* The CoDel dequeue algorithm, as in RFC 8289 */
+static struct fq_pkt_st *codel_dequeue(worker_fq_st *fq, struct fq_flow_st *flow,
+				       uint64_t now)
+{
+	struct fq_pkt_st *pkt;
+	unsigned drop, delta;
+
+	pkt = flow_pop(fq, flow);
+	drop = codel_should_drop(fq, flow, pkt, now);
+
+	if (flow->dropping) {
+		if (drop == 0) {
+			flow->dropping = 0;
+			return pkt;
+		}
+
+		while (now >= flow->drop_next && flow->dropping) {
+			codel_drop(fq, pkt);
+			flow->count++;
+
+			pkt = flow_pop(fq, flow);
+			if (codel_should_drop(fq, flow, pkt, now) == 0)
+				flow->dropping = 0;
+			else
+				flow->drop_next = codel_control_law(fq, flow->drop_next, flow->count);
+		}
+	} else if (drop != 0) {
+		codel_drop(fq, pkt);
+
+		pkt = flow_pop(fq, flow);
+		codel_should_drop(fq, flow, pkt, now);
+		flow->dropping = 1;
+
+		/* start from the previous drop rate if the last dropping
+		 * state ended recently */
+		delta = flow->count - flow->last_count;
+		if (delta > 1 && now - flow->drop_next < 16 * fq->interval)
+			flow->count = delta;
+		else
+			flow->count = 1;
+
+		flow->drop_next = codel_control_law(fq, now, flow->count);
+		flow->last_count = flow->count;
+	}
+
+	return pkt;
+}
+
+/* Drops the oldest packet of the flow with the largest backlog */
+static void drop_overlimit(worker_fq_st *fq)
+{
+	struct fq_flow_st *fat = NULL;
+	unsigned i;
+
+	for (i = 0; i < fq->nflows; i++) {
+		if (fat == NULL || fq->flows[i].backlog > fat->backlog)
+			fat = &fq->flows[i];
+	}
+
+	fq->overlimit_drops++;
+	talloc_free(flow_pop(fq, fat));
+}
+
+/* Queues a packet. Returns a negative number if the queue is full
+ * and the packet itself was dropped. */
+int worker_fq_enqueue(worker_fq_st *fq, const uint8_t *data, size_t size,
+		      uint64_t now)
+{
+	struct fq_flow_st *flow;
+	struct fq_pkt_st *pkt;
+
+	pkt = talloc_size(fq, sizeof(*pkt) + size);
+	if (pkt == NULL) {
+		fq->overlimit_drops++;
+		return -1;
+	}
+
+	pkt->next = NULL;
+	pkt->tstamp = now;
+	pkt->size = size;
+	memcpy(pkt->data, data, size);
+
+	flow = &fq->flows[classify(fq, data, size)];
+	if (flow->tail != NULL)
+		flow->tail->next = pkt;
+	else
+		flow->head = pkt;
+	flow->tail = pkt;
+	flow->backlog += size;
+	fq->queued++;
+
+	if (flow->active == 0) {
+		list_add_tail(&fq->new_flows, &flow->list);
+		flow->active = 1;
+		flow->deficit = fq->quantum;
+		fq->active_flows++;
+	}
+
+	if (fq->queued > fq->limit) {
+		drop_overlimit(fq);
+		/* the new packet was dropped if it was alone in the
+		 * largest flow */
+		if (flow->tail != pkt)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Copies the next packet to be sent to buf, and returns its size,
+ * or zero if there are no packets queued. */
+ssize_t worker_fq_dequeue(worker_fq_st *fq, uint8_t *buf, size_t buf_size,
+			  uint64_t now)
+{
+	struct fq_flow_st *flow;
+	struct fq_pkt_st *pkt;
+	struct list_head *head;
+	ssize_t size;
+
+	for (;;) {
+		if (!list_empty(&fq->new_flows))
+			head = &fq->new_flows;
+		else if (!list_empty(&fq->old_flows))
+			head = &fq->old_flows;
+		else
+			return 0;
+
+		flow = list_top(head, struct fq_flow_st, list);
+
+		if (flow->deficit <= 0) {
+			flow->deficit += fq->quantum;
+			list_del(&flow->list);
+			list_add_tail(&fq->old_flows, &flow->list);
+			continue;
+		}
+
+		pkt = codel_dequeue(fq, flow, now);
+		if (pkt == NULL) {
+			list_del(&flow->list);
+			/* an emptied new flow goes to the old flows once, so
+			 * that it cannot gain priority by staying sparse */
+			if (head == &fq->new_flows && !list_empty(&fq->old_flows)) {
+				list_add_tail(&fq->old_flows, &flow->list);
+			} else {
+				flow->active = 0;
+				fq->active_flows--;
+			}
+			continue;
+		}
+
+		flow->deficit -= pkt->size;
+
+		if (pkt->size > buf_size) {
+			fq->overlimit_drops++;
+			talloc_free(pkt);
+			continue;
+		}
+
+		memcpy(buf, pkt->data, pkt->size);
+		size = pkt->size;
+		talloc_free(pkt);
+
+		return size;
+	}
+}
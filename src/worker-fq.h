@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This file is part of ocserv.
+ *
+ * ocserv is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ocserv is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef WORKER_FQ_H
+# define WORKER_FQ_H
+
+#include <stdint.h>
+#include <unistd.h>
+#include <ccan/list/list.h>
+
+struct fq_pkt_st;
+
+struct fq_flow_st {
+	struct fq_pkt_st *head;
+	struct fq_pkt_st *tail;
+	size_t backlog; /* bytes */
+	int deficit;
+
+	/* the new or old flows list, if active */
+	struct list_node list;
+	unsigned active;
+
+	/* CoDel state */
+	uint64_t first_above_time;
+	uint64_t drop_next;
+	unsigned count;
+	unsigned last_count;
+	unsigned dropping;
+};
+
+/* A fair queueing scheduler with CoDel active queue management, in
+ * the spirit of the fq_codel queueing discipline (RFC 8290). The
+ * packets are hashed by their inner 5-tuple into flow queues which
+ * are served in deficit round robin, new flows first. Each flow drops
+ * the packets which stay in its queue longer than the target delay
+ * for an interval. All times are in microseconds.
+ */
+typedef struct worker_fq_st {
+	struct fq_flow_st *flows;
+	unsigned nflows;
+
+	struct list_head new_flows;
+	struct list_head old_flows;
+
+	unsigned limit; /* packets */
+	unsigned quantum; /* bytes */
+	uint64_t target;
+	uint64_t interval;
+	uint32_t perturbation;
+
+	/* statistics */
+	unsigned queued;
+	unsigned active_flows;
+	uint64_t overlimit_drops;
+	uint64_t codel_drops;
+} worker_fq_st;
+
+worker_fq_st *worker_fq_init(void *pool, unsigned nflows, unsigned limit,
+			     unsigned quantum, unsigned target_ms,
+			     unsigned interval_ms, uint32_t perturbation);
+int worker_fq_enqueue(worker_fq_st *fq, const uint8_t *data, size_t size,
+		      uint64_t now);
+ssize_t worker_fq_dequeue(worker_fq_st *fq, uint8_t *buf, size_t buf_size,
+			  uint64_t now);
+
+#endif
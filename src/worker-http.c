@@ -572,6 +572,10 @@ void header_value_check(struct worker_st *ws, struct http_req_st *req)
 		if (memmem(value, value_length, "true", 4) != NULL)
 			ws->full_ipv6 = 1;
 		break;
+	case HEADER_CSTP_COALESCING:
+		if (memmem(value, value_length, "true", 4) != NULL)
+			ws->cstp_coalescing = 1;
+		break;
 	case HEADER_COOKIE:
 		/* don't bother parsing cookies if we are already authenticated */
 		if (ws->auth_state > S_AUTH_COOKIE)
@@ -22,6 +22,7 @@
 
 #include <gnutls/gnutls.h>
 #include <gnutls/crypto.h>
+#include <gnutls/dtls.h>
 #include <gnutls/x509.h>
 #include <errno.h>
 #include <stdlib.h>
@@ -79,6 +80,207 @@ static unsigned recv_from_new_fd(struct worker_st *ws, int fd, UdpFdMsg **tmsg)
  	return ret;
 }
 
+/* switches the DTLS channel to fd; tmsg holds its first packet, if any */
+static void set_dtls_fd(struct worker_st *ws, int fd, UdpFdMsg *tmsg)
+{
+	if (ws->dtls_tptr.fd != -1 && ws->dtls_tptr.fd != fd)
+		close(ws->dtls_tptr.fd);
+	if (ws->dtls_tptr.msg != NULL)
+		udp_fd_msg__free_unpacked(ws->dtls_tptr.msg, NULL);
+
+	ws->dtls_tptr.msg = tmsg;
+	ws->dtls_tptr.fd = fd;
+
+	if (WSCONFIG(ws)->try_mtu == 0)
+		set_mtu_disc(fd, ws->proto, 0);
+
+	ws->udp_recv_time = time(0);
+}
+
+struct port_hello_verify_st {
+	int fd;
+	struct sockaddr_storage *cli_addr;
+	socklen_t cli_addr_len;
+};
+
+static ssize_t port_hello_verify_push(gnutls_transport_ptr_t ptr, const void *data, size_t size)
+{
+	struct port_hello_verify_st *p = ptr;
+
+	return sendto(p->fd, data, size, MSG_DONTWAIT,
+		      (struct sockaddr *)p->cli_addr, p->cli_addr_len);
+}
+
+/* Verifies that the sender of the client hello in ws->buffer can receive
+ * at its address, as main does on udp-port, before the socket is
+ * connected to it. Returns 1 and the message carrying the hello and the
+ * handshake state if the hello has a valid cookie, and 0 otherwise,
+ * after replying with a HelloVerifyRequest.
+ */
+static int port_hello_verify(struct worker_st *ws, int fd, size_t size,
+			     struct sockaddr_storage *cli_addr, socklen_t cli_addr_len,
+			     UdpFdMsg **tmsg)
+{
+	gnutls_dtls_prestate_st prestate;
+	UdpFdMsg msg = UDP_FD_MSG__INIT;
+	uint8_t *packed;
+	size_t packed_size;
+	int ret;
+
+	if (ws->dtls_cookie_key.data == NULL) {
+		ret = gnutls_key_generate(&ws->dtls_cookie_key, GNUTLS_COOKIE_KEY_SIZE);
+		if (ret < 0) {
+			oclog(ws, LOG_ERR, "could not generate DTLS cookie key: %s",
+			      gnutls_strerror(ret));
+			return 0;
+		}
+	}
+
+	memset(&prestate, 0, sizeof(prestate));
+	ret = gnutls_dtls_cookie_verify(&ws->dtls_cookie_key,
+					cli_addr, cli_addr_len,
+					ws->buffer, size, &prestate);
+	if (ret < 0) {
+		struct port_hello_verify_st hvp = {
+			.fd = fd,
+			.cli_addr = cli_addr,
+			.cli_addr_len = cli_addr_len
+		};
+
+		ret = gnutls_dtls_cookie_send(&ws->dtls_cookie_key,
+					      cli_addr, cli_addr_len,
+					      &prestate, &hvp, port_hello_verify_push);
+		if (ret < 0)
+			oclog(ws, LOG_DEBUG, "could not send DTLS cookie");
+		else
+			oclog(ws, LOG_DEBUG, "sent DTLS cookie");
+		return 0;
+	}
+
+	/* the same message main passes with a socket on udp-port */
+	msg.data.data = ws->buffer;
+	msg.data.len = size;
+	msg.has_record_seq = 1;
+	msg.record_seq = prestate.record_seq;
+	msg.has_hsk_read_seq = 1;
+	msg.hsk_read_seq = prestate.hsk_read_seq;
+	msg.has_hsk_write_seq = 1;
+	msg.hsk_write_seq = prestate.hsk_write_seq;
+
+	packed_size = udp_fd_msg__get_packed_size(&msg);
+	packed = talloc_size(ws, packed_size);
+	if (packed == NULL)
+		return 0;
+	udp_fd_msg__pack(&msg, packed);
+
+	*tmsg = udp_fd_msg__unpack(NULL, packed_size, packed);
+	talloc_free(packed);
+
+	return (*tmsg != NULL);
+}
+
+/* Handles the first packet received on the session's own DTLS port
+ * (see dtls-port-range). The socket is connected to the sender if the
+ * packet is a client hello with our session ID (and a valid cookie when
+ * dtls-hello-verify applies), or, once the DTLS session is set up, if it
+ * comes from the client's address (its NAT changed the port). Other
+ * packets are discarded.
+ */
+int dtls_port_accept(struct worker_st *ws)
+{
+	struct sockaddr_storage cli_addr;
+	socklen_t cli_addr_len = sizeof(cli_addr);
+	UdpFdMsg *tmsg = NULL;
+	uint8_t *id;
+	int id_size;
+	unsigned hello;
+	ssize_t ret;
+	int fd = ws->udp_port_fd;
+
+	/* the packet is left in the socket for the DTLS session */
+	ret = recvfrom(fd, ws->buffer, sizeof(ws->buffer), MSG_PEEK,
+		       (struct sockaddr *)&cli_addr, &cli_addr_len);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		oclog(ws, LOG_INFO, "error receiving in DTLS port: %s", strerror(errno));
+		goto discard;
+	}
+
+	if (ret < RECORD_PAYLOAD_POS)
+		goto discard;
+
+	hello = (ws->buffer[0] == 22);
+	if (hello) {
+		if (!get_dtls_session_id(ws->buffer, ret, WSCONFIG(ws)->dtls_psk, &id, &id_size) ||
+		    id_size != sizeof(ws->session_id) ||
+		    memcmp(id, ws->session_id, id_size) != 0) {
+			oclog(ws, LOG_DEBUG, "discarding DTLS hello of another session");
+			goto discard;
+		}
+
+		/* the pre-standard DTLS 0.9 clients do not support
+		 * HelloVerifyRequest */
+		if (WSCONFIG(ws)->dtls_hello_verify && ws->buffer[1] == 254) {
+			if (!port_hello_verify(ws, fd, ret, &cli_addr, cli_addr_len, &tmsg))
+				goto discard;
+			/* the hello is passed to the session in tmsg */
+			recv(fd, ws->buffer, 1, 0);
+		}
+	} else if (ws->dtls_session == NULL ||
+		   ip_cmp(&cli_addr, &ws->remote_addr) != 0) {
+		goto discard;
+	}
+
+	if (connect(fd, (struct sockaddr *)&cli_addr, cli_addr_len) < 0) {
+		oclog(ws, LOG_ERR, "connect DTLS port: %s", strerror(errno));
+		if (tmsg != NULL) {
+			udp_fd_msg__free_unpacked(tmsg, NULL);
+			return 0;
+		}
+		goto discard;
+	}
+
+	if (hello) {
+		ws->udp_state = UP_SETUP;
+	} else if (!recv_from_new_fd(ws, fd, &tmsg)) {
+		oclog(ws, LOG_INFO, "received packet in DTLS port but its session has invalid data!");
+		ws->udp_port_waiting = 0;
+		dtls_port_release(ws);
+		return 0;
+	}
+
+	set_dtls_fd(ws, fd, tmsg);
+	ws->udp_port_waiting = 0;
+
+	oclog(ws, LOG_DEBUG, "DTLS port connected to peer");
+	return 0;
+
+ discard:
+	recv(fd, ws->buffer, 1, 0);
+	return 0;
+}
+
+/* Disconnects the session's own DTLS socket, so that the client can
+ * reach it again, possibly from another address or port. */
+void dtls_port_release(struct worker_st *ws)
+{
+	struct sockaddr sa;
+
+	if (ws->udp_port_fd == -1 || ws->udp_port_waiting)
+		return;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_family = AF_UNSPEC;
+	if (connect(ws->udp_port_fd, &sa, sizeof(sa)) < 0) {
+		oclog(ws, LOG_INFO, "could not disconnect DTLS port: %s", strerror(errno));
+		return;
+	}
+
+	oclog(ws, LOG_DEBUG, "DTLS port disconnected from peer");
+	ws->udp_port_waiting = 1;
+}
+
 int handle_commands_from_main(struct worker_st *ws)
 {
 	uint8_t cmd;
@@ -127,7 +329,16 @@ int handle_commands_from_main(struct worker_st *ws)
 				goto udp_fd_fail;
 			}
 
+			if (ws->udp_port_fd != -1) {
+				oclog(ws, LOG_DEBUG, "ignoring UDP fd; the session has its own DTLS port");
+				if (tmsg)
+					udp_fd_msg__free_unpacked(tmsg, NULL);
+				close(fd);
+				return 0;
+			}
+
 			set_non_block(fd);
+			dtls_udp_gro_check(ws, fd);
 			if (has_hello == 0) {
 				/* check if the first packet received is a valid one -
 				 * if not discard the new fd */
@@ -142,19 +353,9 @@ int handle_commands_from_main(struct worker_st *ws)
 				ws->udp_state = UP_SETUP;
 			}
 
-			if (ws->dtls_tptr.fd != -1)
-				close(ws->dtls_tptr.fd);
-			if (ws->dtls_tptr.msg != NULL)
-				udp_fd_msg__free_unpacked(ws->dtls_tptr.msg, NULL);
-
-			ws->dtls_tptr.msg = tmsg;
-			ws->dtls_tptr.fd = fd;
-
-			if (WSCONFIG(ws)->try_mtu == 0)
-				set_mtu_disc(fd, ws->proto, 0);
+			set_dtls_fd(ws, fd, tmsg);
 
 			oclog(ws, LOG_DEBUG, "received new UDP fd and connected to peer");
-			ws->udp_recv_time = time(0);
 
 			return 0;
 
@@ -29,6 +29,7 @@
 #include <sys/syscall.h>
 #include <seccomp.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <errno.h>
 
 /* libseccomp 2.4.2 broke accidentally the API. Work around it. */
@@ -81,6 +82,43 @@ int disable_system_calls(struct worker_st *ws)
 #endif
 	ADD_SYSCALL(recvmsg, 0);
 	ADD_SYSCALL(sendmsg, 0);
+#ifdef HAVE_RECVMMSG
+	ADD_SYSCALL(recvmmsg, 0);
+#endif
+#ifdef HAVE_SENDMMSG
+	ADD_SYSCALL(sendmmsg, 0);
+#endif
+#ifdef ENABLE_IO_URING
+	/* the ring and its buffer ring are created, mapped and restricted
+	 * before the filter is loaded; only submitting to it is allowed
+	 * here. The allocator may still map the TUN buffers, but no
+	 * executable mapping is allowed. */
+	if (GETCONFIG(ws)->io_uring) {
+		ADD_SYSCALL(io_uring_enter, 0);
+		ADD_SYSCALL(mmap, 1, SCMP_A2(SCMP_CMP_MASKED_EQ, PROT_EXEC, 0));
+		ADD_SYSCALL(munmap, 0);
+	}
+#endif
+
+#ifdef ENABLE_WORKER_THREADS
+	/* the transmit thread exists already (worker_tx_thread_init()),
+	 * and it is filtered too; no new thread or executable mapping
+	 * is allowed */
+	if (GETCONFIG(ws)->worker_tx_thread) {
+		ret = seccomp_attr_set(ctx, SCMP_FLTATR_CTL_TSYNC, 1);
+		if (ret < 0) {
+			oclog(ws, LOG_DEBUG, "could not synchronize the seccomp filter of the threads: %s", strerror(-ret));
+			ret = -1;
+			goto fail;
+		}
+
+		ADD_SYSCALL(futex, 0);
+		ADD_SYSCALL(mmap, 1, SCMP_A2(SCMP_CMP_MASKED_EQ, PROT_EXEC, 0));
+		ADD_SYSCALL(mprotect, 1, SCMP_A2(SCMP_CMP_MASKED_EQ, PROT_EXEC, 0));
+		ADD_SYSCALL(munmap, 0);
+		ADD_SYSCALL(madvise, 0);
+	}
+#endif
 
 	ADD_SYSCALL(read, 0);
 
@@ -112,10 +150,17 @@ int disable_system_calls(struct worker_st *ws)
 	ADD_SYSCALL(exit_group, 0);
 	ADD_SYSCALL(socket, 0);
 	ADD_SYSCALL(connect, 0);
+	/* to end the connection to sec-mod */
+	ADD_SYSCALL(shutdown, 0);
 
 	ADD_SYSCALL(getsockopt, 0);
 	ADD_SYSCALL(setsockopt, 0);
 
+	/* used to switch the TUN and UDP descriptors to
+	 * non-blocking mode */
+	ADD_SYSCALL(fcntl, 0);
+	ADD_SYSCALL(fcntl64, 0);
+
 	/* we need to open files when we have an xml_config_file setup on any vhost */
 	list_for_each(ws->vconfig, vhost, list) {
 		if (vhost->perm_config.config->xml_config_file) {
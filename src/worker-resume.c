@@ -50,6 +50,7 @@ static int recv_resume_fetch_reply(worker_st *ws, int sd, gnutls_datum_t *sdata)
 		(unpack_func)session_resume_reply_msg__unpack, DEFAULT_SOCKET_TIMEOUT);
 	if (ret < 0) {
 		oclog(ws, LOG_ERR, "error receiving resumption reply (fetch)");
+		disconnect_from_secmod(ws);
 		return ret;
 	}
 
@@ -106,13 +107,12 @@ static gnutls_datum_t resume_db_fetch(void *dbf, gnutls_datum_t key)
 		(pack_size_func)session_resume_fetch_msg__get_packed_size,
 		(pack_func)session_resume_fetch_msg__pack);
 	if (ret < 0) {
-		goto cleanup;
+		disconnect_from_secmod(ws);
+		return r;
 	}
 
 	recv_resume_fetch_reply(ws, sd, &r);
 
- cleanup:
- 	close(sd);
 	return r;
 }
 
@@ -154,10 +154,8 @@ resume_db_store (void *dbf, gnutls_datum_t key, gnutls_datum_t data)
 	ret = send_msg_to_secmod(ws, sd, RESUME_STORE_REQ, &msg,
 		(pack_size_func)session_resume_store_req_msg__get_packed_size,
 		(pack_func)session_resume_store_req_msg__pack);
-
-	close(sd);
-
 	if (ret < 0) {
+		disconnect_from_secmod(ws);
 		return GNUTLS_E_DB_ERROR;
 	}
 
@@ -191,10 +189,10 @@ static int resume_db_delete(void *dbf, gnutls_datum_t key)
 	ret = send_msg_to_secmod(ws, sd, RESUME_DELETE_REQ, &msg,
 		(pack_size_func)session_resume_fetch_msg__get_packed_size,
 		(pack_func)session_resume_fetch_msg__pack);
-
-	close(sd);
-	if (ret < 0)
+	if (ret < 0) {
+		disconnect_from_secmod(ws);
 		return GNUTLS_E_DB_ERROR;
+	}
 
 	return 0;
 }
@@ -0,0 +1,715 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This file is part of ocserv.
+ *
+ * ocserv is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ocserv is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* An io_uring based replacement of the poll() and TUN device I/O of
+ * the worker's main loop. The command, TLS and UDP sockets are watched
+ * with poll requests, while a number of reads of the TUN device are
+ * kept posted, using buffers provided to the kernel. The writes to the
+ * TUN device are queued and submitted in a single system call at the
+ * end of each batch of packets (see worker_uring_flush()).
+ */
+
+#include <config.h>
+
+#ifdef ENABLE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vpn.h>
+#include <worker.h>
+#include <worker-uring.h>
+#include <tun.h>
+
+#define URING_MAX_DEPTH 64
+/* the entries of the provided buffer ring; a power of two */
+#define URING_BR_ENTRIES (2 * URING_MAX_DEPTH)
+/* the entries of the pollfd array of connect_handler() */
+#define URING_POLL_SLOTS 4
+
+/* the user_data of the requests: type, generation and index */
+#define UD_TUN_READ 1
+#define UD_TUN_WRITE 2
+#define UD_POLL 3
+#define UD_POLL_REMOVE 4
+
+#define UD(type, gen, idx) (((uint64_t)(type) << 56) | ((uint64_t)((gen) & 0xffffff) << 32) | (uint32_t)(idx))
+#define UD_TYPE(ud) ((unsigned)((ud) >> 56))
+#define UD_GEN(ud) ((unsigned)(((ud) >> 32) & 0xffffff))
+#define UD_IDX(ud) ((unsigned)((ud) & 0xffffffff))
+
+struct uring_poll_slot {
+	int fd;
+	short events;
+	unsigned armed;
+	unsigned gen;
+	short revents;
+};
+
+struct uring_rx_entry {
+	uint16_t bid;
+	uint32_t len;
+};
+
+struct worker_uring_st {
+	int fd;
+	int tun_fd;
+
+	/* submission queue */
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned sq_entries;
+	unsigned sq_local_tail;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	/* completion queue */
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/* TUN reads; the buffers are provided to the kernel in br */
+	struct io_uring_buf_ring *br;
+	size_t br_size;
+	uint16_t br_tail;
+	uint8_t *rx_bufs;
+	unsigned rx_buf_size;
+	unsigned rx_nbufs;
+	unsigned rx_depth;
+	unsigned rx_posted;
+	/* completed reads in the order they were received */
+	struct uring_rx_entry *rx_ready;
+	unsigned rx_ready_head;
+	unsigned rx_ready_count;
+	int rx_err;
+
+	/* TUN writes */
+	uint8_t *tx_bufs;
+	unsigned tx_buf_size;
+	unsigned tx_nbufs;
+	unsigned *tx_free;
+	unsigned tx_nfree;
+	int tx_err;
+
+	struct uring_poll_slot poll[URING_POLL_SLOTS];
+};
+
+static int uring_enter(struct worker_uring_st *u, unsigned wait_nr,
+		       const struct timespec *ts, const sigset_t *sigmask)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec kts;
+	unsigned submit, flags = 0;
+	int ret;
+
+	__atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+	submit = u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+
+	if (submit == 0 && wait_nr == 0)
+		return 0;
+
+	memset(&arg, 0, sizeof(arg));
+	if (sigmask) {
+		arg.sigmask = (uintptr_t)sigmask;
+		arg.sigmask_sz = _NSIG / 8;
+	}
+	if (ts) {
+		kts.tv_sec = ts->tv_sec;
+		kts.tv_nsec = ts->tv_nsec;
+		arg.ts = (uintptr_t)&kts;
+	}
+
+	if (wait_nr > 0)
+		flags |= IORING_ENTER_GETEVENTS;
+
+	do {
+		ret = syscall(__NR_io_uring_enter, u->fd, submit, wait_nr,
+			      flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+	} while (ret == -1 && errno == EINTR && sigmask == NULL);
+
+	if (ret == -1 && errno == ETIME)
+		return 0;
+
+	return ret;
+}
+
+static struct io_uring_sqe *uring_get_sqe(struct worker_uring_st *u)
+{
+	struct io_uring_sqe *sqe;
+
+	if (u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+		/* full; submit what is queued */
+		if (uring_enter(u, 0, NULL, NULL) < 0)
+			return NULL;
+		if (u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries)
+			return NULL;
+	}
+
+	sqe = &u->sqes[u->sq_local_tail & *u->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	u->sq_local_tail++;
+
+	return sqe;
+}
+
+static void rx_buf_provide(struct worker_uring_st *u, unsigned bid)
+{
+	struct io_uring_buf *buf;
+
+	buf = &u->br->bufs[u->br_tail & (URING_BR_ENTRIES - 1)];
+	buf->addr = (uintptr_t)(u->rx_bufs + bid * u->rx_buf_size);
+	buf->len = u->rx_buf_size;
+	buf->bid = bid;
+	u->br_tail++;
+
+	__atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+}
+
+static void uring_reap(struct worker_uring_st *u)
+{
+	unsigned head, tail, idx;
+	struct io_uring_cqe *cqe;
+	struct uring_poll_slot *slot;
+	struct uring_rx_entry *e;
+
+	head = *u->cq_head;
+	tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++) {
+		cqe = &u->cqes[head & *u->cq_mask];
+		idx = UD_IDX(cqe->user_data);
+
+		switch (UD_TYPE(cqe->user_data)) {
+		case UD_TUN_READ:
+			u->rx_posted--;
+			if (cqe->flags & IORING_CQE_F_BUFFER) {
+				idx = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+				if (cqe->res > 0) {
+					e = &u->rx_ready[(u->rx_ready_head + u->rx_ready_count) % u->rx_nbufs];
+					e->bid = idx;
+					e->len = cqe->res;
+					u->rx_ready_count++;
+				} else {
+					rx_buf_provide(u, idx);
+				}
+			} else if (cqe->res < 0 && cqe->res != -ENOBUFS &&
+				   cqe->res != -EAGAIN && cqe->res != -EINTR &&
+				   cqe->res != -ECANCELED) {
+				u->rx_err = -cqe->res;
+			}
+			break;
+		case UD_TUN_WRITE:
+			u->tx_free[u->tx_nfree++] = idx;
+			if (cqe->res < 0 && u->tx_err == 0)
+				u->tx_err = -cqe->res;
+			break;
+		case UD_POLL:
+			slot = &u->poll[idx];
+			if (UD_GEN(cqe->user_data) != slot->gen)
+				break;
+			slot->armed = 0;
+			if (cqe->res > 0)
+				slot->revents |= cqe->res;
+			else if (cqe->res < 0 && cqe->res != -ECANCELED)
+				slot->revents |= POLLERR;
+			break;
+		default:
+			break;
+		}
+	}
+
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void post_tun_reads(struct worker_uring_st *u)
+{
+	struct io_uring_sqe *sqe;
+
+	/* don't post more reads than there are available buffers */
+	while (u->rx_posted < u->rx_depth &&
+	       u->rx_posted + u->rx_ready_count < u->rx_nbufs) {
+		sqe = uring_get_sqe(u);
+		if (sqe == NULL)
+			break;
+
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = u->tun_fd;
+		sqe->off = (uint64_t)-1;
+		sqe->len = u->rx_buf_size;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = 0;
+		sqe->user_data = UD(UD_TUN_READ, 0, 0);
+		u->rx_posted++;
+	}
+}
+
+static void arm_poll(struct worker_uring_st *u, unsigned i, int fd, short events)
+{
+	struct uring_poll_slot *slot = &u->poll[i];
+	struct io_uring_sqe *sqe;
+
+	if (slot->armed && slot->fd == fd && slot->events == events)
+		return;
+
+	if (slot->armed) {
+		/* the fd or the events changed; cancel the old request */
+		sqe = uring_get_sqe(u);
+		if (sqe == NULL)
+			return;
+		sqe->opcode = IORING_OP_POLL_REMOVE;
+		sqe->fd = -1;
+		sqe->addr = UD(UD_POLL, slot->gen, i);
+		sqe->user_data = UD(UD_POLL_REMOVE, 0, i);
+		slot->armed = 0;
+	}
+
+	if (slot->fd != fd) {
+		slot->revents = 0;
+		slot->fd = fd;
+	}
+	slot->gen++;
+	slot->events = events;
+
+	sqe = uring_get_sqe(u);
+	if (sqe == NULL)
+		return;
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+#if __BYTE_ORDER == __BIG_ENDIAN
+	sqe->poll32_events = ((uint32_t)(uint16_t)events << 16);
+#else
+	sqe->poll32_events = (uint16_t)events;
+#endif
+	sqe->user_data = UD(UD_POLL, slot->gen, i);
+	slot->armed = 1;
+}
+
+static unsigned fill_revents(struct worker_uring_st *u, struct pollfd *pfd, unsigned pfd_size)
+{
+	unsigned i, ready = 0;
+
+	for (i = 0; i < pfd_size; i++) {
+		if (pfd[i].fd == u->tun_fd) {
+			if (u->rx_ready_count > 0 || u->rx_err != 0)
+				pfd[i].revents = POLLIN;
+		} else if (u->poll[i].fd == pfd[i].fd) {
+			pfd[i].revents = u->poll[i].revents & (pfd[i].events | POLLERR | POLLHUP);
+			u->poll[i].revents = 0;
+		}
+		if (pfd[i].revents)
+			ready++;
+	}
+
+	return ready;
+}
+
+/* Waits for events on the pollfd entries, similarly to ppoll(). The
+ * entry of the TUN device becomes ready when a read has completed; the
+ * data are then available through worker_uring_tun_read().
+ */
+int worker_uring_poll(struct worker_st *ws, struct pollfd *pfd, unsigned pfd_size,
+		      const struct timespec *ts, const sigset_t *sigmask)
+{
+	struct worker_uring_st *u = ws->uring;
+	unsigned i, wait_nr = 1;
+	int ret;
+
+	for (i = 0; i < pfd_size && i < URING_POLL_SLOTS; i++) {
+		pfd[i].revents = 0;
+		if (pfd[i].fd == u->tun_fd)
+			post_tun_reads(u);
+		else
+			arm_poll(u, i, pfd[i].fd, pfd[i].events);
+	}
+
+	uring_reap(u);
+	if (u->rx_ready_count > 0 || u->rx_err != 0)
+		wait_nr = 0;
+	for (i = 0; i < pfd_size && i < URING_POLL_SLOTS; i++) {
+		if (pfd[i].fd != u->tun_fd && u->poll[i].revents != 0)
+			wait_nr = 0;
+	}
+
+	ret = uring_enter(u, wait_nr, wait_nr ? ts : NULL, sigmask);
+	if (ret < 0)
+		return -1;
+
+	uring_reap(u);
+
+	return fill_revents(u, pfd, pfd_size);
+}
+
+ssize_t worker_uring_tun_read(struct worker_st *ws, void *buf, size_t len)
+{
+	struct worker_uring_st *u = ws->uring;
+	struct uring_rx_entry *e;
+
+	if (u->rx_ready_count == 0)
+		uring_reap(u);
+
+	if (u->rx_ready_count == 0) {
+		if (u->rx_err != 0) {
+			errno = u->rx_err;
+			u->rx_err = 0;
+		} else {
+			errno = EAGAIN;
+		}
+		return -1;
+	}
+
+	e = &u->rx_ready[u->rx_ready_head];
+	u->rx_ready_head = (u->rx_ready_head + 1) % u->rx_nbufs;
+	u->rx_ready_count--;
+
+	if (len > e->len)
+		len = e->len;
+	memcpy(buf, u->rx_bufs + e->bid * u->rx_buf_size, len);
+	rx_buf_provide(u, e->bid);
+
+	return len;
+}
+
+/* waits until all the queued writes are complete, or until a write
+ * buffer is available if @any is set */
+static int wait_tun_writes(struct worker_uring_st *u, unsigned any)
+{
+	while (u->tx_nfree < u->tx_nbufs) {
+		if (any && u->tx_nfree > 0)
+			break;
+		if (uring_enter(u, 1, NULL, NULL) < 0)
+			return -1;
+		uring_reap(u);
+	}
+	return 0;
+}
+
+ssize_t worker_uring_tun_write(struct worker_st *ws, const void *buf, size_t len)
+{
+	struct worker_uring_st *u = ws->uring;
+	struct io_uring_sqe *sqe;
+	unsigned idx;
+
+	if (u->tx_err != 0) {
+		errno = u->tx_err;
+		return -1;
+	}
+
+	if (len > u->tx_buf_size) {
+		/* keep the packet order */
+		if (wait_tun_writes(u, 0) < 0)
+			return -1;
+		return tun_write(u->tun_fd, buf, len);
+	}
+
+	if (u->tx_nfree == 0 && wait_tun_writes(u, 1) < 0)
+		return -1;
+
+	idx = u->tx_free[u->tx_nfree - 1];
+	sqe = uring_get_sqe(u);
+	if (sqe == NULL) {
+		errno = EBUSY;
+		return -1;
+	}
+	u->tx_nfree--;
+
+	memcpy(u->tx_bufs + idx * u->tx_buf_size, buf, len);
+
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = u->tun_fd;
+	sqe->off = (uint64_t)-1;
+	sqe->addr = (uintptr_t)(u->tx_bufs + idx * u->tx_buf_size);
+	sqe->len = len;
+	sqe->user_data = UD(UD_TUN_WRITE, 0, idx);
+
+	return len;
+}
+
+/* Submits the queued writes and reposts the completed reads of the
+ * TUN device. It is called at the end of each batch of packets. */
+int worker_uring_flush(struct worker_st *ws)
+{
+	struct worker_uring_st *u = ws->uring;
+
+	post_tun_reads(u);
+	if (uring_enter(u, 0, NULL, NULL) < 0)
+		return -1;
+	uring_reap(u);
+
+	if (u->tx_err != 0) {
+		errno = u->tx_err;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void *map_ring(int fd, size_t size, off_t offset)
+{
+	void *p;
+
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		 MAP_SHARED | MAP_POPULATE, fd, offset);
+	if (p == MAP_FAILED)
+		return NULL;
+	return p;
+}
+
+static int uring_setup(struct worker_uring_st *u, unsigned entries)
+{
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+	/* no requests are accepted until the restrictions are in place */
+	p.flags = IORING_SETUP_R_DISABLED;
+	u->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (u->fd < 0)
+		return -1;
+
+	if (!(p.features & IORING_FEAT_EXT_ARG) ||
+	    !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	u->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (u->cq_ring_size > u->sq_ring_size)
+		u->sq_ring_size = u->cq_ring_size;
+	u->cq_ring_size = u->sq_ring_size;
+
+	u->sq_ring = map_ring(u->fd, u->sq_ring_size, IORING_OFF_SQ_RING);
+	if (u->sq_ring == NULL)
+		return -1;
+	u->cq_ring = u->sq_ring;
+
+	u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = map_ring(u->fd, u->sqes_size, IORING_OFF_SQES);
+	if (u->sqes == NULL)
+		return -1;
+
+	u->sq_head = (void*)((uint8_t*)u->sq_ring + p.sq_off.head);
+	u->sq_tail = (void*)((uint8_t*)u->sq_ring + p.sq_off.tail);
+	u->sq_mask = (void*)((uint8_t*)u->sq_ring + p.sq_off.ring_mask);
+	u->sq_entries = p.sq_entries;
+	u->sq_local_tail = *u->sq_tail;
+
+	u->cq_head = (void*)((uint8_t*)u->cq_ring + p.cq_off.head);
+	u->cq_tail = (void*)((uint8_t*)u->cq_ring + p.cq_off.tail);
+	u->cq_mask = (void*)((uint8_t*)u->cq_ring + p.cq_off.ring_mask);
+	u->cqes = (void*)((uint8_t*)u->cq_ring + p.cq_off.cqes);
+
+	/* the submission queue entries are used in order */
+	{
+		unsigned *array = (void*)((uint8_t*)u->sq_ring + p.sq_off.array);
+		unsigned i;
+
+		for (i = 0; i < p.sq_entries; i++)
+			array[i] = i;
+	}
+
+	return 0;
+}
+
+static int setup_buffers(struct worker_uring_st *u)
+{
+	struct io_uring_buf_reg reg;
+	int ret;
+
+	u->br_size = URING_BR_ENTRIES * sizeof(struct io_uring_buf);
+	u->br = mmap(NULL, u->br_size, PROT_READ | PROT_WRITE,
+		     MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (u->br == MAP_FAILED) {
+		u->br = NULL;
+		return -1;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uintptr_t)u->br;
+	reg.ring_entries = URING_BR_ENTRIES;
+	reg.bgid = 0;
+
+	ret = syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PBUF_RING, &reg, 1);
+	if (ret < 0)
+		return -1;
+
+	return 0;
+}
+
+/* Limits the ring to the requests we submit, and enables it. The
+ * kernel does not allow restricting the descriptors a request
+ * refers to, unless they are registered, but these operations give
+ * nothing that read(), write() and poll() don't.
+ */
+static int restrict_ring(struct worker_uring_st *u)
+{
+	static const uint8_t ops[] = {
+		IORING_OP_READ,
+		IORING_OP_WRITE,
+		IORING_OP_POLL_ADD,
+		IORING_OP_POLL_REMOVE
+	};
+	struct io_uring_restriction res[sizeof(ops) + 1];
+	unsigned i;
+	int ret;
+
+	memset(res, 0, sizeof(res));
+	for (i = 0; i < sizeof(ops); i++) {
+		res[i].opcode = IORING_RESTRICTION_SQE_OP;
+		res[i].sqe_op = ops[i];
+	}
+	res[i].opcode = IORING_RESTRICTION_SQE_FLAGS_ALLOWED;
+	res[i].sqe_flags = IOSQE_BUFFER_SELECT;
+
+	/* no register operations are listed; once the ring is
+	 * enabled none is allowed */
+	ret = syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_RESTRICTIONS,
+		      res, sizeof(res) / sizeof(res[0]));
+	if (ret < 0)
+		return -1;
+
+	ret = syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_ENABLE_RINGS,
+		      NULL, 0);
+	if (ret < 0)
+		return -1;
+
+	return 0;
+}
+
+static int uring_destructor(struct worker_uring_st *u)
+{
+	if (u->sqes)
+		munmap(u->sqes, u->sqes_size);
+	if (u->sq_ring)
+		munmap(u->sq_ring, u->sq_ring_size);
+	if (u->fd >= 0)
+		close(u->fd);
+	if (u->br)
+		munmap(u->br, u->br_size);
+	return 0;
+}
+
+/* Creates the io_uring instance of the worker. This happens before the
+ * system calls are restricted, since neither the creation nor the
+ * registration of anything is allowed afterwards. On failure ws->uring
+ * remains NULL, and the worker uses poll(). */
+int worker_uring_init(struct worker_st *ws)
+{
+	struct worker_uring_st *u;
+	unsigned i;
+	int e;
+
+	u = talloc_zero(ws, struct worker_uring_st);
+	if (u == NULL)
+		return -1;
+
+	u->fd = -1;
+	u->tun_fd = -1;
+	talloc_set_destructor(u, uring_destructor);
+
+	for (i = 0; i < URING_POLL_SLOTS; i++)
+		u->poll[i].fd = -1;
+
+	/* the TUN reads and writes, and a poll and its removal per slot */
+	if (uring_setup(u, 2 * URING_MAX_DEPTH + 2 * URING_POLL_SLOTS) < 0) {
+		e = errno;
+		oclog(ws, LOG_DEBUG, "io_uring_setup: %s", strerror(e));
+		goto fail;
+	}
+
+	if (setup_buffers(u) < 0) {
+		e = errno;
+		oclog(ws, LOG_DEBUG, "could not register io_uring buffers: %s", strerror(e));
+		goto fail;
+	}
+
+	if (restrict_ring(u) < 0) {
+		e = errno;
+		oclog(ws, LOG_DEBUG, "could not restrict io_uring: %s", strerror(e));
+		goto fail;
+	}
+
+	ws->uring = u;
+	return 0;
+
+ fail:
+	talloc_free(u);
+	return -1;
+}
+
+/* Sets up the TUN device I/O once the device is known. On failure the
+ * instance is released, and the caller continues with poll(). */
+int worker_uring_start(struct worker_st *ws)
+{
+	struct worker_uring_st *u = ws->uring;
+	unsigned i, depth;
+
+	if (u == NULL)
+		return -1;
+
+	u->tun_fd = ws->tun_fd;
+
+	depth = MIN(MAX(WSCONFIG(ws)->packet_batch_size, 2), URING_MAX_DEPTH);
+	u->rx_depth = depth;
+	for (u->rx_nbufs = 1; u->rx_nbufs < 2 * depth; u->rx_nbufs <<= 1)
+		;
+	u->rx_buf_size = ws->vinfo.mtu;
+	u->tx_nbufs = depth;
+	u->tx_buf_size = ws->vinfo.mtu;
+
+	u->rx_bufs = talloc_size(u, u->rx_nbufs * u->rx_buf_size);
+	u->rx_ready = talloc_array(u, struct uring_rx_entry, u->rx_nbufs);
+	u->tx_bufs = talloc_size(u, u->tx_nbufs * u->tx_buf_size);
+	u->tx_free = talloc_array(u, unsigned, u->tx_nbufs);
+	if (u->rx_bufs == NULL || u->rx_ready == NULL ||
+	    u->tx_bufs == NULL || u->tx_free == NULL)
+		goto fail;
+
+	for (i = 0; i < u->tx_nbufs; i++)
+		u->tx_free[i] = u->tx_nbufs - 1 - i;
+	u->tx_nfree = u->tx_nbufs;
+
+	for (i = 0; i < u->rx_nbufs; i++)
+		rx_buf_provide(u, i);
+
+	/* the TUN device stays in non-blocking mode; for such a device
+	 * the kernel waits for data before completing the posted reads */
+	oclog(ws, LOG_DEBUG, "using io_uring with %u posted reads", depth);
+	return 0;
+
+ fail:
+	ws->uring = NULL;
+	talloc_free(u);
+	return -1;
+}
+
+#endif
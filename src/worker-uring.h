@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This file is part of ocserv.
+ *
+ * ocserv is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ocserv is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef WORKER_URING_H
+# define WORKER_URING_H
+
+#ifdef ENABLE_IO_URING
+
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+struct worker_st;
+struct worker_uring_st;
+
+int worker_uring_init(struct worker_st *ws);
+int worker_uring_start(struct worker_st *ws);
+int worker_uring_poll(struct worker_st *ws, struct pollfd *pfd, unsigned pfd_size,
+		      const struct timespec *ts, const sigset_t *sigmask);
+ssize_t worker_uring_tun_read(struct worker_st *ws, void *buf, size_t len);
+ssize_t worker_uring_tun_write(struct worker_st *ws, const void *buf, size_t len);
+int worker_uring_flush(struct worker_st *ws);
+
+#endif
+
+#endif
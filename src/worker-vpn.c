@@ -36,6 +36,7 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <arpa/inet.h>
 #include <system.h>
 #include <time.h>
@@ -45,6 +46,8 @@
 #include <c-strcase.h>
 #include <c-ctype.h>
 #include <worker-bandwidth.h>
+#include <worker-fq.h>
+#include <worker-uring.h>
 #include <signal.h>
 #include <poll.h>
 
@@ -81,6 +84,10 @@
 
 #define MSS_ADJUST(x) x += TCP_HEADER_SIZE + ((ws->proto == AF_INET)?(IP_HEADER_SIZE):(IPV6_HEADER_SIZE))
 
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+# define USE_DTLS_MMSG
+#endif
+
 struct worker_st *global_ws = NULL;
 
 static int terminate = 0;
@@ -96,6 +103,7 @@ static void set_net_priority(worker_st * ws, int fd, int priority);
 static void set_socket_timeout(worker_st * ws, int fd);
 
 static void link_mtu_set(worker_st * ws, unsigned mtu);
+static int mtu_not_ok(worker_st * ws);
 
 static void handle_alarm(int signo)
 {
@@ -112,13 +120,62 @@ static void handle_term(int signo)
 	alarm(2);		/* force exit by SIGALRM */
 }
 
-/* we override that function to force gnutls use poll()
+/* When the transmit thread is used, tx_lock serializes everything that
+ * sends to the client, and the changes to the state that thread reads,
+ * such as the DTLS session and transport, or udp_state. The transmit
+ * thread holds it while it sends a batch of packets. The main thread
+ * holds it except while it waits for data, and while it receives,
+ * decrypts and writes to the tun device the client's data packets;
+ * GnuTLS allows one thread to send and another to receive on the same
+ * session. These two functions are only called by the main thread.
+ */
+inline static void tx_lock(worker_st *ws)
+{
+#ifdef ENABLE_WORKER_THREADS
+	if (ws->tx_thread && !ws->tx_locked) {
+		pthread_mutex_lock(&ws->tx_lock);
+		ws->tx_locked = 1;
+	}
+#endif
+}
+
+inline static void tx_unlock(worker_st *ws)
+{
+#ifdef ENABLE_WORKER_THREADS
+	if (ws->tx_thread && ws->tx_locked) {
+		ws->tx_locked = 0;
+		pthread_mutex_unlock(&ws->tx_lock);
+	}
+#endif
+}
+
+/* The TLS session is given the TCP socket as its transport when kernel
+ * TLS is enabled, since GnuTLS sets it up on that socket. Otherwise the
+ * transport is a pointer to the socket with the functions below, which
+ * GnuTLS never replaces by kernel TLS.
  */
 static
-int tls_pull_timeout(gnutls_transport_ptr_t ptr, unsigned int ms)
+ssize_t tls_pull(gnutls_transport_ptr_t ptr, void *data, size_t size)
+{
+	return recv(*((int *)ptr), data, size, 0);
+}
+
+static
+ssize_t tls_vec_push(gnutls_transport_ptr_t ptr, const giovec_t *iov, int iovcnt)
+{
+	struct msghdr hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_iov = (struct iovec *)iov;
+	hdr.msg_iovlen = iovcnt;
+
+	return sendmsg(*((int *)ptr), &hdr, MSG_NOSIGNAL);
+}
+
+static
+int tls_poll(int fd, unsigned int ms)
 {
 	int ret;
-	int fd = (long)ptr;
 	struct pollfd pfd;
 
 	pfd.fd = fd;
@@ -132,18 +189,526 @@ int tls_pull_timeout(gnutls_transport_ptr_t ptr, unsigned int ms)
 	return ret;
 }
 
+/* we override these functions to force gnutls use poll()
+ */
+static
+int tls_pull_timeout(gnutls_transport_ptr_t ptr, unsigned int ms)
+{
+	return tls_poll(*((int *)ptr), ms);
+}
+
+static
+int tls_pull_timeout_fd(gnutls_transport_ptr_t ptr, unsigned int ms)
+{
+	return tls_poll((long)ptr, ms);
+}
+
+/* The DTLS records which cannot be sent because the UDP socket buffer
+ * is full are kept in a bounded queue, which is sent when the socket
+ * becomes writable (POLLOUT in connect_handler()). While records are
+ * queued the new ones are queued too, to keep their order. When the
+ * queue is full either the new record, or the oldest queued one, is
+ * dropped.
+ */
+struct dtls_txq_st {
+	unsigned size;
+	unsigned slot_size;
+	unsigned drop_head;
+
+	uint8_t *data;
+	size_t *len;
+	unsigned head;
+	unsigned count;
+
+	uint64_t dropped;
+};
+
+static struct dtls_txq_st *dtls_txq_init(void *pool, unsigned size,
+					 unsigned slot_size, unsigned drop_head)
+{
+	struct dtls_txq_st *q;
+
+	q = talloc_zero(pool, struct dtls_txq_st);
+	if (q == NULL)
+		return NULL;
+
+	q->size = size;
+	q->slot_size = slot_size;
+	q->drop_head = drop_head;
+	q->data = talloc_size(q, size * slot_size);
+	q->len = talloc_zero_array(q, size_t, size);
+	if (q->data == NULL || q->len == NULL) {
+		talloc_free(q);
+		return NULL;
+	}
+
+	return q;
+}
+
+static void dtls_txq_add(struct dtls_txq_st *q, const void *data, size_t size)
+{
+	unsigned slot;
+
+	if (size > q->slot_size) {
+		q->dropped++;
+		return;
+	}
+
+	if (q->count == q->size) {
+		q->dropped++;
+		if (q->drop_head == 0)
+			return;
+		q->head = (q->head + 1) % q->size;
+		q->count--;
+	}
+
+	slot = (q->head + q->count) % q->size;
+	memcpy(q->data + slot * q->slot_size, data, size);
+	q->len[slot] = size;
+	q->count++;
+}
+
+/* Sends the queued records until the socket is full. The records
+ * rejected by the kernel are dropped, and the error of the first
+ * of them is returned.
+ */
+static int dtls_txq_flush(dtls_transport_ptr *p)
+{
+	struct dtls_txq_st *q = p->txq;
+	int ret, e, err = 0;
+
+	while (q->count > 0) {
+		ret = send(p->fd, q->data + q->head * q->slot_size, q->len[q->head], 0);
+		if (ret == -1) {
+			e = errno;
+			if (e == EINTR)
+				continue;
+			if (e == EAGAIN)
+				break;
+			if (err == 0)
+				err = e;
+		}
+
+		q->head = (q->head + 1) % q->size;
+		q->count--;
+	}
+
+	if (err != 0) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+#ifdef USE_DTLS_MMSG
+/* The DTLS transport reads all the datagrams available (up to size) with
+ * a single recvmmsg(), and gnutls then consumes them one by one from the
+ * receive ring. While the main loop processes a batch of packets, the
+ * records gnutls sends are queued and transmitted with a single sendmmsg()
+ * at the end of the batch.
+ *
+ * With UDP GRO the kernel may coalesce several datagrams in one, which are
+ * split again here, and with UDP GSO a run of equal-size queued records is
+ * passed to the kernel as a single message.
+ */
+#define DTLS_GRO_SLOTS 2
+#define DTLS_GRO_SLOT_SIZE 65535
+#define DTLS_GSO_MAX_SEGMENTS 64
+#define DTLS_GSO_MAX_SIZE 65000
+
+struct dtls_mmsg_st {
+	unsigned size; /* number of slots in each direction */
+	unsigned slot_size;
+
+	struct mmsghdr *rx_msgs;
+	struct iovec *rx_iov;
+	unsigned rx_slots;
+	unsigned rx_head;
+	unsigned rx_count;
+	/* the remainder of the datagram being consumed */
+	uint8_t *rx_ptr;
+	unsigned rx_left;
+	unsigned rx_seg;
+
+	/* queued records, stored contiguously */
+	uint8_t *tx_data;
+	struct iovec *tx_iov;
+	unsigned tx_count;
+	unsigned tx_queue; /* when non-zero records are queued, not sent */
+
+	/* the messages passed to sendmmsg() */
+	struct mmsghdr *out_msgs;
+	struct iovec *out_iov;
+	unsigned *out_first; /* the first record of each message */
+	unsigned *out_records; /* the number of records in each message */
+
+	unsigned gro;
+	unsigned gso;
+	/* room for a control message per slot; the received ones are
+	 * read as the datagrams are consumed, after sends may occur */
+	uint8_t *rx_cmsg;
+	uint8_t *tx_cmsg;
+	unsigned cmsg_size;
+};
+
+static struct dtls_mmsg_st *dtls_mmsg_init(void *pool, int fd, unsigned size,
+					   unsigned slot_size, unsigned rx_slot_size,
+					   unsigned udp_gso)
+{
+	struct dtls_mmsg_st *m;
+	uint8_t *rx_data;
+	unsigned i;
+#if defined(UDP_GRO) && defined(UDP_SEGMENT)
+	int y;
+	socklen_t len;
+#endif
+
+	m = talloc_zero(pool, struct dtls_mmsg_st);
+	if (m == NULL)
+		return NULL;
+
+#if defined(UDP_GRO) && defined(UDP_SEGMENT)
+	if (udp_gso) {
+		/* main process enabled GRO on the socket, if supported */
+		y = 0;
+		len = sizeof(y);
+		if (getsockopt(fd, SOL_UDP, UDP_GRO, &y, &len) == 0 && y != 0)
+			m->gro = 1;
+		/* the option is set per message; this only checks for kernel support */
+		len = sizeof(y);
+		if (getsockopt(fd, SOL_UDP, UDP_SEGMENT, &y, &len) == 0)
+			m->gso = 1;
+	}
+#endif
+
+	m->size = size;
+	m->slot_size = slot_size;
+	m->cmsg_size = CMSG_SPACE(sizeof(int));
+
+	if (m->gro) {
+		/* coalesced datagrams may be up to the maximum UDP size */
+		m->rx_slots = MIN(size, DTLS_GRO_SLOTS);
+		rx_slot_size = DTLS_GRO_SLOT_SIZE;
+	} else {
+		m->rx_slots = size;
+	}
+
+	m->rx_msgs = talloc_zero_array(m, struct mmsghdr, m->rx_slots);
+	m->rx_iov = talloc_zero_array(m, struct iovec, m->rx_slots);
+	m->tx_iov = talloc_zero_array(m, struct iovec, size);
+	m->out_msgs = talloc_zero_array(m, struct mmsghdr, size);
+	m->out_iov = talloc_zero_array(m, struct iovec, size);
+	m->out_first = talloc_zero_array(m, unsigned, size);
+	m->out_records = talloc_zero_array(m, unsigned, size);
+	m->rx_cmsg = talloc_zero_size(m, m->rx_slots * m->cmsg_size);
+	m->tx_cmsg = talloc_zero_size(m, size * m->cmsg_size);
+	rx_data = talloc_size(m, m->rx_slots * rx_slot_size);
+	m->tx_data = talloc_size(m, size * slot_size);
+	if (m->rx_msgs == NULL || m->rx_iov == NULL || m->tx_iov == NULL ||
+	    m->out_msgs == NULL || m->out_iov == NULL || m->out_first == NULL ||
+	    m->out_records == NULL || m->rx_cmsg == NULL ||
+	    m->tx_cmsg == NULL || rx_data == NULL ||
+	    m->tx_data == NULL) {
+		talloc_free(m);
+		return NULL;
+	}
+
+	for (i = 0; i < m->rx_slots; i++) {
+		m->rx_iov[i].iov_base = rx_data + i * rx_slot_size;
+		m->rx_iov[i].iov_len = rx_slot_size;
+		m->rx_msgs[i].msg_hdr.msg_iov = &m->rx_iov[i];
+		m->rx_msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (i = 0; i < size; i++) {
+		m->out_msgs[i].msg_hdr.msg_iov = &m->out_iov[i];
+		m->out_msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	return m;
+}
+
+#ifdef UDP_GRO
+/* Returns the size of the segments of a datagram coalesced by the kernel,
+ * or zero. */
+static unsigned get_gro_size(struct msghdr *hdr)
+{
+	struct cmsghdr *cmsg;
+	int gso_size;
+
+	for (cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+		if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+			memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+			return gso_size > 0 ? gso_size : 0;
+		}
+	}
+	return 0;
+}
+#endif
+
+static ssize_t dtls_pull_mmsg(dtls_transport_ptr *p, void *data, size_t size)
+{
+	struct dtls_mmsg_st *m = p->mmsg;
+	struct mmsghdr *msg;
+	uint8_t *ptr;
+	unsigned i, seg;
+	int ret;
+
+	while (m->rx_left == 0) {
+		if (m->rx_count == 0) {
+			if (m->gro) {
+				for (i = 0; i < m->rx_slots; i++) {
+					m->rx_msgs[i].msg_hdr.msg_control = m->rx_cmsg + i * m->cmsg_size;
+					m->rx_msgs[i].msg_hdr.msg_controllen = m->cmsg_size;
+				}
+			}
+
+			ret = recvmmsg(p->fd, m->rx_msgs, m->rx_slots, 0, NULL);
+			if (ret <= 0) {
+				if (ret == 0)
+					errno = EAGAIN;
+				return -1;
+			}
+			m->rx_head = 0;
+			m->rx_count = ret;
+		}
+
+		msg = &m->rx_msgs[m->rx_head++];
+		m->rx_count--;
+
+		/* the slots hold the largest datagram the worker can decrypt;
+		 * anything larger is discarded, as it would be if corrupt */
+		if (msg->msg_hdr.msg_flags & MSG_TRUNC)
+			continue;
+
+		m->rx_ptr = msg->msg_hdr.msg_iov->iov_base;
+		m->rx_left = msg->msg_len;
+		m->rx_seg = msg->msg_len;
+#ifdef UDP_GRO
+		if (m->gro) {
+			ret = get_gro_size(&msg->msg_hdr);
+			if (ret > 0)
+				m->rx_seg = ret;
+		}
+#endif
+	}
+
+	/* return the next datagram */
+	ptr = m->rx_ptr;
+	seg = MIN(m->rx_seg, m->rx_left);
+	m->rx_ptr += seg;
+	m->rx_left -= seg;
+
+	ret = MIN(seg, size);
+	memcpy(data, ptr, ret);
+	return ret;
+}
+
+/* Groups the queued records in messages; with GSO a message holds
+ * a run of records of the same size, except the last which may
+ * be shorter. Returns the number of messages. */
+static unsigned dtls_mmsg_prepare(struct dtls_mmsg_st *m)
+{
+	struct msghdr *hdr;
+	struct cmsghdr *cmsg;
+	unsigned i, j, n = 0;
+	size_t seg, total;
+
+	for (i = 0; i < m->tx_count; i = j) {
+		seg = m->tx_iov[i].iov_len;
+		total = seg;
+		j = i + 1;
+
+		if (m->gso) {
+			while (j < m->tx_count && j - i < DTLS_GSO_MAX_SEGMENTS &&
+			       m->tx_iov[j-1].iov_len == seg &&
+			       m->tx_iov[j].iov_len <= seg &&
+			       total + m->tx_iov[j].iov_len <= DTLS_GSO_MAX_SIZE) {
+				total += m->tx_iov[j].iov_len;
+				j++;
+			}
+		}
+
+		hdr = &m->out_msgs[n].msg_hdr;
+		m->out_iov[n].iov_base = m->tx_iov[i].iov_base;
+		m->out_iov[n].iov_len = total;
+		m->out_first[n] = i;
+		m->out_records[n] = j - i;
+
+		hdr->msg_control = NULL;
+		hdr->msg_controllen = 0;
+#ifdef UDP_SEGMENT
+		if (j - i > 1) {
+			hdr->msg_control = m->tx_cmsg + n * m->cmsg_size;
+			hdr->msg_controllen = m->cmsg_size;
+			cmsg = CMSG_FIRSTHDR(hdr);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			*((uint16_t *) CMSG_DATA(cmsg)) = seg;
+		}
+#endif
+		n++;
+	}
+
+	return n;
+}
+
+/* Sends the records of a message which the kernel refused to segment
+ * one by one. Returns 0 or the error of the first failed record. */
+static int dtls_mmsg_send_records(dtls_transport_ptr *p, unsigned msg)
+{
+	struct dtls_mmsg_st *m = p->mmsg;
+	unsigned i;
+	int ret, err = 0;
+
+	for (i = m->out_first[msg]; i < m->out_first[msg] + m->out_records[msg]; i++) {
+		do {
+			ret = send(p->fd, m->tx_iov[i].iov_base, m->tx_iov[i].iov_len, 0);
+		} while (ret == -1 && errno == EINTR);
+
+		if (ret == -1 && err == 0)
+			err = errno;
+	}
+
+	return err;
+}
+
+/* Moves the queued records, starting from the given one, to the
+ * transmit queue.
+ */
+static void dtls_mmsg_to_txq(dtls_transport_ptr *p, unsigned first)
+{
+	struct dtls_mmsg_st *m = p->mmsg;
+	unsigned i;
+
+	for (i = first; i < m->tx_count; i++)
+		dtls_txq_add(p->txq, m->tx_iov[i].iov_base, m->tx_iov[i].iov_len);
+	m->tx_count = 0;
+}
+
+/* Sends all the queued records; those which do not fit in the socket
+ * buffer are moved to the transmit queue. The datagrams rejected by the
+ * kernel are dropped, and the error of the first of them is returned.
+ */
+static int dtls_mmsg_flush(dtls_transport_ptr *p)
+{
+	struct dtls_mmsg_st *m = p->mmsg;
+	unsigned sent = 0, n;
+	int ret, e, err = 0;
+
+	/* the records of the transmit queue go first */
+	if (p->txq->count > 0) {
+		if (dtls_txq_flush(p) < 0)
+			err = errno;
+		if (p->txq->count > 0) {
+			dtls_mmsg_to_txq(p, 0);
+			goto finish;
+		}
+	}
+
+	n = dtls_mmsg_prepare(m);
+
+	while (sent < n) {
+		ret = sendmmsg(p->fd, &m->out_msgs[sent], n - sent, 0);
+		if (ret < 0) {
+			e = errno;
+			if (e == EINTR)
+				continue;
+
+			if (e == EAGAIN) {
+				dtls_mmsg_to_txq(p, m->out_first[sent]);
+				goto finish;
+			}
+
+			if (m->out_records[sent] > 1) {
+				/* fall back to plain datagrams; if they go
+				 * through the kernel cannot segment them */
+				e = dtls_mmsg_send_records(p, sent);
+				if (e == 0)
+					m->gso = 0;
+			}
+
+			if (e != 0 && err == 0)
+				err = e;
+			sent++;
+			continue;
+		}
+		sent += ret;
+	}
+	m->tx_count = 0;
+
+ finish:
+	if (err != 0) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+static ssize_t dtls_push_mmsg(dtls_transport_ptr *p, const void *data, size_t size)
+{
+	struct dtls_mmsg_st *m = p->mmsg;
+	uint8_t *ptr;
+
+	if (m->tx_count == m->size) {
+		/* report any error to the caller of the current record */
+		if (dtls_mmsg_flush(p) < 0)
+			return -1;
+	}
+
+	if (m->tx_count == 0)
+		ptr = m->tx_data;
+	else
+		ptr = (uint8_t *)m->tx_iov[m->tx_count-1].iov_base +
+		      m->tx_iov[m->tx_count-1].iov_len;
+
+	memcpy(ptr, data, size);
+	m->tx_iov[m->tx_count].iov_base = ptr;
+	m->tx_iov[m->tx_count].iov_len = size;
+	m->tx_count++;
+
+	return size;
+}
+#endif
+
 inline static ssize_t dtls_pull_buffer_non_empty(gnutls_transport_ptr_t ptr)
 {
 	dtls_transport_ptr *p = ptr;
 	if (p->msg)
 		return 1;
+#ifdef USE_DTLS_MMSG
+	if (p->mmsg && (p->mmsg->rx_count > 0 || p->mmsg->rx_left > 0))
+		return 1;
+#endif
 	return 0;
 }
 
+#ifdef ENABLE_WORKER_THREADS
+/* Returns non-zero if the DTLS records in the datagram are all
+ * application data. */
+static unsigned dtls_records_are_data(const uint8_t *data, size_t size)
+{
+	size_t len;
+
+	while (size >= RECORD_PAYLOAD_POS) {
+		if (data[0] != 23) /* application data */
+			return 0;
+		len = RECORD_PAYLOAD_POS + ((data[11] << 8) | data[12]);
+		if (len > size)
+			break;
+		data += len;
+		size -= len;
+	}
+	return 1;
+}
+#endif
+
 static
 ssize_t dtls_pull(gnutls_transport_ptr_t ptr, void *data, size_t size)
 {
 	dtls_transport_ptr *p = ptr;
+	ssize_t ret;
 
 	if (p->msg) {
 		ssize_t need = p->msg->data.len;
@@ -154,9 +719,24 @@ ssize_t dtls_pull(gnutls_transport_ptr_t ptr, void *data, size_t size)
 
 		udp_fd_msg__free_unpacked(p->msg, NULL);
 		p->msg = NULL;
-		return need;
+		ret = need;
+	} else {
+#ifdef USE_DTLS_MMSG
+		if (p->mmsg)
+			ret = dtls_pull_mmsg(p, data, size);
+		else
+#endif
+			ret = recv(p->fd, data, size, 0);
 	}
-	return recv(p->fd, data, size, 0);
+
+#ifdef ENABLE_WORKER_THREADS
+	/* Handshake records and alerts may make GnuTLS send, e.g., to
+	 * retransmit its last handshake flight, from within the receiving
+	 * function; the transmit thread is stopped for these. */
+	if (ret > 0 && !dtls_records_are_data(data, ret))
+		tx_lock(container_of(p, worker_st, dtls_tptr));
+#endif
+	return ret;
 }
 
 static
@@ -186,8 +766,119 @@ static
 ssize_t dtls_push(gnutls_transport_ptr_t ptr, const void *data, size_t size)
 {
 	dtls_transport_ptr *p = ptr;
+	ssize_t ret;
+
+#ifdef USE_DTLS_MMSG
+	if (p->mmsg && p->mmsg->tx_queue) {
+		if (size <= p->mmsg->slot_size)
+			return dtls_push_mmsg(p, data, size);
+
+		/* keep the records in order */
+		if (dtls_mmsg_flush(p) < 0)
+			return -1;
+	}
+#endif
+	if (p->txq == NULL)
+		return send(p->fd, data, size, 0);
+
+	if (p->txq->count > 0) {
+		dtls_txq_add(p->txq, data, size);
+		return size;
+	}
+
+	ret = send(p->fd, data, size, 0);
+	if (ret == -1 && errno == EAGAIN) {
+		dtls_txq_add(p->txq, data, size);
+		return size;
+	}
+
+	return ret;
+}
+
+/* UDP GRO is enabled by main on the UDP sockets when udp-gso is set, but
+ * only the batched transport can split the coalesced datagrams. This
+ * disables it when the transport is not (or cannot be) used.
+ */
+void dtls_udp_gro_check(worker_st *ws, int fd)
+{
+#ifdef UDP_GRO
+	int y = 0;
+
+	if (WSCONFIG(ws)->udp_gso == 0)
+		return;
+
+# ifdef USE_DTLS_MMSG
+	if (WSCONFIG(ws)->packet_batch_size > 1) {
+		/* the transport is set up together with the DTLS session */
+		if (ws->dtls_tptr.mmsg == NULL && ws->dtls_session == NULL)
+			return;
+		if (ws->dtls_tptr.mmsg != NULL && ws->dtls_tptr.mmsg->gro)
+			return;
+	}
+# endif
+
+	setsockopt(fd, SOL_UDP, UDP_GRO, &y, sizeof(y));
+#endif
+}
+
+/* Starts queuing the DTLS records sent, when the transport supports it.
+ */
+static void dtls_tx_batch_start(worker_st *ws)
+{
+#ifdef USE_DTLS_MMSG
+	if (ws->dtls_tptr.mmsg)
+		ws->dtls_tptr.mmsg->tx_queue = 1;
+#endif
+}
+
+/* Handles the error of a deferred DTLS send. Returns a negative number
+ * if it is fatal.
+ */
+static int dtls_tx_error(worker_st *ws, int e)
+{
+	if (e == EMSGSIZE) {
+		/* the record was lost, but the next ones will fit */
+		mtu_not_ok(ws);
+		return 0;
+	}
+
+	oclog(ws, LOG_ERR, "error sending DTLS data: %s", strerror(e));
+	return -1;
+}
+
+/* Sends the DTLS records queued since dtls_tx_batch_start() and stops
+ * queuing. Returns a negative number on a fatal error.
+ */
+static int dtls_tx_batch_end(worker_st *ws)
+{
+#ifdef USE_DTLS_MMSG
+	struct dtls_mmsg_st *m = ws->dtls_tptr.mmsg;
+
+	if (m == NULL)
+		return 0;
+
+	m->tx_queue = 0;
+	if (m->tx_count == 0)
+		return 0;
+
+	if (dtls_mmsg_flush(&ws->dtls_tptr) < 0)
+		return dtls_tx_error(ws, errno);
+#endif
+	return 0;
+}
+
+/* Sends the records of the transmit queue, when the UDP socket
+ * becomes writable. Returns a negative number on a fatal error.
+ */
+static int dtls_txq_send(worker_st *ws)
+{
+	if (ws->dtls_tptr.txq == NULL || ws->dtls_tptr.txq->count == 0)
+		return 0;
 
-	return send(p->fd, data, size, 0);
+	if (dtls_txq_flush(&ws->dtls_tptr) < 0)
+		return dtls_tx_error(ws, errno);
+
+	return 0;
 }
 
 int get_psk_key(gnutls_session_t session,
@@ -343,6 +1034,16 @@ static int setup_dtls_connection(struct worker_st *ws)
 
 	gnutls_session_set_ptr(session, ws);
 
+	/* main has already exchanged a cookie with the client */
+	if (ws->dtls_tptr.msg != NULL && ws->dtls_tptr.msg->has_hsk_read_seq) {
+		gnutls_dtls_prestate_st prestate;
+
+		prestate.record_seq = ws->dtls_tptr.msg->record_seq;
+		prestate.hsk_read_seq = ws->dtls_tptr.msg->hsk_read_seq;
+		prestate.hsk_write_seq = ws->dtls_tptr.msg->hsk_write_seq;
+		gnutls_dtls_prestate_set(session, &prestate);
+	}
+
 	if (ws->req.use_psk && ws->session) {
 		oclog(ws, LOG_INFO, "setting up DTLS-PSK connection");
 		ret = setup_dtls_psk_keys(session, ws);
@@ -387,7 +1088,32 @@ static int setup_dtls_connection(struct worker_st *ws)
 	/* reset MTU */
 	link_mtu_set(ws, ws->adv_link_mtu);
 
+	if (ws->dtls_tptr.txq == NULL) {
+		ws->dtls_tptr.txq = dtls_txq_init(ws, WSCONFIG(ws)->dtls_tx_queue_size,
+						  ws->adv_link_mtu,
+						  WSCONFIG(ws)->dtls_tx_drop_head);
+		if (ws->dtls_tptr.txq == NULL) {
+			oclog(ws, LOG_ERR, "could not allocate DTLS transmit queue");
+			goto fail;
+		}
+	}
+
+#ifdef USE_DTLS_MMSG
+	if (WSCONFIG(ws)->packet_batch_size > 1 && ws->dtls_tptr.mmsg == NULL) {
+		/* no record we send will exceed the MTU we advertised, but
+		 * the peer's may, e.g., its MTU probes */
+		ws->dtls_tptr.mmsg = dtls_mmsg_init(ws, ws->dtls_tptr.fd,
+						    WSCONFIG(ws)->packet_batch_size,
+						    ws->adv_link_mtu,
+						    sizeof(ws->buffer),
+						    WSCONFIG(ws)->udp_gso);
+		if (ws->dtls_tptr.mmsg == NULL)
+			oclog(ws, LOG_INFO, "could not allocate DTLS batching buffers");
+	}
+#endif
+
 	ws->dtls_session = session;
+	dtls_udp_gro_check(ws, ws->dtls_tptr.fd);
 
 	return 0;
  fail:
@@ -474,9 +1200,15 @@ void send_stats_to_secmod(worker_st * ws, time_t now, unsigned discon_reason)
 		ret = send_msg_to_secmod(ws, sd, CMD_SEC_CLI_STATS, &msg,
 				 (pack_size_func)cli_stats_msg__get_packed_size,
 				 (pack_func) cli_stats_msg__pack);
-		if (discon_reason) /* wait for sec-mod to close connection to verify data have been accounted */
+		if (ret >= 0 && discon_reason) {
+			/* this is our last request; sec-mod closes the connection
+			 * once it is read, which verifies the data have been accounted */
+			shutdown(sd, SHUT_WR);
 			read(sd, buf, sizeof(buf));
-		close(sd);
+			disconnect_from_secmod(ws);
+		} else if (ret < 0) {
+			disconnect_from_secmod(ws);
+		}
 
 		if (ret >= 0) {
 			oclog(ws, LOG_INFO,
@@ -500,6 +1232,12 @@ void exit_worker(worker_st * ws)
 
 void exit_worker_reason(worker_st * ws, unsigned reason)
 {
+#ifdef ENABLE_WORKER_THREADS
+	/* the transmit thread calls this with tx_lock held */
+	if (ws->tx_thread && !pthread_equal(pthread_self(), ws->tx_tid))
+		tx_lock(ws);
+#endif
+
 	/* send statistics to parent */
 	if (ws->auth_state == S_AUTH_COMPLETE) {
 		send_stats_to_secmod(ws, time(0), reason);
@@ -508,7 +1246,9 @@ void exit_worker_reason(worker_st * ws, unsigned reason)
 	if (ws->ban_points > 0)
 		ws_add_score_to_ip(ws, 0, 1);
 
-	talloc_free(ws->main_pool);
+	/* the other thread may still be using it */
+	if (ws->tx_thread == 0)
+		talloc_free(ws->main_pool);
 	closelog();
 	_exit(1);
 }
@@ -729,6 +1469,11 @@ void vpn_server(struct worker_st *ws)
 	 * prevents worker processes tracing each other. */
 	if (GETPCONFIG(ws)->debug == 0)
 		pr_set_undumpable("worker");
+#ifdef ENABLE_IO_URING
+	/* the ring cannot be created once the system calls are restricted */
+	if (GETCONFIG(ws)->io_uring)
+		worker_uring_init(ws);
+#endif
 	if (GETCONFIG(ws)->isolate != 0) {
 		ret = disable_system_calls(ws);
 		if (ret < 0) {
@@ -781,20 +1526,41 @@ void vpn_server(struct worker_st *ws)
 #endif
 		}
 
-		gnutls_transport_set_ptr(session,
-				 (gnutls_transport_ptr_t) (long)ws->conn_fd);
+		if (GETCONFIG(ws)->ktls) {
+			gnutls_transport_set_ptr(session,
+					 (gnutls_transport_ptr_t) (long)ws->conn_fd);
+			gnutls_transport_set_pull_timeout_function(session, tls_pull_timeout_fd);
+		} else {
+			gnutls_transport_set_ptr(session, &ws->conn_fd);
+			gnutls_transport_set_pull_function(session, tls_pull);
+			gnutls_transport_set_vec_push_function(session, tls_vec_push);
+			gnutls_transport_set_pull_timeout_function(session, tls_pull_timeout);
+		}
 
 		set_resume_db_funcs(session);
 		gnutls_db_set_ptr(session, ws);
 
 		gnutls_handshake_set_timeout(session, GNUTLS_DEFAULT_HANDSHAKE_TIMEOUT);
-		gnutls_transport_set_pull_timeout_function(session, tls_pull_timeout);
 		do {
 			ret = gnutls_handshake(session);
 		} while (ret < 0 && gnutls_error_is_fatal(ret) == 0);
 		GNUTLS_FATAL_ERR(ret);
 
+		if (ws->accept_time != 0)
+			ws->handshake_us = MIN(gettime_mono_us() - ws->accept_time, UINT_MAX);
+
 		oclog(ws, LOG_DEBUG, "TLS handshake completed");
+
+#ifdef HAVE_GNUTLS_KTLS
+		/* this is the state of the session whatever the option */
+		ws->ktls = gnutls_transport_is_ktls_enabled(session);
+		if (ws->ktls != 0)
+			oclog(ws, LOG_DEBUG, "kernel TLS is enabled for%s%s",
+			      (ws->ktls & GNUTLS_KTLS_SEND) ? " send" : "",
+			      (ws->ktls & GNUTLS_KTLS_RECV) ? " receive" : "");
+		else if (GETCONFIG(ws)->ktls)
+			oclog(ws, LOG_INFO, "kernel TLS is not available for this session; using TLS in user space");
+#endif
 	} else {
 		ws->vhost = find_vhost(ws->vconfig, NULL);
 
@@ -923,6 +1689,47 @@ void vpn_server(struct worker_st *ws)
 	cstp_close(ws);
 }
 
+/* vpn_server_wait:
+ * @ws: an initialized worker structure, without a connection
+ *
+ * This is the main function of a pre-forked worker. It waits for
+ * main to pass it an accepted connection, and then serves it with
+ * vpn_server(). It exits if main closes the command socket instead.
+ */
+void vpn_server_wait(struct worker_st *ws)
+{
+	WorkerStartMsg *msg = NULL;
+	int fd = -1;
+	int ret;
+	PROTOBUF_ALLOCATOR(pa, ws);
+
+	ret = recv_socket_msg(ws, ws->cmd_fd, CMD_WORKER_START, &fd,
+			      (void *)&msg,
+			      (unpack_func) worker_start_msg__unpack, 0);
+	if (ret == ERR_PEER_TERMINATED)
+		exit(0);
+
+	if (ret < 0 || fd == -1 ||
+	    msg->remote_addr.len > sizeof(ws->remote_addr) ||
+	    msg->our_addr.len > sizeof(ws->our_addr)) {
+		oclog(ws, LOG_ERR, "error receiving the connection from main");
+		exit(1);
+	}
+
+	memcpy(&ws->remote_addr, msg->remote_addr.data, msg->remote_addr.len);
+	ws->remote_addr_len = msg->remote_addr.len;
+	memcpy(&ws->our_addr, msg->our_addr.data, msg->our_addr.len);
+	ws->our_addr_len = msg->our_addr.len;
+
+	ws->conn_fd = fd;
+	ws->conn_type = msg->sock_type;
+	ws->accept_time = msg->accept_time;
+
+	worker_start_msg__free_unpacked(msg, &pa);
+
+	vpn_server(ws);
+}
+
 static
 void data_mtu_send(worker_st * ws, unsigned mtu)
 {
@@ -966,6 +1773,17 @@ void session_info_send(worker_st * ws)
 		msg.hostname = ws->req.hostname;
 	}
 
+	if (ws->ktls != 0) {
+		msg.ktls = ws->ktls;
+		msg.has_ktls = 1;
+	}
+
+	if (ws->handshake_us != 0) {
+		msg.handshake_us = ws->handshake_us;
+		msg.has_handshake_us = 1;
+		ws->handshake_us = 0;
+	}
+
 	if (WSCONFIG(ws)->listen_proxy_proto) {
 		msg.our_addr.data = (uint8_t*)&ws->our_addr;
 		msg.our_addr.len = ws->our_addr_len;
@@ -983,6 +1801,38 @@ void session_info_send(worker_st * ws)
 	gnutls_free(msg.dtls_ciphersuite);
 }
 
+static void worker_stats_send(worker_st * ws)
+{
+	WorkerStatsMsg msg = WORKER_STATS_MSG__INIT;
+
+	msg.batch_wakeups = ws->batch_wakeups;
+	msg.has_batch_wakeups = 1;
+	msg.batch_packets = ws->batch_packets;
+	msg.has_batch_packets = 1;
+
+	if (ws->dtls_tptr.txq != NULL) {
+		msg.dtls_tx_queued = ws->dtls_tptr.txq->count;
+		msg.has_dtls_tx_queued = 1;
+		msg.dtls_tx_dropped = ws->dtls_tptr.txq->dropped;
+		msg.has_dtls_tx_dropped = 1;
+	}
+
+	if (ws->fq != NULL) {
+		msg.fq_flows = ws->fq->active_flows;
+		msg.has_fq_flows = 1;
+		msg.fq_queued = ws->fq->queued;
+		msg.has_fq_queued = 1;
+		msg.fq_overlimit_drops = ws->fq->overlimit_drops;
+		msg.has_fq_overlimit_drops = 1;
+		msg.fq_codel_drops = ws->fq->codel_drops;
+		msg.has_fq_codel_drops = 1;
+	}
+
+	send_msg_to_main(ws, CMD_WORKER_STATS, &msg,
+			 (pack_size_func) worker_stats_msg__get_packed_size,
+			 (pack_func) worker_stats_msg__pack);
+}
+
 /* link_mtu_set: Sets the link MTU for the session
  *
  * @ws: a worker structure
@@ -1181,12 +2031,8 @@ int periodic_check(worker_st * ws, struct timespec *tnow, unsigned dpd)
 	time_t now = tnow->tv_sec;
 	time_t periodic_check_time = PERIODIC_CHECK_TIME;
 
-	/* modify timers with a fuzzying factor, to prevent all worker processes
-	 * to act at exactly the same time (e.g., after a server restart on which
-	 * all clients reconnect at the same time). */
-	FUZZ(periodic_check_time, 5, tnow->tv_nsec);
-
-	if (now - ws->last_periodic_check < periodic_check_time)
+	if (now < ws->next_periodic_check &&
+	    ws->next_periodic_check - now <= PERIODIC_CHECK_TIME + 5)
 		return 0;
 
 	/* we set an alarm at each periodic check to prevent any
@@ -1196,10 +2042,13 @@ int periodic_check(worker_st * ws, struct timespec *tnow, unsigned dpd)
 	alarm(1800);
 
 	if (WSCONFIG(ws)->idle_timeout > 0) {
-		if (now - ws->last_nc_msg > WSCONFIG(ws)->idle_timeout) {
+		/* both threads update it */
+		time_t last_nc_msg = __atomic_load_n(&ws->last_nc_msg, __ATOMIC_RELAXED);
+
+		if (now - last_nc_msg > WSCONFIG(ws)->idle_timeout) {
 			oclog(ws, LOG_ERR,
 			      "idle timeout reached for process (%d secs)",
-			      (int)(now - ws->last_nc_msg));
+			      (int)(now - last_nc_msg));
 			terminate = 1;
 			terminate_reason = REASON_IDLE_TIMEOUT;
 			goto cleanup;
@@ -1223,6 +2072,10 @@ int periodic_check(worker_st * ws, struct timespec *tnow, unsigned dpd)
 		send_stats_to_secmod(ws, now, 0);
 	}
 
+	if (ws->batch_wakeups > 0 ||
+	    (ws->dtls_tptr.txq != NULL && ws->dtls_tptr.txq->dropped > 0))
+		worker_stats_send(ws);
+
 	/* check DPD. Otherwise exit */
 	if (ws->udp_state == UP_ACTIVE &&
 	    now - ws->last_msg_udp > DPD_TRIES * dpd && dpd > 0) {
@@ -1243,6 +2096,11 @@ int periodic_check(worker_st * ws, struct timespec *tnow, unsigned dpd)
 			ws->udp_state = UP_INACTIVE;
 		}
 	}
+
+	/* a client which lost its DTLS channel may come back to its own
+	 * port from another address */
+	if (ws->udp_state == UP_INACTIVE)
+		dtls_port_release(ws);
 	if (dpd > 0 && now - ws->last_msg_tcp > DPD_TRIES * dpd) {
 		oclog(ws, LOG_DEBUG,
 		      "have not received TCP DPD for long (%d secs)",
@@ -1276,11 +2134,30 @@ int periodic_check(worker_st * ws, struct timespec *tnow, unsigned dpd)
 	}
 
  cleanup:
-	ws->last_periodic_check = now;
+	/* modify timers with a fuzzying factor, to prevent all worker processes
+	 * to act at exactly the same time (e.g., after a server restart on which
+	 * all clients reconnect at the same time). */
+	FUZZ(periodic_check_time, 5, tnow->tv_nsec);
+	ws->next_periodic_check = now + periodic_check_time;
 
 	return 0;
 }
 
+/* The time until the next periodic check, which is the longest an idle
+ * worker needs to sleep. */
+static unsigned periodic_check_wait_ms(worker_st *ws, struct timespec *tnow)
+{
+	time_t secs;
+
+	if (tnow->tv_sec >= ws->next_periodic_check)
+		return 0;
+
+	/* the clock went backwards */
+	secs = MIN(ws->next_periodic_check - tnow->tv_sec, PERIODIC_CHECK_TIME + 5);
+
+	return secs * 1000 - tnow->tv_nsec / (1000 * 1000);
+}
+
 #define TOSCLASS(x) (IPTOS_CLASS_CS##x)
 
 static void set_net_priority(worker_st * ws, int fd, int priority)
@@ -1315,16 +2192,22 @@ static void set_net_priority(worker_st * ws, int fd, int priority)
 
 #define SEND_ERR(x) if (x<0) goto send_error
 
+/* Returns a negative number on error, 1 if a data channel packet
+ * was processed, and zero otherwise.
+ */
 static int dtls_mainloop(worker_st * ws, struct timespec *tnow)
 {
-	int ret;
+	int ret, processed = 0;
 	gnutls_datum_t data;
 	void *packet = NULL;
 
 	switch (ws->udp_state) {
 	case UP_ACTIVE:
 	case UP_INACTIVE:
+		tx_unlock(ws);
 		ret = dtls_recv_packet(ws, &data, &packet);
+		if (ret < 1)
+			tx_lock(ws);
 		oclog(ws, LOG_TRANSFER_DEBUG,
 		      "received %d byte(s) (DTLS)", ret);
 
@@ -1347,6 +2230,12 @@ static int dtls_mainloop(worker_st * ws, struct timespec *tnow)
 			oclog(ws, LOG_DEBUG,
 			      "client requested rehandshake on DTLS channel");
 
+			/* the handshake messages cannot wait for the end of the batch */
+			if (dtls_tx_batch_end(ws) < 0) {
+				ret = -1;
+				goto cleanup;
+			}
+
 			do {
 				ret = gnutls_handshake(ws->dtls_session);
 			} while (ret == GNUTLS_E_AGAIN
@@ -1357,21 +2246,21 @@ static int dtls_mainloop(worker_st * ws, struct timespec *tnow)
 
 			ws->last_dtls_rehandshake = tnow->tv_sec;
 		} else if (ret >= 1) {
+			processed = 1;
+
+			ret =
+			    parse_dtls_data(ws, data.data, data.size,
+					    tnow->tv_sec);
+			tx_lock(ws);
+			if (ret < 0) {
+				oclog(ws, LOG_INFO,
+				      "error parsing CSTP data");
+				goto cleanup;
+			}
+
 			/* where we receive any DTLS UDP packet we reset the state
 			 * to active */
 			ws->udp_state = UP_ACTIVE;
-
-			if (bandwidth_update
-			    (&ws->b_rx, data.size - CSTP_DTLS_OVERHEAD, tnow) != 0) {
-				ret =
-				    parse_dtls_data(ws, data.data, data.size,
-						    tnow->tv_sec);
-				if (ret < 0) {
-					oclog(ws, LOG_INFO,
-					      "error parsing CSTP data");
-					goto cleanup;
-				}
-			}
 		} else
 			oclog(ws, LOG_TRANSFER_DEBUG,
 			      "no data received (%d)", ret);
@@ -1431,19 +2320,29 @@ static int dtls_mainloop(worker_st * ws, struct timespec *tnow)
 		break;
 	}
 
-	ret = 0;
+	ret = processed;
  cleanup:
  	packet_deinit(packet);
 	return ret;
 }
 
+/* Returns a negative number on error, 1 if a data channel packet
+ * was processed, and zero otherwise.
+ */
 static int tls_mainloop(struct worker_st *ws, struct timespec *tnow)
 {
-	int ret;
+	int ret, processed = 0;
 	gnutls_datum_t data;
 	void *packet = NULL;
 
+	/* a TLS 1.3 record may be a key update, which changes the keys
+	 * the transmit thread uses; these are received with tx_lock */
+	if (ws->session == NULL ||
+	    gnutls_protocol_get_version(ws->session) != GNUTLS_TLS1_3)
+		tx_unlock(ws);
 	ret = cstp_recv_packet(ws, &data, &packet);
+	if (ret < 8)
+		tx_lock(ws);
 	if (ret == GNUTLS_E_PREMATURE_TERMINATION) {
 		oclog(ws, LOG_DEBUG, "client disconnected prematurely");
 		ret = -1;
@@ -1458,24 +2357,45 @@ static int tls_mainloop(struct worker_st *ws, struct timespec *tnow)
 		goto cleanup;
 	} else if (ret >= 8) {
 		oclog(ws, LOG_TRANSFER_DEBUG, "received %d byte(s) (TLS)", data.size);
+		processed = 1;
 
-		if (bandwidth_update(&ws->b_rx, data.size - 8, tnow) != 0) {
-			ret = parse_cstp_data(ws, data.data, data.size, tnow->tv_sec);
-			if (ret < 0) {
-				oclog(ws, LOG_ERR, "error parsing CSTP data");
-				goto cleanup;
-			}
+		ret = parse_cstp_data(ws, data.data, data.size, tnow->tv_sec);
+		tx_lock(ws);
+		if (ret < 0) {
+			oclog(ws, LOG_ERR, "error parsing CSTP data");
+			goto cleanup;
+		}
 
-			if ((ret == AC_PKT_DATA || ret == AC_PKT_COMPRESSED) && ws->udp_state == UP_ACTIVE) {
-				/* client switched to TLS for some reason */
-				if (tnow->tv_sec - ws->udp_recv_time >
-				    UDP_SWITCH_TIME)
-					ws->udp_state = UP_INACTIVE;
-			}
+		if (data.data[6] == AC_PKT_DATA && ws->udp_state == UP_ACTIVE) {
+			/* if we received a data packet in the CSTP channel we assume that
+			 * our peer wants to switch to it as the communication channel */
+			ws->udp_state = UP_INACTIVE;
+		}
+
+		if ((ret == AC_PKT_DATA || ret == AC_PKT_COMPRESSED) && ws->udp_state == UP_ACTIVE) {
+			/* client switched to TLS for some reason */
+			if (tnow->tv_sec - ws->udp_recv_time >
+			    UDP_SWITCH_TIME)
+				ws->udp_state = UP_INACTIVE;
 		}
 
 	} else if (ret == GNUTLS_E_REHANDSHAKE) {
 		/* rekey? */
+		if (ws->ktls != 0) {
+			/* the keys in the kernel cannot be renegotiated; the
+			 * client was told to use the new-tunnel method */
+			oclog(ws, LOG_INFO,
+			      "client requested TLS rehandshake, which is refused with kernel TLS");
+			ret = gnutls_alert_send(ws->session, GNUTLS_AL_WARNING,
+						GNUTLS_A_NO_RENEGOTIATION);
+			if (ret < 0 && gnutls_error_is_fatal(ret)) {
+				ret = -1;
+				goto cleanup;
+			}
+			ret = processed;
+			goto cleanup;
+		}
+
 		if (ws->last_tls_rehandshake > 0 &&
 		    tnow->tv_sec - ws->last_tls_rehandshake <
 		    WSCONFIG(ws)->rekey_time / 2) {
@@ -1487,6 +2407,13 @@ static int tls_mainloop(struct worker_st *ws, struct timespec *tnow)
 
 		oclog(ws, LOG_INFO,
 		      "client requested rehandshake on TLS channel");
+
+		/* the buffered packets are sent before the handshake */
+		if (cstp_batch_end(ws) < 0) {
+			ret = -1;
+			goto cleanup;
+		}
+
 		do {
 			ret = gnutls_handshake(ws->session);
 		} while (ret < 0 && gnutls_error_is_fatal(ret) == 0);
@@ -1496,45 +2423,53 @@ static int tls_mainloop(struct worker_st *ws, struct timespec *tnow)
 		oclog(ws, LOG_INFO, "TLS rehandshake completed");
 	}
 
-	ret = 0;
+	ret = processed;
  cleanup:
  	packet_deinit(packet);
 	return ret;
 }
 
-static int tun_mainloop(struct worker_st *ws, struct timespec *tnow)
+/* Writes a packet received from the client to the tun device.
+ */
+static int tun_write_pkt(struct worker_st *ws, const void *data, size_t size)
 {
-	int ret, l, e;
-	unsigned tls_retry;
-	int dtls_type = AC_PKT_DATA;
-	int cstp_type = AC_PKT_DATA;
-	gnutls_datum_t dtls_to_send;
-	gnutls_datum_t cstp_to_send;
+	int ret, e;
 
-	l = tun_read(ws->tun_fd, ws->buffer + 8, DATA_MTU(ws, ws->link_mtu));
-	if (l < 0) {
+	oclog(ws, LOG_TRANSFER_DEBUG, "writing %d byte(s) to TUN",
+	      (int)size);
+#ifdef ENABLE_IO_URING
+	if (ws->uring != NULL)
+		ret = worker_uring_tun_write(ws, data, size);
+	else
+#endif
+		ret = tun_write(ws->tun_fd, data, size);
+	if (ret == -1) {
 		e = errno;
-
-		if (e != EAGAIN && e != EINTR) {
-			oclog(ws, LOG_ERR,
-			      "received corrupt data from tun (%d): %s",
-			      l, strerror(e));
-			return -1;
-		}
-
-		return 0;
+		oclog(ws, LOG_ERR, "could not write data to tun: %s",
+		      strerror(e));
+		return -1;
 	}
+	ws->tun_bytes_in += size;
 
-	if (l == 0) {
-		oclog(ws, LOG_INFO, "TUN device returned zero");
-		return 0;
-	}
+	return 0;
+}
 
+/* Sends the l bytes of the packet at ws->tx_buffer + 8, read from
+ * the tun device, to the client.
+ */
+static int tun_send(struct worker_st *ws, int l, struct timespec *tnow)
+{
+	int ret;
+	unsigned tls_retry;
+	int dtls_type = AC_PKT_DATA;
+	int cstp_type = AC_PKT_DATA;
+	gnutls_datum_t dtls_to_send;
+	gnutls_datum_t cstp_to_send;
 
-	dtls_to_send.data = ws->buffer;
+	dtls_to_send.data = ws->tx_buffer;
 	dtls_to_send.size = l;
 
-	cstp_to_send.data = ws->buffer;
+	cstp_to_send.data = ws->tx_buffer;
 	cstp_to_send.size = l;
 
 	if (WSCONFIG(ws)->switch_to_tcp_timeout &&
@@ -1547,16 +2482,16 @@ static int tun_mainloop(struct worker_st *ws, struct timespec *tnow)
 
 	if (ws->udp_state == UP_ACTIVE && ws->dtls_selected_comp != NULL && l > WSCONFIG(ws)->no_compress_limit) {
 		/* otherwise don't compress */
-		ret = ws->dtls_selected_comp->compress(ws->decomp+8, sizeof(ws->decomp)-8, ws->buffer+8, l);
+		ret = ws->dtls_selected_comp->compress(ws->tx_decomp+8, sizeof(ws->decomp)-8, ws->tx_buffer+8, l);
 		oclog(ws, LOG_TRANSFER_DEBUG, "compressed %d to %d\n", (int)l, ret);
 		if (ret > 0 && ret < l) {
-			dtls_to_send.data = ws->decomp;
+			dtls_to_send.data = ws->tx_decomp;
 			dtls_to_send.size = ret;
 			dtls_type = AC_PKT_COMPRESSED;
 
 			if (ws->cstp_selected_comp) {
 				if (ws->cstp_selected_comp->id == ws->dtls_selected_comp->id) {
-					cstp_to_send.data = ws->decomp;
+					cstp_to_send.data = ws->tx_decomp;
 					cstp_to_send.size = ret;
 					cstp_type = AC_PKT_COMPRESSED;
 				}
@@ -1564,62 +2499,338 @@ static int tun_mainloop(struct worker_st *ws, struct timespec *tnow)
 		}
 	} else if (ws->cstp_selected_comp != NULL && l > WSCONFIG(ws)->no_compress_limit) {
 		/* otherwise don't compress */
-		ret = ws->cstp_selected_comp->compress(ws->decomp+8, sizeof(ws->decomp)-8, ws->buffer+8, l);
+		ret = ws->cstp_selected_comp->compress(ws->tx_decomp+8, sizeof(ws->decomp)-8, ws->tx_buffer+8, l);
 		oclog(ws, LOG_TRANSFER_DEBUG, "compressed %d to %d\n", (int)l, ret);
 		if (ret > 0 && ret < l) {
-			cstp_to_send.data = ws->decomp;
+			cstp_to_send.data = ws->tx_decomp;
 			cstp_to_send.size = ret;
 			cstp_type = AC_PKT_COMPRESSED;
 		}
 	}
 
-	/* only transmit if allowed */
-	if (bandwidth_update(&ws->b_tx, dtls_to_send.size, tnow)
-	    != 0) {
-		tls_retry = 0;
+	tls_retry = 0;
 
-		oclog(ws, LOG_TRANSFER_DEBUG, "sending %d byte(s)\n", l);
+	oclog(ws, LOG_TRANSFER_DEBUG, "sending %d byte(s)\n", l);
 
-		if (ws->udp_state == UP_ACTIVE) {
+	if (ws->udp_state == UP_ACTIVE) {
 
-			ws->tun_bytes_out += dtls_to_send.size;
+		ws->tun_bytes_out += dtls_to_send.size;
 
-			dtls_to_send.data[7] = dtls_type;
-			ret = dtls_send(ws, dtls_to_send.data + 7, dtls_to_send.size + 1);
-			DTLS_FATAL_ERR_CMD(ret, exit_worker_reason(ws, REASON_ERROR));
+		dtls_to_send.data[7] = dtls_type;
+		ret = dtls_send(ws, dtls_to_send.data + 7, dtls_to_send.size + 1);
+		DTLS_FATAL_ERR_CMD(ret, exit_worker_reason(ws, REASON_ERROR));
 
-			if (ret == GNUTLS_E_LARGE_PACKET) {
-				mtu_not_ok(ws);
+		if (ret == GNUTLS_E_LARGE_PACKET) {
+			mtu_not_ok(ws);
+
+			oclog(ws, LOG_TRANSFER_DEBUG,
+			      "retrying (TLS) %d\n", l);
+			tls_retry = 1;
+		} else if (ret >= 1+DATA_MTU(ws, ws->link_mtu) &&
+			   WSCONFIG(ws)->try_mtu != 0) {
+			mtu_ok(ws);
+		}
+	}
+
+	if (ws->udp_state != UP_ACTIVE || tls_retry != 0) {
+		cstp_to_send.data[0] = 'S';
+		cstp_to_send.data[1] = 'T';
+		cstp_to_send.data[2] = 'F';
+		cstp_to_send.data[3] = 1;
+		cstp_to_send.data[4] = cstp_to_send.size >> 8;
+		cstp_to_send.data[5] = cstp_to_send.size & 0xff;
+		cstp_to_send.data[6] = cstp_type;
+		cstp_to_send.data[7] = 0;
+
+		ws->tun_bytes_out += cstp_to_send.size;
+
+		ret = cstp_send(ws, cstp_to_send.data, cstp_to_send.size + 8);
+		CSTP_FATAL_ERR_CMD(ws, ret, exit_worker_reason(ws, REASON_ERROR));
+	}
+	__atomic_store_n(&ws->last_nc_msg, tnow->tv_sec, __ATOMIC_RELAXED);
+
+	return 1;
+}
+
+/* The clock of the fair queueing scheduler, in microseconds */
+static uint64_t fq_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Returns a negative number on error, 1 if a packet was read from
+ * the tun device, and zero otherwise.
+ */
+static int tun_mainloop(struct worker_st *ws, struct timespec *tnow)
+{
+	int l, e;
+
+#ifdef ENABLE_IO_URING
+	if (ws->uring != NULL)
+		l = worker_uring_tun_read(ws, ws->tx_buffer + 8, DATA_MTU(ws, ws->link_mtu));
+	else
+#endif
+		l = tun_read(ws->tun_fd, ws->tx_buffer + 8, DATA_MTU(ws, ws->link_mtu));
+	if (l < 0) {
+		e = errno;
+
+		if (e != EAGAIN && e != EINTR) {
+			oclog(ws, LOG_ERR,
+			      "received corrupt data from tun (%d): %s",
+			      l, strerror(e));
+			return -1;
+		}
+
+		return 0;
+	}
+
+	if (l == 0) {
+		oclog(ws, LOG_INFO, "TUN device returned zero");
+		return 0;
+	}
+
+	/* the scheduler decides when the packet is sent; see
+	 * tun_fq_send() */
+	if (ws->fq != NULL) {
+		if (worker_fq_enqueue(ws->fq, ws->tx_buffer + 8, l, fq_now()) < 0)
+			oclog(ws, LOG_TRANSFER_DEBUG,
+			      "dropped %d byte(s) over the queue limit", l);
+		return 1;
+	}
+
+	/* only transmit if allowed; otherwise hold the packet
+	 * until the rate allows it */
+	if (bandwidth_update(&ws->b_tx, l, tnow) == 0) {
+		if (bandwidth_queue(&ws->b_tx, ws->tx_buffer + 8, l) < 0)
+			oclog(ws, LOG_TRANSFER_DEBUG,
+			      "dropped %d byte(s) exceeding the tx rate", l);
+		return 1;
+	}
+
+	return tun_send(ws, l, tnow);
+}
+
+/* Sends the packets queued in the fair queueing scheduler, until the
+ * DTLS socket or the bandwidth shaper cannot take more. The packets
+ * left wait in their flow queues, where CoDel controls their delay.
+ */
+static int tun_fq_send(struct worker_st *ws, struct timespec *tnow)
+{
+	uint64_t now = fq_now();
+	ssize_t l;
+	int ret;
+
+	while (ws->fq->queued > 0 && ws->b_tx.queue_count == 0) {
+		if (ws->udp_state == UP_ACTIVE && ws->dtls_tptr.txq != NULL &&
+		    ws->dtls_tptr.txq->count > 0)
+			break;
+
+		l = worker_fq_dequeue(ws->fq, ws->tx_buffer + 8,
+				      ws->buffer_size - 8, now);
+		if (l <= 0)
+			break;
 
+		if (bandwidth_update(&ws->b_tx, l, tnow) == 0) {
+			if (bandwidth_queue(&ws->b_tx, ws->tx_buffer + 8, l) < 0)
 				oclog(ws, LOG_TRANSFER_DEBUG,
-				      "retrying (TLS) %d\n", l);
-				tls_retry = 1;
-			} else if (ret >= 1+DATA_MTU(ws, ws->link_mtu) &&
-				   WSCONFIG(ws)->try_mtu != 0) {
-				mtu_ok(ws);
-			}
+				      "dropped %d byte(s) exceeding the tx rate", (int)l);
+			break;
+		}
+
+		ret = tun_send(ws, l, tnow);
+		if (ret < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Writes the packets held by the receive bandwidth shaper to the
+ * tun device, as long as the rate allows it.
+ */
+static int bandwidth_release_rx(struct worker_st *ws, struct timespec *tnow)
+{
+	bandwidth_pkt_st pkt;
+	int ret;
+
+	while (bandwidth_dequeue(&ws->b_rx, tnow, &pkt) != 0) {
+		ret = tun_write_pkt(ws, pkt.data, pkt.size);
+		talloc_free(pkt.data);
+		if (ret < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Sends the packets held by the transmit bandwidth shaper to the
+ * client, as long as the rate allows it.
+ */
+static int bandwidth_release_tx(struct worker_st *ws, struct timespec *tnow)
+{
+	bandwidth_pkt_st pkt;
+	int ret;
+
+	while (bandwidth_dequeue(&ws->b_tx, tnow, &pkt) != 0) {
+		memcpy(ws->tx_buffer + 8, pkt.data, pkt.size);
+		talloc_free(pkt.data);
+
+		ret = tun_send(ws, pkt.size, tnow);
+		if (ret < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+#ifdef ENABLE_WORKER_THREADS
+/* The transmit thread: it reads the packets from the tun device, and
+ * encrypts and sends them to the client, while the main thread receives
+ * the client's packets; see tx_lock(). It holds tx_lock except while it
+ * waits for packets. The thread is created with the worker process, and
+ * waits until the tunnel is set up (tx_thread_start()).
+ */
+static void *tx_thread(void *arg)
+{
+	worker_st *ws = arg;
+	struct pollfd pfd[2];
+	struct timespec tnow;
+	unsigned tun_ready, wait_ms, i;
+	int ret;
+
+	pthread_mutex_lock(&ws->tx_lock);
+	while (ws->tx_thread == 0)
+		pthread_cond_wait(&ws->tx_start, &ws->tx_lock);
+
+	for (;;) {
+		pfd[0].fd = ws->tun_fd;
+		pfd[0].events = POLLIN;
+		pfd[0].revents = 0;
+
+		/* the records left in the DTLS transmit queue */
+		pfd[1].fd = -1;
+		pfd[1].events = POLLOUT;
+		pfd[1].revents = 0;
+		if (ws->udp_state > UP_WAIT_FD && ws->dtls_tptr.txq != NULL &&
+		    ws->dtls_tptr.txq->count > 0)
+			pfd[1].fd = ws->dtls_tptr.fd;
+
+		/* the descriptors may change while the lock is released; poll
+		 * for a limited time to catch up with them while records are
+		 * queued. Otherwise an idle thread sleeps until a packet
+		 * arrives or the shaper releases one. */
+		gettime(&tnow);
+		wait_ms = bandwidth_wait_ms(&ws->b_tx, &tnow);
+		if (pfd[1].fd != -1)
+			wait_ms = MIN(wait_ms, 1000);
+
+		pthread_mutex_unlock(&ws->tx_lock);
+		ret = poll(pfd, 2, wait_ms == UINT_MAX ? -1 : (int)wait_ms);
+		pthread_mutex_lock(&ws->tx_lock);
+
+		if (ret == -1 && errno != EINTR && errno != EAGAIN) {
+			oclog(ws, LOG_ERR, "error in the transmit thread: %s",
+			      strerror(errno));
+			exit_worker_reason(ws, REASON_ERROR);
 		}
 
-		if (ws->udp_state != UP_ACTIVE || tls_retry != 0) {
-			cstp_to_send.data[0] = 'S';
-			cstp_to_send.data[1] = 'T';
-			cstp_to_send.data[2] = 'F';
-			cstp_to_send.data[3] = 1;
-			cstp_to_send.data[4] = cstp_to_send.size >> 8;
-			cstp_to_send.data[5] = cstp_to_send.size & 0xff;
-			cstp_to_send.data[6] = cstp_type;
-			cstp_to_send.data[7] = 0;
+		gettime(&tnow);
+
+		if ((pfd[1].revents & POLLOUT) && dtls_txq_send(ws) < 0)
+			exit_worker_reason(ws, REASON_ERROR);
 
-			ws->tun_bytes_out += cstp_to_send.size;
+		tun_ready = pfd[0].revents & (POLLIN|POLLHUP);
 
-			ret = cstp_send(ws, cstp_to_send.data, cstp_to_send.size + 8);
-			CSTP_FATAL_ERR_CMD(ws, ret, exit_worker_reason(ws, REASON_ERROR));
+		if (ws->udp_state == UP_ACTIVE)
+			dtls_tx_batch_start(ws);
+		cstp_batch_start(ws);
+
+		if (bandwidth_release_tx(ws, &tnow) < 0)
+			exit_worker_reason(ws, REASON_ERROR);
+
+		for (i = 0; i < WSCONFIG(ws)->packet_batch_size && tun_ready; i++) {
+			ret = tun_mainloop(ws, &tnow);
+			if (ret < 0)
+				exit_worker_reason(ws, REASON_ERROR);
+			tun_ready = ret;
 		}
-		ws->last_nc_msg = tnow->tv_sec;
+
+		if (ws->fq != NULL && tun_fq_send(ws, &tnow) < 0)
+			exit_worker_reason(ws, REASON_ERROR);
+
+		if (cstp_batch_end(ws) < 0 || dtls_tx_batch_end(ws) < 0)
+			exit_worker_reason(ws, REASON_ERROR);
+	}
+
+	return NULL;
+}
+
+/* Creates the transmit thread of a new worker process. That happens
+ * before the process drops its privileges, since neither the process
+ * limit (RLIMIT_NPROC) nor the seccomp filter of the worker allow it
+ * afterwards. The thread has all signals blocked.
+ */
+int worker_tx_thread_init(worker_st *ws)
+{
+	sigset_t set, old;
+	int ret;
+
+	ret = pthread_mutex_init(&ws->tx_lock, NULL);
+	if (ret != 0)
+		return -1;
+
+	ret = pthread_cond_init(&ws->tx_start, NULL);
+	if (ret != 0)
+		goto fail_cond;
+
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &old);
+	ret = pthread_create(&ws->tx_tid, NULL, tx_thread, ws);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (ret != 0)
+		goto fail;
+
+	ws->tx_thread_ready = 1;
+	return 0;
+
+ fail:
+	pthread_cond_destroy(&ws->tx_start);
+ fail_cond:
+	pthread_mutex_destroy(&ws->tx_lock);
+	return -1;
+}
+
+/* Lets the transmit thread run. The calling thread holds tx_lock when
+ * this returns. */
+static int tx_thread_start(worker_st *ws)
+{
+	if (ws->tx_thread_ready == 0) {
+		oclog(ws, LOG_ERR, "the transmit thread is not available");
+		return -1;
+	}
+
+	ws->tx_buffer = talloc_size(ws, ws->buffer_size);
+	ws->tx_decomp = talloc_size(ws, sizeof(ws->decomp));
+	if (ws->tx_buffer == NULL || ws->tx_decomp == NULL) {
+		oclog(ws, LOG_ERR, "could not start the transmit thread");
+		talloc_free(ws->tx_buffer);
+		talloc_free(ws->tx_decomp);
+		ws->tx_buffer = ws->buffer;
+		ws->tx_decomp = ws->decomp;
+		return -1;
 	}
 
+	pthread_mutex_lock(&ws->tx_lock);
+	ws->tx_thread = 1;
+	ws->tx_locked = 1;
+	pthread_cond_signal(&ws->tx_start);
+
 	return 0;
 }
+#endif
 
 static
 char *replace_vals(worker_st *ws, const char *txt)
@@ -1788,6 +2999,7 @@ static int connect_handler(worker_st * ws)
 	struct http_req_st *req = &ws->req;
 	struct pollfd pfd[4];
 	unsigned pfd_size;
+	short udp_revents;
 	int max, ret, t;
 	char *p;
 	unsigned rnd;
@@ -1795,6 +3007,8 @@ static int connect_handler(worker_st * ws)
 	struct timespec tv;
 #endif
 	unsigned tls_pending, dtls_pending = 0, i;
+	unsigned tun_ready, tls_ready, dtls_ready, processed;
+	unsigned wait_ms;
 	struct timespec tnow;
 	unsigned ip6;
 	sigset_t emptyset, blockset;
@@ -1806,6 +3020,8 @@ static int connect_handler(worker_st * ws)
 	gnutls_rnd(GNUTLS_RND_NONCE, &rnd, sizeof(rnd));
 
 	ws->buffer_size = sizeof(ws->buffer);
+	ws->tx_buffer = ws->buffer;
+	ws->tx_decomp = ws->decomp;
 
 	cookie_authenticate_or_exit(ws);
 
@@ -1888,6 +3104,13 @@ static int connect_handler(worker_st * ws)
 	if (WSPCONFIG(ws)->udp_port != 0 && req->master_secret_set != 0) {
 		memcpy(ws->master_secret, req->master_secret, TLS_MASTER_SIZE);
 		ws->udp_state = UP_WAIT_FD;
+
+		/* with its own port the session does not wait for main */
+		if (ws->udp_port_fd != -1) {
+			set_non_block(ws->udp_port_fd);
+			dtls_udp_gro_check(ws, ws->udp_port_fd);
+			ws->udp_port_waiting = 1;
+		}
 	} else {
 		oclog(ws, LOG_DEBUG, "disabling UDP (DTLS) connection");
 	}
@@ -2097,8 +3320,10 @@ static int connect_handler(worker_st * ws)
 		SEND_ERR(ret);
 
 		/* if the peer isn't patched for safe renegotiation, always
-		 * require him to open a new tunnel. */
-		if (ws->session != NULL && gnutls_safe_renegotiation_status(ws->session) != 0)
+		 * require him to open a new tunnel. The same applies when the
+		 * keys are in the kernel, which cannot rehandshake. */
+		if (ws->session != NULL && gnutls_safe_renegotiation_status(ws->session) != 0 &&
+		    ws->ktls == 0)
 			method = WSCONFIG(ws)->rekey_method;
 		else
 			method = REKEY_METHOD_NEW_TUNNEL;
@@ -2158,6 +3383,12 @@ static int connect_handler(worker_st * ws)
 
 	set_socket_timeout(ws, ws->conn_fd);
 	set_non_block(ws->conn_fd);
+	/* allow draining the tun device without blocking */
+	set_non_block(ws->tun_fd);
+#ifdef ENABLE_IO_URING
+	if (GETCONFIG(ws)->io_uring && worker_uring_start(ws) < 0)
+		oclog(ws, LOG_INFO, "io_uring is not available; using poll()");
+#endif
 	set_net_priority(ws, ws->conn_fd, ws->user_config->net_priority);
 
 	if (ws->udp_state != UP_DISABLED) {
@@ -2171,7 +3402,7 @@ static int connect_handler(worker_st * ws)
 
 		ret =
 		    cstp_printf(ws, "X-DTLS-Port: %u\r\n",
-			       WSPCONFIG(ws)->udp_port);
+			       ws->udp_port_fd != -1 ? ws->dtls_port : WSPCONFIG(ws)->udp_port);
 		SEND_ERR(ret);
 
 		if (WSCONFIG(ws)->rekey_time > 0) {
@@ -2276,6 +3507,17 @@ static int connect_handler(worker_st * ws)
 		SEND_ERR(ret);
 	}
 
+	/* the packets of a batch are coalesced only for the clients which
+	 * announced it; kernel TLS uses TCP_CORK instead */
+	if (ws->cstp_coalescing) {
+		if (WSCONFIG(ws)->cstp_coalesce_size > 0 && ws->ktls == 0) {
+			ret = cstp_puts(ws, "X-CSTP-Coalescing: true\r\n");
+			SEND_ERR(ret);
+		} else {
+			ws->cstp_coalescing = 0;
+		}
+	}
+
 	ret = cstp_puts(ws, "\r\n");
 	SEND_ERR(ret);
 
@@ -2286,11 +3528,36 @@ static int connect_handler(worker_st * ws)
 	gettime(&tnow);
 	ws->last_msg_tcp = ws->last_msg_udp = ws->last_nc_msg = tnow.tv_sec;
 
-	bandwidth_init(&ws->b_rx, ws->user_config->rx_per_sec);
-	bandwidth_init(&ws->b_tx, ws->user_config->tx_per_sec);
+	if (WSCONFIG(ws)->fq_codel) {
+		ws->fq = worker_fq_init(ws, WSCONFIG(ws)->fq_codel_flows,
+					WSCONFIG(ws)->fq_codel_limit,
+					ws->link_mtu,
+					WSCONFIG(ws)->fq_codel_target,
+					WSCONFIG(ws)->fq_codel_interval, rnd);
+		if (ws->fq == NULL) {
+			oclog(ws, LOG_ERR, "could not allocate the packet scheduler");
+			exit_worker(ws);
+		}
+	}
+
+	if (bandwidth_init(ws, &ws->b_rx, ws->user_config->rx_per_sec,
+			   WSCONFIG(ws)->bandwidth_burst,
+			   WSCONFIG(ws)->bandwidth_queue_size, &tnow) < 0 ||
+	    bandwidth_init(ws, &ws->b_tx, ws->user_config->tx_per_sec,
+			   WSCONFIG(ws)->bandwidth_burst,
+			   WSCONFIG(ws)->bandwidth_queue_size, &tnow) < 0) {
+		oclog(ws, LOG_ERR, "could not allocate the bandwidth queues");
+		exit_worker(ws);
+	}
 
 	sigprocmask(SIG_BLOCK, &blockset, NULL);
 
+#ifdef ENABLE_WORKER_THREADS
+	/* on failure the packets are sent by this thread */
+	if (GETCONFIG(ws)->worker_tx_thread)
+		tx_thread_start(ws);
+#endif
+
 	/* worker main loop  */
 	for (;;) {
 		if (terminate != 0) {
@@ -2315,7 +3582,7 @@ static int connect_handler(worker_st * ws)
 		else
 			tls_pending = 0;
 
-		if (ws->udp_state > UP_WAIT_FD) {
+		if (ws->udp_state > UP_WAIT_FD && !ws->udp_port_waiting) {
 			dtls_pending = dtls_pull_buffer_non_empty(&ws->dtls_tptr);
 			if (ws->dtls_session != NULL)
 				dtls_pending +=
@@ -2328,6 +3595,7 @@ static int connect_handler(worker_st * ws)
 		pfd[1].revents = 0;
 		pfd[2].revents = 0;
 		pfd[3].revents = 0;
+		pfd_size = 0;
 
 		if (tls_pending == 0 && dtls_pending == 0) {
 			pfd[0].fd = ws->conn_fd;
@@ -2336,26 +3604,49 @@ static int connect_handler(worker_st * ws)
 			pfd[1].fd = ws->cmd_fd;
 			pfd[1].events = POLLIN;
 
-			pfd[2].fd = ws->tun_fd;
+			/* the transmit thread reads the tun device */
+			pfd[2].fd = ws->tx_thread ? -1 : ws->tun_fd;
 			pfd[2].events = POLLIN;
 
 			pfd_size = 3;
 
-			if (ws->udp_state > UP_WAIT_FD) {
+			if (ws->udp_port_waiting) {
+				pfd[3].fd = ws->udp_port_fd;
+				pfd[3].events = POLLIN;
+				pfd_size++;
+			} else if (ws->udp_state > UP_WAIT_FD) {
 				pfd[3].fd = ws->dtls_tptr.fd;
 				pfd[3].events = POLLIN;
+				if (ws->dtls_tptr.txq != NULL && ws->dtls_tptr.txq->count > 0)
+					pfd[3].events |= POLLOUT;
 				pfd_size++;
 			}
 
+			/* wake up when the packets held by the
+			 * bandwidth shaper can be sent, or for the next
+			 * periodic check; an idle session stays asleep
+			 * until then */
+			wait_ms = bandwidth_wait_ms(&ws->b_rx, &tnow);
+			if (ws->tx_thread == 0)
+				wait_ms = MIN(wait_ms, bandwidth_wait_ms(&ws->b_tx, &tnow));
+			wait_ms = MIN(wait_ms, periodic_check_wait_ms(ws, &tnow));
+
+			tx_unlock(ws);
 #ifdef HAVE_PPOLL
-			tv.tv_nsec = 0;
-			tv.tv_sec = 10;
-			ret = ppoll(pfd, pfd_size, &tv, &emptyset);
+			tv.tv_nsec = (wait_ms % 1000) * 1000 * 1000;
+			tv.tv_sec = wait_ms / 1000;
+# ifdef ENABLE_IO_URING
+			if (ws->uring != NULL)
+				ret = worker_uring_poll(ws, pfd, pfd_size, &tv, &emptyset);
+			else
+# endif
+				ret = ppoll(pfd, pfd_size, &tv, &emptyset);
 #else
 			sigprocmask(SIG_UNBLOCK, &blockset, NULL);
-			ret = poll(pfd, pfd_size, 10*1000);
+			ret = poll(pfd, pfd_size, wait_ms);
 			sigprocmask(SIG_BLOCK, &blockset, NULL);
 #endif
+			tx_lock(ws);
 			if (ret == -1) {
 				if (errno == EINTR || errno == EAGAIN)
 					continue;
@@ -2363,8 +3654,8 @@ static int connect_handler(worker_st * ws)
 				goto exit;
 			}
 
-			if ((pfd[0].revents | pfd[1].revents |
-			     pfd[2].revents | pfd[3].revents) & POLLERR) {
+			if ((pfd[0].revents | pfd[1].revents | pfd[2].revents |
+			     (pfd_size > 3 ? pfd[3].revents : 0)) & POLLERR) {
 				terminate_reason = REASON_ERROR;
 				goto exit;
 			}
@@ -2376,35 +3667,113 @@ static int connect_handler(worker_st * ws)
 			goto exit;
 		}
 
-		/* send pending data from tun device */
-		if (pfd[2].revents & (POLLIN|POLLHUP)) {
-			ret = tun_mainloop(ws, &tnow);
-			if (ret < 0) {
+		/* the UDP entry is only valid when it was polled */
+		udp_revents = pfd_size > 3 ? pfd[3].revents : 0;
+
+		if (udp_revents & POLLOUT) {
+			if (dtls_txq_send(ws) < 0) {
 				terminate_reason = REASON_ERROR;
 				goto exit;
 			}
 		}
 
-		/* read pending data from TCP channel */
-		if ((pfd[0].revents & (POLLIN|POLLHUP)) || tls_pending != 0) {
-			ret = tls_mainloop(ws, &tnow);
-			if (ret < 0) {
+		if (ws->udp_port_waiting && (udp_revents & POLLIN))
+			dtls_port_accept(ws);
+
+		tun_ready = pfd[2].revents & (POLLIN|POLLHUP);
+		tls_ready = (pfd[0].revents & (POLLIN|POLLHUP)) || tls_pending != 0;
+		dtls_ready = ws->udp_state > UP_WAIT_FD && !ws->udp_port_waiting &&
+		    ((udp_revents & (POLLIN|POLLHUP)) || dtls_pending != 0);
+
+		/* Process up to packet_batch_size packets from each channel
+		 * before polling again. The channels are served in turn so
+		 * that a busy direction cannot starve the others. A channel
+		 * drops out of the round once it has no more data. */
+		processed = 0;
+		if (ws->tx_thread == 0) {
+			if (ws->udp_state == UP_ACTIVE)
+				dtls_tx_batch_start(ws);
+			if (tun_ready || ws->b_tx.queue_count > 0 ||
+			    (ws->fq != NULL && ws->fq->queued > 0))
+				cstp_batch_start(ws);
+
+			if (bandwidth_release_tx(ws, &tnow) < 0) {
 				terminate_reason = REASON_ERROR;
 				goto exit;
 			}
 		}
 
-		/* read data from UDP channel */
-		if (ws->udp_state > UP_WAIT_FD &&
-		    ((pfd[3].revents & (POLLIN|POLLHUP)) || dtls_pending != 0)) {
+		if (bandwidth_release_rx(ws, &tnow) < 0) {
+			terminate_reason = REASON_ERROR;
+			goto exit;
+		}
+
+		for (i = 0; i < WSCONFIG(ws)->packet_batch_size &&
+		     (tun_ready | tls_ready | dtls_ready); i++) {
+			/* send pending data from tun device */
+			if (tun_ready) {
+				ret = tun_mainloop(ws, &tnow);
+				if (ret < 0) {
+					terminate_reason = REASON_ERROR;
+					goto exit;
+				}
+				tun_ready = ret;
+				processed += ret;
+			}
 
-			ret = dtls_mainloop(ws, &tnow);
-			if (ret < 0) {
-				terminate_reason = REASON_ERROR;
-				goto exit;
+			/* read pending data from TCP channel */
+			if (tls_ready) {
+				ret = tls_mainloop(ws, &tnow);
+				if (ret < 0) {
+					terminate_reason = REASON_ERROR;
+					goto exit;
+				}
+				/* the unix socket channel blocks on a partial
+				 * read; only drain it when it is TLS */
+				tls_ready = ret && ws->session != NULL;
+				processed += ret;
+			}
+
+			/* read data from UDP channel */
+			if (dtls_ready) {
+				ret = dtls_mainloop(ws, &tnow);
+				if (ret < 0) {
+					terminate_reason = REASON_ERROR;
+					goto exit;
+				}
+				dtls_ready = ret && ws->udp_state > UP_WAIT_FD;
+				processed += ret;
 			}
 		}
 
+		if (ws->fq != NULL && ws->tx_thread == 0 &&
+		    tun_fq_send(ws, &tnow) < 0) {
+			terminate_reason = REASON_ERROR;
+			goto exit;
+		}
+
+		if (cstp_batch_end(ws) < 0) {
+			terminate_reason = REASON_ERROR;
+			goto exit;
+		}
+		if (dtls_tx_batch_end(ws) < 0) {
+			terminate_reason = REASON_ERROR;
+			goto exit;
+		}
+#ifdef ENABLE_IO_URING
+		if (ws->uring != NULL && worker_uring_flush(ws) < 0) {
+			oclog(ws, LOG_ERR, "could not write data to tun: %s",
+			      strerror(errno));
+			terminate_reason = REASON_ERROR;
+			goto exit;
+		}
+#endif
+
+		if (processed > 0) {
+			ws->batch_wakeups++;
+			ws->batch_packets += processed;
+		}
+
 		/* read commands from command fd */
 		if (pfd[1].revents & (POLLIN|POLLHUP)) {
 			ret = handle_commands_from_main(ws);
@@ -2423,9 +3792,11 @@ static int connect_handler(worker_st * ws)
 	return 0;
 
  exit:
+	tx_lock(ws);
 	cstp_close(ws);
 	/*gnutls_deinit(ws->session); */
 	if (ws->udp_state == UP_ACTIVE && ws->dtls_session) {
+		dtls_tx_batch_end(ws);
 		dtls_close(ws);
 		/*gnutls_deinit(ws->dtls_session); */
 	}
@@ -2442,10 +3813,11 @@ static int connect_handler(worker_st * ws)
 static int parse_data(struct worker_st *ws, uint8_t *buf, size_t buf_size,
 		      time_t now, unsigned is_dtls)
 {
-	int ret, e;
+	int ret;
 	uint8_t *plain;
 	ssize_t plain_size;
 	unsigned head;
+	struct timespec tnow;
 
 	if (is_dtls == 0) { /* CSTP */
 		plain = buf + 8;
@@ -2457,6 +3829,10 @@ static int parse_data(struct worker_st *ws, uint8_t *buf, size_t buf_size,
 		head = buf[0];
 	}
 
+	/* only the data packets are handled without tx_lock */
+	if (head != AC_PKT_DATA && head != AC_PKT_COMPRESSED)
+		tx_lock(ws);
+
 	switch (head) {
 	case AC_PKT_DPD_RESP:
 		oclog(ws, LOG_TRANSFER_DEBUG, "received DPD response");
@@ -2537,17 +3913,23 @@ static int parse_data(struct worker_st *ws, uint8_t *buf, size_t buf_size,
 		plain = ws->decomp;
 		/* fall through */
 	case AC_PKT_DATA:
-		oclog(ws, LOG_TRANSFER_DEBUG, "writing %d byte(s) to TUN",
-		      (int)plain_size);
-		ret = tun_write(ws->tun_fd, plain, plain_size);
-		if (ret == -1) {
-			e = errno;
-			oclog(ws, LOG_ERR, "could not write data to tun: %s",
-			      strerror(e));
-			return -1;
+		__atomic_store_n(&ws->last_nc_msg, now, __ATOMIC_RELAXED);
+
+		/* hold the packet if it exceeds the receive rate */
+		if (ws->b_rx.kb_per_sec != 0) {
+			gettime(&tnow);
+			if (bandwidth_update(&ws->b_rx, plain_size, &tnow) == 0) {
+				if (bandwidth_queue(&ws->b_rx, plain, plain_size) < 0)
+					oclog(ws, LOG_TRANSFER_DEBUG,
+					      "dropped %d byte(s) exceeding the rx rate",
+					      (int)plain_size);
+				break;
+			}
 		}
-		ws->tun_bytes_in += plain_size;
-		ws->last_nc_msg = now;
+
+		ret = tun_write_pkt(ws, plain, plain_size);
+		if (ret < 0)
+			return -1;
 
 		break;
 	default:
@@ -2583,12 +3965,6 @@ static int parse_cstp_data(struct worker_st *ws,
 		return -1;
 	}
 
-	if (buf[6] == AC_PKT_DATA && ws->udp_state == UP_ACTIVE) {
-		/* if we received a data packet in the CSTP channel we assume that
-		 * our peer wants to switch to it as the communication channel */
-		ws->udp_state = UP_INACTIVE;
-	}
-
 	ret = parse_data(ws, buf, buf_size, now, 0);
 	/* whatever we received treat it as DPD response.
 	 * it indicates that the channel is alive */
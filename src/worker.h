@@ -33,9 +33,13 @@
 #include <common.h>
 #include <str.h>
 #include <worker-bandwidth.h>
+#include <worker-fq.h>
 #include <stdbool.h>
 #include <sys/un.h>
 #include <sys/uio.h>
+#ifdef ENABLE_WORKER_THREADS
+# include <pthread.h>
+#endif
 #include "vhost.h"
 
 typedef enum {
@@ -64,7 +68,8 @@ enum {
 	HEADER_CSTP_ENCODING,
 	HEADER_DTLS_ENCODING,
 	HEADER_SUPPORT_SPNEGO,
-	HEADER_AUTHORIZATION
+	HEADER_AUTHORIZATION,
+	HEADER_CSTP_COALESCING
 };
 
 enum {
@@ -158,6 +163,8 @@ typedef struct dtls_transport_ptr {
 	int fd;
 	UdpFdMsg *msg; /* holds the data of the first client hello */
 	int consumed;
+	struct dtls_mmsg_st *mmsg; /* recvmmsg()/sendmmsg() buffers, if any */
+	struct dtls_txq_st *txq; /* records waiting for the socket to be writable */
 } dtls_transport_ptr;
 
 /* Given a base MTU, this macro provides the DTLS plaintext data we can send;
@@ -181,6 +188,10 @@ typedef struct worker_st {
 	int cmd_fd;
 	int conn_fd;
 	sock_type_t conn_type; /* AF_UNIX or something else */
+	/* the monotonic time of accept(), and the time it took to
+	 * complete the TLS handshake after it, in microseconds */
+	uint64_t accept_time;
+	unsigned handshake_us;
 	
 	http_parser *parser;
 
@@ -196,6 +207,7 @@ typedef struct worker_st {
 
 	struct sockaddr_un secmod_addr;	/* sec-mod unix address */
 	socklen_t secmod_addr_len;
+	int secmod_fd; /* the connection to sec-mod; -1 if not open */
 
 	struct sockaddr_storage our_addr;	/* our address */
 	socklen_t our_addr_len;
@@ -213,13 +225,21 @@ typedef struct worker_st {
 
 	time_t last_nc_msg; /* last message that wasn't control, on any channel */
 
-	time_t last_periodic_check;
+	time_t next_periodic_check;
 
 	/* set after authentication */
 	dtls_transport_ptr dtls_tptr;
 	udp_port_state_t udp_state;
 	time_t udp_recv_time; /* time last udp packet was received */
 
+	/* the session's own DTLS socket (dtls-port-range), or -1; it is
+	 * connected to the client once its first packet arrives */
+	int udp_port_fd;
+	unsigned dtls_port;
+	unsigned udp_port_waiting; /* not connected to the client */
+	/* for the HelloVerifyRequest exchange on that socket */
+	gnutls_datum_t dtls_cookie_key;
+
 	/* protection from multiple rehandshakes */
 	time_t last_tls_rehandshake;
 	time_t last_dtls_rehandshake;
@@ -235,6 +255,9 @@ typedef struct worker_st {
 	bandwidth_st b_tx;
 	bandwidth_st b_rx;
 
+	/* fair queueing of the packets sent to the client */
+	worker_fq_st *fq;
+
 	/* ws->link_mtu: The MTU of the link of the connecting. The plaintext
 	 *  data we can send to the client (i.e., MTU of the tun device,
 	 *  can be accessed using the DATA_MTU() macro and this value. */
@@ -256,6 +279,23 @@ typedef struct worker_st {
 	/* Buffer used for decompression */
 	uint8_t decomp[16*1024];
 	unsigned buffer_size;
+	/* Buffers for the packets read from the tun device; they are
+	 * ws->buffer and ws->decomp unless the transmit thread is used */
+	uint8_t *tx_buffer;
+	uint8_t *tx_decomp;
+
+	/* the packets from the tun device are sent by a separate thread;
+	 * what both threads use is shared under tx_lock */
+	unsigned tx_thread;
+	/* set while the main thread holds tx_lock */
+	unsigned tx_locked;
+#ifdef ENABLE_WORKER_THREADS
+	/* set once the thread is created, with the worker process */
+	unsigned tx_thread_ready;
+	pthread_t tx_tid;
+	pthread_mutex_t tx_lock;
+	pthread_cond_t tx_start;
+#endif
 
 	/* the following are set only if authentication is complete */
 
@@ -281,10 +321,28 @@ typedef struct worker_st {
 	/* ban points to be sent on exit */
 	unsigned ban_points;
 
+	/* gnutls_transport_ktls_enable_flags_t of the TLS session */
+	unsigned ktls;
+
+	/* set when the main loop uses io_uring */
+	struct worker_uring_st *uring;
+
+	/* set when the client can take several CSTP packets in a TLS
+	 * record, and cstp-coalesce-size is set */
+	unsigned cstp_coalescing;
+	/* set while the CSTP packets of a batch are buffered by GnuTLS */
+	unsigned cstp_corked;
+	size_t cstp_corked_size;
+
 	/* tun device stats */
 	uint64_t tun_bytes_in;
 	uint64_t tun_bytes_out;
 
+	/* main loop wakeups which processed data, and the
+	 * number of packets processed in them */
+	uint64_t batch_wakeups;
+	uint64_t batch_packets;
+
 	/* information on the tun device addresses and network */
 	struct vpn_st vinfo;
 	unsigned default_route;
@@ -293,6 +351,10 @@ typedef struct worker_st {
 } worker_st;
 
 void vpn_server(struct worker_st* ws);
+void vpn_server_wait(struct worker_st* ws);
+#ifdef ENABLE_WORKER_THREADS
+int worker_tx_thread_init(struct worker_st *ws);
+#endif
 
 int auth_cookie(worker_st *ws, void* cookie, size_t cookie_size);
 int auth_user_deinit(worker_st *ws);
@@ -354,6 +416,9 @@ int complete_vpn_info(worker_st * ws,
 
 int send_tun_mtu(worker_st *ws, unsigned int mtu);
 int handle_commands_from_main(struct worker_st *ws);
+int dtls_port_accept(struct worker_st *ws);
+void dtls_port_release(struct worker_st *ws);
+void dtls_udp_gro_check(worker_st *ws, int fd);
 int disable_system_calls(struct worker_st *ws);
 void ocsigaltstack(struct worker_st *ws);
 
@@ -365,6 +430,9 @@ int ws_switch_auth_to_next(struct worker_st *ws);
 void ws_add_score_to_ip(worker_st *ws, unsigned points, unsigned final);
 
 int connect_to_secmod(worker_st * ws);
+void disconnect_from_secmod(worker_st * ws);
+/* the worker of this process, if it is one */
+extern struct worker_st *global_ws;
 inline static
 int send_msg_to_secmod(worker_st * ws, int sd, uint8_t cmd,
 		       const void *msg, pack_size_func get_size, pack_func pack)
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <arpa/inet.h>
+
+/* Unit test for the accept rate limits and the load shedding
+ * of main-admission.c.
+ */
+#include "../src/main-admission.c"
+
+#define MS 1000
+
+static socklen_t set_addr(struct sockaddr_storage *ss, const char *ip)
+{
+	struct sockaddr_in *a4 = (struct sockaddr_in *)ss;
+	struct sockaddr_in6 *a6 = (struct sockaddr_in6 *)ss;
+
+	memset(ss, 0, sizeof(*ss));
+	if (inet_pton(AF_INET, ip, &a4->sin_addr) == 1) {
+		a4->sin_family = AF_INET;
+		return sizeof(*a4);
+	}
+
+	assert(inet_pton(AF_INET6, ip, &a6->sin6_addr) == 1);
+	a6->sin6_family = AF_INET6;
+	return sizeof(*a6);
+}
+
+int main(void)
+{
+	void *pool = talloc_new(NULL);
+	admission_st a;
+	admission_bucket_st b;
+	struct sockaddr_storage ss;
+	socklen_t len;
+	uint64_t now = 1000 * MS;
+	unsigned i, shed;
+
+	/* one every 100ms without burst: the second has to wait */
+	memset(&b, 0, sizeof(b));
+	assert(admission_take(&b, 100 * MS, 1, now) != 0);
+	assert(admission_wait(&b, 100 * MS, 1, now) == 100 * MS);
+	assert(admission_take(&b, 100 * MS, 1, now + 40 * MS) == 0);
+	assert(admission_wait(&b, 100 * MS, 1, now + 40 * MS) == 60 * MS);
+	assert(admission_take(&b, 100 * MS, 1, now + 100 * MS) != 0);
+
+	/* a burst of 4 after a quiet period, then one per interval */
+	now += 10000 * MS;
+	for (i = 0; i < 4; i++) {
+		assert(admission_wait(&b, 100 * MS, 4, now) == 0);
+		assert(admission_take(&b, 100 * MS, 4, now) != 0);
+	}
+	assert(admission_take(&b, 100 * MS, 4, now) == 0);
+	assert(admission_wait(&b, 100 * MS, 4, now) == 100 * MS);
+	assert(admission_take(&b, 100 * MS, 4, now + 100 * MS) != 0);
+	assert(admission_take(&b, 100 * MS, 4, now + 100 * MS) == 0);
+
+	/* the networks have separate buckets; /24 for IPv4 and /64 for IPv6 */
+	assert(admission_init(pool, &a, 0x1234) == 0);
+	now += 10000 * MS;
+
+	len = set_addr(&ss, "192.168.1.1");
+	assert(admission_take_net(&a, &ss, len, 1000 * MS, 2, now) != 0);
+	len = set_addr(&ss, "192.168.1.200");
+	assert(admission_take_net(&a, &ss, len, 1000 * MS, 2, now) != 0);
+	assert(admission_take_net(&a, &ss, len, 1000 * MS, 2, now) == 0);
+	len = set_addr(&ss, "::ffff:192.168.1.7");
+	assert(admission_take_net(&a, &ss, len, 1000 * MS, 2, now) == 0);
+	len = set_addr(&ss, "192.168.2.1");
+	assert(admission_take_net(&a, &ss, len, 1000 * MS, 2, now) != 0);
+
+	len = set_addr(&ss, "2001:db8:0:1::1");
+	assert(admission_take_net(&a, &ss, len, 1000 * MS, 1, now) != 0);
+	len = set_addr(&ss, "2001:db8:0:1:ffff::2");
+	assert(admission_take_net(&a, &ss, len, 1000 * MS, 1, now) == 0);
+	len = set_addr(&ss, "2001:db8:0:2::1");
+	assert(admission_take_net(&a, &ss, len, 1000 * MS, 1, now) != 0);
+
+	len = set_addr(&ss, "192.168.1.1");
+	assert(admission_take_net(&a, &ss, len, 1000 * MS, 2, now + 1000 * MS) != 0);
+
+	/* no shedding below the threshold or without a limit */
+	for (i = 0; i < 1000; i++) {
+		assert(admission_shed(79, 100, 80, i) == 0);
+		assert(admission_shed(5000, 0, 80, i) == 0);
+		assert(admission_shed(99, 100, 0, i) == 0);
+		assert(admission_shed(100, 100, 80, i) != 0);
+	}
+
+	/* the rejected share grows with the load */
+	shed = 0;
+	for (i = 0; i < 2100; i++)
+		shed += admission_shed(80, 100, 80, i);
+	assert(shed == 100);
+	shed = 0;
+	for (i = 0; i < 2100; i++)
+		shed += admission_shed(90, 100, 80, i);
+	assert(shed == 1100);
+	shed = 0;
+	for (i = 0; i < 2100; i++)
+		shed += admission_shed(99, 100, 80, i);
+	assert(shed == 2000);
+
+	talloc_free(pool);
+	return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* Unit test for the token bucket shaper in worker-bandwidth.c. It
+ * checks the burst, the rate and the ordering of held packets.
+ */
+#include "../src/worker-bandwidth.c"
+
+#define RATE_KB 100
+#define BURST 20000
+#define PKT_SIZE 1000
+
+static void advance(struct timespec *t, unsigned ms)
+{
+	t->tv_nsec += (ms % 1000) * 1000 * 1000;
+	t->tv_sec += ms / 1000 + t->tv_nsec / (1000 * 1000 * 1000);
+	t->tv_nsec %= 1000 * 1000 * 1000;
+}
+
+int main(void)
+{
+	void *pool = talloc_new(NULL);
+	bandwidth_st b;
+	bandwidth_pkt_st pkt;
+	struct timespec now = { 1000, 0 };
+	uint8_t data[PKT_SIZE];
+	unsigned i, sent;
+
+	/* disabled */
+	assert(bandwidth_init(pool, &b, 0, 0, 8, &now) == 0);
+	for (i = 0; i < 1000; i++)
+		assert(bandwidth_update(&b, PKT_SIZE, &now) != 0);
+	assert(bandwidth_wait_ms(&b, &now) == UINT_MAX);
+
+	/* the default burst is never less than the largest packet */
+	assert(bandwidth_init(pool, &b, 1, 0, 0, &now) == 0);
+	assert(b.burst == MIN_BURST_BYTES);
+
+	assert(bandwidth_init(pool, &b, RATE_KB, BURST, 4, &now) == 0);
+
+	/* the burst is available at once */
+	for (sent = 0; bandwidth_update(&b, PKT_SIZE, &now) != 0; sent++);
+	assert(sent == BURST / PKT_SIZE);
+
+	/* then the rate applies: 100 bytes per millisecond */
+	advance(&now, 10);
+	assert(bandwidth_update(&b, PKT_SIZE, &now) != 0);
+	assert(bandwidth_update(&b, PKT_SIZE, &now) == 0);
+
+	/* packets are held in order, and dropped when the queue is full */
+	for (i = 0; i < 6; i++) {
+		memset(data, i, sizeof(data));
+		assert(bandwidth_queue(&b, data, PKT_SIZE) == (i < 4 ? 0 : -1));
+	}
+	assert(b.dropped == 2);
+
+	/* a held packet blocks the ones after it */
+	advance(&now, 10);
+	assert(bandwidth_update(&b, 1, &now) == 0);
+
+	assert(bandwidth_wait_ms(&b, &now) == 0);
+	for (i = 0; i < 4; i++) {
+		assert(bandwidth_dequeue(&b, &now, &pkt) != 0);
+		assert(pkt.size == PKT_SIZE && pkt.data[0] == i);
+		talloc_free(pkt.data);
+
+		if (i < 3) {
+			assert(bandwidth_dequeue(&b, &now, &pkt) == 0);
+			assert(bandwidth_wait_ms(&b, &now) == 10);
+			advance(&now, 10);
+		}
+	}
+	assert(bandwidth_dequeue(&b, &now, &pkt) == 0);
+	assert(bandwidth_wait_ms(&b, &now) == UINT_MAX);
+
+	/* an idle period refills no more than the burst */
+	advance(&now, 60 * 60 * 1000);
+	for (sent = 0; bandwidth_update(&b, PKT_SIZE, &now) != 0; sent++);
+	assert(sent == BURST / PKT_SIZE);
+
+	/* a clock going backwards adds no tokens */
+	now.tv_sec -= 100;
+	assert(bandwidth_update(&b, PKT_SIZE, &now) == 0);
+
+	talloc_free(pool);
+	return 0;
+}
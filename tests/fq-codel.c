@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* Unit test for the fair queueing scheduler in worker-fq.c. It checks
+ * that flows are served in turn, and that CoDel and the queue limit
+ * drop packets as expected.
+ */
+#include "../src/worker-fq.c"
+
+#define QUANTUM 1500
+#define MS 1000
+
+/* an IPv4 UDP packet of the given size from the given source port */
+static void udp_pkt(uint8_t *p, size_t size, unsigned port, unsigned seq)
+{
+	memset(p, 0, size);
+	p[0] = 0x45;
+	p[9] = 17;
+	p[12] = 10; p[15] = 1;
+	p[16] = 10; p[19] = 2;
+	p[20] = port >> 8;
+	p[21] = port & 0xff;
+	p[23] = 53;
+	p[28] = seq;
+}
+
+int main(void)
+{
+	void *pool = talloc_new(NULL);
+	worker_fq_st *fq;
+	uint8_t pkt[QUANTUM], out[QUANTUM];
+	uint64_t now = 1000 * MS;
+	unsigned i, bulk, sparse;
+	ssize_t ret;
+
+	fq = worker_fq_init(pool, 1024, 64, QUANTUM, 5, 100, 0);
+	assert(fq != NULL);
+	assert(worker_fq_dequeue(fq, out, sizeof(out), now) == 0);
+
+	/* a bulk flow has 32 packets queued, then a sparse flow sends one;
+	 * the sparse flow's packet is sent first as a new flow */
+	for (i = 0; i < 32; i++) {
+		udp_pkt(pkt, QUANTUM, 1000, i);
+		assert(worker_fq_enqueue(fq, pkt, QUANTUM, now) == 0);
+	}
+	assert(worker_fq_dequeue(fq, out, sizeof(out), now) == QUANTUM);
+	assert(out[21] == (1000 & 0xff) && out[28] == 0);
+
+	udp_pkt(pkt, 100, 2000, 0);
+	assert(worker_fq_enqueue(fq, pkt, 100, now) == 0);
+	assert(fq->active_flows == 2);
+	assert(worker_fq_dequeue(fq, out, sizeof(out), now) == 100);
+	assert(out[21] == (2000 & 0xff));
+
+	/* the packets of a flow stay in order */
+	for (i = 1; i < 32; i++) {
+		ret = worker_fq_dequeue(fq, out, sizeof(out), now);
+		assert(ret == QUANTUM && out[28] == i);
+	}
+	assert(fq->queued == 0);
+	assert(worker_fq_dequeue(fq, out, sizeof(out), now) == 0);
+	assert(fq->active_flows == 0);
+
+	/* two backlogged flows share the link equally */
+	for (i = 0; i < 16; i++) {
+		udp_pkt(pkt, QUANTUM, 1000, i);
+		assert(worker_fq_enqueue(fq, pkt, QUANTUM, now) == 0);
+		udp_pkt(pkt, QUANTUM, 3000, i);
+		assert(worker_fq_enqueue(fq, pkt, QUANTUM, now) == 0);
+	}
+	bulk = sparse = 0;
+	for (i = 0; i < 16; i++) {
+		assert(worker_fq_dequeue(fq, out, sizeof(out), now) == QUANTUM);
+		if (out[21] == (1000 & 0xff))
+			bulk++;
+		else
+			sparse++;
+	}
+	assert(bulk == 8 && sparse == 8);
+	while (worker_fq_dequeue(fq, out, sizeof(out), now) > 0);
+
+	/* the queue limit drops from the largest flow */
+	for (i = 0; i < 64; i++) {
+		udp_pkt(pkt, QUANTUM, 1000, i);
+		assert(worker_fq_enqueue(fq, pkt, QUANTUM, now) == 0);
+	}
+	udp_pkt(pkt, 100, 2000, 0);
+	assert(worker_fq_enqueue(fq, pkt, 100, now) == 0);
+	assert(fq->queued == 64 && fq->overlimit_drops == 1);
+	while (worker_fq_dequeue(fq, out, sizeof(out), now) > 0);
+
+	/* a standing queue above the target delay is controlled by CoDel */
+	for (i = 0; i < 200; i++) {
+		udp_pkt(pkt, QUANTUM, 1000, i);
+		assert(worker_fq_enqueue(fq, pkt, QUANTUM, now) >= 0);
+		if (i % 2 == 0) {
+			/* serve at half the arrival rate */
+			worker_fq_dequeue(fq, out, sizeof(out), now);
+		}
+		now += 2 * MS;
+	}
+	assert(fq->codel_drops > 0);
+
+	/* without delay there are no drops */
+	while (worker_fq_dequeue(fq, out, sizeof(out), now) > 0);
+	fq->codel_drops = 0;
+	for (i = 0; i < 200; i++) {
+		udp_pkt(pkt, QUANTUM, 1000, i);
+		assert(worker_fq_enqueue(fq, pkt, QUANTUM, now) == 0);
+		assert(worker_fq_dequeue(fq, out, sizeof(out), now) == QUANTUM);
+		now += 2 * MS;
+	}
+	assert(fq->codel_drops == 0);
+
+	talloc_free(pool);
+	return 0;
+}
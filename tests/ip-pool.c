@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <arpa/inet.h>
+
+/* Unit test for the IP lease pools of ip-pool.c.
+ */
+#include "../src/ip-pool.c"
+
+int main(void)
+{
+	void *pool = talloc_new(NULL);
+	ip_pool_st p;
+	uint8_t net[16], addr[16];
+	uint32_t i, n;
+	int64_t r;
+
+	/* a /24 of single addresses */
+	assert(inet_pton(AF_INET, "10.1.2.0", net) == 1);
+	assert(ip_pool_init(pool, &p, AF_INET, net, 24, 32) == 0);
+	assert(p.size == 256 && p.levels == 2);
+	ip_pool_reserve(&p, 0);
+	ip_pool_reserve(&p, 1);
+	ip_pool_reserve(&p, 255);
+	assert(p.reserved == 3);
+
+	/* the hint is preferred; otherwise the next free is taken */
+	assert(ip_pool_alloc(&p, 77) == 77);
+	assert(ip_pool_alloc(&p, 77) == 78);
+	assert(ip_pool_alloc(&p, 255) == 2);
+	assert(ip_pool_alloc(&p, 256 + 90) == 90);
+	ip_pool_free(&p, 77);
+	assert(ip_pool_alloc(&p, 76) == 76);
+	assert(ip_pool_alloc(&p, 76) == 77);
+
+	/* it fills up, and frees */
+	for (n = p.used; n < 253; n++)
+		assert(ip_pool_alloc(&p, 0) >= 0);
+	assert(ip_pool_alloc(&p, 5) == -1);
+	assert(p.used == 253);
+	ip_pool_free(&p, 130);
+	assert(ip_pool_alloc(&p, 3) == 130);
+	ip_pool_deinit(&p);
+
+	/* the largest pool at 99% utilization */
+	assert(ip_pool_init(pool, &p, AF_INET, net, 8, 32) == 0);
+	assert(p.size == 1 << 24 && p.levels == 4);
+	for (i = 0; i < p.size / 100 * 99; i++)
+		assert(ip_pool_alloc(&p, 0) == i);
+	for (i = 0; i < 1000; i++) {
+		r = ip_pool_alloc(&p, i * 7919);
+		assert(r == p.size / 100 * 99 + i);
+	}
+	ip_pool_free(&p, 12345);
+	assert(ip_pool_alloc(&p, 0) == 12345);
+	ip_pool_free(&p, 64 * 64 * 64 * 3 + 5);
+	assert(ip_pool_alloc(&p, 100) == 64 * 64 * 64 * 3 + 5);
+	ip_pool_deinit(&p);
+
+	/* ranges that are too large or empty */
+	assert(ip_pool_init(pool, &p, AF_INET, net, 7, 32) != 0);
+	assert(ip_pool_init(pool, &p, AF_INET, net, 32, 32) != 0);
+
+	/* the index is the bits between the prefixes */
+	assert(inet_pton(AF_INET, "10.1.2.0", net) == 1);
+	assert(ip_pool_init(pool, &p, AF_INET, net, 20, 32) == 0);
+	assert(inet_pton(AF_INET, "10.1.5.9", addr) == 1);
+	assert(ip_pool_index(&p, addr) == 0x509);
+	ip_pool_set_index(&p, addr, 0xabc);
+	assert(memcmp(addr, "\x0a\x01\x0a\xbc", 4) == 0);
+	ip_pool_deinit(&p);
+
+	assert(inet_pton(AF_INET6, "fd00:1::", net) == 1);
+	assert(ip_pool_init(pool, &p, AF_INET6, net, 48, 64) == 0);
+	assert(inet_pton(AF_INET6, "fd00:1:0:1234:ffff::1", addr) == 1);
+	assert(ip_pool_index(&p, addr) == 0x1234);
+	ip_pool_set_index(&p, addr, 0xfe);
+	assert(memcmp(addr + 6, "\x00\xfe\xff\xff", 4) == 0);
+	ip_pool_deinit(&p);
+
+	talloc_free(pool);
+	return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <gnutls/gnutls.h>
+#include <gnutls/crypto.h>
+
+/* A stand-in RADIUS server for the radius-latency-bench. It accepts
+ * every Access-Request, and answers every Accounting-Request, after
+ * the given delay; the requests are not blocked by the delayed ones,
+ * as with a slow but not overloaded server.
+ *
+ * Usage: radius-standin PORT SECRET DELAY-MS
+ */
+
+#define RAD_HDR_SIZE 20
+#define MAX_PACKET 4096
+#define MAX_PENDING 4096
+
+#define CODE_ACCESS_REQUEST 1
+#define CODE_ACCESS_ACCEPT 2
+#define CODE_ACCOUNTING_REQUEST 4
+#define CODE_ACCOUNTING_RESPONSE 5
+
+typedef struct pending_st {
+	uint64_t due_ms;
+	struct sockaddr_storage addr;
+	socklen_t addr_len;
+	uint8_t reply[RAD_HDR_SIZE];
+} pending_st;
+
+static pending_st pending[MAX_PENDING];
+static unsigned head, tail;
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Sets the reply to an empty one, with the Response Authenticator
+ * MD5(Code+ID+Length+RequestAuth+Attributes+Secret). */
+static int make_reply(uint8_t *reply, const uint8_t *req, const char *secret)
+{
+	uint8_t buf[RAD_HDR_SIZE + 256];
+	size_t secret_len = strlen(secret);
+
+	if (secret_len > 256)
+		return -1;
+
+	if (req[0] == CODE_ACCESS_REQUEST)
+		reply[0] = CODE_ACCESS_ACCEPT;
+	else if (req[0] == CODE_ACCOUNTING_REQUEST)
+		reply[0] = CODE_ACCOUNTING_RESPONSE;
+	else
+		return -1;
+
+	reply[1] = req[1];
+	reply[2] = 0;
+	reply[3] = RAD_HDR_SIZE;
+
+	memcpy(buf, reply, 4);
+	memcpy(buf + 4, req + 4, 16);
+	memcpy(buf + RAD_HDR_SIZE, secret, secret_len);
+
+	if (gnutls_hash_fast(GNUTLS_DIG_MD5, buf, RAD_HDR_SIZE + secret_len, reply + 4) < 0)
+		return -1;
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in sa;
+	struct pollfd pfd;
+	uint8_t req[MAX_PACKET];
+	const char *secret;
+	unsigned delay, served = 0;
+	uint64_t now;
+	pending_st *p;
+	ssize_t ret;
+	int fd, timeout;
+
+	if (argc != 4) {
+		fprintf(stderr, "usage: %s PORT SECRET DELAY-MS\n", argv[0]);
+		return 1;
+	}
+
+	secret = argv[2];
+	delay = atoi(argv[3]);
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd == -1) {
+		perror("socket");
+		return 1;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(atoi(argv[1]));
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == -1) {
+		perror("bind");
+		return 1;
+	}
+
+	printf("listening on 127.0.0.1:%s, replying after %u ms\n", argv[1], delay);
+	fflush(stdout);
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	for (;;) {
+		/* the delay is constant, so the replies are due in order */
+		now = now_ms();
+		while (head != tail && pending[head].due_ms <= now) {
+			p = &pending[head];
+			sendto(fd, p->reply, RAD_HDR_SIZE, 0,
+			       (struct sockaddr *)&p->addr, p->addr_len);
+			head = (head + 1) % MAX_PENDING;
+			if ((++served % 100) == 0) {
+				printf("served %u requests\n", served);
+				fflush(stdout);
+			}
+		}
+
+		timeout = -1;
+		if (head != tail)
+			timeout = pending[head].due_ms - now;
+
+		ret = poll(&pfd, 1, timeout);
+		if (ret == -1 && errno != EINTR) {
+			perror("poll");
+			return 1;
+		}
+		if (ret <= 0)
+			continue;
+
+		p = &pending[tail];
+		p->addr_len = sizeof(p->addr);
+		ret = recvfrom(fd, req, sizeof(req), 0,
+			       (struct sockaddr *)&p->addr, &p->addr_len);
+		if (ret < RAD_HDR_SIZE)
+			continue;
+
+		if ((tail + 1) % MAX_PENDING == head) {
+			fprintf(stderr, "too many pending requests; dropping one\n");
+			continue;
+		}
+
+		if (make_reply(p->reply, req, secret) < 0)
+			continue;
+
+		p->due_ms = now_ms() + delay;
+		tail = (tail + 1) % MAX_PENDING;
+	}
+
+	return 0;
+}
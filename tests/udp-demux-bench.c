@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Compares the kernel's demultiplexing of the DTLS datagrams of
+ * many sessions on loopback, in the two modes of the server:
+ *
+ *  shared:   one socket per session, bound to the shared udp-port
+ *            and connected to the client, as main creates them
+ *            in forward_udp_to_owner();
+ *  per-port: one unconnected socket per session, on its own port,
+ *            as with dtls-port-range.
+ *
+ * For each number of sessions it prints the cost of creating a
+ * session's socket, and of delivering a datagram from a random
+ * client to its session (send and receive).
+ *
+ * Usage: udp-demux-bench [PACKETS [SESSIONS...]]
+ */
+
+#define DEFAULT_PACKETS 200000
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int udp_socket(struct sockaddr_in *addr, int reuse)
+{
+	socklen_t len = sizeof(*addr);
+	int fd, y = 1;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	if (reuse)
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &y, sizeof(y));
+
+	if (bind(fd, (struct sockaddr *)addr, sizeof(*addr)) < 0) {
+		perror("bind");
+		exit(1);
+	}
+
+	if (getsockname(fd, (struct sockaddr *)addr, &len) < 0) {
+		perror("getsockname");
+		exit(1);
+	}
+
+	return fd;
+}
+
+static void run(const char *mode, unsigned sessions, unsigned packets)
+{
+	struct sockaddr_in listen_addr, addr, *server_addr;
+	int *server, *client;
+	int listen_fd = -1;
+	in_port_t client_port;
+	unsigned i, n;
+	uint64_t start, setup, deliver;
+	char buf[64];
+	int shared = (strcmp(mode, "shared") == 0);
+
+	server = calloc(sessions, sizeof(int));
+	client = calloc(sessions, sizeof(int));
+	server_addr = calloc(sessions, sizeof(*server_addr));
+	if (server == NULL || client == NULL || server_addr == NULL) {
+		fprintf(stderr, "memory error\n");
+		exit(1);
+	}
+
+	memset(&listen_addr, 0, sizeof(listen_addr));
+	listen_addr.sin_family = AF_INET;
+	listen_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (shared)
+		listen_fd = udp_socket(&listen_addr, 1);
+
+	/* the clients share a port on distinct loopback addresses, to
+	 * leave the ephemeral ports to the per-port sessions */
+	client_port = 0;
+	for (i = 0; i < sessions; i++) {
+		addr = listen_addr;
+		addr.sin_addr.s_addr = htonl(0x7f010000 + i + 1);
+		addr.sin_port = client_port;
+		client[i] = udp_socket(&addr, 0);
+		client_port = addr.sin_port;
+		server_addr[i] = addr; /* the client's address, for now */
+	}
+
+	start = now_ns();
+	for (i = 0; i < sessions; i++) {
+		if (shared) {
+			addr = listen_addr;
+			server[i] = udp_socket(&addr, 1);
+			if (connect(server[i], (struct sockaddr *)&server_addr[i],
+				    sizeof(server_addr[i])) < 0) {
+				perror("connect");
+				exit(1);
+			}
+		} else {
+			addr = listen_addr;
+			addr.sin_port = 0;
+			server[i] = udp_socket(&addr, 0);
+		}
+		server_addr[i] = addr;
+	}
+	setup = now_ns() - start;
+
+	memset(buf, 0x17, sizeof(buf));
+	srandom(1);
+
+	start = now_ns();
+	for (n = 0; n < packets; n++) {
+		i = random() % sessions;
+
+		if (sendto(client[i], buf, sizeof(buf), 0,
+			   (struct sockaddr *)&server_addr[i],
+			   sizeof(server_addr[i])) < 0) {
+			perror("sendto");
+			exit(1);
+		}
+
+		/* a misdelivered datagram would block here */
+		if (recv(server[i], buf, sizeof(buf), 0) < 0) {
+			perror("recv");
+			exit(1);
+		}
+	}
+	deliver = now_ns() - start;
+
+	printf("%-9s %8u sessions: %7.0f ns/session setup, %6.0f ns/datagram\n",
+	       mode, sessions, (double)setup / sessions,
+	       (double)deliver / packets);
+	fflush(stdout);
+
+	for (i = 0; i < sessions; i++) {
+		close(server[i]);
+		close(client[i]);
+	}
+	if (listen_fd != -1)
+		close(listen_fd);
+
+	free(server);
+	free(client);
+	free(server_addr);
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned default_sessions[] = { 10, 1000, 10000, 25000 };
+	unsigned packets = DEFAULT_PACKETS;
+	unsigned sessions, max_sessions = UINT_MAX;
+	struct rlimit rl;
+	int i, n;
+
+	if (argc > 1)
+		packets = atoi(argv[1]);
+	if (packets == 0) {
+		fprintf(stderr, "usage: %s [PACKETS [SESSIONS...]]\n", argv[0]);
+		return 1;
+	}
+
+	n = (argc > 2) ? argc - 2 : (int)(sizeof(default_sessions) / sizeof(default_sessions[0]));
+
+	/* a client and a server socket per session */
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+		getrlimit(RLIMIT_NOFILE, &rl);
+		max_sessions = (rl.rlim_cur - 16) / 2;
+	}
+
+	for (i = 0; i < n; i++) {
+		sessions = (argc > 2) ? (unsigned)atoi(argv[i + 2]) : default_sessions[i];
+		if (sessions == 0)
+			continue;
+		if (sessions > max_sessions) {
+			printf("%u sessions: skipped; the open files limit allows %u\n",
+			       sessions, max_sessions);
+			continue;
+		}
+		run("shared", sessions, packets);
+		run("per-port", sessions, packets);
+	}
+
+	return 0;
+}